@@ -446,6 +446,40 @@ async function updateCharts(temp, humid) {
         updateChartDisplay();
 }
 
+// Samples the device stored while this page was closed (GET /history, CSV)
+async function loadDeviceHistory() {
+    if (!chartsInitialized) return;
+    const sevenDaysAgo = Date.now() - (7 * 24 * 60 * 60 * 1000);
+    const newest = allChartData.length ? allChartData[allChartData.length - 1].timestamp : 0;
+    const from = Math.floor(Math.max(newest + 1000, sevenDaysAgo) / 1000);
+    try {
+        const response = await fetch(`/history?from=${from}`);
+        if (!response.ok) return;
+        const rows = (await response.text()).trim().split('\n').slice(1);
+        let added = 0;
+        rows.forEach(row => {
+            const [time, temp, humid] = row.split(',');
+            if (!temp || !humid) return;   // failed reads are empty
+            const date = new Date(Number(time) * 1000);
+            allChartData.push({
+                timestamp: date.getTime(),
+                dateStr: date.toLocaleDateString('en-US'),
+                timeStr: date.toLocaleTimeString('en-US', { hour: '2-digit', minute: '2-digit', second: '2-digit', hour12: false }),
+                temperature: Number(temp),
+                humidity: Number(humid)
+            });
+            added++;
+        });
+        if (added === 0) return;
+        allChartData.sort((a, b) => a.timestamp - b.timestamp);
+        saveToLocalStorage('allChartData', allChartData);
+        updateChartDisplay();
+        console.log(`Loaded ${added} points from device history`);
+    } catch (e) {
+        console.warn('Device history load failed:', e);
+    }
+}
+
 function getFilteredData() {
     let filtered = [...allChartData];
 
@@ -648,6 +682,11 @@ function initWebSocket() {
         console.log('WebSocket connected');
         setControlsEnabled(true);
         websocket.send('getReadings');
+        // Turns on alert acks and replays alerts missed while disconnected
+        ackAlerts();
+        // Device history is stamped with this clock
+        websocket.send(`clock:${Math.floor(Date.now() / 1000)}`);
+        loadDeviceHistory();
         reconnectDelay = 2000;
     };
 
@@ -689,9 +728,34 @@ function sendLockDoorCommand() {
     }
 }
 
+// Last alert seen, kept across reloads so a reconnect gets what it missed
+let lastAlert = loadFromLocalStorage('lastAlert', { boot: 0, seq: 0 });
+
+function ackAlerts() {
+    if (websocket && websocket.readyState === WebSocket.OPEN) {
+        websocket.send(`ack:${lastAlert.boot}:${lastAlert.seq}`);
+    }
+}
+
+// Alerts carry a sequence number and are sent again until acknowledged,
+// false for a copy already handled
+function acceptAlert(data) {
+    if (data.alertSeq === undefined) return true;
+    const repeat = data.boot === lastAlert.boot && data.alertSeq <= lastAlert.seq;
+    if (!repeat) {
+        lastAlert = { boot: data.boot, seq: data.alertSeq };
+        saveToLocalStorage('lastAlert', lastAlert);
+    }
+    ackAlerts();
+    return !repeat;
+}
+
 function onMessage(event) {
     try {
         const data = JSON.parse(event.data);
+        // Latency-traced frames (LATENCY_TRACE builds) are answered at once
+        if (data.trace !== undefined) websocket.send(`rx:${data.trace}`);
+        if (!acceptAlert(data)) return;
 
         // Temperature & Humidity
         const temp = parseFloat(data.temperature ?? data.temp);
@@ -711,6 +775,15 @@ function onMessage(event) {
             updateCharts(temp, humid);
         }
 
+        // Sensor health: readings are null while the DHT has no fresh value
+        if (data.dht === "stale" || data.dht === "failed") {
+            temperatureElement.textContent = "--";
+            humidityElement.textContent = "--";
+        }
+        if (data.dht !== undefined) {
+            temperatureElement.title = humidityElement.title = "DHT22: " + data.dht;
+        }
+
         // Heat Index Alerts
         if (data.heatIndexAlert !== undefined && data.heatIndex !== undefined) {
             handleHeatIndexAlert(data.heatIndexAlert, data.heatIndex);
@@ -0,0 +1,195 @@
+#include "allocTrack.h"
+
+#ifdef ALLOC_TRACK
+
+const int ALLOC_SITES = 16;
+const unsigned long SOAK_WARMUP_MS = 60000;
+// The largest free block moves with lwIP/AsyncTCP buffers: its lowest value
+// over SOAK_FLOOR_MS after the warm-up is the floor, and the soak fails when
+// it later drops more than SOAK_BLOCK_TOLERANCE below that
+const unsigned long SOAK_FLOOR_MS = 600000;
+const uint32_t SOAK_BLOCK_TOLERANCE = 2048;
+
+struct ScopeStats {
+    TaskHandle_t task;          // task inside the scope, nullptr when closed
+    uint32_t allocs;            // current pass
+    uint32_t bytes;
+    uint32_t passes;
+    uint32_t passesWithAllocs;
+    uint32_t totalAllocs;
+    uint32_t totalBytes;
+    uint32_t maxAllocs;
+    uint32_t steadyAllocs;      // allocations counted after the soak warm-up
+};
+
+struct AllocSite {
+    void* caller;
+    uint8_t scope;
+    uint32_t count;
+    uint32_t bytes;
+};
+
+static ScopeStats scopes[ALLOC_SCOPE_COUNT];
+static AllocSite sites[ALLOC_SITES];
+static portMUX_TYPE allocMux = portMUX_INITIALIZER_UNLOCKED;
+static bool soakSteady = false;
+static unsigned long soakStart = 0;
+static bool soakFloorSet = false;
+static uint32_t soakFloor = 0;
+static uint32_t soakMinLargestBlock = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+}
+
+// Runs inside malloc: must not allocate or print
+static void countAlloc(size_t size, void* caller) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&allocMux);
+    for (int s = 0; s < ALLOC_SCOPE_COUNT; s++) {
+        ScopeStats& st = scopes[s];
+        if (st.task != task) continue;
+
+        st.allocs++;
+        st.bytes += size;
+        if (soakSteady) st.steadyAllocs++;
+
+        for (int i = 0; i < ALLOC_SITES; i++) {
+            if (sites[i].count == 0) {
+                sites[i].caller = caller;
+                sites[i].scope = s;
+            }
+            if (sites[i].caller == caller && sites[i].scope == s) {
+                sites[i].count++;
+                sites[i].bytes += size;
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&allocMux);
+}
+
+extern "C" void* __wrap_malloc(size_t size) {
+    countAlloc(size, __builtin_return_address(0));
+    return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t n, size_t size) {
+    countAlloc(n * size, __builtin_return_address(0));
+    return __real_calloc(n, size);
+}
+
+extern "C" void* __wrap_realloc(void* ptr, size_t size) {
+    countAlloc(size, __builtin_return_address(0));
+    return __real_realloc(ptr, size);
+}
+
+void allocScopeBegin(AllocScope scope) {
+    portENTER_CRITICAL(&allocMux);
+    scopes[scope].task = xTaskGetCurrentTaskHandle();
+    scopes[scope].allocs = 0;
+    scopes[scope].bytes = 0;
+    portEXIT_CRITICAL(&allocMux);
+}
+
+void allocScopeEnd(AllocScope scope) {
+    portENTER_CRITICAL(&allocMux);
+    ScopeStats& st = scopes[scope];
+    st.task = nullptr;
+    st.passes++;
+    st.totalAllocs += st.allocs;
+    st.totalBytes += st.bytes;
+    if (st.allocs > 0) st.passesWithAllocs++;
+    if (st.allocs > st.maxAllocs) st.maxAllocs = st.allocs;
+    portEXIT_CRITICAL(&allocMux);
+}
+
+void startAllocSoak() {
+    uint32_t largest = ESP.getMaxAllocHeap();
+
+    if (!soakSteady) {
+        if (millis() < SOAK_WARMUP_MS) return;
+        soakSteady = true;
+        soakStart = millis();
+        soakFloor = largest;
+        Serial.println("Alloc soak: steady state from now, largest block " + String(largest));
+        return;
+    }
+    if (!soakFloorSet) {
+        if (largest < soakFloor) soakFloor = largest;
+        if (millis() - soakStart < SOAK_FLOOR_MS) return;
+        soakFloorSet = true;
+        soakMinLargestBlock = soakFloor;
+        Serial.println("Alloc soak: largest block floor " + String(soakFloor));
+        return;
+    }
+    if (largest < soakMinLargestBlock) soakMinLargestBlock = largest;
+}
+
+String allocStatsJson() {
+    static const char* const names[ALLOC_SCOPE_COUNT] = {"tick", "wsEvent", "commands", "send"};
+
+    ScopeStats copy[ALLOC_SCOPE_COUNT];
+    AllocSite siteCopy[ALLOC_SITES];
+    portENTER_CRITICAL(&allocMux);
+    memcpy(copy, scopes, sizeof(copy));
+    memcpy(siteCopy, sites, sizeof(siteCopy));
+    portEXIT_CRITICAL(&allocMux);
+
+    String json = "{\"enabled\":true,\"scopes\":{";
+    for (int s = 0; s < ALLOC_SCOPE_COUNT; s++) {
+        const ScopeStats& st = copy[s];
+        if (s) json += ",";
+        json += "\"" + String(names[s]) + "\":{";
+        json += "\"passes\":" + String(st.passes);
+        json += ",\"passesWithAllocs\":" + String(st.passesWithAllocs);
+        json += ",\"allocs\":" + String(st.totalAllocs);
+        json += ",\"bytes\":" + String(st.totalBytes);
+        json += ",\"maxPerPass\":" + String(st.maxAllocs);
+        json += ",\"steadyAllocs\":" + String(st.steadyAllocs) + "}";
+    }
+    json += "},\"sites\":[";
+    for (int i = 0; i < ALLOC_SITES && siteCopy[i].count; i++) {
+        char caller[12];
+        snprintf(caller, sizeof(caller), "0x%08lx", (unsigned long)(uintptr_t)siteCopy[i].caller);
+        if (i) json += ",";
+        json += "{\"scope\":\"" + String(names[siteCopy[i].scope]) + "\"";
+        json += ",\"caller\":\"" + String(caller) + "\"";
+        json += ",\"count\":" + String(siteCopy[i].count);
+        json += ",\"bytes\":" + String(siteCopy[i].bytes) + "}";
+    }
+
+    // Only our own scopes are held to zero, library send buffers are reported
+    bool pass = soakFloorSet &&
+                copy[ALLOC_SCOPE_TICK].steadyAllocs == 0 &&
+                copy[ALLOC_SCOPE_WS_EVENT].steadyAllocs == 0 &&
+                copy[ALLOC_SCOPE_COMMANDS].steadyAllocs == 0 &&
+                soakMinLargestBlock + SOAK_BLOCK_TOLERANCE >= soakFloor;
+    json += "],\"soak\":{\"steady\":" + String(soakSteady ? "true" : "false");
+    json += ",\"steadyMs\":" + String(soakSteady ? millis() - soakStart : 0);
+    json += ",\"largestBlockFloor\":" + String(soakFloorSet ? soakFloor : 0);
+    json += ",\"largestBlockMin\":" + String(soakFloorSet ? soakMinLargestBlock : 0);
+    json += ",\"toleranceBytes\":" + String(SOAK_BLOCK_TOLERANCE);
+    json += ",\"pass\":" + String(pass ? "true" : "false") + "}}";
+    return json;
+}
+
+#else
+
+void allocScopeBegin(AllocScope) {
+}
+
+void allocScopeEnd(AllocScope) {
+}
+
+void startAllocSoak() {
+}
+
+String allocStatsJson() {
+    return "{\"enabled\":false}";
+}
+
+#endif
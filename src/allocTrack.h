@@ -0,0 +1,31 @@
+#ifndef ALLOCTRACK_H
+#define ALLOCTRACK_H
+
+#include <Arduino.h>
+
+// Heap allocation tracking (build with ALLOC_TRACK, see env:esp32dev_alloctrack).
+// malloc/calloc/realloc are wrapped at link time; allocations made by the task
+// that opened a scope are counted per scope pass, with their call sites.
+// Without ALLOC_TRACK the scope calls are empty.
+enum AllocScope {
+    ALLOC_SCOPE_TICK,       // controlTick(): sensors, rooms, door, broadcasts
+    ALLOC_SCOPE_WS_EVENT,   // onWsEvent() on the AsyncTCP task
+    ALLOC_SCOPE_COMMANDS,   // drainCommands(): the loop running queued commands
+    ALLOC_SCOPE_SEND,       // startWsOutbox() (AsyncWebSocket message buffers)
+    ALLOC_SCOPE_COUNT
+};
+
+void allocScopeBegin(AllocScope scope);
+void allocScopeEnd(AllocScope scope);
+
+// Soak check: after a warm-up, any allocation in the tick, event and command
+// scopes fails it, and so does the largest free block falling more than a
+// tolerance below its floor (its lowest value over the first minutes).
+// Call every loop.
+// tools/alloc_soak.cpp runs the same scopes on the host for days.
+void startAllocSoak();
+
+// Per-scope counters, call sites and soak result
+String allocStatsJson();
+
+#endif
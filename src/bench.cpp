@@ -0,0 +1,223 @@
+#include "bench.h"
+
+#ifdef BENCH
+
+#include "doorSystem.h"
+#include "roomSystem_1.h"
+#include "roomSystem_2.h"
+#include "roomSystem_3.h"
+#include "lcd.h"
+#include "hal.h"
+#include "controlState.h"
+
+// Kernels under test that are not in the module headers
+void stateJson(char* out, size_t len);             // main.cpp
+void handleCommand(const char* msg);               // main.cpp
+void controlTick();                                // main.cpp
+void updateBaseline(int value);                    // roomSystem_2.cpp
+bool detectClap();                                 // roomSystem_2.cpp
+void autoAdaptEnvironment();                       // roomSystem_2.cpp
+void benchArmClap();                               // roomSystem_2.cpp
+void benchArmAdapt();                              // roomSystem_2.cpp
+extern int baselineSum;
+extern int sampleCount;
+
+// Each kernel runs BENCH_REPS batches; the median batch is the result
+const int BENCH_REPS = 15;
+const unsigned long BENCH_FIRST_RUN_MS = 10000;
+
+struct BenchKernel {
+    const char* name;
+    uint32_t iterations;    // per batch
+    void (*run)(uint32_t i);
+    bool panel;             // draws on the LCD, everything else is a dry run
+};
+
+struct BenchResult {
+    uint32_t medianNs;      // per iteration
+    uint32_t meanNs;
+    uint32_t minNs;
+    uint32_t maxNs;
+};
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile uint32_t sink = 0;
+
+static const char* const benchCommands[] = {
+    "room1:ON", "room1:AUTO", "room2:OFF", "room2:AUTO"
+};
+
+static void benchStateJson(uint32_t) {
+    char json[256];
+    stateJson(json, sizeof(json));
+    sink = sink + json[1];
+}
+
+static void benchCommand(uint32_t i) {
+    handleCommand(benchCommands[i & 3]);
+}
+
+static void benchBaseline(uint32_t i) {
+    updateBaseline(100 + (i * 37) % 64);
+}
+
+// Armed on every call, a clap found in the batch would otherwise hold off
+// the rest for the clap timeout
+static void benchClap(uint32_t) {
+    benchArmClap();
+    sink = sink + detectClap();
+}
+
+static void benchAdapt(uint32_t) {
+    benchArmAdapt();
+    autoAdaptEnvironment();
+}
+
+static void benchHeatIndex(uint32_t i) {
+    float t = 20.0f + (i % 20);
+    float h = 30.0f + (i % 60);
+    sink = sink + (uint32_t)dht22.computeHeatIndex(t, h, false);
+}
+
+static void benchHeatLevel(uint32_t i) {
+    sink = sink + checkHeatIndexLevel(20.0f + (i % 40));
+}
+
+// Same cursor/print pattern as the temperature field
+static void benchLcd(uint32_t i) {
+    lcd.setCursor(6, 2);
+    lcd.print((i & 1) ? "23.4" : "23.5");
+}
+
+static void benchTick(uint32_t) {
+    controlTick();
+}
+
+static const BenchKernel kernels[] = {
+    {"state_json",        200,  benchStateJson,  false},
+    {"ws_command",        100,  benchCommand,    false},
+    {"update_baseline",   1000, benchBaseline,   false},
+    {"detect_clap",       4,    benchClap,       false},
+    {"auto_adapt",        100,  benchAdapt,      false},
+    {"heat_index",        1000, benchHeatIndex,  false},
+    {"heat_index_level",  1000, benchHeatLevel,  false},
+    {"lcd_print",         20,   benchLcd,        true},
+    {"control_tick",      4,    benchTick,       false}
+};
+const int KERNEL_COUNT = sizeof(kernels) / sizeof(kernels[0]);
+
+static BenchResult results[KERNEL_COUNT];
+static bool haveResults = false;
+static volatile bool benchRequested = false;
+static bool firstRunDone = false;
+
+// Every batch starts from the control state saved before the suite
+static void runKernel(const BenchKernel& k, BenchResult& r, const uint8_t* saved) {
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    uint32_t samples[BENCH_REPS];
+
+    halSetDryRun(!k.panel);
+    restoreControlState(saved);
+    k.run(0);  // warm up caches and flash
+    for (int rep = 0; rep < BENCH_REPS; rep++) {
+        restoreControlState(saved);
+        uint32_t start = ESP.getCycleCount();
+        for (uint32_t i = 0; i < k.iterations; i++) k.run(i);
+        uint32_t cycles = ESP.getCycleCount() - start;
+        samples[rep] = (uint32_t)((uint64_t)cycles * 1000ULL / mhz / k.iterations);
+    }
+    halSetDryRun(false);
+
+    // Insertion sort, BENCH_REPS is small
+    for (int i = 1; i < BENCH_REPS; i++) {
+        uint32_t v = samples[i];
+        int j = i - 1;
+        while (j >= 0 && samples[j] > v) {
+            samples[j + 1] = samples[j];
+            j--;
+        }
+        samples[j + 1] = v;
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < BENCH_REPS; i++) sum += samples[i];
+    r.medianNs = samples[BENCH_REPS / 2];
+    r.meanNs = sum / BENCH_REPS;
+    r.minNs = samples[0];
+    r.maxNs = samples[BENCH_REPS - 1];
+}
+
+// The kernels run the real control code; everything it keeps is in the
+// control state registry, saved here and put back after the suite
+static void runSuite() {
+    uint8_t* saved = (uint8_t*)malloc(controlStateSize());
+    if (saved == nullptr) {
+        Serial.println("Bench: no memory for the control state");
+        return;
+    }
+    Serial.println("Bench: running " + String(KERNEL_COUNT) + " kernels");
+
+    saveControlState(saved);
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        runKernel(kernels[i], results[i], saved);
+        delay(1);
+    }
+    restoreControlState(saved);
+    free(saved);
+    showLCD();
+
+    haveResults = true;
+    Serial.println("BENCH " + benchResultsJson());
+}
+
+void requestBenchmarks() {
+    benchRequested = true;
+}
+
+// Runs once after boot has settled, then on request
+void startBenchmarks() {
+    if (!firstRunDone && millis() >= BENCH_FIRST_RUN_MS) {
+        firstRunDone = true;
+        benchRequested = true;
+    }
+    if (!benchRequested) return;
+    benchRequested = false;
+    runSuite();
+}
+
+String benchResultsJson() {
+    String json = "{\"context\":{";
+    json += "\"cpuMHz\":" + String(ESP.getCpuFreqMHz());
+    json += ",\"sdk\":\"" + String(ESP.getSdkVersion()) + "\"";
+    json += ",\"reps\":" + String(BENCH_REPS);
+    json += ",\"uptimeMs\":" + String(millis());
+    json += "},\"benchmarks\":[";
+    if (haveResults) {
+        for (int i = 0; i < KERNEL_COUNT; i++) {
+            const BenchResult& r = results[i];
+            if (i > 0) json += ",";
+            json += "{\"name\":\"" + String(kernels[i].name) + "\"";
+            json += ",\"iterations\":" + String(kernels[i].iterations);
+            json += ",\"median_ns\":" + String(r.medianNs);
+            json += ",\"mean_ns\":" + String(r.meanNs);
+            json += ",\"min_ns\":" + String(r.minNs);
+            json += ",\"max_ns\":" + String(r.maxNs) + "}";
+        }
+    }
+    json += "]}";
+    return json;
+}
+
+#else
+
+void requestBenchmarks() {
+}
+
+void startBenchmarks() {
+}
+
+String benchResultsJson() {
+    return "{\"enabled\":false}";
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+
+// On-device micro-benchmarks of the hot kernels (build with BENCH, see
+// env:esp32dev_bench). Each kernel runs in repeated batches timed with the
+// CPU cycle counter; results are printed as one "BENCH {...}" line and
+// served on GET /bench, and tools/bench_compare.py checks them against a
+// stored baseline. Every batch starts from the same saved control state and,
+// apart from lcd_print, runs as a HAL dry run (hal.h), so the door, lights,
+// DHT, panel and clients are left alone. Without BENCH these are empty.
+
+// Run the suite from the loop (it blocks the loop for a few seconds)
+void requestBenchmarks();
+void startBenchmarks();
+
+// Last results: {"context":{...},"benchmarks":[{name, iterations, *_ns}]}
+String benchResultsJson();
+
+#endif
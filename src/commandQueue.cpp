@@ -0,0 +1,225 @@
+#include "commandQueue.h"
+
+const int QUEUE_MAX_CLIENTS = 8;
+const int QUEUE_DEPTH = 4;
+const size_t COMMAND_LEN = 24;
+
+// Commands run per loop pass, taken round-robin across clients
+const int COMMAND_BATCH = 4;
+
+// Token bucket: TOKEN_BURST commands at once, then one per TOKEN_REFILL_MS
+const uint16_t TOKEN_BURST = 6;
+const unsigned long TOKEN_REFILL_MS = 250;
+
+struct ClientQueue {
+    bool used;
+    uint32_t id;
+    char commands[QUEUE_DEPTH][COMMAND_LEN];
+    uint8_t head;
+    uint8_t count;
+    uint16_t tokens;
+    unsigned long lastRefill;
+    bool refusing;              // refused since the last accepted command
+    unsigned long accepted;
+    unsigned long collapsed;
+    unsigned long rateLimited;
+    unsigned long queueFull;
+    unsigned long executed;
+};
+
+static ClientQueue queues[QUEUE_MAX_CLIENTS];
+static int nextQueue = 0;
+
+static unsigned long batches = 0;
+static unsigned long drainUsMax = 0;
+
+// admitCommand()/queueCommand() run on the AsyncTCP task, drainCommands()
+// on the loop
+static SemaphoreHandle_t queueLock = nullptr;
+
+static void lock() {
+    xSemaphoreTake(queueLock, portMAX_DELAY);
+}
+
+static void unlock() {
+    xSemaphoreGive(queueLock);
+}
+
+bool setCommandQueue() {
+    queueLock = xSemaphoreCreateMutex();
+    return queueLock != nullptr;
+}
+
+bool commandQueueConnect(uint32_t id) {
+    bool added = false;
+    lock();
+    for (int i = 0; i < QUEUE_MAX_CLIENTS && !added; i++) {
+        ClientQueue& q = queues[i];
+        if (q.used) continue;
+
+        memset(&q, 0, sizeof(q));
+        q.used = true;
+        q.id = id;
+        q.tokens = TOKEN_BURST;
+        q.lastRefill = millis();
+        added = true;
+    }
+    unlock();
+    return added;
+}
+
+void commandQueueDisconnect(uint32_t id) {
+    lock();
+    for (int i = 0; i < QUEUE_MAX_CLIENTS; i++) {
+        ClientQueue& q = queues[i];
+        if (q.used && q.id == id) q.used = false;
+    }
+    unlock();
+}
+
+static ClientQueue* findQueue(uint32_t id) {
+    for (int i = 0; i < QUEUE_MAX_CLIENTS; i++) {
+        if (queues[i].used && queues[i].id == id) return &queues[i];
+    }
+    return nullptr;
+}
+
+static void refill(ClientQueue& q, unsigned long now) {
+    unsigned long earned = (now - q.lastRefill) / TOKEN_REFILL_MS;
+    if (earned == 0) return;
+    if (q.tokens + earned >= TOKEN_BURST) {
+        q.tokens = TOKEN_BURST;
+        q.lastRefill = now;
+    } else {
+        q.tokens += earned;
+        q.lastRefill += earned * TOKEN_REFILL_MS;
+    }
+}
+
+static bool isDoorCommand(const char* msg) {
+    return strcmp(msg, "lockDoor") == 0 || strcmp(msg, "unlockDoor") == 0;
+}
+
+// "room1:ON" and "room1:AUTO" set the same thing, so do lock/unlockDoor
+static bool sameTarget(const char* a, const char* b) {
+    if (isDoorCommand(a) && isDoorCommand(b)) return true;
+    const char* colon = strchr(a, ':');
+    if (colon) return strncmp(a, b, colon - a + 1) == 0;
+    return strcmp(a, b) == 0;
+}
+
+// Only the first refusal in a row is worth telling the client about
+static CommandResult refusal(ClientQueue& q, CommandResult result) {
+    if (q.refusing) return CMD_REFUSED_AGAIN;
+    q.refusing = true;
+    return result;
+}
+
+CommandResult admitCommand(uint32_t id) {
+    CommandResult result;
+    lock();
+    ClientQueue* q = findQueue(id);
+    if (q == nullptr) {
+        result = CMD_REJECTED;
+    } else {
+        refill(*q, millis());
+        if (q->tokens == 0) {
+            q->rateLimited++;
+            result = refusal(*q, CMD_RATE_LIMITED);
+        } else {
+            q->tokens--;
+            result = CMD_ADMITTED;
+        }
+    }
+    unlock();
+    return result;
+}
+
+CommandResult queueCommand(uint32_t id, const char* msg) {
+    if (strlen(msg) >= COMMAND_LEN) return CMD_REJECTED;
+
+    CommandResult result;
+    lock();
+    ClientQueue* q = findQueue(id);
+    if (q == nullptr) {
+        result = CMD_REJECTED;
+    } else {
+        char* newest = q->count > 0 ? q->commands[(q->head + q->count - 1) % QUEUE_DEPTH] : nullptr;
+
+        if (newest != nullptr && sameTarget(newest, msg)) {
+            strcpy(newest, msg);
+            q->collapsed++;
+            q->refusing = false;
+            result = CMD_COLLAPSED;
+        } else if (q->count >= QUEUE_DEPTH) {
+            q->queueFull++;
+            result = refusal(*q, CMD_QUEUE_FULL);
+        } else {
+            strcpy(q->commands[(q->head + q->count) % QUEUE_DEPTH], msg);
+            q->count++;
+            q->accepted++;
+            q->refusing = false;
+            result = CMD_QUEUED;
+        }
+    }
+    unlock();
+    return result;
+}
+
+void drainCommands(void (*run)(const char*)) {
+    char batch[COMMAND_BATCH][COMMAND_LEN];
+    int n = 0;
+
+    // One command per client per round, until the batch is full
+    lock();
+    bool found = true;
+    while (n < COMMAND_BATCH && found) {
+        found = false;
+        for (int k = 0; k < QUEUE_MAX_CLIENTS && n < COMMAND_BATCH; k++) {
+            ClientQueue& q = queues[nextQueue];
+            nextQueue = (nextQueue + 1) % QUEUE_MAX_CLIENTS;
+            if (!q.used || q.count == 0) continue;
+
+            strcpy(batch[n++], q.commands[q.head]);
+            q.head = (q.head + 1) % QUEUE_DEPTH;
+            q.count--;
+            q.executed++;
+            found = true;
+        }
+    }
+    unlock();
+
+    if (n == 0) return;
+
+    unsigned long start = micros();
+    for (int i = 0; i < n; i++) run(batch[i]);
+    unsigned long elapsed = micros() - start;
+    batches++;
+    if (elapsed > drainUsMax) drainUsMax = elapsed;
+}
+
+String commandQueueStatsJson() {
+    String json = "{\"clients\":[";
+    lock();
+    bool first = true;
+    for (int i = 0; i < QUEUE_MAX_CLIENTS; i++) {
+        const ClientQueue& q = queues[i];
+        if (!q.used) continue;
+        if (!first) json += ",";
+        first = false;
+        json += "{\"id\":" + String(q.id);
+        json += ",\"depth\":" + String(q.count);
+        json += ",\"tokens\":" + String(q.tokens);
+        json += ",\"accepted\":" + String(q.accepted);
+        json += ",\"collapsed\":" + String(q.collapsed);
+        json += ",\"rateLimited\":" + String(q.rateLimited);
+        json += ",\"queueFull\":" + String(q.queueFull);
+        json += ",\"executed\":" + String(q.executed) + "}";
+    }
+    unlock();
+    json += "],\"batches\":" + String(batches);
+    json += ",\"drainUsMax\":" + String(drainUsMax);
+    json += "}";
+    drainUsMax = 0;
+    return json;
+}
@@ -0,0 +1,42 @@
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <Arduino.h>
+
+// Per-client WebSocket command queues.
+// Commands are queued by the AsyncTCP task and run by the loop, a few per
+// pass, taking one from each client in turn. Each client has a token bucket
+// (a short burst, then a steady rate) that every command it sends is
+// admitted through, queued or handled at once; commands over the limit are
+// refused. The dashboard's automatic replies (ack:, rx:, clock:) are not
+// commands and take no token. A command for the same target as the newest queued one (room1:,
+// room2:, door, ...) replaces it instead of queueing behind it.
+enum CommandResult {
+    CMD_ADMITTED,       // took a token, the caller handles the message
+    CMD_QUEUED,
+    CMD_COLLAPSED,      // replaced the newest queued command
+    CMD_RATE_LIMITED,
+    CMD_QUEUE_FULL,
+    CMD_REJECTED,       // too long, or no queue slot for the client
+    CMD_REFUSED_AGAIN   // only the first refusal in a row is reported
+};
+
+bool setCommandQueue();
+
+// Client bookkeeping (call from the WebSocket event handler); false when
+// every client slot is taken
+bool commandQueueConnect(uint32_t id);
+void commandQueueDisconnect(uint32_t id);
+
+// Take a token for a command from the client, before handling it
+CommandResult admitCommand(uint32_t id);
+// Queue an admitted command
+CommandResult queueCommand(uint32_t id, const char* msg);
+
+// Run up to one batch of queued commands, call every loop
+void drainCommands(void (*run)(const char*));
+
+// Per-client queue depth, collapsed/refused counters, drain timing
+String commandQueueStatsJson();
+
+#endif
@@ -0,0 +1,73 @@
+#include "controlState.h"
+
+struct StateEntry {
+    uint8_t* data;
+    uint8_t* replayCopy;
+    size_t size;
+    portMUX_TYPE* lock;
+};
+
+static StateEntry entries[CONTROL_STATE_MAX_ENTRIES];
+static int numEntries = 0;
+static size_t totalSize = 0;
+
+void keepControlState(void* data, size_t size, void* replayCopy, portMUX_TYPE* lock) {
+    if (numEntries >= CONTROL_STATE_MAX_ENTRIES) {
+        Serial.println("Control state: too many entries");
+        return;
+    }
+    StateEntry& e = entries[numEntries++];
+    e.data = (uint8_t*)data;
+    e.replayCopy = (uint8_t*)replayCopy;
+    e.size = size;
+    e.lock = lock;
+    totalSize += size;
+}
+
+size_t controlStateSize() {
+    return totalSize;
+}
+
+// Copy to or from a live table, under its lock if it has one
+static void copyLive(const StateEntry& e, void* to, const void* from) {
+    if (e.lock) portENTER_CRITICAL(e.lock);
+    memcpy(to, from, e.size);
+    if (e.lock) portEXIT_CRITICAL(e.lock);
+}
+
+void saveControlState(uint8_t* out) {
+    for (int i = 0; i < numEntries; i++) {
+        copyLive(entries[i], out, entries[i].data);
+        out += entries[i].size;
+    }
+}
+
+void restoreControlState(const uint8_t* in) {
+    for (int i = 0; i < numEntries; i++) {
+        copyLive(entries[i], entries[i].data, in);
+        in += entries[i].size;
+    }
+}
+
+void loadReplayState(const uint8_t* recorded, uint8_t* swap) {
+    for (int i = 0; i < numEntries; i++) {
+        const StateEntry& e = entries[i];
+        memcpy(e.replayCopy ? e.replayCopy : swap, recorded, e.size);
+        recorded += e.size;
+        swap += e.size;
+    }
+}
+
+void swapControlState(uint8_t* swap) {
+    for (int i = 0; i < numEntries; i++) {
+        const StateEntry& e = entries[i];
+        if (!e.replayCopy) {
+            for (size_t j = 0; j < e.size; j++) {
+                uint8_t b = e.data[j];
+                e.data[j] = swap[j];
+                swap[j] = b;
+            }
+        }
+        swap += e.size;
+    }
+}
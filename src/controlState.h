@@ -0,0 +1,42 @@
+#ifndef CONTROLSTATE_H
+#define CONTROLSTATE_H
+
+#include <Arduino.h>
+
+// Control state of the loop-side modules as one block of bytes.
+// Each module registers its statics once from its set*() function. The
+// block is recorded in every trace snapshot and put back when a replay
+// starts, swapped with the live values around each replay slice, and saved
+// around benchmark kernels (see sensorTrace.h, bench.h).
+// A module that already keeps a replay copy of a table (because another task
+// reads it) passes that copy too: replay starts from the snapshot in the copy
+// and the live table is never swapped. If that task reads the table under a
+// spinlock, the module passes the lock as well and the live table is only
+// saved and restored while holding it.
+
+const int CONTROL_STATE_MAX_ENTRIES = 80;
+
+void keepControlState(void* data, size_t size, void* replayCopy = nullptr,
+                      portMUX_TYPE* lock = nullptr);
+
+template <typename T>
+void keepControlState(T& value) {
+    keepControlState(&value, sizeof(value));
+}
+
+// Bytes in the block
+size_t controlStateSize();
+
+// Live values into / back from a block
+void saveControlState(uint8_t* out);
+void restoreControlState(const uint8_t* in);
+
+// Replay start: a recorded block goes into the replay copies, and into
+// swap for the rest
+void loadReplayState(const uint8_t* recorded, uint8_t* swap);
+
+// Exchange the values without a replay copy with swap (live out, replay in
+// and back again)
+void swapControlState(uint8_t* swap);
+
+#endif
@@ -1,4 +1,8 @@
 #include "doorSystem.h"
+#include "hal.h"
+#include "gpioEdges.h"
+#include "latencyTrace.h"
+#include "controlState.h"
 
 // Pin Declarations
 const int touch1 = 2;
@@ -10,7 +14,9 @@ const int button = 13;
 
 
 int failAttempts = 0;
-unsigned long touchStart = 0;
+// Both pads held since touchStartUs (edge time, micros clock)
+bool touchHeld = false;
+unsigned long touchStartUs = 0;
 const unsigned long TOUCH_HOLD_MS = 3000UL;
 bool doorOpen = false;
 
@@ -19,142 +25,196 @@ static unsigned long ledTimerStart = 0;
 static bool ledTimerActive = false;
 const unsigned long LED_TIMEOUT = 5000;  // 5 seconds
 
+// Debounce windows (the touch pads have clean edges, the button bounces)
+const unsigned long BUTTON_DEBOUNCE_US = 20000;
+const unsigned long TOUCH_DEBOUNCE_US = 5000;
+
+// Input indexes from gpioEdges
+static int buttonInput = -1;
+static int touch1Input = -1;
+static int touch2Input = -1;
+
+// Buzzer pattern, played from startDoor() instead of blocking
+static int beepsLeft = 0;
+static bool beepOn = false;
+static unsigned long beepOnMs = 0;
+static unsigned long beepOffMs = 0;
+static unsigned long beepSince = 0;
+static unsigned long beepWait = 0;
+
 bool setDoorPins() {
-    pinMode(touch1, INPUT);
-    pinMode(touch2, INPUT);
     pinMode(accessLED, OUTPUT);
     pinMode(intruderLED, OUTPUT);
     pinMode(buzzer, OUTPUT); 
-    pinMode(button, INPUT);
 
-    digitalWrite(accessLED, LOW);
-    digitalWrite(intruderLED, LOW);
-    digitalWrite(buzzer, LOW);
+    halDigitalWrite(accessLED, LOW);
+    halDigitalWrite(intruderLED, LOW);
+    halDigitalWrite(buzzer, LOW);
+
+    buttonInput = addEdgeInput(button, BUTTON_DEBOUNCE_US);
+    touch1Input = addEdgeInput(touch1, TOUCH_DEBOUNCE_US);
+    touch2Input = addEdgeInput(touch2, TOUCH_DEBOUNCE_US);
+    if (buttonInput < 0 || touch1Input < 0 || touch2Input < 0) {
+        Serial.println("Door inputs: no free edge slots");
+        return false;
+    }
+
+    // Saved and restored as a whole for trace replay and benchmarks
+    keepControlState(failAttempts);
+    keepControlState(touchHeld);
+    keepControlState(touchStartUs);
+    keepControlState(doorOpen);
+    keepControlState(ledTimerStart);
+    keepControlState(ledTimerActive);
+    keepControlState(beepsLeft);
+    keepControlState(beepOn);
+    keepControlState(beepOnMs);
+    keepControlState(beepOffMs);
+    keepControlState(beepSince);
+    keepControlState(beepWait);
 
     Serial.println("Door System Ready");
     return true;
 }
 
-// Variables to track touch sensor state for beep feedback
-static bool touch1WasHigh = false;
-static bool touch2WasHigh = false;
+static void beep(int count, unsigned long onMs, unsigned long offMs) {
+    beepsLeft = count;
+    beepOnMs = onMs;
+    beepOffMs = offMs;
+    beepOn = false;
+    beepSince = halMillis();
+    beepWait = 0;
+}
+
+static void updateBuzzer() {
+    if (beepsLeft == 0 || halMillis() - beepSince < beepWait) return;
+
+    beepSince = halMillis();
+    if (!beepOn) {
+        halDigitalWrite(buzzer, HIGH);
+        beepOn = true;
+        beepWait = beepOnMs;
+    } else {
+        halDigitalWrite(buzzer, LOW);
+        beepOn = false;
+        beepsLeft--;
+        beepWait = beepOffMs;
+    }
+}
 
 void unlockDoor(AsyncWebSocket& ws) {
     Serial.println("Access Granted");
     
     // Single beep (active buzzer)
-    digitalWrite(buzzer, HIGH);
-    delay(200);
-    digitalWrite(buzzer, LOW);
+    beep(1, 200, 0);
 
-    digitalWrite(accessLED, HIGH);
-    digitalWrite(intruderLED, LOW);
+    halDigitalWrite(accessLED, HIGH);
+    halDigitalWrite(intruderLED, LOW);
 
     failAttempts = 0;
-    touchStart = 0;
+    touchHeld = false;
     doorOpen = true;
+    spanState();
 
     
     // Start LED timer
-    ledTimerStart = millis();
+    ledTimerStart = halMillis();
     ledTimerActive = true;
 
-    ws.textAll("{\"alert\":\"Access Granted\"}");
-    ws.textAll("{\"door\":\"UNLOCKED\"}");
+    halTextAll(ws, "{\"alert\":\"Access Granted\"}", FRAME_ALERT);
+    halTextAll(ws, "{\"door\":\"UNLOCKED\"}", FRAME_DOOR);
 }
 
 void intruderAlert(AsyncWebSocket& ws) {
     
     // Three beeps 
-    for (int i = 0; i < 3; i++) { 
-        digitalWrite(buzzer, HIGH);
-        delay(300);
-        digitalWrite(buzzer, LOW);
-        delay(300);
-    }
+    beep(3, 300, 300);
 
-    digitalWrite(accessLED, LOW);
-    digitalWrite(intruderLED, HIGH);
+    halDigitalWrite(accessLED, LOW);
+    halDigitalWrite(intruderLED, HIGH);
 
     failAttempts = 0;
-    touchStart = 0;
+    touchHeld = false;
     
     // Start LED timer
-    ledTimerStart = millis();
+    ledTimerStart = halMillis();
     ledTimerActive = true;
 
-    ws.textAll("{\"alert\":\"Access Denied\"}");
+    halTextAll(ws, "{\"alert\":\"Access Denied\"}", FRAME_ALERT);
 }
 
 void lockDoor(AsyncWebSocket& ws) {
     
     
     doorOpen = false;
+    spanState();
    
     
-    ws.textAll("{\"door\":\"LOCKED\"}");
+    halTextAll(ws, "{\"door\":\"LOCKED\"}", FRAME_DOOR);
+}
+
+// Touch pads: both held for TOUCH_HOLD_MS unlocks, letting go early is a
+// failed attempt. Times come from the edges, not from when the loop saw them.
+static void handleTouch(AsyncWebSocket& ws, const InputEvent& ev) {
+    // Short beep when touch sensor is activated 
+    if (ev.pressed) beep(1, 50, 0);
+
+    bool bothTouched = inputPressed(touch1Input) && inputPressed(touch2Input);
+    if (bothTouched) {
+        if (!touchHeld) {
+            touchHeld = true;
+            touchStartUs = ev.timeUs;
+        }
+    } else if (touchHeld) {
+        failAttempts++;
+        // Send failed attempt notification
+        halTextAll(ws, "{\"alert\":\"Failed Attempt\"}", FRAME_ALERT);
+        
+        if (failAttempts >= 3) intruderAlert(ws);
+        touchHeld = false;
+    }
 }
 
 void startDoor(AsyncWebSocket& ws) {
+    updateBuzzer();
+
     // Check if LED timer has expired
-    if (ledTimerActive && (millis() - ledTimerStart >= LED_TIMEOUT)) {
-        digitalWrite(accessLED, LOW);
-        digitalWrite(intruderLED, LOW);
+    if (ledTimerActive && (halMillis() - ledTimerStart >= LED_TIMEOUT)) {
+        halDigitalWrite(accessLED, LOW);
+        halDigitalWrite(intruderLED, LOW);
         ledTimerActive = false;
-    }
 
-        // Tactile Button Logic
-    static bool lastButtonState = LOW;
-    bool buttonState = digitalRead(button);
-    if (lastButtonState == LOW && buttonState == HIGH) {
-        // Button was just pressed
-        if (doorOpen) {
-            lockDoor(ws);
-        } else {
-            unlockDoor(ws);
+        // Pads still held from before count as a new touch from now on,
+        // their press edges were dropped while the LEDs were on
+        if (inputPressed(touch1Input) && inputPressed(touch2Input)) {
+            touchHeld = true;
+            touchStartUs = halMicros();
         }
-        delay(250); // Debounce delay
-    }
-    lastButtonState = buttonState;
-
-    // Disable touch sensors while LEDs are active
-    if (ledTimerActive) {
-        return;  // Don't process touch sensors while showing result
     }
 
-    int t1 = digitalRead(touch1);
-    int t2 = digitalRead(touch2);
-    bool bothTouched = (t1 == HIGH && t2 == HIGH);
+    InputEvent ev;
+    while (nextInputEvent(&ev)) {
+        // Tactile Button Logic
+        if (ev.input == buttonInput) {
+            if (!ev.pressed) continue;
+            spanBegin(SPAN_BUTTON, ev.timeUs, (1 << FRAME_DOOR) | (1 << FRAME_STATE));
+            if (doorOpen) {
+                lockDoor(ws);
+            } else {
+                unlockDoor(ws);
+            }
+            continue;
+        }
 
-    // Short beep when touch sensor is activated 
-    if (t1 == HIGH && !touch1WasHigh) {
-        digitalWrite(buzzer, HIGH);
-        delay(50);  // Very short beep
-        digitalWrite(buzzer, LOW);
+        // Touch sensors are ignored while the LEDs show a result
+        if (ledTimerActive) continue;
+        handleTouch(ws, ev);
     }
-    if (t2 == HIGH && !touch2WasHigh) {
-        digitalWrite(buzzer, HIGH);
-        delay(50);  // Very short beep
-        digitalWrite(buzzer, LOW);
-    }
-    
-    // Update previous states
-    touch1WasHigh = (t1 == HIGH);
-    touch2WasHigh = (t2 == HIGH);
 
-    if (bothTouched) {
-        if (touchStart == 0) touchStart = millis();
-        if (millis() - touchStart >= TOUCH_HOLD_MS) {
-            unlockDoor(ws);
-        }
-    } else {
-        if (touchStart != 0) {
-            failAttempts++;
-            // Send failed attempt notification
-            ws.textAll("{\"alert\":\"Failed Attempt\"}");
-            
-            if (failAttempts >= 3) intruderAlert(ws);
-            touchStart = 0;
-        }
+    // Unlock once the hold, measured from the later press on the same micros
+    // clock as the edges, is long enough
+    if (touchHeld && !ledTimerActive &&
+        halMicros() - touchStartUs >= TOUCH_HOLD_MS * 1000UL) {
+        unlockDoor(ws);
     }
 }
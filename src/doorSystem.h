@@ -6,7 +6,8 @@
 
 // Counters/timers (shared state)
 extern int failAttempts;
-extern unsigned long touchStart;
+extern bool touchHeld;
+extern unsigned long touchStartUs;
 extern bool doorOpen;
 
 
@@ -0,0 +1,188 @@
+#include "gpioEdges.h"
+#include <soc/gpio_reg.h>
+#include "hal.h"
+#include "sensorTrace.h"
+#include "controlState.h"
+
+// Ring sizes (power of two, indexes run free and are masked)
+const uint32_t EDGE_RING_SIZE = 64;
+const uint32_t EVENT_RING_SIZE = 16;
+
+// Raw edge as captured in the interrupt
+struct Edge {
+    uint8_t input;
+    uint8_t level;
+    unsigned long timeUs;
+};
+
+struct Debouncer {
+    unsigned long debounceUs;
+    bool stable;                 // debounced level
+    bool candidate;              // level of the last raw edge
+    bool settling;               // edges seen since the last stable level
+    unsigned long burstStart;    // first edge of the current burst
+    unsigned long lastEdge;
+    unsigned long stableSince;
+};
+
+// Written by the ISR (head) and the loop (tail) only, no lock needed
+static Edge edgeRing[EDGE_RING_SIZE];
+static volatile uint32_t edgeHead = 0;
+static volatile uint32_t edgeTail = 0;
+static volatile uint32_t droppedEdges = 0;
+
+static uint8_t inputPins[MAX_EDGE_INPUTS];
+static int numInputs = 0;
+
+// Replay drives its own debouncers, started from the trace snapshot, so the
+// live ones are left alone
+static Debouncer liveInputs[MAX_EDGE_INPUTS];
+static Debouncer replayInputs[MAX_EDGE_INPUTS];
+
+// Debounced events (loop only, swapped with the replay's, see controlState.h)
+static InputEvent events[EVENT_RING_SIZE];
+static uint32_t eventHead = 0;
+static uint32_t eventTail = 0;
+
+static Debouncer* debouncers() {
+    return traceReplaying() ? replayInputs : liveInputs;
+}
+
+// Runs from IRAM: only register reads, no Arduino GPIO calls
+static void IRAM_ATTR onEdge(void* arg) {
+    uint8_t input = (uint8_t)(uintptr_t)arg;
+    uint32_t head = edgeHead;
+    if (head - edgeTail >= EDGE_RING_SIZE) {
+        droppedEdges++;
+        return;
+    }
+
+    uint8_t pin = inputPins[input];
+    uint32_t in = pin < 32 ? REG_READ(GPIO_IN_REG) : REG_READ(GPIO_IN1_REG);
+
+    Edge& edge = edgeRing[head & (EDGE_RING_SIZE - 1)];
+    edge.input = input;
+    edge.level = (in >> (pin & 31)) & 1;
+    edge.timeUs = micros();
+    edgeHead = head + 1;
+}
+
+static void pushEvent(uint8_t input, bool pressed, unsigned long timeUs) {
+    if (eventHead - eventTail >= EVENT_RING_SIZE) {
+        droppedEdges++;
+        return;
+    }
+    InputEvent& ev = events[eventHead & (EVENT_RING_SIZE - 1)];
+    ev.input = input;
+    ev.pressed = pressed;
+    ev.timeUs = timeUs;
+    eventHead++;
+}
+
+// A burst settles once no edge has arrived for debounceUs; it only becomes
+// an event if it ended on the other level (a glitch that returns is dropped)
+static void settle(uint8_t input, Debouncer& d, unsigned long nowUs) {
+    if (!d.settling || nowUs - d.lastEdge < d.debounceUs) return;
+    d.settling = false;
+    if (d.candidate == d.stable) return;
+
+    d.stable = d.candidate;
+    pushEvent(input, d.stable, d.burstStart);
+    d.stableSince = d.burstStart;
+}
+
+static void feed(uint8_t input, bool level, unsigned long timeUs) {
+    Debouncer& d = debouncers()[input];
+
+    // Settle the previous burst first so a press shorter than a loop pass
+    // still produces both events
+    settle(input, d, timeUs);
+    if (!d.settling) {
+        d.settling = true;
+        d.burstStart = timeUs;
+    }
+    d.candidate = level;
+    d.lastEdge = timeUs;
+}
+
+static int findInput(uint8_t pin) {
+    for (int i = 0; i < numInputs; i++) {
+        if (inputPins[i] == pin) return i;
+    }
+    return -1;
+}
+
+// Edges come back out of a trace with the time they were captured at
+static void replayEdge(uint8_t pin, bool level, unsigned long timeUs) {
+    int input = findInput(pin);
+    if (input < 0) return;
+    feed(input, level, timeUs);
+}
+
+static void drainEdges() {
+    uint32_t head = edgeHead;
+    while (edgeTail != head) {
+        Edge edge = edgeRing[edgeTail & (EDGE_RING_SIZE - 1)];
+        edgeTail = edgeTail + 1;
+
+        traceRecordEdge(inputPins[edge.input], edge.level, edge.timeUs);
+
+        feed(edge.input, edge.level, edge.timeUs);
+    }
+}
+
+int addEdgeInput(uint8_t pin, unsigned long debounceUs) {
+    if (numInputs >= MAX_EDGE_INPUTS) return -1;
+
+    int input = numInputs;
+    pinMode(pin, INPUT);
+    inputPins[input] = pin;
+
+    Debouncer& d = liveInputs[input];
+    d.debounceUs = debounceUs;
+    d.stable = digitalRead(pin) == HIGH;
+    d.candidate = d.stable;
+    d.settling = false;
+    d.stableSince = micros();
+
+    if (numInputs++ == 0) {
+        keepControlState(liveInputs, sizeof(liveInputs), replayInputs);
+        keepControlState(events);
+        keepControlState(eventHead);
+        keepControlState(eventTail);
+    }
+    setTraceEdgeHandler(replayEdge);
+    attachInterruptArg(pin, onEdge, (void*)(uintptr_t)input, CHANGE);
+    return input;
+}
+
+bool nextInputEvent(InputEvent* event) {
+    // A dry run leaves real edges for the next live pass
+    if (halDryRun()) return false;
+    if (eventHead == eventTail) {
+        // While replaying, edges are fed from the trace instead
+        if (traceReplaying()) tracePollEvents();
+        else drainEdges();
+
+        Debouncer* inputs = debouncers();
+        unsigned long now = halMicros();
+        for (int i = 0; i < numInputs; i++) settle(i, inputs[i], now);
+    }
+
+    if (eventHead == eventTail) return false;
+    *event = events[eventTail & (EVENT_RING_SIZE - 1)];
+    eventTail++;
+    return true;
+}
+
+bool inputPressed(int input) {
+    return debouncers()[input].stable;
+}
+
+unsigned long inputSinceUs(int input) {
+    return debouncers()[input].stableSince;
+}
+
+unsigned long edgeOverflows() {
+    return droppedEdges;
+}
@@ -0,0 +1,33 @@
+#ifndef GPIOEDGES_H
+#define GPIOEDGES_H
+
+#include <Arduino.h>
+
+// Interrupt-driven input capture for the button and touch pads.
+// A GPIO interrupt pushes every edge with its micros() timestamp into a
+// lock-free ring; the loop drains it through a per-input debouncer and gets
+// press/release events with exact edge times, so short presses are not lost
+// and hold durations do not depend on the loop period.
+
+const int MAX_EDGE_INPUTS = 4;
+
+struct InputEvent {
+    uint8_t input;           // index returned by addEdgeInput()
+    bool pressed;            // true = went HIGH, false = went LOW
+    unsigned long timeUs;    // first edge of the settled transition
+};
+
+// Register a pin (HIGH = pressed), returns its input index or -1
+int addEdgeInput(uint8_t pin, unsigned long debounceUs);
+
+// Next debounced event, call in a loop until it returns false
+bool nextInputEvent(InputEvent* event);
+
+// Debounced level and the time it was reached
+bool inputPressed(int input);
+unsigned long inputSinceUs(int input);
+
+// Edges dropped because the ring was full
+unsigned long edgeOverflows();
+
+#endif
@@ -0,0 +1,257 @@
+#include "hal.h"
+#include "sensorTrace.h"
+#include "latencyTrace.h"
+#include "controlState.h"
+
+const int HAL_MAX_PIN = 40;
+
+// Last level written to each output pin (replay keeps its own copy, started
+// from the trace snapshot, so the live levels are never touched)
+static uint8_t liveLevel[HAL_MAX_PIN];
+static uint8_t replayLevel[HAL_MAX_PIN];
+static bool isOutput[HAL_MAX_PIN];
+
+static bool dryRun = false;
+
+// DHT values and echo time from the last real read, served during a dry run
+static float lastHumidity = NAN;
+static float lastTemperature = NAN;
+static unsigned long lastPulse = 0;
+
+// Dry runs are not recorded, their inputs never reached the control state
+static void record(uint8_t type, uint8_t pin, uint16_t value) {
+    if (!dryRun) traceRecord(type, pin, value);
+}
+
+static uint8_t* outputLevels() {
+    return traceReplaying() ? replayLevel : liveLevel;
+}
+
+// DHT values are stored in tenths, this marks a failed read
+const uint16_t TRACE_NAN = 0x8000;
+
+static uint16_t packTenths(float v) {
+    if (isnan(v)) return TRACE_NAN;
+    return (uint16_t)(int16_t)lroundf(v * 10.0f);
+}
+
+static float unpackTenths(uint16_t v) {
+    if (v == TRACE_NAN) return NAN;
+    return (int16_t)v / 10.0f;
+}
+
+#ifdef SENSOR_FAULTS
+// Roughly what a DHT read with no sensor answering takes
+const unsigned int DHT_FAULT_US = 2500;
+static volatile uint8_t activeFaults = 0;
+// The echo pin of a faulted pulse read reads low, as with no sensor on it
+static uint8_t faultedPulsePin = 0xFF;
+#endif
+
+#ifdef SENSOR_FAULTS
+void halSetFaults(uint8_t faults) {
+    activeFaults = faults;
+}
+#else
+void halSetFaults(uint8_t) {
+}
+#endif
+
+unsigned long halMillis() {
+    if (traceReplaying()) return traceClock();
+    return millis();
+}
+
+unsigned long halMicros() {
+    if (traceReplaying()) return traceClockUs();
+    return micros();
+}
+
+// The pass start time is an input: replay picks its clock up from here
+// rather than from the previous pass's last read
+void halBeginTick() {
+    if (traceReplaying()) {
+        uint16_t value = 0;
+        traceNextInput(TRACE_TICK, 0, &value);
+        return;
+    }
+    record(TRACE_TICK, 0, (uint16_t)micros());
+}
+
+void halDelay(unsigned long ms) {
+    if (traceReplaying()) {
+        traceAdvance(ms * 1000UL);
+        return;
+    }
+    delay(ms);
+}
+
+void halDelayMicroseconds(unsigned int us) {
+    if (traceReplaying()) {
+        traceAdvance(us);
+        return;
+    }
+    delayMicroseconds(us);
+}
+
+int halAnalogRead(uint8_t pin) {
+    if (traceReplaying()) {
+        uint16_t value = 0;
+        traceNextInput(TRACE_ANALOG, pin, &value);
+        return value;
+    }
+    int value = analogRead(pin);
+    record(TRACE_ANALOG, pin, value);
+    return value;
+}
+
+int halDigitalRead(uint8_t pin) {
+    if (pin < HAL_MAX_PIN && isOutput[pin]) return outputLevels()[pin];
+
+    if (traceReplaying()) {
+        uint16_t value = LOW;
+        traceNextInput(TRACE_DIGITAL, pin, &value);
+        return value;
+    }
+#ifdef SENSOR_FAULTS
+    if ((activeFaults & HAL_FAULT_PULSE) && pin == faultedPulsePin) {
+        record(TRACE_DIGITAL, pin, LOW);
+        return LOW;
+    }
+#endif
+    int value = digitalRead(pin);
+    record(TRACE_DIGITAL, pin, value);
+    return value;
+}
+
+unsigned long halPulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+    if (traceReplaying()) {
+        // Ends as long after it started as the echo it measured, or the
+        // whole timeout (the record's own time is only to the millisecond)
+        unsigned long startUs = traceClockUs();
+        uint16_t value = 0;
+        traceNextInput(TRACE_PULSE, pin, &value);
+        unsigned long left = startUs + (value ? value : timeout) - traceClockUs();
+        if ((long)left > 0) traceAdvance(left);
+        return value;
+    }
+    if (dryRun) return lastPulse;
+#ifdef SENSOR_FAULTS
+    if (activeFaults & HAL_FAULT_PULSE) {
+        faultedPulsePin = pin;
+        delayMicroseconds(timeout);
+        record(TRACE_PULSE, pin, 0);
+        return 0;
+    }
+#endif
+    unsigned long value = pulseIn(pin, state, timeout);
+    lastPulse = value;
+    record(TRACE_PULSE, pin, value > 0xFFFF ? 0xFFFF : value);
+    return value;
+}
+
+void halReadDHT(DHT& dht, float* humidity, float* temperature) {
+    if (traceReplaying()) {
+        uint16_t h = TRACE_NAN, t = TRACE_NAN;
+        traceNextInput(TRACE_HUMIDITY, 0, &h);
+        traceNextInput(TRACE_TEMPERATURE, 0, &t);
+        *humidity = unpackTenths(h);
+        *temperature = unpackTenths(t);
+        return;
+    }
+    if (dryRun) {
+        *humidity = lastHumidity;
+        *temperature = lastTemperature;
+        return;
+    }
+#ifdef SENSOR_FAULTS
+    if (activeFaults & HAL_FAULT_DHT) {
+        delayMicroseconds(DHT_FAULT_US);
+        *humidity = NAN;
+        *temperature = NAN;
+        record(TRACE_HUMIDITY, 0, TRACE_NAN);
+        record(TRACE_TEMPERATURE, 0, TRACE_NAN);
+        return;
+    }
+#endif
+    *humidity = dht.readHumidity();
+    *temperature = dht.readTemperature();
+    lastHumidity = *humidity;
+    lastTemperature = *temperature;
+    record(TRACE_HUMIDITY, 0, packTenths(*humidity));
+    record(TRACE_TEMPERATURE, 0, packTenths(*temperature));
+}
+
+void halDigitalWrite(uint8_t pin, uint8_t value) {
+    bool changed = true;
+    if (pin < HAL_MAX_PIN) {
+        uint8_t* levels = outputLevels();
+        changed = !isOutput[pin] || levels[pin] != value;
+        isOutput[pin] = true;
+        levels[pin] = value;
+    }
+
+    if (traceReplaying()) {
+        if (changed) traceCheckOutput(TRACE_PIN_OUT, pin, value);
+        return;
+    }
+    if (dryRun) return;
+    digitalWrite(pin, value);
+    if (changed) record(TRACE_PIN_OUT, pin, value);
+}
+
+size_t halClientCount(AsyncWebSocket& ws) {
+    if (traceReplaying()) return traceClientCount();
+    return ws.count();
+}
+
+void halClientsChanged(AsyncWebSocket& ws) {
+    traceClientsChanged(ws.count());
+}
+
+// Sent through the outbox, which has the clients (ws is for the callers)
+void halTextAll(AsyncWebSocket&, const char* json, FrameClass cls) {
+    if (dryRun) return;
+    uint32_t hash = traceHash(json);
+    // Stamped in replay too, where the span ends here
+    uint16_t traceId = spanFrame(cls);
+    if (traceReplaying()) {
+        traceCheckOutput(TRACE_FRAME, (hash >> 16) & 0xFF, hash & 0xFFFF);
+        return;
+    }
+    publishFrame(cls, json, traceId);
+    record(TRACE_FRAME, (hash >> 16) & 0xFF, hash & 0xFFFF);
+}
+
+bool halFrameDue(FrameClass cls) {
+    if (traceReplaying()) {
+        uint16_t value = 0;
+        traceNextInput(TRACE_DUE, cls, &value);
+        return value;
+    }
+    // Every frame is built, as when all subscribers are due
+    if (dryRun) return true;
+    bool due = frameDue(cls);
+    record(TRACE_DUE, cls, due);
+    return due;
+}
+
+void setHal() {
+    keepControlState(liveLevel, sizeof(liveLevel), replayLevel);
+}
+
+void halBeginReplay() {
+    latencyBeginReplay();
+}
+
+void halCommand(const char* msg) {
+    if (!dryRun) traceRecordText(TRACE_COMMAND, msg);
+}
+
+void halSetDryRun(bool on) {
+    dryRun = on;
+}
+
+bool halDryRun() {
+    return dryRun;
+}
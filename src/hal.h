@@ -0,0 +1,58 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+#include <DHT.h>
+#include <ESPAsyncWebServer.h>
+#include "wsOutbox.h"
+
+// Hardware access for the room/door modules.
+// Inputs and actuator outputs go through here so they can be recorded into a
+// sensor trace and, during replay, served from the trace with a virtual clock
+// (see sensorTrace.h). Outside of replay these are thin wrappers.
+
+unsigned long halMillis();
+unsigned long halMicros();
+// Call first in every control pass: its start time is recorded, and replay
+// takes the pass's clock from it
+void halBeginTick();
+void halDelay(unsigned long ms);
+void halDelayMicroseconds(unsigned int us);
+
+int halAnalogRead(uint8_t pin);
+int halDigitalRead(uint8_t pin);
+unsigned long halPulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
+void halReadDHT(DHT& dht, float* humidity, float* temperature);
+
+// Actuators: reads of a written pin return the last written level
+void halDigitalWrite(uint8_t pin, uint8_t value);
+
+// Register the written levels as control state (call from setup)
+void setHal();
+void halBeginReplay();
+
+// Dry run (benchmarks): the control code runs on live inputs, but nothing
+// reaches the actuators, the DHT, the ultrasonic sensor, the panel or the
+// clients, input edges are left queued and nothing is recorded. The caller puts the control state
+// back afterwards (controlState.h).
+void halSetDryRun(bool on);
+bool halDryRun();
+
+// WebSocket output/input
+size_t halClientCount(AsyncWebSocket& ws);
+void halClientsChanged(AsyncWebSocket& ws);
+// Frames are queued per client through wsOutbox, not sent directly
+void halTextAll(AsyncWebSocket& ws, const char* json, FrameClass cls);
+// Whether any subscriber wants this class now (an input: replayed from the trace)
+bool halFrameDue(FrameClass cls);
+void halCommand(const char* msg);
+
+// Fault injection (SENSOR_FAULTS builds, "fault:" command): reads of the
+// selected sensors fail the way a disconnected sensor does, taking as long
+enum HalFault : uint8_t {
+    HAL_FAULT_DHT = 1,
+    HAL_FAULT_PULSE = 2
+};
+void halSetFaults(uint8_t faults);
+
+#endif
@@ -0,0 +1,228 @@
+#include "historyCodec.h"
+#include <string.h>
+#include <math.h>
+
+const uint32_t PAYLOAD_BITS = HISTORY_PAYLOAD_BYTES * 8;
+
+// Largest encoding of one sample: 4 + 32 time bits, 3 + 16 per reading
+const uint32_t MAX_SAMPLE_BITS = 74;
+
+// Bits are packed MSB first; the payload starts zeroed so writes only OR
+static void putBits(HistoryBlock& b, uint32_t value, uint8_t n) {
+    uint32_t pos = b.header.bits;
+    while (n > 0) {
+        uint8_t free = 8 - (pos & 7);
+        uint8_t take = n < free ? n : free;
+        uint32_t chunk = (value >> (n - take)) & ((1u << take) - 1);
+        b.payload[pos >> 3] |= chunk << (free - take);
+        pos += take;
+        n -= take;
+    }
+    b.header.bits = pos;
+}
+
+static uint32_t getBits(const HistoryBlock& b, uint32_t& pos, uint8_t n) {
+    uint32_t value = 0;
+    while (n > 0) {
+        // Never past the payload, even for a block claiming too many samples
+        if ((pos >> 3) >= HISTORY_PAYLOAD_BYTES) {
+            pos += n;
+            return n >= 32 ? 0 : value << n;
+        }
+        uint8_t left = 8 - (pos & 7);
+        uint8_t take = n < left ? n : left;
+        uint32_t chunk = (b.payload[pos >> 3] >> (left - take)) & ((1u << take) - 1);
+        value = (value << take) | chunk;
+        pos += take;
+        n -= take;
+    }
+    return value;
+}
+
+static bool fits(int64_t v, uint8_t n) {
+    return v >= -(1LL << (n - 1)) && v < (1LL << (n - 1));
+}
+
+static int32_t signExtend(uint32_t v, uint8_t n) {
+    return (int32_t)(v << (32 - n)) >> (32 - n);
+}
+
+// '0' same, '10' + 4 bit change, '110' + 8 bit change, '111' + raw value
+// (a change to or from a failed read is always raw)
+static void putValue(HistoryBlock& b, int16_t value, int16_t prev) {
+    if (value == prev) {
+        putBits(b, 0, 1);
+        return;
+    }
+    if (value != HISTORY_NAN && prev != HISTORY_NAN) {
+        int32_t d = (int32_t)value - prev;
+        if (fits(d, 4)) {
+            putBits(b, 0x2, 2);
+            putBits(b, d & 0xF, 4);
+            return;
+        }
+        if (fits(d, 8)) {
+            putBits(b, 0x6, 3);
+            putBits(b, d & 0xFF, 8);
+            return;
+        }
+    }
+    putBits(b, 0x7, 3);
+    putBits(b, (uint16_t)value, 16);
+}
+
+static int16_t getValue(const HistoryBlock& b, uint32_t& pos, int16_t prev) {
+    if (getBits(b, pos, 1) == 0) return prev;
+    if (getBits(b, pos, 1) == 0) return prev + signExtend(getBits(b, pos, 4), 4);
+    if (getBits(b, pos, 1) == 0) return prev + signExtend(getBits(b, pos, 8), 8);
+    return (int16_t)getBits(b, pos, 16);
+}
+
+// '0' same interval, '10'/'110'/'1110' + 7/9/12 bit change of interval,
+// '1111' + the interval itself
+static void putTime(HistoryBlock& b, HistoryEncoder& enc, uint32_t time) {
+    uint32_t delta = time - enc.prevTime;
+    int64_t dod = (int64_t)delta - enc.prevDelta;
+    if (dod == 0) {
+        putBits(b, 0, 1);
+    } else if (fits(dod, 7)) {
+        putBits(b, 0x2, 2);
+        putBits(b, (uint32_t)dod & 0x7F, 7);
+    } else if (fits(dod, 9)) {
+        putBits(b, 0x6, 3);
+        putBits(b, (uint32_t)dod & 0x1FF, 9);
+    } else if (fits(dod, 12)) {
+        putBits(b, 0xE, 4);
+        putBits(b, (uint32_t)dod & 0xFFF, 12);
+    } else {
+        putBits(b, 0xF, 4);
+        putBits(b, delta, 32);
+    }
+    enc.prevDelta = delta;
+    enc.prevTime = time;
+}
+
+static uint32_t getDelta(const HistoryBlock& b, uint32_t& pos, uint32_t prevDelta) {
+    if (getBits(b, pos, 1) == 0) return prevDelta;
+    if (getBits(b, pos, 1) == 0) return prevDelta + signExtend(getBits(b, pos, 7), 7);
+    if (getBits(b, pos, 1) == 0) return prevDelta + signExtend(getBits(b, pos, 9), 9);
+    if (getBits(b, pos, 1) == 0) return prevDelta + signExtend(getBits(b, pos, 12), 12);
+    return getBits(b, pos, 32);
+}
+
+// CRC-16/CCITT
+static uint16_t crc16(uint16_t crc, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t blockCrc(const HistoryBlock& block) {
+    uint16_t crc = crc16(0xFFFF, (const uint8_t*)&block.header, offsetof(HistoryBlockHeader, crc));
+    return crc16(crc, block.payload, (block.header.bits + 7) / 8);
+}
+
+void historyBlockBegin(HistoryBlock& block, HistoryEncoder& enc, uint32_t seq) {
+    memset(&block, 0, sizeof(block));
+    block.header.magic = HISTORY_MAGIC_OPEN;
+    block.header.seq = seq;
+    memset(&enc, 0, sizeof(enc));
+}
+
+bool historyBlockAppend(HistoryBlock& block, HistoryEncoder& enc,
+                        uint32_t time, int16_t temp, int16_t hum) {
+    HistoryBlockHeader& h = block.header;
+    if (h.count == 0xFFFF || h.bits + MAX_SAMPLE_BITS > PAYLOAD_BITS) return false;
+
+    if (h.count == 0) {
+        // First sample: time is in the header, readings raw
+        h.firstTime = time;
+        enc.prevTime = time;
+        enc.prevDelta = 0;
+        putBits(block, (uint16_t)temp, 16);
+        putBits(block, (uint16_t)hum, 16);
+    } else {
+        if ((int32_t)(time - enc.prevTime) < 0) time = enc.prevTime;
+        putTime(block, enc, time);
+        putValue(block, temp, enc.prevTemp);
+        putValue(block, hum, enc.prevHum);
+    }
+    enc.prevTemp = temp;
+    enc.prevHum = hum;
+    h.lastTime = time;
+    h.count++;
+    return true;
+}
+
+void historyBlockFinish(HistoryBlock& block, bool sealed) {
+    block.header.magic = sealed ? HISTORY_MAGIC_SEALED : HISTORY_MAGIC_OPEN;
+    block.header.crc = blockCrc(block);
+}
+
+bool historyBlockValid(const HistoryBlock& block) {
+    const HistoryBlockHeader& h = block.header;
+    if (h.magic != HISTORY_MAGIC_OPEN && h.magic != HISTORY_MAGIC_SEALED) return false;
+    if (h.bits > PAYLOAD_BITS || h.count == 0) return false;
+    return h.crc == blockCrc(block);
+}
+
+bool historyResume(const HistoryBlock& block, HistoryEncoder& enc) {
+    HistoryDecoder dec;
+    historyDecodeBegin(dec);
+    uint32_t time;
+    int16_t temp, hum;
+    while (historyDecodeNext(block, dec, &time, &temp, &hum)) {}
+    if (dec.index != block.header.count || dec.bitPos != block.header.bits) return false;
+
+    enc.prevTime = dec.time;
+    enc.prevDelta = dec.delta;
+    enc.prevTemp = dec.temp;
+    enc.prevHum = dec.hum;
+    return true;
+}
+
+void historyDecodeBegin(HistoryDecoder& dec) {
+    memset(&dec, 0, sizeof(dec));
+}
+
+bool historyDecodeNext(const HistoryBlock& block, HistoryDecoder& dec,
+                       uint32_t* time, int16_t* temp, int16_t* hum) {
+    const HistoryBlockHeader& h = block.header;
+    if (dec.index >= h.count || dec.bitPos >= h.bits) return false;
+
+    if (dec.index == 0) {
+        dec.time = h.firstTime;
+        dec.delta = 0;
+        dec.temp = (int16_t)getBits(block, dec.bitPos, 16);
+        dec.hum = (int16_t)getBits(block, dec.bitPos, 16);
+    } else {
+        dec.delta = getDelta(block, dec.bitPos, dec.delta);
+        dec.time += dec.delta;
+        dec.temp = getValue(block, dec.bitPos, dec.temp);
+        dec.hum = getValue(block, dec.bitPos, dec.hum);
+    }
+    // A damaged block can claim more bits than it holds
+    if (dec.bitPos > h.bits) return false;
+    dec.index++;
+
+    *time = dec.time;
+    *temp = dec.temp;
+    *hum = dec.hum;
+    return true;
+}
+
+int16_t historyTenths(float value) {
+    if (isnan(value)) return HISTORY_NAN;
+    if (value > 3276.0f) value = 3276.0f;
+    if (value < -3276.0f) value = -3276.0f;
+    return (int16_t)lroundf(value * 10.0f);
+}
+
+float historyValue(int16_t tenths) {
+    if (tenths == HISTORY_NAN) return NAN;
+    return tenths / 10.0f;
+}
@@ -0,0 +1,78 @@
+#ifndef HISTORYCODEC_H
+#define HISTORYCODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compressed temperature/humidity samples in fixed-size blocks.
+// Timestamps (seconds) are stored as delta-of-delta, so a steady 5 s
+// interval costs one bit. Readings are stored as tenths (the DHT22's
+// resolution) and each one as the change from the previous sample in a
+// variable-width bucket; repeats cost one bit. Lossless at 0.1 resolution.
+// Plain C++ so tools/history_bench.cpp can build it on the host.
+
+const size_t HISTORY_BLOCK_BYTES = 1024;
+const int16_t HISTORY_NAN = INT16_MIN;     // tenths value of a failed read
+
+const uint16_t HISTORY_MAGIC_OPEN = 0x4F48;     // "HO", still being filled
+const uint16_t HISTORY_MAGIC_SEALED = 0x5348;   // "HS", full
+
+struct HistoryBlockHeader {
+    uint16_t magic;
+    uint16_t count;         // samples in the block
+    uint32_t seq;           // block number, never reused
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint16_t bits;          // payload bits used
+    uint16_t crc;           // CRC-16 of the header before it and the payload
+};
+
+const size_t HISTORY_PAYLOAD_BYTES = HISTORY_BLOCK_BYTES - sizeof(HistoryBlockHeader);
+
+struct HistoryBlock {
+    HistoryBlockHeader header;
+    uint8_t payload[HISTORY_PAYLOAD_BYTES];
+};
+
+// Previous sample, needed to append the next one
+struct HistoryEncoder {
+    uint32_t prevTime;
+    uint32_t prevDelta;
+    int16_t prevTemp;
+    int16_t prevHum;
+};
+
+struct HistoryDecoder {
+    uint32_t bitPos;
+    uint16_t index;
+    uint32_t time;
+    uint32_t delta;
+    int16_t temp;
+    int16_t hum;
+};
+
+void historyBlockBegin(HistoryBlock& block, HistoryEncoder& enc, uint32_t seq);
+
+// False when the sample does not fit (seal the block and begin the next).
+// Times must not go backwards; an earlier time is stored as the previous one.
+bool historyBlockAppend(HistoryBlock& block, HistoryEncoder& enc,
+                        uint32_t time, int16_t temp, int16_t hum);
+
+// Set the magic and CRC before the block is written out
+void historyBlockFinish(HistoryBlock& block, bool sealed);
+
+// Magic, sizes and CRC check for a block read back from flash
+bool historyBlockValid(const HistoryBlock& block);
+
+// Rebuild the encoder from an open block's samples (after a restart)
+bool historyResume(const HistoryBlock& block, HistoryEncoder& enc);
+
+void historyDecodeBegin(HistoryDecoder& dec);
+bool historyDecodeNext(const HistoryBlock& block, HistoryDecoder& dec,
+                       uint32_t* time, int16_t* temp, int16_t* hum);
+
+// Readings to and from tenths (NaN <-> HISTORY_NAN)
+int16_t historyTenths(float value);
+float historyValue(int16_t tenths);
+
+#endif
@@ -0,0 +1,663 @@
+#include "historyStore.h"
+#include <LittleFS.h>
+#include "historyCodec.h"
+
+const unsigned long HISTORY_INTERVAL_MS = 5000;
+// The open block is written to its slot this often (a reset loses at most this)
+const unsigned long HISTORY_CHECKPOINT_MS = 300000;
+// 512 KB of the ~1.9 MB LittleFS partition: about 3 weeks at 5 s (see /history/stats)
+const uint32_t HISTORY_SLOTS = 512;
+const uint8_t MAX_HISTORY_STREAMS = 2;
+
+// One file per slot (/h/<slot>), each written whole under a temporary name
+// and renamed over the old one, so flash is never rewritten in place
+static const char* HISTORY_DIR = "/h";
+static const char* HISTORY_INDEX_PATH = "/history.idx";
+static const char* HISTORY_INDEX_TMP_PATH = "/history.itmp";
+// Older firmware kept the ring in one file, updated in place
+static const char* HISTORY_OLD_PATH = "/history.bin";
+
+// One per slot, the index file is this table as is
+struct HistoryIndexEntry {
+    uint32_t seq;           // 0 = empty
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint16_t count;
+    uint16_t bits;
+};
+
+// Sealed blocks are oldestSeq .. open seq - 1 (oldestSeq 0 = none yet)
+static HistoryIndexEntry slots[HISTORY_SLOTS];
+static uint32_t oldestSeq = 0;
+static HistoryBlock openBlock;
+static HistoryEncoder encoder;
+// Blocks on their way to flash (and read back at boot)
+static HistoryBlock flushBlock;
+
+// Guards the index and the open block, streams read them from the AsyncTCP task
+static portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool historyReady = false;
+
+// History time = clockBase + seconds since the first startHistory()
+static uint32_t clockBase = 0;
+static bool clockSet = false;
+static uint64_t uptimeMs = 0;
+static unsigned long lastMillis = 0;
+static uint64_t nextSampleMs = HISTORY_INTERVAL_MS;
+static volatile uint32_t latestTime = 0;
+
+// Set from the WebSocket task, applied by startHistory()
+static volatile uint32_t pendingClock = 0;
+static volatile bool clockPending = false;
+
+static bool checkpointDirty = false;
+static unsigned long lastCheckpoint = 0;
+
+static unsigned long samplesAppended = 0;
+static unsigned long blocksSealed = 0;
+static unsigned long checkpoints = 0;
+static unsigned long writeFailures = 0;
+static unsigned long lastWriteUs = 0;
+static unsigned long maxWriteUs = 0;
+static volatile int activeStreams = 0;
+static volatile unsigned long streamsServed = 0;
+static volatile unsigned long streamsRefused = 0;
+static volatile unsigned long rowsStreamed = 0;
+static volatile unsigned long damagedBlocks = 0;
+
+static uint32_t slotOf(uint32_t seq) {
+    return (seq - 1) % HISTORY_SLOTS;
+}
+
+static void slotPath(char* out, size_t len, const char* dir, uint32_t slot) {
+    snprintf(out, len, "%s/%lu", dir, (unsigned long)slot);
+}
+
+static bool readSlot(uint32_t seq, HistoryBlock& block) {
+    char path[16];
+    slotPath(path, sizeof(path), HISTORY_DIR, slotOf(seq));
+    // Checked first, opening a missing file logs an error
+    if (!LittleFS.exists(path)) return false;
+    File file = LittleFS.open(path, "r");
+    if (!file) return false;
+    bool ok = file.read((uint8_t*)&block, sizeof(block)) == sizeof(block);
+    file.close();
+    return ok;
+}
+
+// Whole file under a temporary name, then renamed: a reset leaves the old
+// contents or the new ones
+static bool writeWhole(const char* path, const char* tmpPath, const uint8_t* data, size_t len) {
+    File file = LittleFS.open(tmpPath, "w");
+    if (!file) return false;
+    bool ok = file.write(data, len) == len;
+    file.close();
+    if (!ok || !LittleFS.rename(tmpPath, path)) {
+        LittleFS.remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+static bool writeBlockFile(const char* dir, uint32_t slot, const HistoryBlock& block) {
+    char path[16], tmpPath[16];
+    slotPath(path, sizeof(path), dir, slot);
+    snprintf(tmpPath, sizeof(tmpPath), "%s/tmp", dir);
+    return writeWhole(path, tmpPath, (const uint8_t*)&block, sizeof(block));
+}
+
+static void noteWrite(unsigned long start, bool ok) {
+    lastWriteUs = micros() - start;
+    if (lastWriteUs > maxWriteUs) maxWriteUs = lastWriteUs;
+    if (!ok) writeFailures++;
+}
+
+static bool writeSlot(const HistoryBlock& block) {
+    unsigned long start = micros();
+    bool ok = writeBlockFile(HISTORY_DIR, slotOf(block.header.seq), block);
+    noteWrite(start, ok);
+    return ok;
+}
+
+// The index is small enough to rewrite whole after each sealed block
+static bool writeIndex() {
+    unsigned long start = micros();
+    bool ok = writeWhole(HISTORY_INDEX_PATH, HISTORY_INDEX_TMP_PATH, (const uint8_t*)slots, sizeof(slots));
+    noteWrite(start, ok);
+    return ok;
+}
+
+static void indexBlock(const HistoryBlockHeader& h) {
+    HistoryIndexEntry& e = slots[slotOf(h.seq)];
+    e.seq = h.seq;
+    e.firstTime = h.firstTime;
+    e.lastTime = h.lastTime;
+    e.count = h.count;
+    e.bits = h.bits;
+    if (oldestSeq == 0) oldestSeq = h.seq;
+}
+
+// Start the open block; once the ring is full its slot holds the oldest
+// sealed block, which the first checkpoint overwrites, so that one goes now
+static void beginBlock(uint32_t seq) {
+    portENTER_CRITICAL(&historyMux);
+    historyBlockBegin(openBlock, encoder, seq);
+    if (oldestSeq != 0 && seq - oldestSeq >= HISTORY_SLOTS) {
+        oldestSeq = seq - HISTORY_SLOTS + 1;
+        slots[slotOf(seq)].seq = 0;
+    }
+    portEXIT_CRITICAL(&historyMux);
+}
+
+// Index from the slot headers, when /history.idx is missing or short
+static void rebuildIndex() {
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < HISTORY_SLOTS; i++) {
+        char path[16];
+        slotPath(path, sizeof(path), HISTORY_DIR, i);
+        if (!LittleFS.exists(path)) continue;
+        File file = LittleFS.open(path, "r");
+        if (!file) continue;
+        HistoryBlockHeader h;
+        bool ok = file.read((uint8_t*)&h, sizeof(h)) == sizeof(h);
+        file.close();
+        if (ok && h.magic == HISTORY_MAGIC_SEALED && h.seq != 0 && slotOf(h.seq) == i) {
+            indexBlock(h);
+            found++;
+        }
+    }
+    if (found > 0) Serial.println("History index rebuilt: " + String(found) + " blocks");
+}
+
+static bool loadIndex() {
+    memset(slots, 0, sizeof(slots));
+    if (LittleFS.exists(HISTORY_OLD_PATH)) {
+        LittleFS.remove(HISTORY_OLD_PATH);
+        LittleFS.remove(HISTORY_INDEX_PATH);
+        Serial.println("History: old single-file ring dropped");
+    }
+    if (!LittleFS.exists(HISTORY_DIR) && !LittleFS.mkdir(HISTORY_DIR)) return false;
+
+    File file = LittleFS.open(HISTORY_INDEX_PATH, "r");
+    if (file) {
+        size_t n = file.read((uint8_t*)slots, sizeof(slots));
+        file.close();
+        if (n == sizeof(slots)) return true;
+        memset(slots, 0, sizeof(slots));
+    }
+
+    rebuildIndex();
+    return writeIndex();
+}
+
+static bool loadHistory() {
+    if (!loadIndex()) return false;
+
+    // Entries that do not fit the ring below the newest sealed block are
+    // leftovers (the open block's slot, damaged writes)
+    uint32_t newest = 0;
+    for (uint32_t i = 0; i < HISTORY_SLOTS; i++) {
+        if (slots[i].seq != 0 && slotOf(slots[i].seq) == i && slots[i].seq > newest) {
+            newest = slots[i].seq;
+        }
+    }
+    oldestSeq = 0;
+    for (uint32_t i = 0; i < HISTORY_SLOTS; i++) {
+        uint32_t seq = slots[i].seq;
+        if (seq == 0) continue;
+        if (slotOf(seq) != i || newest - seq >= HISTORY_SLOTS - 1) {
+            slots[i].seq = 0;
+            continue;
+        }
+        if (oldestSeq == 0 || seq < oldestSeq) oldestSeq = seq;
+    }
+
+    // Blocks sealed after the last index write, then the checkpointed open block
+    uint32_t seq = newest + 1;
+    bool resumed = false;
+    bool recovered = false;
+    for (uint32_t i = 0; i < HISTORY_SLOTS; i++, seq++) {
+        if (!readSlot(seq, flushBlock) || !historyBlockValid(flushBlock) ||
+            flushBlock.header.seq != seq) break;
+        if (flushBlock.header.magic == HISTORY_MAGIC_SEALED) {
+            beginBlock(seq);
+            indexBlock(flushBlock.header);
+            recovered = true;
+            continue;
+        }
+        beginBlock(seq);
+        memcpy(&openBlock, &flushBlock, sizeof(openBlock));
+        resumed = historyResume(openBlock, encoder);
+        break;
+    }
+    if (!resumed) beginBlock(seq);
+    if (recovered) writeIndex();
+
+    // Carry on from the newest stored sample until a browser sets the clock
+    uint32_t newestTime = 0;
+    if (openBlock.header.count > 0) newestTime = openBlock.header.lastTime;
+    else if (oldestSeq != 0) newestTime = slots[slotOf(seq - 1)].lastTime;
+    clockBase = newestTime;
+    latestTime = newestTime;
+    lastMillis = millis();
+
+    Serial.println("History: " + String(oldestSeq ? seq - oldestSeq : 0) + " blocks, " +
+                   String(openBlock.header.count) + " samples in the open block");
+    return true;
+}
+
+static void sealOpenBlock() {
+    memcpy(&flushBlock, &openBlock, sizeof(flushBlock));
+    historyBlockFinish(flushBlock, true);
+    writeSlot(flushBlock);
+
+    uint32_t seq = flushBlock.header.seq;
+    portENTER_CRITICAL(&historyMux);
+    indexBlock(flushBlock.header);
+    portEXIT_CRITICAL(&historyMux);
+    writeIndex();
+    beginBlock(seq + 1);
+
+    blocksSealed++;
+    checkpointDirty = false;
+    lastCheckpoint = millis();
+}
+
+static void checkpointOpenBlock() {
+    memcpy(&flushBlock, &openBlock, sizeof(flushBlock));
+    historyBlockFinish(flushBlock, false);
+    writeSlot(flushBlock);
+    checkpoints++;
+    checkpointDirty = false;
+    lastCheckpoint = millis();
+}
+
+static void appendSample(uint32_t time, int16_t temp, int16_t hum) {
+    portENTER_CRITICAL(&historyMux);
+    bool added = historyBlockAppend(openBlock, encoder, time, temp, hum);
+    portEXIT_CRITICAL(&historyMux);
+    if (!added) {
+        sealOpenBlock();
+        portENTER_CRITICAL(&historyMux);
+        historyBlockAppend(openBlock, encoder, time, temp, hum);
+        portEXIT_CRITICAL(&historyMux);
+    }
+    samplesAppended++;
+    latestTime = time;
+    checkpointDirty = true;
+}
+
+#ifdef BENCH
+// Write timing over a ring lap and a quarter on a scratch ring: the same
+// whole-file slot writes and index rewrites as a sealed block, the slots
+// created on the first lap and replaced after it. Blocks the loop for the
+// whole lap (tens of seconds).
+static const char* LAP_DIR = "/hlap";
+static const char* LAP_INDEX_PATH = "/hlap/idx";
+static const char* LAP_INDEX_TMP_PATH = "/hlap/itmp";
+const uint32_t LAP_BLOCKS = HISTORY_SLOTS + HISTORY_SLOTS / 4;
+
+static volatile bool lapRequested = false;
+static bool lapDone = false;
+static uint32_t lapFirstMaxUs = 0;      // slots created
+static uint32_t lapReplaceMaxUs = 0;    // slots replaced
+static uint32_t lapMeanUs = 0;
+
+void requestHistoryLap() {
+    lapRequested = true;
+}
+
+static void runHistoryLap() {
+    size_t needed = (HISTORY_SLOTS + 2) * HISTORY_BLOCK_BYTES + 2 * sizeof(slots);
+    if (LittleFS.totalBytes() - LittleFS.usedBytes() < needed) {
+        Serial.println("History lap: not enough free space");
+        return;
+    }
+    if (!LittleFS.exists(LAP_DIR) && !LittleFS.mkdir(LAP_DIR)) return;
+    Serial.println("History lap: " + String(LAP_BLOCKS) + " blocks");
+
+    lapFirstMaxUs = 0;
+    lapReplaceMaxUs = 0;
+    uint64_t total = 0;
+    for (uint32_t seq = 1; seq <= LAP_BLOCKS; seq++) {
+        memset(&flushBlock, (uint8_t)seq, sizeof(flushBlock));
+        flushBlock.header.seq = seq;
+
+        unsigned long start = micros();
+        bool ok = writeBlockFile(LAP_DIR, slotOf(seq), flushBlock) &&
+                  writeWhole(LAP_INDEX_PATH, LAP_INDEX_TMP_PATH, (const uint8_t*)slots, sizeof(slots));
+        uint32_t us = micros() - start;
+        if (!ok) writeFailures++;
+
+        total += us;
+        uint32_t& lapMax = seq <= HISTORY_SLOTS ? lapFirstMaxUs : lapReplaceMaxUs;
+        if (us > lapMax) lapMax = us;
+        delay(1);
+    }
+    lapMeanUs = total / LAP_BLOCKS;
+    lapDone = true;
+
+    for (uint32_t i = 0; i < HISTORY_SLOTS; i++) {
+        char path[16];
+        slotPath(path, sizeof(path), LAP_DIR, i);
+        LittleFS.remove(path);
+    }
+    LittleFS.remove(LAP_INDEX_PATH);
+    LittleFS.rmdir(LAP_DIR);
+    Serial.println("History lap: max " + String(lapReplaceMaxUs) + " us replacing a slot, " +
+                   String(lapFirstMaxUs) + " us creating one, mean " + String(lapMeanUs) + " us");
+}
+#else
+void requestHistoryLap() {
+}
+#endif
+
+bool requestHistoryClock(const char* spec) {
+    char* end;
+    unsigned long seconds = strtoul(spec, &end, 10);
+    // Anything before 2020 is not a real clock
+    if (*end != '\0' || seconds < 1577836800UL) return false;
+    pendingClock = seconds;
+    clockPending = true;
+    return true;
+}
+
+void startHistory(float temperature, float humidity) {
+    if (!historyReady) return;
+
+#ifdef BENCH
+    if (lapRequested) {
+        lapRequested = false;
+        runHistoryLap();
+    }
+#endif
+
+    unsigned long now = millis();
+    uptimeMs += now - lastMillis;
+    lastMillis = now;
+
+    if (clockPending) {
+        clockPending = false;
+        uint32_t base = pendingClock - (uint32_t)(uptimeMs / 1000);
+        if (base > clockBase) {
+            clockBase = base;
+            clockSet = true;
+        }
+    }
+
+    // Samples are stamped on the schedule, not when the loop got to them,
+    // so the interval stays exact and costs one bit
+    if (uptimeMs >= nextSampleMs) {
+        uint32_t time = clockBase + (uint32_t)(nextSampleMs / 1000);
+        nextSampleMs += HISTORY_INTERVAL_MS;
+        if (uptimeMs >= nextSampleMs) nextSampleMs = uptimeMs + HISTORY_INTERVAL_MS;
+        appendSample(time, historyTenths(temperature), historyTenths(humidity));
+    }
+
+    if (checkpointDirty && now - lastCheckpoint >= HISTORY_CHECKPOINT_MS) {
+        checkpointOpenBlock();
+    }
+}
+
+// ---- Streaming ----
+
+enum StreamStage : uint8_t {
+    STREAM_HEAD,
+    STREAM_ROWS,
+    STREAM_TAIL,
+    STREAM_DONE
+};
+
+// Per-request state, in the request's _tempObject (freed with it)
+struct HistoryStream {
+    uint32_t from;
+    uint32_t to;
+    uint32_t seq;           // block being decoded
+    bool json;
+    bool loaded;
+    bool firstRow;
+    StreamStage stage;
+    HistoryBlock block;
+    HistoryDecoder dec;
+    char line[48];          // row that did not fit the last buffer
+    uint8_t lineLen;
+    uint8_t linePos;
+};
+
+// First block that can hold samples at or after from
+static uint32_t findStartSeq(uint32_t from) {
+    portENTER_CRITICAL(&historyMux);
+    uint32_t hi = openBlock.header.seq;
+    uint32_t lo = oldestSeq ? oldestSeq : hi;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (slots[slotOf(mid)].lastTime < from) lo = mid + 1;
+        else hi = mid;
+    }
+    portEXIT_CRITICAL(&historyMux);
+    return lo;
+}
+
+// Sealed blocks come from flash, the open one is copied out of RAM
+static bool loadStreamBlock(HistoryStream* s) {
+    for (;;) {
+        portENTER_CRITICAL(&historyMux);
+        uint32_t openSeq = openBlock.header.seq;
+        uint32_t oldest = oldestSeq ? oldestSeq : openSeq;
+        bool isOpen = s->seq == openSeq;
+        if (isOpen) memcpy(&s->block, &openBlock, sizeof(s->block));
+        portEXIT_CRITICAL(&historyMux);
+
+        if (s->seq > openSeq) return false;
+        if (s->seq < oldest) {
+            // Overwritten by the ring while streaming
+            s->seq = oldest;
+            continue;
+        }
+        if (isOpen || (readSlot(s->seq, s->block) && historyBlockValid(s->block) &&
+                       s->block.header.seq == s->seq)) {
+            historyDecodeBegin(s->dec);
+            s->loaded = true;
+            return true;
+        }
+        damagedBlocks = damagedBlocks + 1;
+        s->seq++;
+    }
+}
+
+static void formatTenths(char* out, size_t len, int16_t tenths, bool json) {
+    if (tenths != HISTORY_NAN) snprintf(out, len, "%.1f", tenths / 10.0f);
+    else if (json) snprintf(out, len, "null");
+    else out[0] = '\0';
+}
+
+static bool nextRow(HistoryStream* s) {
+    for (;;) {
+        if (!s->loaded && !loadStreamBlock(s)) return false;
+
+        uint32_t time;
+        int16_t temp, hum;
+        if (!historyDecodeNext(s->block, s->dec, &time, &temp, &hum)) {
+            s->loaded = false;
+            s->seq++;
+            continue;
+        }
+        if (time < s->from) continue;
+        if (time > s->to) return false;
+
+        char tempStr[10], humStr[10];
+        formatTenths(tempStr, sizeof(tempStr), temp, s->json);
+        formatTenths(humStr, sizeof(humStr), hum, s->json);
+        int n;
+        if (s->json) {
+            n = snprintf(s->line, sizeof(s->line), "%s[%lu,%s,%s]",
+                         s->firstRow ? "" : ",", (unsigned long)time, tempStr, humStr);
+        } else {
+            n = snprintf(s->line, sizeof(s->line), "%lu,%s,%s\n",
+                         (unsigned long)time, tempStr, humStr);
+        }
+        s->firstRow = false;
+        s->lineLen = n < (int)sizeof(s->line) ? n : sizeof(s->line) - 1;
+        rowsStreamed = rowsStreamed + 1;
+        return true;
+    }
+}
+
+static bool nextLine(HistoryStream* s) {
+    s->linePos = 0;
+    s->lineLen = 0;
+    switch (s->stage) {
+        case STREAM_HEAD:
+            s->lineLen = snprintf(s->line, sizeof(s->line), "%s",
+                                  s->json ? "{\"samples\":[" : "time,temperature,humidity\n");
+            s->stage = STREAM_ROWS;
+            return true;
+        case STREAM_ROWS:
+            if (nextRow(s)) return true;
+            s->stage = STREAM_TAIL;
+            // fall through
+        case STREAM_TAIL:
+            s->stage = STREAM_DONE;
+            if (!s->json) return false;
+            s->lineLen = snprintf(s->line, sizeof(s->line), "]}\n");
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Whole rows until the buffer is full; 0 ends the response
+static size_t fillHistory(HistoryStream* s, uint8_t* buffer, size_t maxLen) {
+    size_t n = 0;
+    while (n < maxLen) {
+        if (s->linePos < s->lineLen) {
+            size_t take = s->lineLen - s->linePos;
+            if (take > maxLen - n) take = maxLen - n;
+            memcpy(buffer + n, s->line + s->linePos, take);
+            s->linePos += take;
+            n += take;
+            continue;
+        }
+        if (!nextLine(s)) break;
+    }
+    return n;
+}
+
+static void handleHistory(AsyncWebServerRequest* request) {
+    if (!historyReady) {
+        request->send(503, "application/json", "{\"error\":\"history unavailable\"}");
+        return;
+    }
+    if (activeStreams >= MAX_HISTORY_STREAMS) {
+        streamsRefused = streamsRefused + 1;
+        request->send(503, "application/json", "{\"error\":\"busy\"}");
+        return;
+    }
+    HistoryStream* s = (HistoryStream*)malloc(sizeof(HistoryStream));
+    if (!s) {
+        request->send(503, "application/json", "{\"error\":\"out of memory\"}");
+        return;
+    }
+    memset(s, 0, sizeof(*s));
+    s->to = 0xFFFFFFFF;
+    if (request->hasParam("from")) s->from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+    if (request->hasParam("to")) s->to = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+    if (request->hasParam("last")) {
+        uint32_t last = strtoul(request->getParam("last")->value().c_str(), nullptr, 10);
+        uint32_t newest = latestTime;
+        s->from = newest > last ? newest - last : 0;
+    }
+    s->json = request->hasParam("format") && request->getParam("format")->value() == "json";
+    s->firstRow = true;
+    s->stage = STREAM_HEAD;
+    s->seq = findStartSeq(s->from);
+    request->_tempObject = s;
+
+    activeStreams = activeStreams + 1;
+    streamsServed = streamsServed + 1;
+    request->onDisconnect([]() { activeStreams = activeStreams - 1; });
+
+    AsyncWebServerResponse* response = request->beginChunkedResponse(
+        s->json ? "application/json" : "text/csv",
+        [s](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return fillHistory(s, buffer, maxLen);
+        });
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+bool setHistory(AsyncWebServer& server) {
+    // Before /history, which would also match it
+    server.on("/history/stats", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", historyStatsJson());
+    });
+    server.on("/history", HTTP_GET, handleHistory);
+
+    historyReady = loadHistory();
+    if (!historyReady) Serial.println("History unavailable");
+    return historyReady;
+}
+
+String historyStatsJson() {
+    uint32_t blocks = 0, samples = 0, bits = 0, oldestTime = 0;
+    portENTER_CRITICAL(&historyMux);
+    uint32_t openSeq = openBlock.header.seq;
+    if (oldestSeq != 0) {
+        oldestTime = slots[slotOf(oldestSeq)].firstTime;
+        for (uint32_t seq = oldestSeq; seq < openSeq; seq++) {
+            const HistoryIndexEntry& e = slots[slotOf(seq)];
+            if (e.seq != seq) continue;
+            blocks++;
+            samples += e.count;
+            bits += e.bits;
+        }
+    } else if (openBlock.header.count > 0) {
+        oldestTime = openBlock.header.firstTime;
+    }
+    uint32_t openCount = openBlock.header.count;
+    uint32_t openBits = openBlock.header.bits;
+    portEXIT_CRITICAL(&historyMux);
+
+    // Flash cost counts whole slots; retention assumes blocks fill like the
+    // ones so far (or like the open block before the first is sealed)
+    uint32_t total = samples + openCount;
+    float bytesPerSample = total ? (blocks + (openCount ? 1 : 0)) * (float)HISTORY_BLOCK_BYTES / total : 0;
+    float bitsPerSample = total ? (float)(bits + openBits) / total : 0;
+    float samplesPerBlock = blocks ? (float)samples / blocks
+                                   : (openBits ? openCount * (HISTORY_PAYLOAD_BYTES * 8.0f) / openBits : 0);
+    float retentionDays = samplesPerBlock * (HISTORY_SLOTS - 1) * (HISTORY_INTERVAL_MS / 1000.0f) / 86400.0f;
+
+    String json = "{";
+    json += "\"ready\":" + String(historyReady ? "true" : "false");
+    json += ",\"clockSet\":" + String(clockSet ? "true" : "false");
+    json += ",\"oldest\":" + String(oldestTime);
+    json += ",\"newest\":" + String((uint32_t)latestTime);
+    json += ",\"blocks\":" + String(blocks);
+    json += ",\"slots\":" + String(HISTORY_SLOTS);
+    json += ",\"samples\":" + String(total);
+    json += ",\"bytesPerSample\":" + String(bytesPerSample, 2);
+    json += ",\"payloadBitsPerSample\":" + String(bitsPerSample, 1);
+    json += ",\"retentionDays\":" + String(retentionDays, 1);
+    json += ",\"appended\":" + String(samplesAppended);
+    json += ",\"sealed\":" + String(blocksSealed);
+    json += ",\"checkpoints\":" + String(checkpoints);
+    json += ",\"writeFailures\":" + String(writeFailures);
+    json += ",\"lastWriteUs\":" + String(lastWriteUs);
+    json += ",\"maxWriteUs\":" + String(maxWriteUs);
+#ifdef BENCH
+    if (lapDone) {
+        json += ",\"lap\":{\"blocks\":" + String(LAP_BLOCKS);
+        json += ",\"createMaxUs\":" + String(lapFirstMaxUs);
+        json += ",\"replaceMaxUs\":" + String(lapReplaceMaxUs);
+        json += ",\"meanUs\":" + String(lapMeanUs) + "}";
+    }
+#endif
+    json += ",\"streams\":" + String(activeStreams);
+    json += ",\"streamsServed\":" + String(streamsServed);
+    json += ",\"streamsRefused\":" + String(streamsRefused);
+    json += ",\"rowsStreamed\":" + String(rowsStreamed);
+    json += ",\"damagedBlocks\":" + String(damagedBlocks);
+    json += "}";
+    return json;
+}
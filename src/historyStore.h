@@ -0,0 +1,40 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// On-device temperature/humidity history on LittleFS.
+// A sample is taken every 5 s into a compressed block in RAM (see
+// historyCodec.h). Full blocks are sealed into a ring of 1 KB slots, one
+// file per slot (/h/<slot>), with a small index (/history.idx, block number
+// and first timestamp per slot) kept in RAM for seeking by time. Slot files
+// and the index are always written whole and renamed into place, never
+// updated in place. The open block is checkpointed to its slot every few
+// minutes so a reset loses little.
+//
+// Times are unix seconds once a browser has sent "clock:<unix>", seconds
+// counted on from the newest stored sample before that. The clock only
+// ever moves forward.
+//
+// GET /history?from=&to=[&format=json] streams the range as CSV (or JSON),
+// decoding one block at a time into the response.
+
+// Load the index and the open block, add the /history routes
+// (call after LittleFS is mounted)
+bool setHistory(AsyncWebServer& server);
+
+// "clock:<unix seconds>", applied from the loop
+bool requestHistoryClock(const char* spec);
+
+// Sample, seal and checkpoint when due, call every loop
+void startHistory(float temperature, float humidity);
+
+// BENCH builds, "bench:history": time the slot and index writes over a full
+// ring lap on a scratch ring, reported under "lap" in the stats
+void requestHistoryLap();
+
+// Blocks, samples, bytes per sample, retention and write times
+String historyStatsJson();
+
+#endif
@@ -0,0 +1,282 @@
+#include "latencyTrace.h"
+
+#ifdef LATENCY_TRACE
+
+#include "hal.h"
+#include "sensorTrace.h"
+
+const int SPAN_SLOTS = 8;
+// Bucket i counts times below 2^i us (the last one everything above)
+const int SPAN_BUCKETS = 24;
+// A span still waiting for its frame after this is dropped
+const unsigned long SPAN_TIMEOUT_US = 5000000;
+
+enum SpanStage {
+    STAGE_INPUT,
+    STAGE_STATE,
+    STAGE_SERIALIZED,
+    STAGE_QUEUED,
+    STAGE_SENT,
+    STAGE_ECHO,
+    STAGE_COUNT
+};
+
+// Histogram i is the time from stage i to stage i + 1, the last one input
+// to sent
+const int INTERVAL_TOTAL = STAGE_COUNT - 1;
+const int INTERVAL_COUNT = STAGE_COUNT;
+static const char* intervalNames[INTERVAL_COUNT] = {
+    "sense", "publish", "outbox", "socket", "echo", "total"
+};
+static const char* eventNames[SPAN_EVENT_COUNT] = {"button", "clap", "command"};
+
+struct Span {
+    uint16_t id;                  // 0 = free
+    uint8_t event;
+    uint8_t frames;
+    uint8_t stage;                // last stage stamped
+    unsigned long at[STAGE_COUNT];
+};
+
+struct Histogram {
+    uint32_t count;
+    uint64_t sumUs;
+    uint32_t maxUs;
+    uint32_t buckets[SPAN_BUCKETS];
+};
+
+struct SpanTable {
+    Span spans[SPAN_SLOTS];
+    uint8_t next;
+    uint32_t started[SPAN_EVENT_COUNT];
+    Histogram hist[SPAN_EVENT_COUNT][INTERVAL_COUNT];
+};
+
+// Replay runs on the virtual clock, so it gets a table of its own
+static SpanTable live;
+static SpanTable replay;
+static uint16_t nextId = 1;
+
+// Echoes arrive on the AsyncTCP task
+static portMUX_TYPE spanMux = portMUX_INITIALIZER_UNLOCKED;
+
+static SpanTable& table() {
+    return traceReplaying() ? replay : live;
+}
+
+static void addSample(Histogram& h, unsigned long us) {
+    int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if (bucket >= SPAN_BUCKETS) bucket = SPAN_BUCKETS - 1;
+    h.count++;
+    h.sumUs += us;
+    if (us > h.maxUs) h.maxUs = us;
+    h.buckets[bucket]++;
+}
+
+// Stages are stamped in order, each one adds the time since the previous
+static bool stamp(SpanTable& t, Span& s, uint8_t stage, unsigned long now) {
+    if (s.id == 0 || s.stage != stage - 1) return false;
+    s.at[stage] = now;
+    s.stage = stage;
+    addSample(t.hist[s.event][stage - 1], now - s.at[stage - 1]);
+    if (stage == STAGE_SENT) addSample(t.hist[s.event][INTERVAL_TOTAL], now - s.at[STAGE_INPUT]);
+    return true;
+}
+
+static Span* findSpan(SpanTable& t, uint16_t id) {
+    if (id == 0) return nullptr;
+    for (int i = 0; i < SPAN_SLOTS; i++) {
+        if (t.spans[i].id == id) return &t.spans[i];
+    }
+    return nullptr;
+}
+
+void spanBegin(SpanEvent event, unsigned long inputUs, uint8_t frames) {
+    portENTER_CRITICAL(&spanMux);
+    SpanTable& t = table();
+    for (int i = 0; i < SPAN_SLOTS; i++) {
+        if (t.spans[i].stage == STAGE_INPUT) t.spans[i].id = 0;
+    }
+    // The oldest slot is reused
+    Span& s = t.spans[t.next];
+    t.next = (t.next + 1) % SPAN_SLOTS;
+    s.id = nextId;
+    nextId = nextId == 0xFFFF ? 1 : nextId + 1;
+    s.event = event;
+    s.frames = frames;
+    s.stage = STAGE_INPUT;
+    s.at[STAGE_INPUT] = inputUs;
+    t.started[event]++;
+    portEXIT_CRITICAL(&spanMux);
+}
+
+void spanState() {
+    unsigned long now = halMicros();
+    portENTER_CRITICAL(&spanMux);
+    SpanTable& t = table();
+    for (int i = 0; i < SPAN_SLOTS; i++) {
+        if (t.spans[i].id != 0 && t.spans[i].stage == STAGE_INPUT) {
+            stamp(t, t.spans[i], STAGE_STATE, now);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&spanMux);
+}
+
+uint16_t spanFrame(FrameClass cls) {
+    unsigned long now = halMicros();
+    uint16_t id = 0;
+    portENTER_CRITICAL(&spanMux);
+    SpanTable& t = table();
+    // The longest waiting span this frame can show
+    Span* oldest = nullptr;
+    for (int i = 0; i < SPAN_SLOTS; i++) {
+        Span& s = t.spans[i];
+        if (s.id == 0 || s.stage != STAGE_STATE || !(s.frames & (1 << cls))) continue;
+        if (now - s.at[STAGE_STATE] > SPAN_TIMEOUT_US) {
+            s.id = 0;
+            continue;
+        }
+        if (!oldest || (long)(s.at[STAGE_STATE] - oldest->at[STAGE_STATE]) < 0) oldest = &s;
+    }
+    if (oldest && stamp(t, *oldest, STAGE_SERIALIZED, now)) id = oldest->id;
+    portEXIT_CRITICAL(&spanMux);
+    return id;
+}
+
+// Frames only go out live, so the stages from here on are live only
+void spanQueued(uint16_t id) {
+    if (id == 0) return;
+    unsigned long now = micros();
+    portENTER_CRITICAL(&spanMux);
+    Span* s = findSpan(live, id);
+    if (s) stamp(live, *s, STAGE_QUEUED, now);
+    portEXIT_CRITICAL(&spanMux);
+}
+
+void spanSent(uint16_t id) {
+    if (id == 0) return;
+    unsigned long now = micros();
+    portENTER_CRITICAL(&spanMux);
+    Span* s = findSpan(live, id);
+    if (s) stamp(live, *s, STAGE_SENT, now);
+    portEXIT_CRITICAL(&spanMux);
+}
+
+bool spanEcho(const char* spec) {
+    char* end;
+    unsigned long id = strtoul(spec, &end, 10);
+    if (end == spec || *end != '\0' || id == 0 || id > 0xFFFF) return false;
+    unsigned long now = micros();
+
+    portENTER_CRITICAL(&spanMux);
+    Span* s = findSpan(live, id);
+    if (s) {
+        // The answer can beat the loop noticing the queue drained
+        if (s->stage == STAGE_QUEUED) stamp(live, *s, STAGE_SENT, now);
+        stamp(live, *s, STAGE_ECHO, now);
+    }
+    portEXIT_CRITICAL(&spanMux);
+    return true;
+}
+
+void latencyBeginReplay() {
+    portENTER_CRITICAL(&spanMux);
+    memset(&replay, 0, sizeof(replay));
+    portEXIT_CRITICAL(&spanMux);
+}
+
+// Upper bound of the bucket holding the q-th fraction, at most the max
+static uint32_t percentile(const Histogram& h, float q) {
+    uint32_t target = (uint32_t)ceilf(h.count * q);
+    uint32_t seen = 0;
+    for (int i = 0; i < SPAN_BUCKETS; i++) {
+        seen += h.buckets[i];
+        if (seen >= target) {
+            uint32_t limit = i == SPAN_BUCKETS - 1 ? h.maxUs : (1UL << i);
+            return limit < h.maxUs ? limit : h.maxUs;
+        }
+    }
+    return h.maxUs;
+}
+
+static String histogramJson(const Histogram& h) {
+    String json = "{\"count\":" + String(h.count);
+    json += ",\"avgUs\":" + String(h.count ? (uint32_t)(h.sumUs / h.count) : 0);
+    json += ",\"p50Us\":" + String(percentile(h, 0.5f));
+    json += ",\"p90Us\":" + String(percentile(h, 0.9f));
+    json += ",\"p99Us\":" + String(percentile(h, 0.99f));
+    json += ",\"maxUs\":" + String(h.maxUs);
+
+    // Trailing empty buckets are left out
+    int used = SPAN_BUCKETS;
+    while (used > 0 && h.buckets[used - 1] == 0) used--;
+    json += ",\"buckets\":[";
+    for (int i = 0; i < used; i++) {
+        if (i > 0) json += ",";
+        json += String(h.buckets[i]);
+    }
+    json += "]}";
+    return json;
+}
+
+static String tableJson(SpanTable& t) {
+    String json = "{";
+    for (int ev = 0; ev < SPAN_EVENT_COUNT; ev++) {
+        portENTER_CRITICAL(&spanMux);
+        uint32_t started = t.started[ev];
+        portEXIT_CRITICAL(&spanMux);
+
+        if (ev > 0) json += ",";
+        json += "\"" + String(eventNames[ev]) + "\":{\"spans\":" + String(started);
+        for (int i = 0; i < INTERVAL_COUNT; i++) {
+            Histogram h;
+            portENTER_CRITICAL(&spanMux);
+            h = t.hist[ev][i];
+            portEXIT_CRITICAL(&spanMux);
+            json += ",\"" + String(intervalNames[i]) + "\":" + histogramJson(h);
+        }
+        json += "}";
+    }
+    json += "}";
+    return json;
+}
+
+String latencyStatsJson() {
+    String json = "{\"enabled\":true";
+    json += ",\"live\":" + tableJson(live);
+    json += ",\"replay\":" + tableJson(replay);
+    json += "}";
+    return json;
+}
+
+#else
+
+void spanBegin(SpanEvent, unsigned long, uint8_t) {
+}
+
+void spanState() {
+}
+
+uint16_t spanFrame(FrameClass) {
+    return 0;
+}
+
+void spanQueued(uint16_t) {
+}
+
+void spanSent(uint16_t) {
+}
+
+bool spanEcho(const char*) {
+    return false;
+}
+
+void latencyBeginReplay() {
+}
+
+String latencyStatsJson() {
+    return "{\"enabled\":false}";
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef LATENCYTRACE_H
+#define LATENCYTRACE_H
+
+#include <Arduino.h>
+#include "wsOutbox.h"
+
+// Input-to-dashboard latency spans (build with LATENCY_TRACE, see
+// env:esp32dev_latency). A button press, clap or WebSocket command opens a
+// span stamped on halMicros() at each stage:
+//   input       edge time of the press, start of the clap's sample window,
+//               or the command taken from its queue
+//   state       the control state changed
+//   serialized  first frame showing it was built (halTextAll)
+//   queued      that frame was handed to a client's socket
+//   sent        the client's socket queue drained past it
+//   echo        the dashboard answered "rx:<id>" (the frame has "trace":id)
+// The time between stages goes into log2 histograms per event type, served
+// on GET /latency. During trace replay spans run on the virtual clock in a
+// table of their own and end at "serialized". Without LATENCY_TRACE these
+// are empty and frames carry no trace id.
+
+enum SpanEvent {
+    SPAN_BUTTON,
+    SPAN_CLAP,
+    SPAN_COMMAND,
+    SPAN_EVENT_COUNT
+};
+
+// Open a span; frames is a bit mask (1 << FrameClass) of the frames that
+// can show the change. A span still waiting for its state change is dropped.
+void spanBegin(SpanEvent event, unsigned long inputUs, uint8_t frames);
+
+// The state the open span's input asked for changed
+void spanState();
+
+// A frame of this class is being built: trace id to put in it, 0 for none
+uint16_t spanFrame(FrameClass cls);
+
+// Frame carrying id queued to / drained from a client socket (first wins)
+void spanQueued(uint16_t id);
+void spanSent(uint16_t id);
+
+// "rx:<id>" from the dashboard (runs on the AsyncTCP task)
+bool spanEcho(const char* spec);
+
+// Fresh replay table (called when a trace replay starts)
+void latencyBeginReplay();
+
+// Per event and stage: count, avg/max/percentiles and log2 buckets
+String latencyStatsJson();
+
+#endif
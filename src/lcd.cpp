@@ -1,6 +1,37 @@
 #include "lcd.h"
+#include "sensorTrace.h"
+#include "hal.h"
 
-LiquidCrystal_I2C lcd(0x27, 20, 4); // I2C address 0x27, 20 columns x 4 rows
+ReplaySafeLcd lcd(0x27, 20, 4); // I2C address 0x27, 20 columns x 4 rows
+
+ReplaySafeLcd::ReplaySafeLcd(uint8_t address, uint8_t columns, uint8_t rows)
+    : panel(address, columns, rows) {
+}
+
+void ReplaySafeLcd::init() {
+    panel.init();
+}
+
+void ReplaySafeLcd::backlight() {
+    panel.backlight();
+}
+
+static bool panelOff() {
+    return traceReplaying() || halDryRun();
+}
+
+void ReplaySafeLcd::clear() {
+    if (!panelOff()) panel.clear();
+}
+
+void ReplaySafeLcd::setCursor(uint8_t column, uint8_t row) {
+    if (!panelOff()) panel.setCursor(column, row);
+}
+
+size_t ReplaySafeLcd::write(uint8_t c) {
+    if (panelOff()) return 1;
+    return panel.write(c);
+}
 
 bool setLCD(){
     lcd.init();
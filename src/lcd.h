@@ -4,9 +4,24 @@
 #include <Arduino.h>
 #include <LiquidCrystal_I2C.h>
 
+// The 20x4 panel. Trace replay and benchmark dry runs (hal.h) run the room
+// code, which draws on it, so output is dropped while either is running.
+class ReplaySafeLcd : public Print {
+public:
+    ReplaySafeLcd(uint8_t address, uint8_t columns, uint8_t rows);
+    void init();
+    void backlight();
+    void clear();
+    void setCursor(uint8_t column, uint8_t row);
+    size_t write(uint8_t c) override;
+    using Print::write;
 
-extern LiquidCrystal_I2C lcd;
+private:
+    LiquidCrystal_I2C panel;
+};
+
+extern ReplaySafeLcd lcd;
 
 bool setLCD();
 void showLCD();
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,149 @@
+#include "ledcLights.h"
+#include <driver/ledc.h>
+#include <esp_timer.h>
+#include "lightSequence.h"
+#include "sensorTrace.h"
+#include "controlState.h"
+#include "hal.h"
+
+const ledc_mode_t LIGHT_MODE = LEDC_HIGH_SPEED_MODE;
+const ledc_timer_t LIGHT_TIMER = LEDC_TIMER_0;
+const uint32_t LIGHT_PWM_HZ = 5000;
+
+// Same pace as the old software stepper, each stage fading in over one step
+const uint32_t LIGHT_STEP_MS = 300;
+const uint32_t LIGHT_FADE_MS = 300;
+
+struct LightGroup {
+    LightFade fades[LEDC_MAX_LIGHTS];
+    uint8_t percent;
+    bool settled;           // every fade done, times no longer matter
+    uint32_t settledMs;     // when that will be
+    int settledLit;
+};
+
+static uint8_t lightPins[LEDC_MAX_LIGHTS];
+static int numLights = 0;
+static esp_timer_handle_t stageTimers[LEDC_MAX_LIGHTS];
+
+// Replay runs its own copy, started from the trace snapshot, so the live
+// lights are left alone
+static LightGroup live;
+static LightGroup replay;
+
+// The stage timers read the live fades from the esp_timer task, the only
+// place fades are started; saving and restoring the control state (bench,
+// trace snapshots) holds it too
+static portMUX_TYPE lightMux = portMUX_INITIALIZER_UNLOCKED;
+
+static LightGroup& lights() {
+    return traceReplaying() ? replay : live;
+}
+
+static void startFade(int light, uint16_t duty, uint32_t fadeMs) {
+    ledc_channel_t channel = (ledc_channel_t)(LEDC_CHANNEL_0 + light);
+    ledc_set_fade_with_time(LIGHT_MODE, channel, duty, fadeMs);
+    ledc_fade_start(LIGHT_MODE, channel, LEDC_FADE_NO_WAIT);
+}
+
+static void startStage(void* arg) {
+    int light = (int)(intptr_t)arg;
+    portENTER_CRITICAL(&lightMux);
+    LightFade fade = live.fades[light];
+    portEXIT_CRITICAL(&lightMux);
+    startFade(light, fade.toDuty, fade.fadeMs);
+}
+
+bool setLedcLights(const uint8_t* pins, int count) {
+    if (count > LEDC_MAX_LIGHTS) return false;
+
+    ledc_timer_config_t timer = {};
+    timer.speed_mode = LIGHT_MODE;
+    timer.duty_resolution = LEDC_TIMER_13_BIT;
+    timer.timer_num = LIGHT_TIMER;
+    timer.freq_hz = LIGHT_PWM_HZ;
+    timer.clk_cfg = LEDC_AUTO_CLK;
+    if (ledc_timer_config(&timer) != ESP_OK) return false;
+
+    for (int i = 0; i < count; i++) {
+        ledc_channel_config_t channel = {};
+        channel.gpio_num = pins[i];
+        channel.speed_mode = LIGHT_MODE;
+        channel.channel = (ledc_channel_t)(LEDC_CHANNEL_0 + i);
+        channel.intr_type = LEDC_INTR_DISABLE;
+        channel.timer_sel = LIGHT_TIMER;
+        channel.duty = 0;
+        if (ledc_channel_config(&channel) != ESP_OK) return false;
+
+        esp_timer_create_args_t args = {};
+        args.callback = startStage;
+        args.arg = (void*)(intptr_t)i;
+        args.name = "lightStage";
+        if (esp_timer_create(&args, &stageTimers[i]) != ESP_OK) return false;
+        lightPins[i] = pins[i];
+    }
+    numLights = count;
+    keepControlState(&live, sizeof(live), &replay, &lightMux);
+    return ledc_fade_func_install(0) == ESP_OK;
+}
+
+void ledcLightsTo(uint8_t percent, uint32_t now) {
+    if (percent > 100) percent = 100;
+    LightGroup& group = lights();
+    if (numLights == 0 || group.percent == percent) return;
+    bool replaying = traceReplaying();
+
+    portENTER_CRITICAL(&lightMux);
+    group.percent = percent;
+    lightSequenceStart(group.fades, numLights, lightDuty(percent), now, LIGHT_STEP_MS, LIGHT_FADE_MS);
+    portEXIT_CRITICAL(&lightMux);
+
+    group.settled = false;
+    group.settledMs = now;
+    group.settledLit = 0;
+    for (int i = 0; i < numLights; i++) {
+        uint32_t end = group.fades[i].startMs + group.fades[i].fadeMs;
+        if ((int32_t)(end - group.settledMs) > 0) group.settledMs = end;
+        if (group.fades[i].toDuty > 0) group.settledLit++;
+    }
+
+    for (int i = 0; i < numLights; i++) {
+        if (replaying) {
+            traceCheckOutput(TRACE_PIN_OUT, lightPins[i], percent);
+            continue;
+        }
+        if (halDryRun()) continue;
+        traceRecord(TRACE_PIN_OUT, lightPins[i], percent);
+
+        // Every fade is issued from the esp_timer task, stage 0 (and lights
+        // turning round mid-fade) on a timer due at once, so the LEDC fade
+        // calls never run from two tasks
+        esp_timer_stop(stageTimers[i]);
+        uint32_t delayMs = group.fades[i].startMs - now;
+        esp_timer_start_once(stageTimers[i], (uint64_t)delayMs * 1000);
+    }
+}
+
+int ledcLightsLit(uint32_t now) {
+    LightGroup& group = lights();
+    if (group.settled) return group.settledLit;
+
+    if ((int32_t)(now - group.settledMs) < 0) {
+        int lit = 0;
+        for (int i = 0; i < numLights; i++) {
+            if (lightDutyAt(group.fades[i], now) > 0) lit++;
+        }
+        return lit;
+    }
+
+    // Done: hold each light at its duty, so the old fade times are never
+    // compared with a clock that has wrapped round since
+    portENTER_CRITICAL(&lightMux);
+    for (int i = 0; i < numLights; i++) {
+        group.fades[i].fromDuty = group.fades[i].toDuty;
+        group.fades[i].fadeMs = 0;
+    }
+    portEXIT_CRITICAL(&lightMux);
+    group.settled = true;
+    return group.settledLit;
+}
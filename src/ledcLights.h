@@ -0,0 +1,25 @@
+#ifndef LEDCLIGHTS_H
+#define LEDCLIGHTS_H
+
+#include <Arduino.h>
+
+// Room lights on the ESP32 LEDC peripheral, staged as in lightSequence.h.
+// The loop only starts a sequence: each light's fade runs in the LEDC
+// hardware and the later stages are started from an esp_timer. The lights'
+// state is the sequence kept in RAM, never read back from the pins.
+// During trace replay nothing is driven; each light's new target (in %) is
+// checked against the trace as a pin output instead. Times are halMillis().
+// Only needs Arduino.h, driver/ledc.h and esp_timer.h, so tools/light_sim.cpp
+// can build it against a mock of those on the host.
+
+const int LEDC_MAX_LIGHTS = 4;
+
+bool setLedcLights(const uint8_t* pins, int count);
+
+// Fade to a 0-100 % level in stages (nothing to do if already heading there)
+void ledcLightsTo(uint8_t percent, uint32_t now);
+
+// Lights above zero duty now
+int ledcLightsLit(uint32_t now);
+
+#endif
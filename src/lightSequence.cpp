@@ -0,0 +1,32 @@
+#include "lightSequence.h"
+#include <math.h>
+
+uint16_t lightDuty(uint8_t percent) {
+    if (percent >= 100) return LIGHT_MAX_DUTY;
+    return (uint16_t)lroundf(powf(percent / 100.0f, 2.2f) * LIGHT_MAX_DUTY);
+}
+
+void lightSequenceStart(LightFade* lights, int count, uint16_t duty,
+                        uint32_t now, uint32_t stepMs, uint32_t fadeMs) {
+    for (int i = 0; i < count; i++) {
+        LightFade& light = lights[i];
+        bool running = (int32_t)(now - light.startMs) > 0 && lightFading(light, now);
+        int stage = duty > 0 ? i : count - 1 - i;
+
+        light.fromDuty = lightDutyAt(light, now);
+        light.toDuty = duty;
+        light.startMs = running ? now : now + stage * stepMs;
+        light.fadeMs = fadeMs;
+    }
+}
+
+uint16_t lightDutyAt(const LightFade& light, uint32_t now) {
+    int32_t t = (int32_t)(now - light.startMs);
+    if (t <= 0) return light.fromDuty;
+    if ((uint32_t)t >= light.fadeMs) return light.toDuty;
+    return light.fromDuty + ((int32_t)light.toDuty - light.fromDuty) * t / (int32_t)light.fadeMs;
+}
+
+bool lightFading(const LightFade& light, uint32_t now) {
+    return (int32_t)(now - light.startMs) < (int32_t)light.fadeMs;
+}
@@ -0,0 +1,36 @@
+#ifndef LIGHTSEQUENCE_H
+#define LIGHTSEQUENCE_H
+
+#include <stdint.h>
+
+// Staged fades for a row of lights.
+// Switching on, light 0 starts fading first and each next one stepMs later;
+// switching off runs from the last light back. A light's duty at any time
+// follows from its fade, so the state never has to be read back from the
+// hardware. A light caught mid-fade turns round at once, from where it is.
+// Plain C++ so tools/light_sim.cpp can build it on the host.
+
+const uint16_t LIGHT_MAX_DUTY = 8191;     // 13-bit LEDC duty
+
+struct LightFade {
+    uint16_t fromDuty;
+    uint16_t toDuty;
+    uint32_t startMs;
+    uint32_t fadeMs;
+};
+
+// Duty for a 0-100 % level on a gamma 2.2 curve (even steps to the eye).
+// Only the end duties are mapped, a fade between them is linear in duty
+// as the LEDC hardware runs it.
+uint16_t lightDuty(uint8_t percent);
+
+// Start a sequence towards duty from where each light is at now
+void lightSequenceStart(LightFade* lights, int count, uint16_t duty,
+                        uint32_t now, uint32_t stepMs, uint32_t fadeMs);
+
+uint16_t lightDutyAt(const LightFade& light, uint32_t now);
+
+// Fade still to start or running
+bool lightFading(const LightFade& light, uint32_t now);
+
+#endif
@@ -8,6 +8,20 @@
 #include "roomSystem_2.h"
 #include "roomSystem_3.h"
 #include "lcd.h"
+#include "ruleEngine.h"
+#include "stateStore.h"
+#include "webAssets.h"
+#include "hal.h"
+#include "sensorTrace.h"
+#include "allocTrack.h"
+#include "restApi.h"
+#include "bench.h"
+#include "telemetry.h"
+#include "commandQueue.h"
+#include "sensorHealth.h"
+#include "historyStore.h"
+#include "latencyTrace.h"
+#include "controlState.h"
 
 // WiFi Credentials
 const char* ssid = "DomusLink";
@@ -33,108 +47,260 @@ unsigned long lastDHTRead = 0;
 const unsigned long DHT_INTERVAL = 5000;
 unsigned long lastBroadcast = 0;
 const unsigned long WS_BROADCAST_INTERVAL = 5000;
+static unsigned long lastRoomBroadcast = 0;
+
+// Boot timing (millis() when setup finished / first frame went out)
+unsigned long setupDoneMs = 0;
+unsigned long firstFrameMs = 0;
+
+// Loop timing (smoothed average and worst case since last /status read)
+unsigned long loopUsAvg = 0;
+unsigned long loopUsMax = 0;
+unsigned long loopUsLast = 0;
+
+// Record boot-to-first-WebSocket-frame once
+void markFirstFrame() {
+    if (firstFrameMs != 0) return;
+    firstFrameMs = millis();
+    Serial.println("Boot to first WebSocket frame: " + String(firstFrameMs) + " ms");
+}
+
+// Frame buffer size for the JSON frames built below
+const size_t FRAME_LEN = 256;
+
+// JSON number for a reading (null while the sensor has no value)
+void formatReading(char* out, size_t len, float value) {
+    if (isnan(value)) snprintf(out, len, "null");
+    else snprintf(out, len, "%.1f", value);
+}
+
+// soundState is declared in roomSystem_2.h
+const char* soundName() {
+    if (soundState == 2) return "detected";
+    return soundState == 1 ? "listening" : "quiet";
+}
+
+// Full state frame (readings, rooms, door, sound)
+// Built into a caller buffer so the hot paths do not touch the heap
+void stateJson(char* out, size_t len) {
+    char tempStr[12], humStr[12];
+    formatReading(tempStr, sizeof(tempStr), temperature);
+    formatReading(humStr, sizeof(humStr), humidity);
+
+    // Always send actual state and mode separately
+    snprintf(out, len,
+             "{\"temperature\":%s,\"humidity\":%s,"
+             "\"room1\":\"%s\",\"room1Mode\":\"%s\","
+             "\"room2\":\"%s\",\"room2Mode\":\"%s\","
+             "\"door\":\"%s\",\"sound\":\"%s\","
+             "\"dht\":\"%s\",\"ultrasonic\":\"%s\"}",
+             tempStr, humStr,
+             room1_state ? "ON" : "OFF", room1_override ? "MANUAL" : "AUTO",
+             room2_state ? "ON" : "OFF", room2_override ? "MANUAL" : "AUTO",
+             doorOpen ? "UNLOCKED" : "LOCKED", soundName(),
+             sensorStatusName(SENSOR_DHT), sensorStatusName(SENSOR_ULTRASONIC));
+}
+
+// Full state broadcast: commands and room changes only ask for one, it is
+// sent once at the end of the control tick (sendPendingState)
+static bool statePending = false;
 
-// Safe WebSocket Notification
 void notifyClients(float temp, float hum) {
-    if (!wifiConnected || ws.count() == 0) return;
-    
     if (!isnan(temp)) temperature = temp;
     if (!isnan(hum)) humidity = hum;
-    
-    String tempStr = isnan(temperature) ? "0" : String(temperature, 1);
-    String humStr = isnan(humidity) ? "0" : String(humidity, 1);
-    
-    // Always send actual state and mode separately
-    String room1State = room1_state ? "ON" : "OFF";
-    String room2State = room2_state ? "ON" : "OFF";
-    String room1Mode = room1_override ? "MANUAL" : "AUTO";
-    String room2Mode = room2_override ? "MANUAL" : "AUTO";
-    String doorStr = doorOpen ? "UNLOCKED" : "LOCKED";
-    
-    // Determine sound state (soundState is declared in roomSystem_2.h)
-    String soundStr;
-    if (soundState == 2 ) {
-        soundStr = "\"detected\"";
-    } else {
-        soundStr = (soundState == 1) ? "\"listening\"" : "\"quiet\"";
+    statePending = true;
+}
+
+void sendPendingState() {
+    if (!statePending) return;
+    if (!wifiConnected || halClientCount(ws) == 0) {
+        statePending = false;
+        return;
     }
+    // Full state is rate limited (see wsOutbox.h), held until it is due
+    if (!halFrameDue(FRAME_STATE)) return;
+    statePending = false;
+
+    char json[FRAME_LEN];
+    stateJson(json, sizeof(json));
+    halTextAll(ws, json, FRAME_STATE);
+    markFirstFrame();
+}
 
-    String json = "{";
-    json += "\"temperature\":" + tempStr + ",";
-    json += "\"humidity\":" + humStr + ",";
-    json += "\"room1\":\"" + room1State + "\",";
-    json += "\"room1Mode\":\"" + room1Mode + "\",";
-    json += "\"room2\":\"" + room2State + "\",";
-    json += "\"room2Mode\":\"" + room2Mode + "\",";
-    json += "\"door\":\"" + doorStr + "\",";
-    json += "\"sound\":" + soundStr;
-    json += "}";
-    
+// Apply ON/OFF/AUTO to a room's override flags
+void applyRoomCommand(const char* state, bool& override, bool& target) {
+    if(strcmp(state, "ON") == 0) {
+        override = true;
+        target = true;
+    } else if(strcmp(state, "OFF") == 0) {
+        override = true;
+        target = false;
+    } else if(strcmp(state, "AUTO") == 0) {
+        override = false;
+    }
+    spanState();
+}
+
+// Room/door commands (from the WebSocket, or from a trace during replay)
+void handleCommand(const char* msg) {
+    if(strcmp(msg, "getReadings") == 0) {
+        notifyClients(temperature, humidity);
+    }
+
+    // Room 1 Control
+    if(strncmp(msg, "room1:", 6) == 0){
+        applyRoomCommand(msg + 6, room1_override, room1_manualTarget);
+        notifyClients(temperature, humidity);
+    }
+
+    // Room 2 Control
+    if(strncmp(msg, "room2:", 6) == 0){
+        applyRoomCommand(msg + 6, room2_override, room2_manualTarget);
+        if(strcmp(msg + 6, "AUTO") == 0) room2_state = false;
+        notifyClients(temperature, humidity);
+    }
+
+    // Door Control
+    if(strcmp(msg, "unlockDoor") == 0){
+        unlockDoor(ws);
+    }
+    if(strcmp(msg, "lockDoor") == 0){
+        lockDoor(ws);
+    }
+}
+
+// Queued WebSocket commands, recorded when they are applied
+void runCommand(const char* msg) {
+    // Latency span from the command leaving its queue (see latencyTrace.h)
+    spanBegin(SPAN_COMMAND, halMicros(), (1 << FRAME_ROOMS) | (1 << FRAME_DOOR) | (1 << FRAME_STATE));
+    halCommand(msg);
+    handleCommand(msg);
+}
+
+// Sensor fault injection (SENSOR_FAULTS builds)
+void handleFaultCommand(const char* which) {
+    if(strcmp(which, "dht") == 0) halSetFaults(HAL_FAULT_DHT);
+    else if(strcmp(which, "ultrasonic") == 0) halSetFaults(HAL_FAULT_PULSE);
+    else if(strcmp(which, "all") == 0) halSetFaults(HAL_FAULT_DHT | HAL_FAULT_PULSE);
+    else if(strcmp(which, "off") == 0) halSetFaults(0);
+}
 
-    ws.textAll(json);
+// Sensor trace control (SENSOR_TRACE builds, run from the loop, never recorded)
+#ifdef SENSOR_TRACE
+void handleTraceCommand(const char* action) {
+    if(strcmp(action, "start") == 0) requestTraceAction(TRACE_ACTION_START);
+    else if(strcmp(action, "stop") == 0) requestTraceAction(TRACE_ACTION_STOP);
+    else if(strcmp(action, "flush") == 0) requestTraceAction(TRACE_ACTION_FLUSH);
+    else if(strcmp(action, "dump") == 0) requestTraceAction(TRACE_ACTION_DUMP);
+    else if(strcmp(action, "replay") == 0) requestTraceAction(TRACE_ACTION_REPLAY);
+}
+#else
+void handleTraceCommand(const char*) {
+}
+#endif
+
+// Anything other than a dashboard reply is a command: it takes a token
+// from the client's bucket, then runs at once or is queued for the loop
+void handleCommandMessage(AsyncWebSocketClient *client, const char *msg) {
+    CommandResult admitted = admitCommand(client->id());
+    if(admitted == CMD_RATE_LIMITED) {
+        client->text("{\"error\":\"rate limited\"}");
+        return;
+    }
+    if(admitted != CMD_ADMITTED) {
+        if(admitted == CMD_REJECTED) client->text("{\"error\":\"command rejected\"}");
+        return;
+    }
+
+    if(strncmp(msg, "trace:", 6) == 0) {
+        handleTraceCommand(msg + 6);
+    } else if(strncmp(msg, "fault:", 6) == 0) {
+        handleFaultCommand(msg + 6);
+    } else if(strcmp(msg, "bench:run") == 0) {
+        requestBenchmarks();
+    } else if(strcmp(msg, "bench:history") == 0) {
+        requestHistoryLap();
+    } else if(strncmp(msg, "telemetry:", 10) == 0) {
+        if(!requestTelemetryTarget(msg + 10)) {
+            client->text("{\"error\":\"bad telemetry target\"}");
+        }
+    } else if(strncmp(msg, "sub:", 4) == 0) {
+        // Per-client, not part of the control state
+        if(!wsOutboxSubscribe(client->id(), msg + 4)) {
+            client->text("{\"error\":\"bad subscription\"}");
+        }
+    } else {
+        // Run by the loop (see commandQueue.h)
+        CommandResult result = queueCommand(client->id(), msg);
+        if(result == CMD_QUEUE_FULL) {
+            client->text("{\"error\":\"queue full\"}");
+        } else if(result == CMD_REJECTED) {
+            client->text("{\"error\":\"command rejected\"}");
+        }
+    }
 }
 
 // WebSocket Event Handler
-void onWsEvent(AsyncWebSocket *serverPtr, AsyncWebSocketClient *client,
+void onWsEvent(AsyncWebSocket *, AsyncWebSocketClient *client,
                AwsEventType type, void *arg, uint8_t *data, size_t len) {
     switch(type){
         case WS_EVT_CONNECT:
             Serial.println("WebSocket client connected");
-            notifyClients(temperature, humidity);
+            // Every outbox or command queue slot taken: tell the client
+            // and drop it
+            if(!wsOutboxConnect(client) || !commandQueueConnect(client->id())) {
+                wsOutboxDisconnect(client->id());
+                client->text("{\"error\":\"too many clients\"}");
+                client->close();
+                break;
+            }
+            halClientsChanged(ws);
+            // Only the new client needs the full state
+            {
+                char json[FRAME_LEN];
+                stateJson(json, sizeof(json));
+                client->text(json);
+            }
+            markFirstFrame();
             break;
 
         case WS_EVT_DISCONNECT:
             Serial.println("WebSocket client disconnected");
+            wsOutboxDisconnect(client->id());
+            commandQueueDisconnect(client->id());
+            halClientsChanged(ws);
             break;
 
         case WS_EVT_DATA: {
+            // Command handling is held to zero allocations (see allocTrack.h)
+            allocScopeBegin(ALLOC_SCOPE_WS_EVENT);
             AwsFrameInfo *info = (AwsFrameInfo*)arg;
-            if(info->final && info->opcode == WS_TEXT){
-                String msg = String((char*)data, len);
-
-                if(msg == "getReadings") {
-                    notifyClients(temperature, humidity);
-                }
-
-                // Room 1 Control
-                if(msg.startsWith("room1:")){
-                    String state = msg.substring(6);
-                    if(state == "ON") {
-                        room1_override = true;
-                        room1_manualTarget = true;
-                    } else if(state == "OFF") {
-                        room1_override = true;
-                        room1_manualTarget = false;
-                    } else if(state == "AUTO") {
-                        room1_override = false;
+            if(info->final && info->index == 0 && info->opcode == WS_TEXT){
+                // Commands are short, copy into a terminated stack buffer
+                char msg[64];
+                if(len < sizeof(msg)) {
+                    memcpy(msg, data, len);
+                    msg[len] = '\0';
+
+                    // The dashboard's own replies take no command token, so
+                    // alert and trace traffic never crowds out user commands
+                    if(strncmp(msg, "clock:", 6) == 0) {
+                        // Browser time for the stored history (see historyStore.h)
+                        requestHistoryClock(msg + 6);
+                    } else if(strncmp(msg, "ack:", 4) == 0) {
+                        // Alert acknowledgements (see wsOutbox.h)
+                        wsOutboxAck(client->id(), msg + 4);
+                    } else if(strncmp(msg, "rx:", 3) == 0) {
+                        // Dashboard got a traced frame (LATENCY_TRACE builds)
+                        spanEcho(msg + 3);
+                    } else {
+                        handleCommandMessage(client, msg);
                     }
-                    notifyClients(temperature, humidity);
-                }
-
-                // Room 2 Control
-                if(msg.startsWith("room2:")){
-                    String state = msg.substring(6);
-                    if(state == "ON") {
-                        room2_override = true;
-                        room2_manualTarget = true;
-                    } else if(state == "OFF") {
-                        room2_override = true;
-                        room2_manualTarget = false;
-                    } else if(state == "AUTO") {
-                        room2_override = false;
-                        room2_state = false;
-                    }
-                    notifyClients(temperature, humidity);
-                }
-
-                // Door Control
-                if(msg == "unlockDoor"){
-                    unlockDoor(ws);
-                }
-                if(msg == "lockDoor"){
-                    lockDoor(ws);
+                } else {
+                    client->text("{\"error\":\"command rejected\"}");
                 }
             }
+            allocScopeEnd(ALLOC_SCOPE_WS_EVENT);
             break;
         }
 
@@ -170,143 +336,299 @@ void setup() {
     
     Serial.println("\n=== ESP32 IoT System Starting ===");
 
-    // Initialize hardware
-    Serial.println("Initializing hardware...");
-    if (!setLCD()) {
-        Serial.println("LCD initialization failed!");
-    }
-    showLCD();
-    if (!setRoomOne()) {
-        Serial.println("Room 1 hardware initialization failed!");
-    }
-    if (!setRoomTwo()) {
-        Serial.println("Room 2 hardware initialization failed!");
-    }
-    if (!setRoomThree()) {
-        Serial.println("Room 3 hardware initialization failed!");
-    }
-    if (!setDoorPins()) {
-        Serial.println("Door system hardware initialization failed!");
-    }
-    Serial.println("Hardware initialized");
-
     if(!LittleFS.begin()) {
         Serial.println("LittleFS mount failed");
     }
 
-    // Initialize WiFi
+    // Automation rules (falls back to built-in defaults)
+    loadRules();
+
+    // Warm start: restore control state and calibration saved before reset
+    loadState();
+
+    // Bring the AP and server up first, hardware init below overlaps with
+    // the AP starting and clients associating
     initWiFi();
 
     // WebSocket
+    setWsOutbox();
+    setCommandQueue();
     ws.onEvent(onWsEvent);
+    setTraceCommandHandler(handleCommand);
     server.addHandler(&ws);
 
-    // Serve Static Files 
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-        request->send(LittleFS, "/index.html", "text/html");
-    });
+    // Serve Static Files (compiled into flash with EMBED_WEB_ASSETS, else LittleFS)
+    if (!serveEmbeddedAssets(server)) {
+        server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
+            request->send(LittleFS, "/index.html", "text/html");
+        });
     
-    server.on("/login.html", HTTP_GET, [](AsyncWebServerRequest *request){
-        request->send(LittleFS, "/login.html", "text/html");
-    });
+        server.on("/login.html", HTTP_GET, [](AsyncWebServerRequest *request){
+            request->send(LittleFS, "/login.html", "text/html");
+        });
     
-    server.on("/script.js", HTTP_GET, [](AsyncWebServerRequest *request){
-        request->send(LittleFS, "/script.js", "application/javascript");
-    });
+        server.on("/script.js", HTTP_GET, [](AsyncWebServerRequest *request){
+            request->send(LittleFS, "/script.js", "application/javascript");
+        });
     
-    server.on("/chart.js", HTTP_GET, [](AsyncWebServerRequest *request){
-        request->send(LittleFS, "/chart.js", "application/javascript");
-    });
+        server.on("/chart.js", HTTP_GET, [](AsyncWebServerRequest *request){
+            request->send(LittleFS, "/chart.js", "application/javascript");
+        });
     
-    server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request){
-        request->send(LittleFS, "/style.css", "text/css");
-    });
+        server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request){
+            request->send(LittleFS, "/style.css", "text/css");
+        });
+
+        // Serve all assets (fonts, icons, images) with automatic MIME type detection
+        server.serveStatic("/assets/", LittleFS, "/assets/");
+    }
+
+    // REST API (/api/state, /api/commands, /readings)
+    setRestApi(server, stateJson, handleCommand);
 
-    // Serve all assets (fonts, icons, images) with automatic MIME type detection
-    server.serveStatic("/assets/", LittleFS, "/assets/");
+    // Temperature/humidity history (/history, /history/stats)
+    setHistory(server);
 
-    // REST endpoint
-    server.on("/readings", HTTP_GET, [](AsyncWebServerRequest *request){
-        String tempStr = isnan(temperature) ? "0" : String(temperature, 1);
-        String humStr = isnan(humidity) ? "0" : String(humidity, 1);
-        String json = "{\"temperature\":" + tempStr + ",\"humidity\":" + humStr + "}";
+    // Boot/runtime status
+    server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request){
+        String json = "{";
+        json += "\"uptimeMs\":" + String(millis()) + ",";
+        json += "\"setupMs\":" + String(setupDoneMs) + ",";
+        json += "\"firstFrameMs\":" + String(firstFrameMs) + ",";
+        uint32_t freeHeap = ESP.getFreeHeap();
+        uint32_t largestBlock = ESP.getMaxAllocHeap();
+        json += "\"freeHeap\":" + String(freeHeap) + ",";
+        json += "\"minFreeHeap\":" + String(ESP.getMinFreeHeap()) + ",";
+        json += "\"largestBlock\":" + String(largestBlock) + ",";
+        json += "\"fragmentation\":" + String(freeHeap ? 100 - largestBlock * 100 / freeHeap : 0) + ",";
+        json += "\"loopUs\":" + String(loopUsAvg) + ",";
+        json += "\"loopUsMax\":" + String(loopUsMax) + ",";
+        json += "\"clients\":" + String((unsigned)ws.count());
+        json += "}";
+        loopUsMax = 0;
         request->send(200, "application/json", json);
     });
 
+    // Allocation tracking (ALLOC_TRACK builds)
+    server.on("/alloc", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", allocStatsJson());
+    });
+
+    // Benchmark results (BENCH builds)
+    server.on("/bench", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", benchResultsJson());
+    });
+
+    // Sensor trace stream and replay result (trace: commands in SENSOR_TRACE builds)
+    server.on("/trace", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", traceStatsJson());
+    });
+
+    // Sensor health and circuit breakers
+    server.on("/sensors", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", sensorHealthJson());
+    });
+
+    // Input-to-dashboard latency histograms (LATENCY_TRACE builds)
+    server.on("/latency", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", latencyStatsJson());
+    });
+
+    // UDP telemetry stream (TELEMETRY builds)
+    server.on("/telemetry", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", telemetryStatsJson());
+    });
+
+    // State journal stats (write amplification, replay time)
+    server.on("/journal", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", stateStoreStatsJson());
+    });
+
+    // Per-client command queue stats (rate limiting, collapsed commands)
+    server.on("/commands", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", commandQueueStatsJson());
+    });
+
+    // Per-client WebSocket queue stats
+    server.on("/clients", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", wsOutboxStatsJson());
+    });
+
+    // Rule upload: body is written to /rules.tmp and only replaces /rules.json
+    // if it compiles, then reloaded from the loop
+    static volatile bool rulesAccepted = false;
+    server.on("/rules", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (rulesAccepted) {
+            request->send(200, "application/json", "{\"rules\":\"reloading\"}");
+        } else {
+            request->send(400, "application/json", "{\"error\":\"invalid rules\"}");
+        }
+    }, nullptr, [](AsyncWebServerRequest *, uint8_t *data, size_t len, size_t index, size_t total){
+        if (index == 0) rulesAccepted = false;
+        File file = LittleFS.open("/rules.tmp", index == 0 ? "w" : "a");
+        if (!file) return;
+        file.write(data, len);
+        file.close();
+        if (index + len == total) {
+            rulesAccepted = checkRulesFile("/rules.tmp");
+            if (!rulesAccepted) {
+                LittleFS.remove("/rules.tmp");
+                return;
+            }
+            LittleFS.remove("/rules.json");
+            LittleFS.rename("/rules.tmp", "/rules.json");
+            requestRulesReload();
+        }
+    });
+
+    server.on("/rules", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(LittleFS, "/rules.json", "application/json");
+    });
+
     server.begin();
     Serial.println("HTTP server started");
+
+    // Initialize hardware (no blocking calibration, see setRoomTwo)
+    // Each module registers its control state (see controlState.h)
+    Serial.println("Initializing hardware...");
+    setHal();
+    setSensorHealth();
+    keepControlState(temperature);
+    keepControlState(humidity);
+    keepControlState(distance);
+    keepControlState(lastDHTRead);
+    keepControlState(lastBroadcast);
+    keepControlState(lastRoomBroadcast);
+    keepControlState(statePending);
+    if (!setLCD()) {
+        Serial.println("LCD initialization failed!");
+    }
+    showLCD();
+    if (!setRoomOne()) {
+        Serial.println("Room 1 hardware initialization failed!");
+    }
+    if (!setRoomTwo()) {
+        Serial.println("Room 2 hardware initialization failed!");
+    }
+    if (!setRoomThree()) {
+        Serial.println("Room 3 hardware initialization failed!");
+    }
+    if (!setDoorPins()) {
+        Serial.println("Door system hardware initialization failed!");
+    }
+    Serial.println("Hardware initialized");
+
+    setupDoneMs = millis();
+    Serial.println("Setup done in " + String(setupDoneMs) + " ms");
     Serial.println("=== System Ready ===");
     Serial.println("Mode: " + String(wifiConnected ? "ONLINE" : "OFFLINE"));
 }
 
 
-void loop() {
-    unsigned long now = millis();
-   
+// One pass of the control logic (also driven by trace replay)
+void controlTick() {
+    halBeginTick();
+    unsigned long now = halMillis();
 
+    // DHT is skipped while its breaker is open (see sensorHealth.h)
     if(now - lastDHTRead >= DHT_INTERVAL){
         lastDHTRead = now;
-        float t, h;
-        getDHT(&h, &t);
-        if(!isnan(t)) temperature = t;
-        if(!isnan(h)) humidity = h;
+        if(sensorShouldRead(SENSOR_DHT)){
+            float t, h;
+            getDHT(&h, &t);
+            if(!isnan(t)) temperature = t;
+            if(!isnan(h)) humidity = h;
+            if(!isnan(t) && !isnan(h)) {
+                sensorSuccess(SENSOR_DHT);
+                // Heat index alerts follow every new sample
+                checkHeatIndex(t, h, &ws);
+            } else {
+                sensorFailure(SENSOR_DHT, false);
+            }
+        }
+    }
+    // Old readings are dropped rather than reported as current
+    SensorStatus dht = sensorStatus(SENSOR_DHT);
+    if(dht == SENSOR_STALE || dht == SENSOR_FAILED){
+        temperature = NAN;
+        humidity = NAN;
     }
 
-    // Pass WebSocket pointer to Room 3 for heat index alerts
-    startRoomThree(&temperature, &humidity, &distance, &ws);
+    startRoomThree(&temperature, &humidity, &distance);
     startDoor(ws);
     startRoomOne(notifyClients);
     startRoomTwo(notifyClients);
 
-    // Broadcast DHT readings every 5 seconds
-    if(wifiConnected && now - lastBroadcast >= WS_BROADCAST_INTERVAL){
+    // Topic frames are only built when a subscriber is due (see wsOutbox.h)
+    bool clients = wifiConnected && halClientCount(ws) > 0;
+
+    // Temperature/humidity every 5 seconds
+    if(clients && now - lastBroadcast >= WS_BROADCAST_INTERVAL){
         lastBroadcast = now;
-        
-        // Only send temperature and humidity data
-        String tempStr = isnan(temperature) ? "0" : String(temperature, 1);
-        String humStr = isnan(humidity) ? "0" : String(humidity, 1);
-        
-        String json = "{";
-        json += "\"temperature\":" + tempStr + ",";
-        json += "\"humidity\":" + humStr;
-        json += "}";
-        
-        ws.textAll(json);
+        if(halFrameDue(FRAME_ENV)){
+            char tempStr[12], humStr[12], json[96];
+            formatReading(tempStr, sizeof(tempStr), temperature);
+            formatReading(humStr, sizeof(humStr), humidity);
+            snprintf(json, sizeof(json), "{\"temperature\":%s,\"humidity\":%s,\"dht\":\"%s\"}",
+                     tempStr, humStr, sensorStatusName(SENSOR_DHT));
+            halTextAll(ws, json, FRAME_ENV);
+        }
     }
 
-    // Broadcast room states more frequently (every 500ms)
-    static unsigned long lastRoomBroadcast = 0;
-    if(wifiConnected && now - lastRoomBroadcast >= 500){
+    // Rooms, door and sound every 500ms (repeats of an unchanged frame are dropped)
+    if(clients && now - lastRoomBroadcast >= 500){
         lastRoomBroadcast = now;
-        
+        char json[FRAME_LEN];
+
         // Always send actual state and mode separately
-        String room1State = room1_state ? "ON" : "OFF";
-        String room2State = room2_state ? "ON" : "OFF";
-        String room1Mode = room1_override ? "MANUAL" : "AUTO";
-        String room2Mode = room2_override ? "MANUAL" : "AUTO";
-        String doorStr = doorOpen ? "UNLOCKED" : "LOCKED";
-        
-        // Add sound state to this broadcast
-        String soundStr;
-        if (soundState == 2) {
-            soundStr = "\"detected\"";
-        } else {
-            soundStr = (soundState == 1) ? "\"listening\"" : "\"quiet\"";
+        if(halFrameDue(FRAME_ROOMS)){
+            snprintf(json, sizeof(json),
+                     "{\"room1\":\"%s\",\"room1Mode\":\"%s\","
+                     "\"room2\":\"%s\",\"room2Mode\":\"%s\"}",
+                     room1_state ? "ON" : "OFF", room1_override ? "MANUAL" : "AUTO",
+                     room2_state ? "ON" : "OFF", room2_override ? "MANUAL" : "AUTO");
+            halTextAll(ws, json, FRAME_ROOMS);
         }
-        
-        String json = "{";
-        json += "\"room1\":\"" + room1State + "\",";
-        json += "\"room1Mode\":\"" + room1Mode + "\",";
-        json += "\"room2\":\"" + room2State + "\",";
-        json += "\"room2Mode\":\"" + room2Mode + "\",";
-        json += "\"door\":\"" + doorStr + "\",";
-        json += "\"sound\":" + soundStr;
-        json += "}";
-        
-        ws.textAll(json);
+        if(halFrameDue(FRAME_DOOR)){
+            snprintf(json, sizeof(json), "{\"door\":\"%s\"}", doorOpen ? "UNLOCKED" : "LOCKED");
+            halTextAll(ws, json, FRAME_DOOR);
+        }
+        if(halFrameDue(FRAME_SOUND)){
+            snprintf(json, sizeof(json), "{\"sound\":\"%s\"}", soundName());
+            halTextAll(ws, json, FRAME_SOUND);
+        }
+        markFirstFrame();
     }
 
+    // One full state frame per tick, however many changes asked for it
+    sendPendingState();
+}
+
+void loop() {
+    unsigned long now = millis();
+    unsigned long loopStart = micros();
+
+    startRules();
+    startStateStore();
+    startTrace(controlTick);
+    startBenchmarks();
+
+    allocScopeBegin(ALLOC_SCOPE_COMMANDS);
+    drainCommands(runCommand);
+    allocScopeEnd(ALLOC_SCOPE_COMMANDS);
+
+    allocScopeBegin(ALLOC_SCOPE_TICK);
+    controlTick();
+    allocScopeEnd(ALLOC_SCOPE_TICK);
+    startHistory(temperature, humidity);
+    startAllocSoak();
+    startRestApi();
+
     if(wifiConnected) {
+        allocScopeBegin(ALLOC_SCOPE_SEND);
+        startWsOutbox();
+        allocScopeEnd(ALLOC_SCOPE_SEND);
+
         static unsigned long lastCleanup = 0;
         if(now - lastCleanup > 5000){
             lastCleanup = now;
@@ -314,7 +636,14 @@ void loop() {
         }
     }
 
-    
+    // Carries the previous pass's loop time so its own cost is included
+    startTelemetry(loopUsLast);
+
+
+    unsigned long loopUs = micros() - loopStart;
+    loopUsLast = loopUs;
+    loopUsAvg = (loopUsAvg * 7 + loopUs) / 8;
+    if (loopUs > loopUsMax) loopUsMax = loopUs;
 
     delay(1);
 }
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include "restApi.h"
+#include <ArduinoJson.h>
+#include "hal.h"
+#include "doorSystem.h"
+#include "roomSystem_1.h"
+#include "roomSystem_2.h"
+#include "sensorHealth.h"
+#include "stateStore.h"
+
+// Sensor values (main.cpp)
+extern float temperature;
+extern float humidity;
+void formatReading(char* out, size_t len, float value);
+
+// Batch and body limits
+const int MAX_BATCH = 8;
+const size_t COMMAND_LEN = 32;
+const size_t MAX_COMMAND_BODY = 512;
+const size_t STATE_BODY_LEN = 320;
+
+// Long-poll limits (each one holds a connection open)
+const unsigned long MAX_WAIT_MS = 30000;
+const int MAX_LONG_POLLS = 4;
+
+// Everything that shows up in the state JSON, compared every loop
+struct StateKey {
+    int16_t temperature;
+    int16_t humidity;
+    uint8_t flags;
+    uint8_t sound;
+    uint8_t sensors;        // SensorStatus of each sensor, 2 bits apiece
+};
+
+static void (*stateWriter)(char*, size_t) = nullptr;
+static void (*commandRunner)(const char*) = nullptr;
+
+static portMUX_TYPE apiMux = portMUX_INITIALIZER_UNLOCKED;
+static StateKey lastKey;
+static volatile uint32_t version = 0;
+// Versions restart at boot, the ETag carries the boot id (stateStore.h) to
+// tell the runs apart
+static uint16_t bootId = 0;
+static char stateBody[STATE_BODY_LEN];
+static size_t stateBodyLen = 0;
+static char readingsBody[64];
+static size_t readingsBodyLen = 0;
+
+// One batch waits for the loop at a time
+static char batch[MAX_BATCH][COMMAND_LEN];
+static int batchCount = 0;
+static volatile bool batchPending = false;
+
+// Paused long-poll requests (request continuation), answered by the loop.
+// The AsyncTCP task claims a slot and fills it in; the loop frees it once it
+// has answered or finds the pointer expired (the client went away).
+enum LongPollState : uint8_t { POLL_FREE, POLL_CLAIMED, POLL_WAITING };
+
+struct LongPoll {
+    volatile uint8_t state;
+    AsyncWebServerRequestPtr request;
+    uint32_t from;
+    unsigned long start;
+    unsigned long waitMs;
+};
+static LongPoll longPolls[MAX_LONG_POLLS];
+
+static int16_t tenths(float v) {
+    if (isnan(v)) return INT16_MIN;
+    return (int16_t)lroundf(v * 10.0f);
+}
+
+static void captureKey(StateKey& k) {
+    memset(&k, 0, sizeof(k));
+    k.temperature = tenths(temperature);
+    k.humidity = tenths(humidity);
+    k.flags = (room1_state ? 1 : 0) | (room1_override ? 2 : 0) |
+              (room2_state ? 4 : 0) | (room2_override ? 8 : 0) |
+              (doorOpen ? 16 : 0);
+    k.sound = soundState;
+    for (int i = 0; i < SENSOR_COUNT; i++) k.sensors |= sensorStatus((SensorId)i) << (2 * i);
+}
+
+uint32_t stateVersion() {
+    return version;
+}
+
+// "<boot>-<version>", quoted or not, W/ accepted. A tag from another boot
+// never matches, however its version compares.
+static bool tagMatches(const char* p, uint32_t current) {
+    if (strncmp(p, "W/", 2) == 0) p += 2;
+    if (*p == '"') p++;
+    if (*p < '0' || *p > '9') return false;
+    char* end;
+    unsigned long boot = strtoul(p, &end, 10);
+    if (*end != '-' || boot != bootId) return false;
+    p = end + 1;
+    if (*p < '0' || *p > '9') return false;
+    return strtoul(p, nullptr, 10) == current;
+}
+
+static bool etagMatches(const AsyncWebServerRequest* request, uint32_t current) {
+    const AsyncWebHeader* match = request->getHeader("If-None-Match");
+    return match && tagMatches(match->value().c_str(), current);
+}
+
+static void addEtag(AsyncWebServerResponse* response, uint32_t current) {
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%u-%lu\"", bootId, (unsigned long)current);
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+}
+
+static void sendNotModified(AsyncWebServerRequest* request, uint32_t current) {
+    AsyncWebServerResponse* response = request->beginResponse(304, "text/plain", "");
+    addEtag(response, current);
+    request->send(response);
+}
+
+// Copy a cached body out under the lock (the loop rewrites it)
+static size_t copyBody(const char* body, const size_t& bodyLen, char* out, size_t len) {
+    portENTER_CRITICAL(&apiMux);
+    size_t n = bodyLen < len ? bodyLen : len;
+    memcpy(out, body, n);
+    portEXIT_CRITICAL(&apiMux);
+    return n;
+}
+
+static void sendBody(AsyncWebServerRequest* request, const char* body, const size_t& bodyLen, uint32_t current) {
+    char out[STATE_BODY_LEN];
+    size_t n = copyBody(body, bodyLen, out, sizeof(out) - 1);
+    out[n] = '\0';
+    AsyncWebServerResponse* response = request->beginResponse(200, "application/json", out);
+    addEtag(response, current);
+    request->send(response);
+}
+
+// Paused until the version moves or the wait runs out, then answered by
+// the loop (see answerLongPolls()). False when every slot is taken.
+static bool startLongPoll(AsyncWebServerRequest* request, uint32_t from, unsigned long waitMs) {
+    int slot = -1;
+    portENTER_CRITICAL(&apiMux);
+    for (int i = 0; i < MAX_LONG_POLLS; i++) {
+        if (longPolls[i].state == POLL_FREE) {
+            longPolls[i].state = POLL_CLAIMED;
+            slot = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&apiMux);
+    if (slot < 0) return false;
+
+    LongPoll& poll = longPolls[slot];
+    poll.from = from;
+    poll.start = millis();
+    poll.waitMs = waitMs;
+    poll.request = request->pause();
+    portENTER_CRITICAL(&apiMux);
+    poll.state = POLL_WAITING;
+    portEXIT_CRITICAL(&apiMux);
+    return true;
+}
+
+static void handleState(AsyncWebServerRequest* request) {
+    uint32_t current = version;
+    if (current == 0) {
+        request->send(503, "application/json", "{\"error\":\"starting\"}");
+        return;
+    }
+
+    bool upToDate = etagMatches(request, current);
+    if (!upToDate && request->hasParam("since")) {
+        upToDate = tagMatches(request->getParam("since")->value().c_str(), current);
+    }
+    if (!upToDate) {
+        sendBody(request, stateBody, stateBodyLen, current);
+        return;
+    }
+
+    unsigned long waitMs = 0;
+    if (request->hasParam("wait")) {
+        waitMs = strtoul(request->getParam("wait")->value().c_str(), nullptr, 10);
+        if (waitMs > MAX_WAIT_MS) waitMs = MAX_WAIT_MS;
+    }
+    if (waitMs > 0 && startLongPoll(request, current, waitMs)) return;
+    sendNotModified(request, current);
+}
+
+static void handleReadings(AsyncWebServerRequest* request) {
+    uint32_t current = version;
+    if (current == 0) {
+        request->send(503, "application/json", "{\"error\":\"starting\"}");
+        return;
+    }
+    if (etagMatches(request, current)) {
+        sendNotModified(request, current);
+        return;
+    }
+    sendBody(request, readingsBody, readingsBodyLen, current);
+}
+
+static bool validCommand(const char* cmd) {
+    if (strncmp(cmd, "room1:", 6) == 0 || strncmp(cmd, "room2:", 6) == 0) {
+        const char* state = cmd + 6;
+        return strcmp(state, "ON") == 0 || strcmp(state, "OFF") == 0 || strcmp(state, "AUTO") == 0;
+    }
+    return strcmp(cmd, "lockDoor") == 0 || strcmp(cmd, "unlockDoor") == 0;
+}
+
+// Body chunks are collected in the request's temp buffer (freed with it)
+static void collectBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+    if (total > MAX_COMMAND_BODY) return;
+    if (index == 0) {
+        request->_tempObject = malloc(total + 1);
+        if (!request->_tempObject) return;
+    }
+    char* body = (char*)request->_tempObject;
+    if (!body) return;
+    memcpy(body + index, data, len);
+    if (index + len == total) body[total] = '\0';
+}
+
+// The whole batch is checked before any of it is queued
+static void handleCommands(AsyncWebServerRequest* request) {
+    if (request->contentLength() > MAX_COMMAND_BODY) {
+        request->send(413, "application/json", "{\"error\":\"batch too large\"}");
+        return;
+    }
+    const char* body = (const char*)request->_tempObject;
+    if (!body) {
+        request->send(400, "application/json", "{\"error\":\"empty batch\"}");
+        return;
+    }
+
+    JsonDocument doc;
+    if (deserializeJson(doc, body)) {
+        request->send(400, "application/json", "{\"error\":\"invalid JSON\"}");
+        return;
+    }
+    JsonArrayConst list = doc.as<JsonArrayConst>();
+    if (list.isNull() || list.size() == 0 || list.size() > (size_t)MAX_BATCH) {
+        request->send(400, "application/json", "{\"error\":\"expected 1-8 commands\"}");
+        return;
+    }
+
+    char staged[MAX_BATCH][COMMAND_LEN];
+    int count = 0;
+    for (JsonVariantConst item : list) {
+        const char* cmd = item | "";
+        if (strlen(cmd) >= COMMAND_LEN || !validCommand(cmd)) {
+            request->send(400, "application/json", "{\"error\":\"unknown command\"}");
+            return;
+        }
+        strlcpy(staged[count++], cmd, COMMAND_LEN);
+    }
+
+    bool queued = false;
+    portENTER_CRITICAL(&apiMux);
+    if (!batchPending) {
+        memcpy(batch, staged, sizeof(staged[0]) * count);
+        batchCount = count;
+        batchPending = true;
+        queued = true;
+    }
+    portEXIT_CRITICAL(&apiMux);
+
+    if (!queued) {
+        request->send(429, "application/json", "{\"error\":\"batch pending\"}");
+        return;
+    }
+    char json[48];
+    snprintf(json, sizeof(json), "{\"accepted\":%d,\"boot\":%u,\"version\":%lu}",
+             count, bootId, (unsigned long)version);
+    request->send(202, "application/json", json);
+}
+
+void setRestApi(AsyncWebServer& server, void (*writeState)(char*, size_t), void (*runCommand)(const char*)) {
+    stateWriter = writeState;
+    commandRunner = runCommand;
+    bootId = stateBootId();
+
+    server.on("/api/state", HTTP_GET, handleState);
+    server.on("/api/commands", HTTP_POST, handleCommands, nullptr, collectBody);
+    server.on("/readings", HTTP_GET, handleReadings);
+}
+
+// Rebuild the cached bodies, only when the state moved
+static void refreshBodies() {
+    char json[STATE_BODY_LEN - 24];
+    stateWriter(json, sizeof(json));
+
+    char body[STATE_BODY_LEN];
+    uint32_t next = version + 1;
+    int n = snprintf(body, sizeof(body), "{\"boot\":%u,\"version\":%lu,%s", bootId, (unsigned long)next, json + 1);
+    if (n < 0 || (size_t)n >= sizeof(body)) n = sizeof(body) - 1;
+
+    // Readings are null while the DHT has no fresh value
+    char temp[12], hum[12];
+    formatReading(temp, sizeof(temp), temperature);
+    formatReading(hum, sizeof(hum), humidity);
+    char readings[sizeof(readingsBody)];
+    int r = snprintf(readings, sizeof(readings), "{\"temperature\":%s,\"humidity\":%s}", temp, hum);
+    if (r < 0 || (size_t)r >= sizeof(readings)) r = sizeof(readings) - 1;
+
+    portENTER_CRITICAL(&apiMux);
+    memcpy(stateBody, body, n);
+    stateBodyLen = n;
+    memcpy(readingsBody, readings, r);
+    readingsBodyLen = r;
+    version = next;
+    portEXIT_CRITICAL(&apiMux);
+}
+
+// New state (with its ETag) once the version moved, 304 when the wait ran
+// out; slots of clients that went away are freed
+static void answerLongPolls() {
+    uint32_t current = version;
+    unsigned long now = millis();
+    for (int i = 0; i < MAX_LONG_POLLS; i++) {
+        LongPoll& poll = longPolls[i];
+        if (poll.state != POLL_WAITING) continue;
+
+        bool done = poll.request.expired() || current != poll.from || now - poll.start >= poll.waitMs;
+        if (!done) continue;
+
+        if (auto request = poll.request.lock()) {
+            if (current != poll.from) sendBody(request.get(), stateBody, stateBodyLen, current);
+            else sendNotModified(request.get(), current);
+        }
+        poll.request.reset();
+        portENTER_CRITICAL(&apiMux);
+        poll.state = POLL_FREE;
+        portEXIT_CRITICAL(&apiMux);
+    }
+}
+
+void startRestApi() {
+    if (!stateWriter) return;
+
+    // Apply a queued batch in one go, between two control ticks
+    if (batchPending) {
+        char cmds[MAX_BATCH][COMMAND_LEN];
+        int count;
+        portENTER_CRITICAL(&apiMux);
+        count = batchCount;
+        memcpy(cmds, batch, sizeof(cmds[0]) * count);
+        batchPending = false;
+        portEXIT_CRITICAL(&apiMux);
+
+        for (int i = 0; i < count; i++) {
+            halCommand(cmds[i]);
+            commandRunner(cmds[i]);
+        }
+    }
+
+    StateKey key;
+    captureKey(key);
+    if (version == 0 || memcmp(&key, &lastKey, sizeof(key)) != 0) {
+        lastKey = key;
+        refreshBodies();
+    }
+    answerLongPolls();
+}
@@ -0,0 +1,32 @@
+#ifndef RESTAPI_H
+#define RESTAPI_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// Versioned REST API for integrations.
+//   GET  /api/state     full state with ETag "<boot>-<version>", 304 on
+//                       If-None-Match. ?wait=ms (with a matching ETag or
+//                       ?since=<boot>-<version>) long-polls: the loop answers
+//                       with the new state and its ETag once the version
+//                       moves, or 304 when the wait runs out.
+//   POST /api/commands  JSON array of commands ("room1:ON", "lockDoor", ...),
+//                       validated as a whole and applied together between
+//                       two control ticks.
+//   GET  /readings      temperature/humidity, same ETag as /api/state.
+// The version only moves when the state actually changes, so an idle house
+// answers pollers with 304 without building any JSON. It restarts at boot;
+// the boot id in the tag (and in the body) keeps an old tag from matching.
+
+// writeState builds the state JSON, runCommand applies one command
+void setRestApi(AsyncWebServer& server,
+                void (*writeState)(char* out, size_t len),
+                void (*runCommand)(const char* cmd));
+
+// Apply queued command batches, bump the version and answer long polls,
+// call every loop
+void startRestApi();
+
+uint32_t stateVersion();
+
+#endif
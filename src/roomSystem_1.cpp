@@ -1,5 +1,9 @@
 #include "roomSystem_1.h"
 #include "lcd.h"
+#include "hal.h"
+#include "ruleEngine.h"
+#include "ledcLights.h"
+#include "controlState.h"
 
 // Pin Declarations
 const int ldr = 34;
@@ -7,89 +11,76 @@ const int ldrLED1 = 25;
 const int ldrLED2 = 33;
 const int ldrLED3 = 32;
 
-const int ldrThreshold = 4000;
-
 // Manual control
 bool room1_override = false;       // true if web overrides
 bool room1_manualTarget = false;   // manual target ON/OFF
 bool room1_state = false;// Actual LED state
+int ldrValue = 0;
+
+// LDR: averaged over a few reads; the room1Dark rule's hysteresis keeps
+// flicker around its threshold from toggling the lights
+const int LDR_OVERSAMPLE = 8;
 
-// Sequential LED state
-static int ledStage = 0;
-static unsigned long lastStepTime = 0;
-const unsigned long stepDelay = 300;
-static bool turningOn = false;
+// Lights are staged and faded by the LEDC hardware (see ledcLights.h)
+static bool targetOn = false;
+
+static bool lastState = false;
+static unsigned long lastNotifyTime = 0;
+static bool wasGreeting = false;
 
 // Extern for greeting state
 extern bool greetingActive;
 
 bool setRoomOne() {
     pinMode(ldr, INPUT);
-    pinMode(ldrLED1, OUTPUT);
-    pinMode(ldrLED2, OUTPUT);
-    pinMode(ldrLED3, OUTPUT);
 
-    digitalWrite(ldrLED1, LOW);
-    digitalWrite(ldrLED2, LOW);
-    digitalWrite(ldrLED3, LOW);
+    keepControlState(room1_override);
+    keepControlState(room1_manualTarget);
+    keepControlState(room1_state);
+    keepControlState(ldrValue);
+    keepControlState(targetOn);
+    keepControlState(lastState);
+    keepControlState(lastNotifyTime);
+    keepControlState(wasGreeting);
+
+    const uint8_t lights[] = {ldrLED1, ldrLED2, ldrLED3};
+    return setLedcLights(lights, 3);
+}
+
+static int readLdr() {
+    long sum = 0;
+    for (int i = 0; i < LDR_OVERSAMPLE; i++) sum += halAnalogRead(ldr);
+    return sum / LDR_OVERSAMPLE;
+}
 
-    return true;
+static bool checkDark(int value) {
+    setRuleInput(RULE_IN_LDR, value);
+    return ruleOutput(RULE_OUT_ROOM1_DARK);
 }
 
 void startRoomOne(void (*notify)(float,float)) {
-    static bool lastState = false;
-    static unsigned long lastNotifyTime = 0;
-    unsigned long now = millis();
-
-    int LDRvalue = analogRead(ldr);
-    // Use manual target if override active, else sensor
-    bool targetOn = room1_override ? room1_manualTarget : (LDRvalue > ldrThreshold);
-
-    // Start/stop sequence
-    if (targetOn && !turningOn) {
-        turningOn = true;
-        ledStage = 0;
-        lastStepTime = now;
-    } else if (!targetOn && turningOn) {
-        turningOn = false;
-        ledStage = 2;
-        lastStepTime = now;
+    unsigned long now = halMillis();
+
+    ldrValue = readLdr();
+    // Use manual target if override active, else the room1Dark rule
+    bool on = room1_override ? room1_manualTarget : checkDark(ldrValue);
+
+    // Start/stop sequence, the fades run without the loop
+    bool changed = on != targetOn;
+    if (changed) {
+        targetOn = on;
+        ledcLightsTo(on ? 100 : 0, now);
     }
 
-    // Sequential LED control
-    if (now - lastStepTime >= stepDelay) {
-        lastStepTime = now;
-
-        if (turningOn) {
-            if (ledStage == 0) digitalWrite(ldrLED1, HIGH);
-            else if (ledStage == 1) digitalWrite(ldrLED2, HIGH);
-            else if (ledStage == 2) digitalWrite(ldrLED3, HIGH);
-
-            ledStage++;
-            if (ledStage > 2) ledStage = 2;
-
-            // Skip LCD update if greeting is active
-            if(!greetingActive) {
-                lcd.setCursor(16,0);
-                lcd.print("ON ");
-            }
-        } else {
-            if (ledStage == 2) digitalWrite(ldrLED3, LOW);
-            else if (ledStage == 1) digitalWrite(ldrLED2, LOW);
-            else if (ledStage == 0) digitalWrite(ldrLED1, LOW);
-
-            if (ledStage > 0) ledStage--;
-            
-            // Skip LCD update if greeting is active
-            if(!greetingActive) {
-                lcd.setCursor(16,0);
-                lcd.print("OFF");
-            }
-        }
+    // Skip LCD update if greeting is active, redraw once it ends
+    if (!greetingActive && (changed || wasGreeting)) {
+        lcd.setCursor(16,0);
+        lcd.print(on ? "ON " : "OFF");
     }
+    wasGreeting = greetingActive;
 
-    // Update actual state
-    room1_state = digitalRead(ldrLED1) || digitalRead(ldrLED2) || digitalRead(ldrLED3);
+    // Actual state: any light still lit
+    room1_state = ledcLightsLit(now) > 0;
 
     // Notify WebSocket if changed
     if (room1_state != lastState && now - lastNotifyTime > 200) {
@@ -5,6 +5,7 @@
 extern bool room1_override;   // true if web overrides
 extern bool room1_state;      // actual LED state
 extern bool room1_manualTarget;   // desired state: true=ON, false=OFF
+extern int ldrValue;              // last LDR reading
 
 
 bool setRoomOne();
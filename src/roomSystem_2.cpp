@@ -1,12 +1,15 @@
 #include "roomSystem_2.h"
 #include "lcd.h"
+#include "hal.h"
+#include "ruleEngine.h"
+#include "latencyTrace.h"
+#include "controlState.h"
 
 // Pin declarations
 const int sound = 35; 
 const int led = 26;  
 
-// Environment noise level states
-enum Environment { QUIET, NORMAL, NOISY };
+// Environment noise level (see roomSystem_2.h)
 Environment currentEnv = NORMAL;
 
 // Thresholds and timing constants
@@ -35,31 +38,53 @@ static unsigned long lastClapTime = 0;
 static unsigned long lastNotifyTime = 0;
 static unsigned long lastAdaptationTime = 0;
 static unsigned long lastSoundCheckTime = 0;
+static unsigned long clapWindowUs = 0;   // start of the last clap's samples
 
 // Sound state: 0 = quiet, 1 = listening, 2 = activated
 int soundState = 0;
+int soundAmplitude = 0;
 static int consecutiveSoundDetections = 0;
 static int consecutiveQuietDetections = 0;
 static int adaptationSamples[50];
 static int adaptationIndex = 0;
 static bool adaptationReady = false;
 
+static bool lastState = false;
+static bool lastOverride = false;
+
 // External flag for greeting display
 extern bool greetingActive;
 
-// Initialize Room 2 hardware and baseline noise
+// Initialize Room 2 hardware
+// Baseline noise starts from the saved calibration (stateStore) and is
+// refined in the background by updateBaseline() instead of blocking boot
 bool setRoomTwo() {
     pinMode(sound, INPUT);
     pinMode(led, OUTPUT);
-    digitalWrite(led, LOW);
-    
-    // Calculate initial baseline noise
-    long sum = 0;
-    for(int i = 0; i < 100; i++) {
-        sum += analogRead(sound);
-        delay(10);
-    }
-    baselineNoise = sum / 100;
+    halDigitalWrite(led, LOW);
+
+    keepControlState(currentEnv);
+    keepControlState(baselineSum);
+    keepControlState(sampleCount);
+    keepControlState(dynamicThreshold);
+    keepControlState(baselineNoise);
+    keepControlState(room2_override);
+    keepControlState(room2_state);
+    keepControlState(room2_manualTarget);
+    keepControlState(lastClapTime);
+    keepControlState(lastNotifyTime);
+    keepControlState(lastAdaptationTime);
+    keepControlState(lastSoundCheckTime);
+    keepControlState(clapWindowUs);
+    keepControlState(soundState);
+    keepControlState(soundAmplitude);
+    keepControlState(consecutiveSoundDetections);
+    keepControlState(consecutiveQuietDetections);
+    keepControlState(adaptationSamples);
+    keepControlState(adaptationIndex);
+    keepControlState(adaptationReady);
+    keepControlState(lastState);
+    keepControlState(lastOverride);
     return true;
 }
 
@@ -89,21 +114,20 @@ void updateBaseline(int value) {
 
 // Detect a clap event based on amplitude and timing
 bool detectClap() {
-    unsigned long now = millis();
+    unsigned long now = halMillis();
     if (now - lastClapTime < CLAP_TIMEOUT) return false;
+    unsigned long windowUs = halMicros();
     
-    int peak = 0, peakIndex = 0, valley = 2;
+    int peak = 0, valley = 2;
     for(int i = 0; i < SAMPLE_WINDOW; i++) {
-        int sample = analogRead(sound);
-        if(sample > peak) {
-            peak = sample;
-            peakIndex = i;
-        }
+        int sample = halAnalogRead(sound);
+        if(sample > peak) peak = sample;
         if(sample < valley) valley = sample;
-        delayMicroseconds(500);
+        halDelayMicroseconds(500);
     }
     
     int amplitude = peak - valley;
+    soundAmplitude = amplitude;
     
     // Update sound state (listening vs quiet)
     if(now - lastSoundCheckTime >= 250) {
@@ -124,12 +148,14 @@ bool detectClap() {
         }
     }
     
-    // Detect actual clap
-    if(amplitude > dynamicThreshold * 0.35) {
-        delay(5);
-        int afterPeak = analogRead(sound);
+    // Detect actual clap (clap rule, default ratio > 0.35)
+    setRuleInput(RULE_IN_SOUND_RATIO, (float)amplitude / dynamicThreshold);
+    if(ruleOutput(RULE_OUT_CLAP)) {
+        halDelay(5);
+        int afterPeak = halAnalogRead(sound);
         if(afterPeak < peak - (amplitude / 2)) {
             lastClapTime = now;
+            clapWindowUs = windowUs;
             soundState = 2;
             return true;
         }
@@ -140,10 +166,10 @@ bool detectClap() {
 
 // Automatically adapt environment classification based on noise samples
 void autoAdaptEnvironment() {
-    unsigned long now = millis();
+    unsigned long now = halMillis();
     
     if(adaptationIndex < ADAPTATION_SAMPLES) {
-        adaptationSamples[adaptationIndex++] = analogRead(sound);
+        adaptationSamples[adaptationIndex++] = halAnalogRead(sound);
     } else {
         adaptationReady = true;
     }
@@ -165,10 +191,13 @@ void autoAdaptEnvironment() {
         }
         variance = variance / ADAPTATION_SAMPLES;
         
+        setRuleInput(RULE_IN_NOISE_AVG, avgNoise);
+        setRuleInput(RULE_IN_NOISE_VAR, variance);
+
         Environment newEnv = currentEnv;
-        if(avgNoise < 15 && variance < 50) {
+        if(ruleOutput(RULE_OUT_ENV_QUIET)) {
             newEnv = QUIET;
-        } else if(avgNoise > 30 || variance > 200) {
+        } else if(ruleOutput(RULE_OUT_ENV_NOISY)) {
             newEnv = NOISY;
         } else {
             newEnv = NORMAL;
@@ -185,12 +214,23 @@ void autoAdaptEnvironment() {
     }
 }
 
+#ifdef BENCH
+// Benchmarks time the full paths: a clap window past the clap timeout, and
+// an adaptation pass with its samples collected and its interval up
+void benchArmClap() {
+    lastClapTime = halMillis() - CLAP_TIMEOUT;
+}
+
+void benchArmAdapt() {
+    adaptationIndex = ADAPTATION_SAMPLES;
+    lastAdaptationTime = halMillis() - ADAPTATION_INTERVAL;
+}
+#endif
+
 void startRoomTwo(void (*notify)(float,float)) {
-    static bool lastState = false;
-    static bool lastOverride = false;
-    unsigned long now = millis();
+    unsigned long now = halMillis();
     
-    int sensorValue = analogRead(sound);
+    int sensorValue = halAnalogRead(sound);
     autoAdaptEnvironment();
     updateBaseline(sensorValue);
     Serial.println(sensorValue);
@@ -200,11 +240,15 @@ void startRoomTwo(void (*notify)(float,float)) {
         room2_state = room2_manualTarget;
     } else {
         if(lastOverride) lastClapTime = now;
-        if(detectClap()) room2_state = !room2_state;
+        if(detectClap()) {
+            spanBegin(SPAN_CLAP, clapWindowUs, (1 << FRAME_ROOMS) | (1 << FRAME_STATE));
+            room2_state = !room2_state;
+            spanState();
+        }
     }
     
     lastOverride = room2_override;
-    digitalWrite(led, room2_state ? HIGH : LOW);
+    halDigitalWrite(led, room2_state ? HIGH : LOW);
     
     // Update LCD if not in greeting mode
     if(!greetingActive) {
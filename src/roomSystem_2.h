@@ -6,6 +6,15 @@ extern bool room2_override;
 extern bool room2_state;            
 extern bool room2_manualTarget;
 extern int soundState;  // 0 = quiet, 1 = listening, 2 = activated
+extern int soundAmplitude;  // peak-to-valley of the last clap window
+
+// Environment noise level states
+enum Environment { QUIET, NORMAL, NOISY };
+
+// Calibration (persisted by stateStore)
+extern Environment currentEnv;
+extern int dynamicThreshold;
+extern int baselineNoise;
 
 // Accept a function pointer for notifying clients
 void startRoomTwo(void (*notify)(float, float));
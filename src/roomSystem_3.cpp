@@ -1,5 +1,9 @@
 #include "roomSystem_3.h"
 #include "lcd.h"
+#include "hal.h"
+#include "ruleEngine.h"
+#include "sensorHealth.h"
+#include "controlState.h"
 
 // Pin Declarations
 const int DHT22_PIN = 17;
@@ -17,28 +21,45 @@ bool greetingActive = false;
 bool presenceDetected = false;
 int animationFrame = 0;
 static int selectedMessage = 0; // Store the randomly selected message
+static int lastStarPos = -1;
 
 // Heat Index Alert System
-unsigned long lastHeatIndexCheck = 0;
-const unsigned long HEAT_INDEX_CHECK_INTERVAL = 60000; // Check every 60 seconds
-String lastHeatIndexLevel = "none";
+// Checked on every new DHT sample. A higher level alerts at once, a lower
+// one has to hold for HEAT_INDEX_SETTLE_MS first so readings hovering on a
+// band edge do not alert over and over.
+const unsigned long HEAT_INDEX_SETTLE_MS = 60000;
+static const char* const heatIndexLevels[] = {
+    "none", "caution", "extreme_caution", "danger", "extreme_danger"
+};
+static int heatIndexLevel = 0;
+static bool heatIndexLowering = false;
+static unsigned long heatIndexLowerSince = 0;
 
 bool setRoomThree(){
     pinMode(trig, OUTPUT);
     pinMode(echo, INPUT);
     dht22.begin();
     randomSeed(analogRead(0)); // Initialize random seed
+
+    keepControlState(lastGreetingTime);
+    keepControlState(lastAnimationUpdate);
+    keepControlState(greetingActive);
+    keepControlState(presenceDetected);
+    keepControlState(animationFrame);
+    keepControlState(selectedMessage);
+    keepControlState(lastStarPos);
+    keepControlState(heatIndexLevel);
+    keepControlState(heatIndexLowering);
+    keepControlState(heatIndexLowerSince);
     return true;
 }
 
 void getDHT(float* humidity, float* temperature){
-    *humidity = dht22.readHumidity();
-    *temperature = dht22.readTemperature();
+    halReadDHT(dht22, humidity, temperature);
 }
 
 void showGreetingAnimation() {
-    unsigned long now = millis();
-    static int lastStarPos = -1;
+    unsigned long now = halMillis();
     
     // Update star positions every 300ms
     if(now - lastAnimationUpdate >= animationSpeed) {
@@ -72,70 +93,89 @@ void showGreetingAnimation() {
     }
 }
 
-String checkHeatIndexLevel(float heatIndex) {
-    if(heatIndex >= 52.0) {
-        return "extreme_danger";
-    } else if(heatIndex >= 42.0) {
-        return "danger";
-    } else if(heatIndex >= 33.0) {
-        return "extreme_caution";
-    } else if(heatIndex >= 27.0) {
-        return "caution";
+// Heat index bands come from the heat* rules (27/33/42/52 C by default),
+// returns an index into heatIndexLevels
+int checkHeatIndexLevel(float heatIndex) {
+    setRuleInput(RULE_IN_HEAT_INDEX, heatIndex);
+    if(ruleOutput(RULE_OUT_HEAT_EXTREME_DANGER)) {
+        return 4;
+    } else if(ruleOutput(RULE_OUT_HEAT_DANGER)) {
+        return 3;
+    } else if(ruleOutput(RULE_OUT_HEAT_EXTREME_CAUTION)) {
+        return 2;
+    } else if(ruleOutput(RULE_OUT_HEAT_CAUTION)) {
+        return 1;
     }
-    return "none";
+    return 0;
 }
 
-void startRoomThree(float* temperature, float* humidity, float* distance, AsyncWebSocket* ws){
-    // Use provided temperature and humidity (updated every 5s in main.cpp)
+void checkHeatIndex(float temperature, float humidity, AsyncWebSocket* ws){
     // Compute heat index in Celsius (isFahreheit = false)
-    float hic = dht22.computeHeatIndex(*temperature, *humidity, false);
-   
-    // Ultrasonic
-    digitalWrite(trig, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(trig, LOW);
-    float duration_us = pulseIn(echo, HIGH, 30000); // 30ms timeout
-
-    // Convert only if valid pulse was read
-    if(duration_us > 0){
-        *distance = 0.017 * duration_us; // cm
-    } else {
-        *distance = NAN; // invalid reading
+    float hic = dht22.computeHeatIndex(temperature, humidity, false);
+    if(isnan(hic)) return;
+
+    unsigned long now = halMillis();
+    int level = checkHeatIndexLevel(hic);
+    if(level == heatIndexLevel) {
+        heatIndexLowering = false;
+        return;
+    }
+    if(level < heatIndexLevel) {
+        if(!heatIndexLowering) {
+            heatIndexLowering = true;
+            heatIndexLowerSince = now;
+        }
+        if(now - heatIndexLowerSince < HEAT_INDEX_SETTLE_MS) return;
+    }
+    heatIndexLowering = false;
+    heatIndexLevel = level;
+
+    // Only alert for a level other than "none" (queued for clients that
+    // reconnect, see wsOutbox.h)
+    if(level > 0 && ws != nullptr) {
+        char json[96];
+        snprintf(json, sizeof(json), "{\"heatIndexAlert\":\"%s\",\"heatIndex\":%.1f}", heatIndexLevels[level], hic);
+        halTextAll(*ws, json, FRAME_ALERT);
     }
+}
 
-    unsigned long now = millis();
+void startRoomThree(float* temperature, float* humidity, float* distance){
+    // Ultrasonic (skipped while its breaker is open, see sensorHealth.h)
+    *distance = NAN;
+    if(sensorShouldRead(SENSOR_ULTRASONIC)){
+        halDigitalWrite(trig, HIGH);
+        halDelayMicroseconds(10);
+        halDigitalWrite(trig, LOW);
+        float duration_us = halPulseIn(echo, HIGH, 30000); // 30ms timeout
 
-    // Heat Index monitoring
-    if(!isnan(hic) && (now - lastHeatIndexCheck >= HEAT_INDEX_CHECK_INTERVAL)) {
-        lastHeatIndexCheck = now;
-        String currentLevel = checkHeatIndexLevel(hic);
-        
-        // Only send alert if level changed and is not "none"
-        if(currentLevel != lastHeatIndexLevel && currentLevel != "none") {
-            
-            // Send alert to web interface if websocket provided
-            if(ws != nullptr && ws->count() > 0) {
-                String json = "{\"heatIndexAlert\":\"" + currentLevel + "\",\"heatIndex\":" + String(hic, 1) + "}";
-                ws->textAll(json);
-            }
-            
-            lastHeatIndexLevel = currentLevel;
-        } else if(currentLevel == "none" && lastHeatIndexLevel != "none") {
-            // Heat index returned to safe levels
-            lastHeatIndexLevel = "none";
+        // Convert only if valid pulse was read. Nothing in range keeps the
+        // echo high past the timeout (about 38 ms): a good reading of no
+        // object. Only an echo that never rose counts as a failure.
+        if(duration_us > 0){
+            *distance = 0.017 * duration_us; // cm
+            sensorSuccess(SENSOR_ULTRASONIC);
+        } else if(halDigitalRead(echo) == HIGH) {
+            sensorSuccess(SENSOR_ULTRASONIC);
+        } else {
+            sensorFailure(SENSOR_ULTRASONIC, true);
         }
     }
 
-    // Detect Presence
-    bool detected = (!isnan(*distance) && *distance <= 10);
+    unsigned long now = halMillis();
+
+    // Detect Presence (presence rule, default <= 10 cm)
+    setRuleInput(RULE_IN_DISTANCE, *distance);
+    setRuleInput(RULE_IN_TEMPERATURE, *temperature);
+    setRuleInput(RULE_IN_HUMIDITY, *humidity);
+    bool detected = ruleOutput(RULE_OUT_PRESENCE);
 
     // Only trigger greeting if not already active and presence newly detected
     if(detected && !presenceDetected && !greetingActive){
         
         // Select message based on temp conditions
-        if(*temperature >= 32.0) {
+        if(ruleOutput(RULE_OUT_GREET_HOT)) {
             selectedMessage = 5;
-        } else if(*temperature < 22.0) {
+        } else if(ruleOutput(RULE_OUT_GREET_COLD)) {
             selectedMessage = 6;
         } else {
             selectedMessage = random(0, 5);
@@ -206,16 +246,14 @@ void startRoomThree(float* temperature, float* humidity, float* distance, AsyncW
         return; // skip normal LCD updates
     }
 
-    // Update dynamic values
-    if(!isnan(*temperature)){
-        lcd.setCursor(6,2);
-        lcd.print(*temperature,1);       // 1 decimal
-        lcd.setCursor(11,2);
-        lcd.print((char)223);             // degree symbol
-    }
+    // Update dynamic values ("--.-" while the DHT has no fresh reading)
+    lcd.setCursor(6,2);
+    if(!isnan(*temperature)) lcd.print(*temperature,1);   // 1 decimal
+    else lcd.print("--.-");
+    lcd.setCursor(11,2);
+    lcd.print((char)223);                 // degree symbol
 
-    if(!isnan(*humidity)){
-        lcd.setCursor(10,3);
-        lcd.print(*humidity,1);           // 1 decimal
-    }
+    lcd.setCursor(10,3);
+    if(!isnan(*humidity)) lcd.print(*humidity,1);         // 1 decimal
+    else lcd.print("--.-");
 }
\ No newline at end of file
@@ -14,7 +14,12 @@ bool setRoomThree();
 // Read DHT sensor
 void getDHT(float* humidity, float* temperature);
 
+// Heat index alerts, call with each new DHT sample
+void checkHeatIndex(float temperature, float humidity, AsyncWebSocket* ws);
+// Band of a heat index from the heat* rules, 0 = none
+int checkHeatIndexLevel(float heatIndex);
+
 // Non-blocking update function
-void startRoomThree(float* temperature, float* humidity, float* distance, AsyncWebSocket* ws);
+void startRoomThree(float* temperature, float* humidity, float* distance);
 
 #endif
@@ -0,0 +1,178 @@
+#include "ruleEngine.h"
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "hal.h"
+#include "controlState.h"
+
+// The compiled rules and their inputs (rules.json is read once per load)
+static RuleTable table;
+static volatile bool reloadPending = false;
+
+static const char* const inputNames[RULE_INPUT_COUNT] = {
+    "ldr", "soundRatio", "noiseAvg", "noiseVar",
+    "distance", "temperature", "humidity", "heatIndex"
+};
+
+static const char* const outputNames[RULE_OUTPUT_COUNT] = {
+    "room1Dark", "clap", "envQuiet", "envNoisy", "presence",
+    "greetHot", "greetCold", "heatCaution", "heatExtremeCaution",
+    "heatDanger", "heatExtremeDanger"
+};
+
+// Built-in rules, same as data/rules.json (used when the file is missing or invalid)
+static const char defaultRules[] PROGMEM = R"JSON([
+  {"out":"room1Dark","all":[{"in":"ldr","op":">","value":4000,"hyst":50}]},
+  {"out":"clap","all":[{"in":"soundRatio","op":">","value":0.35}]},
+  {"out":"envQuiet","all":[{"in":"noiseAvg","op":"<","value":15},{"in":"noiseVar","op":"<","value":50}]},
+  {"out":"envNoisy","any":[{"in":"noiseAvg","op":">","value":30},{"in":"noiseVar","op":">","value":200}]},
+  {"out":"presence","all":[{"in":"distance","op":"<=","value":10}]},
+  {"out":"greetHot","all":[{"in":"temperature","op":">=","value":32}]},
+  {"out":"greetCold","all":[{"in":"temperature","op":"<","value":22}]},
+  {"out":"heatCaution","all":[{"in":"heatIndex","op":">=","value":27}]},
+  {"out":"heatExtremeCaution","all":[{"in":"heatIndex","op":">=","value":33}]},
+  {"out":"heatDanger","all":[{"in":"heatIndex","op":">=","value":42}]},
+  {"out":"heatExtremeDanger","all":[{"in":"heatIndex","op":">=","value":52}]}
+])JSON";
+
+static int findName(const char* name, const char* const* names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int parseOp(const char* op) {
+    if (strcmp(op, ">") == 0) return OP_GT;
+    if (strcmp(op, ">=") == 0) return OP_GE;
+    if (strcmp(op, "<") == 0) return OP_LT;
+    if (strcmp(op, "<=") == 0) return OP_LE;
+    return -1;
+}
+
+// Compile a JSON rule list into a table
+static bool compileRules(JsonArrayConst list, RuleTable& out) {
+    ruleTableClear(out);
+
+    for (JsonObjectConst r : list) {
+        int output = findName(r["out"] | "", outputNames, RULE_OUTPUT_COUNT);
+        if (output < 0) {
+            Serial.println("Rules: unknown output");
+            return false;
+        }
+
+        bool any = false;
+        JsonArrayConst conds = r["all"];
+        if (conds.isNull()) {
+            conds = r["any"];
+            any = true;
+        }
+        if (conds.isNull() || conds.size() == 0) {
+            Serial.println("Rules: rule without conditions");
+            return false;
+        }
+        if (!ruleTableAddRule(out, output, any)) {
+            Serial.println("Rules: too many rules");
+            return false;
+        }
+
+        for (JsonObjectConst c : conds) {
+            int input = findName(c["in"] | "", inputNames, RULE_INPUT_COUNT);
+            int op = parseOp(c["op"] | "");
+            if (input < 0 || op < 0) {
+                Serial.println("Rules: bad condition");
+                return false;
+            }
+            if (!ruleTableAddCondition(out, input, op, c["value"] | 0.0f,
+                                       c["hyst"] | 0.0f, c["holdMs"] | 0UL)) {
+                Serial.println("Rules: too many conditions");
+                return false;
+            }
+        }
+    }
+    ruleTableFinish(out);
+    return true;
+}
+
+// Swap in a compiled table, keeping the inputs seen so far
+static void commitRules(RuleTable& compiled) {
+    memcpy(compiled.state.inputs, table.state.inputs, sizeof(table.state.inputs));
+    table = compiled;
+    ruleTableEvaluate(table, halMillis());
+}
+
+static bool compileFile(const char* path, RuleTable& out) {
+    File file = LittleFS.open(path, "r");
+    if (!file) return false;
+
+    JsonDocument doc;
+    DeserializationError err = deserializeJson(doc, file);
+    file.close();
+    if (err) {
+        Serial.print("Rules: parse failed: ");
+        Serial.println(err.c_str());
+        return false;
+    }
+    return compileRules(doc.as<JsonArrayConst>(), out);
+}
+
+static bool compileDefaults(RuleTable& out) {
+    JsonDocument doc;
+    if (deserializeJson(doc, defaultRules)) return false;
+    return compileRules(doc.as<JsonArrayConst>(), out);
+}
+
+bool loadRules() {
+    static bool inputsCleared = false;
+    if (!inputsCleared) {
+        ruleTableClear(table);
+        keepControlState(table.state);
+        inputsCleared = true;
+    }
+
+    // Compiled off to the side, the loaded rules are only replaced by good ones
+    static RuleTable compiled;
+    if (compileFile("/rules.json", compiled)) {
+        commitRules(compiled);
+        Serial.println("Rules: loaded " + String(table.numRules) + " rules, " +
+                       String(table.numConditions) + " conditions");
+        return true;
+    }
+
+    Serial.println("Rules: using built-in defaults");
+    if (compileDefaults(compiled)) commitRules(compiled);
+    return false;
+}
+
+bool checkRulesFile(const char* path) {
+    RuleTable* compiled = new RuleTable;
+    bool ok = compileFile(path, *compiled);
+    delete compiled;
+    return ok;
+}
+
+void requestRulesReload() {
+    reloadPending = true;
+}
+
+// Apply a pending reload between ticks so rules never change mid-evaluation
+void startRules() {
+    if (!reloadPending) return;
+    reloadPending = false;
+    loadRules();
+}
+
+void setRuleInput(RuleInput input, float value) {
+    ruleTableSetInput(table, input, value, halMillis());
+}
+
+bool ruleOutput(RuleOutput output) {
+    return ruleTableOutput(table, output);
+}
+
+int ruleCount() {
+    return table.numRules;
+}
+
+int ruleConditionCount() {
+    return table.numConditions;
+}
@@ -0,0 +1,27 @@
+#ifndef RULEENGINE_H
+#define RULEENGINE_H
+
+#include <Arduino.h>
+#include "ruleTable.h"
+
+// Load /rules.json from LittleFS (built-in defaults if missing or invalid)
+bool loadRules();
+
+// Ask for a reload from the main loop (used after an upload)
+void requestRulesReload();
+void startRules();
+
+// Check an uploaded rule file compiles (nothing loaded, safe off the loop)
+bool checkRulesFile(const char* path);
+
+// Update an input value; every rule is evaluated against the new inputs
+void setRuleInput(RuleInput input, float value);
+
+// Output of the last evaluation (nothing is evaluated here)
+bool ruleOutput(RuleOutput output);
+
+// Number of compiled rules/conditions currently loaded
+int ruleCount();
+int ruleConditionCount();
+
+#endif
@@ -0,0 +1,117 @@
+#include "ruleTable.h"
+#include <math.h>
+#include <string.h>
+
+void ruleTableClear(RuleTable& table) {
+    memset(&table, 0, sizeof(table));
+    for (int i = 0; i < RULE_INPUT_COUNT; i++) table.state.inputs[i] = NAN;
+}
+
+bool ruleTableAddRule(RuleTable& table, uint8_t output, bool any) {
+    if (table.numRules >= MAX_RULES || output >= RULE_OUTPUT_COUNT) return false;
+    Rule& rule = table.rules[table.numRules++];
+    rule.output = output;
+    rule.firstCondition = table.numConditions;
+    rule.conditionCount = 0;
+    rule.any = any;
+    return true;
+}
+
+bool ruleTableAddCondition(RuleTable& table, uint8_t input, uint8_t op,
+                           float value, float hyst, uint32_t holdMs) {
+    if (table.numRules == 0 || table.numConditions >= MAX_CONDITIONS) return false;
+    if (input >= RULE_INPUT_COUNT || op > OP_LE) return false;
+
+    Condition& cond = table.conditions[table.numConditions++];
+    cond.input = input;
+    cond.op = op;
+    cond.value = value;
+    cond.hyst = hyst;
+    cond.holdMs = holdMs;
+    table.rules[table.numRules - 1].conditionCount++;
+    return true;
+}
+
+// Stable sort by output, conditions stay where they are
+void ruleTableFinish(RuleTable& table) {
+    Rule added[MAX_RULES];
+    memcpy(added, table.rules, sizeof(Rule) * table.numRules);
+
+    int count = 0;
+    for (int out = 0; out < RULE_OUTPUT_COUNT; out++) {
+        table.outputFirstRule[out] = count;
+        table.outputRuleCount[out] = 0;
+        for (int i = 0; i < table.numRules; i++) {
+            if (added[i].output != out) continue;
+            table.rules[count++] = added[i];
+            table.outputRuleCount[out]++;
+        }
+    }
+}
+
+static bool evalCondition(const Condition& c, ConditionLatch& l, float v, uint32_t now) {
+    if (isnan(v)) {
+        l.latched = false;
+        l.pending = false;
+        return false;
+    }
+
+    // Once latched, the threshold moves back by the hysteresis band
+    bool above = (c.op == OP_GT || c.op == OP_GE);
+    float threshold = c.value;
+    if (l.latched) threshold += above ? -c.hyst : c.hyst;
+
+    bool met;
+    switch (c.op) {
+        case OP_GT: met = v > threshold; break;
+        case OP_GE: met = v >= threshold; break;
+        case OP_LT: met = v < threshold; break;
+        default:    met = v <= threshold; break;
+    }
+
+    if (!met) {
+        l.latched = false;
+        l.pending = false;
+        return false;
+    }
+
+    // Time window: the condition has to stay true for holdMs before it counts
+    if (!l.latched) {
+        if (c.holdMs == 0) {
+            l.latched = true;
+        } else if (!l.pending) {
+            l.pending = true;
+            l.since = now;
+        } else if (now - l.since >= c.holdMs) {
+            l.latched = true;
+        }
+    }
+    return l.latched;
+}
+
+void ruleTableEvaluate(RuleTable& table, uint32_t now) {
+    for (int out = 0; out < RULE_OUTPUT_COUNT; out++) {
+        bool result = false;
+        int first = table.outputFirstRule[out];
+        int last = first + table.outputRuleCount[out];
+        for (int i = first; i < last; i++) {
+            const Rule& rule = table.rules[i];
+            bool ruleMet = !rule.any;
+
+            // Every condition, so hysteresis/hold state stays current
+            for (int j = 0; j < rule.conditionCount; j++) {
+                int k = rule.firstCondition + j;
+                const Condition& c = table.conditions[k];
+                bool met = evalCondition(c, table.state.latches[k], table.state.inputs[c.input], now);
+                ruleMet = rule.any ? (ruleMet || met) : (ruleMet && met);
+            }
+            result = result || ruleMet;
+        }
+        table.state.outputs[out] = result;
+    }
+}
+
+void ruleTableSetInput(RuleTable& table, uint8_t input, float value, uint32_t now) {
+    table.state.inputs[input] = value;
+    ruleTableEvaluate(table, now);
+}
@@ -0,0 +1,106 @@
+#ifndef RULETABLE_H
+#define RULETABLE_H
+
+#include <stdint.h>
+
+// Compiled rules: flat condition/rule tables grouped by output.
+// Every rule is evaluated each time an input is set, so hysteresis and hold
+// windows advance whether or not anything asks for their output, and the
+// outputs are read back from the cache. Nothing is allocated.
+// Plain C++ so tools/rule_bench.cpp can build it on the host.
+
+// Values fed into the rule engine by the room modules
+enum RuleInput {
+    RULE_IN_LDR,            // raw LDR reading (Room 1)
+    RULE_IN_SOUND_RATIO,    // clap amplitude / dynamic threshold (Room 2)
+    RULE_IN_NOISE_AVG,      // adaptation window average (Room 2)
+    RULE_IN_NOISE_VAR,      // adaptation window variance (Room 2)
+    RULE_IN_DISTANCE,       // ultrasonic distance in cm (Room 3)
+    RULE_IN_TEMPERATURE,    // DHT22 temperature in C
+    RULE_IN_HUMIDITY,       // DHT22 humidity in %
+    RULE_IN_HEAT_INDEX,     // computed heat index in C
+    RULE_INPUT_COUNT
+};
+
+// Decisions produced by the rule engine
+enum RuleOutput {
+    RULE_OUT_ROOM1_DARK,
+    RULE_OUT_CLAP,
+    RULE_OUT_ENV_QUIET,
+    RULE_OUT_ENV_NOISY,
+    RULE_OUT_PRESENCE,
+    RULE_OUT_GREET_HOT,
+    RULE_OUT_GREET_COLD,
+    RULE_OUT_HEAT_CAUTION,
+    RULE_OUT_HEAT_EXTREME_CAUTION,
+    RULE_OUT_HEAT_DANGER,
+    RULE_OUT_HEAT_EXTREME_DANGER,
+    RULE_OUTPUT_COUNT
+};
+
+enum RuleOp { OP_GT, OP_GE, OP_LT, OP_LE };
+
+const int MAX_RULES = 24;
+const int MAX_CONDITIONS = 48;
+
+struct Condition {
+    uint8_t input;
+    uint8_t op;
+    float value;
+    float hyst;              // band applied once the condition is latched
+    uint32_t holdMs;         // condition must hold this long before it latches
+};
+
+struct ConditionLatch {
+    bool latched;
+    bool pending;
+    uint32_t since;
+};
+
+struct Rule {
+    uint8_t output;
+    uint8_t firstCondition;
+    uint8_t conditionCount;
+    bool any;                // true = any condition, false = all conditions
+};
+
+// What evaluation changes, kept apart from the compiled rules so it can be
+// saved and restored on its own (see controlState.h)
+struct RuleState {
+    float inputs[RULE_INPUT_COUNT];
+    bool outputs[RULE_OUTPUT_COUNT];
+    ConditionLatch latches[MAX_CONDITIONS];
+};
+
+struct RuleTable {
+    Condition conditions[MAX_CONDITIONS];
+    Rule rules[MAX_RULES];
+    int numConditions;
+    int numRules;
+    // Rules ordered by output, each output owning a contiguous slice
+    uint8_t outputFirstRule[RULE_OUTPUT_COUNT];
+    uint8_t outputRuleCount[RULE_OUTPUT_COUNT];
+    RuleState state;
+};
+
+// No rules, every input unset (NAN)
+void ruleTableClear(RuleTable& table);
+
+// Build a table: a rule, then its conditions (false once a table is full).
+// ruleTableFinish() orders the rules by output.
+bool ruleTableAddRule(RuleTable& table, uint8_t output, bool any);
+bool ruleTableAddCondition(RuleTable& table, uint8_t input, uint8_t op,
+                           float value, float hyst, uint32_t holdMs);
+void ruleTableFinish(RuleTable& table);
+
+// Evaluate every rule against the current inputs and cache the outputs
+void ruleTableEvaluate(RuleTable& table, uint32_t now);
+
+// Set an input, then evaluate
+void ruleTableSetInput(RuleTable& table, uint8_t input, float value, uint32_t now);
+
+inline bool ruleTableOutput(const RuleTable& table, uint8_t output) {
+    return table.state.outputs[output];
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include "sensorHealth.h"
+#include "hal.h"
+#include "sensorTrace.h"
+#include "controlState.h"
+
+struct SensorConfig {
+    const char* name;
+    uint8_t failureThreshold;       // consecutive failures that open the breaker
+    unsigned long baseBackoffMs;    // first open period, doubled per failed probe
+    unsigned long maxBackoffMs;
+    unsigned long staleMs;          // no good sample for this long = stale
+};
+
+// The DHT is read every 5 s; the ultrasonic sensor every pass, and each
+// echo that never rises costs the full 30 ms pulseIn timeout (nothing in
+// range is a good reading, see roomSystem_3.cpp)
+static const SensorConfig configs[SENSOR_COUNT] = {
+    {"dht",        3, 10000, 300000, 30000},
+    {"ultrasonic", 5, 500,   8000,   2000}
+};
+
+struct SensorHealth {
+    unsigned long reads;
+    unsigned long failures;
+    unsigned long timeouts;
+    unsigned long skipped;          // reads not attempted while open
+    unsigned long trips;
+    uint8_t consecutive;
+    uint16_t errorRate;             // per mille, smoothed over ~16 reads
+    bool open;
+    unsigned long openedAt;
+    unsigned long backoffMs;
+    bool haveGood;
+    unsigned long lastGoodMs;
+};
+
+// Replay runs on its own copy so it cannot trip the live breakers (the
+// HTTP task reads the live table, so it is never swapped)
+static SensorHealth liveHealth[SENSOR_COUNT];
+static SensorHealth replayHealth[SENSOR_COUNT];
+
+static SensorHealth* healthTable() {
+    return traceReplaying() ? replayHealth : liveHealth;
+}
+
+void setSensorHealth() {
+    keepControlState(liveHealth, sizeof(liveHealth), replayHealth);
+}
+
+static void updateErrorRate(SensorHealth& h, bool failed) {
+    h.errorRate = h.errorRate - h.errorRate / 16 + (failed ? 1000 / 16 : 0);
+}
+
+bool sensorShouldRead(SensorId id) {
+    SensorHealth& h = healthTable()[id];
+    if (!h.open) return true;
+    if (halMillis() - h.openedAt >= h.backoffMs) return true;   // probe
+    h.skipped++;
+    return false;
+}
+
+void sensorSuccess(SensorId id) {
+    SensorHealth& h = healthTable()[id];
+    h.reads++;
+    h.consecutive = 0;
+    updateErrorRate(h, false);
+    h.haveGood = true;
+    h.lastGoodMs = halMillis();
+
+    if (h.open) {
+        h.open = false;
+        h.backoffMs = 0;
+        Serial.println("Sensor " + String(configs[id].name) + " recovered");
+    }
+}
+
+void sensorFailure(SensorId id, bool timeout) {
+    SensorHealth& h = healthTable()[id];
+    const SensorConfig& c = configs[id];
+    h.reads++;
+    h.failures++;
+    if (timeout) h.timeouts++;
+    if (h.consecutive < 255) h.consecutive++;
+    updateErrorRate(h, true);
+
+    if (h.open) {
+        // Failed probe: stay open for longer
+        h.backoffMs *= 2;
+        if (h.backoffMs > c.maxBackoffMs) h.backoffMs = c.maxBackoffMs;
+        h.openedAt = halMillis();
+    } else if (h.consecutive >= c.failureThreshold) {
+        h.open = true;
+        h.backoffMs = c.baseBackoffMs;
+        h.openedAt = halMillis();
+        h.trips++;
+        Serial.println("Sensor " + String(c.name) + " failing, backing off");
+    }
+}
+
+static SensorStatus statusOf(const SensorHealth& h, SensorId id, unsigned long now) {
+    if (h.open) return SENSOR_FAILED;
+    // Before the first good sample, boot counts as the last one
+    unsigned long since = h.haveGood ? h.lastGoodMs : 0;
+    if (now - since > configs[id].staleMs) return SENSOR_STALE;
+    if (h.consecutive > 0 || h.errorRate >= 100) return SENSOR_DEGRADED;
+    return SENSOR_OK;
+}
+
+static const char* statusName(SensorStatus status) {
+    switch (status) {
+        case SENSOR_DEGRADED: return "degraded";
+        case SENSOR_STALE:    return "stale";
+        case SENSOR_FAILED:   return "failed";
+        default:              return "ok";
+    }
+}
+
+SensorStatus sensorStatus(SensorId id) {
+    return statusOf(healthTable()[id], id, halMillis());
+}
+
+const char* sensorStatusName(SensorId id) {
+    return statusName(sensorStatus(id));
+}
+
+// Served on the HTTP task: the live table on the real clock, even while a
+// replay slice runs
+String sensorHealthJson() {
+    unsigned long now = millis();
+    String json = "{";
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        const SensorHealth& h = liveHealth[i];
+        if (i > 0) json += ",";
+        json += "\"" + String(configs[i].name) + "\":{";
+        json += "\"status\":\"" + String(statusName(statusOf(h, (SensorId)i, now))) + "\"";
+        json += ",\"reads\":" + String(h.reads);
+        json += ",\"failures\":" + String(h.failures);
+        json += ",\"timeouts\":" + String(h.timeouts);
+        json += ",\"errorRate\":" + String(h.errorRate / 10.0f, 1);
+        json += ",\"consecutive\":" + String(h.consecutive);
+        json += ",\"trips\":" + String(h.trips);
+        json += ",\"skipped\":" + String(h.skipped);
+        json += ",\"backoffMs\":" + String(h.open ? h.backoffMs : 0);
+        json += ",\"lastGoodAgeMs\":";
+        json += h.haveGood ? String(now - h.lastGoodMs) : String("null");
+        json += "}";
+    }
+    json += "}";
+    return json;
+}
@@ -0,0 +1,42 @@
+#ifndef SENSORHEALTH_H
+#define SENSORHEALTH_H
+
+#include <Arduino.h>
+
+// Per-sensor health and circuit breakers.
+// Every read reports success or failure. After a run of consecutive
+// failures the breaker opens and the sensor is not read at all; once the
+// backoff has passed a single probe read is let through, which closes the
+// breaker on success or reopens it with twice the backoff. Times come from
+// halMillis() so replayed traces make the same decisions.
+enum SensorId {
+    SENSOR_DHT,             // DHT22 temperature/humidity
+    SENSOR_ULTRASONIC,      // HC-SR04 distance
+    SENSOR_COUNT
+};
+
+enum SensorStatus {
+    SENSOR_OK,
+    SENSOR_DEGRADED,        // recent failures, breaker still closed
+    SENSOR_STALE,           // no good sample for longer than its stale time
+    SENSOR_FAILED           // breaker open
+};
+
+// False while the breaker is open (probe reads are let through)
+bool sensorShouldRead(SensorId id);
+
+void sensorSuccess(SensorId id);
+void sensorFailure(SensorId id, bool timeout);
+
+SensorStatus sensorStatus(SensorId id);
+// "ok", "degraded", "stale", "failed"
+const char* sensorStatusName(SensorId id);
+
+// Register the breakers as control state (call from setup); replay runs on a
+// copy started from the trace snapshot, the live breakers are left alone
+void setSensorHealth();
+
+// Counters, error rate, backoff and last good sample age for each sensor
+String sensorHealthJson();
+
+#endif
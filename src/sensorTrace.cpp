@@ -0,0 +1,630 @@
+#include "sensorTrace.h"
+#include <LittleFS.h>
+#include "hal.h"
+#include "controlState.h"
+
+// RAM ring (8 bytes per record, about 16 KB). Records are streamed from it
+// to /trace.bin by the loop, so it only has to hold the passes between two
+// writes; it also keeps the newest records for a dump
+const size_t TRACE_RECORDS = 2048;
+// Records are appended to the file once this many are waiting
+const size_t TRACE_STREAM_CHUNK = 256;
+// Longest trace on LittleFS (512 KB, about a minute of loop traffic)
+const size_t TRACE_FILE_RECORDS = 65536;
+const unsigned long REPLAY_MAX_TICKS = 200000;
+// Replay runs from the loop in slices of this much wall time
+const unsigned long REPLAY_SLICE_US = 20000;
+// Records read from the file at a time by each replay cursor
+const size_t REPLAY_WINDOW = 256;
+const int REPLAY_MAX_REPORTED_MISMATCHES = 5;
+
+static TraceRecord* ring = nullptr;
+static size_t ringHead = 0;
+static size_t ringCount = 0;
+static size_t unstreamed = 0;               // newest records not in the file yet
+static volatile bool recording = false;
+static portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t* snapshotBuf = nullptr;      // micros(), then the control state
+static uint16_t liveClients = 0;
+
+// Stream to /trace.bin
+static File traceFile;
+static unsigned long fileRecords = 0;
+static unsigned long droppedRecords = 0;    // ring overran or the file was full
+static bool fileFull = false;
+
+static volatile TraceAction pendingAction = TRACE_ACTION_NONE;
+static void (*commandHandler)(const char*) = nullptr;
+static void (*edgeHandler)(uint8_t, bool, unsigned long) = nullptr;
+
+// Part of /trace.bin held in RAM while replaying
+struct TraceWindow {
+    File file;
+    TraceRecord* buf;
+    size_t base;
+    size_t count;
+};
+
+// Replay state
+static TraceWindow inputWindow = {};
+static TraceWindow outputWindow = {};
+static size_t replayCount = 0;
+static size_t inputCursor = 0;
+static size_t outputCursor = 0;
+static bool replayActive = false;           // loaded, running in slices
+static bool replaying = false;              // inside a slice
+static bool replayDone = false;
+static uint8_t* replaySwap = nullptr;       // the other side's control state
+static size_t replayStart = 0;
+static unsigned long replayTicks = 0;
+static unsigned long replayWallUs = 0;
+// One microsecond clock for both: millis() is it / 1000, micros() its low
+// 32 bits, as on the device
+static uint64_t replayClockUs = 0;
+static uint16_t replayClients = 0;
+static bool desynced = false;
+static size_t desyncAt = 0;
+static uint8_t desyncType = 0;
+static uint8_t desyncPin = 0;
+static unsigned long outputsMatched = 0;
+static unsigned long outputsMismatched = 0;
+static unsigned long outputsExtra = 0;
+static unsigned long outputsMissing = 0;
+static unsigned long replayTraceMs = 0;
+static const char* replayResult = "none";
+
+static void pushRecord(uint32_t time, uint8_t type, uint8_t pin, uint16_t value) {
+    TraceRecord& rec = ring[ringHead];
+    rec.time = time;
+    rec.type = type;
+    rec.pin = pin;
+    rec.value = value;
+    ringHead = (ringHead + 1) % TRACE_RECORDS;
+    if (ringCount < TRACE_RECORDS) ringCount++;
+    unstreamed++;
+}
+
+// Room for n records that belong together (a header and its payload), or
+// none of them: a record the loop could not stream in time, or one past the
+// end of the file, ends the trace (call under traceMux)
+static bool reserve(size_t n) {
+    if (fileFull || unstreamed + n > TRACE_RECORDS) {
+        droppedRecords += n;
+        return false;
+    }
+    if (fileRecords + unstreamed + n > TRACE_FILE_RECORDS) {
+        fileFull = true;
+        droppedRecords += n;
+        return false;
+    }
+    return true;
+}
+
+// Records behind a header of len payload bytes
+static size_t payloadRecords(size_t len) {
+    return (len + 6) / 7;
+}
+
+// Bytes packed 7 to a TRACE_PAYLOAD record, in its time, pin and value
+static void pushPayload(const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i += 7) {
+        uint8_t b[7] = {0};
+        memcpy(b, p + i, (len - i) < 7 ? (len - i) : 7);
+        uint32_t time = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+        pushRecord(time, TRACE_PAYLOAD, b[4], b[5] | (b[6] << 8));
+    }
+}
+
+void traceRecord(uint8_t type, uint8_t pin, uint16_t value) {
+    if (!recording) return;
+    portENTER_CRITICAL(&traceMux);
+    if (reserve(1)) pushRecord(millis(), type, pin, value);
+    portEXIT_CRITICAL(&traceMux);
+}
+
+// Text is split into 7-byte payload records right behind its header
+void traceRecordText(uint8_t type, const char* text) {
+    if (!recording) return;
+    size_t len = strlen(text);
+    if (len > 255) len = 255;
+    const uint8_t* p = (const uint8_t*)text;
+
+    portENTER_CRITICAL(&traceMux);
+    if (reserve(1 + payloadRecords(len))) {
+        pushRecord(millis(), type, len, 0);
+        pushPayload(p, len);
+    }
+    portEXIT_CRITICAL(&traceMux);
+}
+
+// The edge's own micros() follows, so replay feeds it in at the time it
+// happened rather than when the loop got to it
+void traceRecordEdge(uint8_t pin, bool level, uint32_t timeUs) {
+    if (!recording) return;
+    portENTER_CRITICAL(&traceMux);
+    if (reserve(1 + payloadRecords(sizeof(timeUs)))) {
+        pushRecord(millis(), TRACE_EDGE, pin, level);
+        pushPayload((const uint8_t*)&timeUs, sizeof(timeUs));
+    }
+    portEXIT_CRITICAL(&traceMux);
+}
+
+// FNV-1a, used to compare outgoing frames without storing them
+uint32_t traceHash(const char* text) {
+    uint32_t hash = 2166136261UL;
+    for (const char* p = text; *p; p++) {
+        hash ^= (uint8_t)*p;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// The whole control state (see controlState.h), with the micros() it was
+// taken at so replay can run both clocks. A trace has one, at its start: the
+// file is never wrapped, so replay always has it
+static void recordSnapshot() {
+    size_t size = 4 + controlStateSize();
+    unsigned long ms = millis();
+    uint32_t us = micros();
+    memcpy(snapshotBuf, &us, 4);
+    saveControlState(snapshotBuf + 4);
+
+    portENTER_CRITICAL(&traceMux);
+    if (reserve(1 + payloadRecords(size))) {
+        pushRecord(ms, TRACE_STATE, 0, size);
+        pushPayload(snapshotBuf, size);
+    }
+    portEXIT_CRITICAL(&traceMux);
+    traceRecord(TRACE_CLIENTS, 0, liveClients);
+}
+
+void traceClientsChanged(uint16_t count) {
+    liveClients = count;
+    traceRecord(TRACE_CLIENTS, 0, count);
+}
+
+size_t traceClientCount() {
+    return replayClients;
+}
+
+bool traceRecording() {
+    return recording;
+}
+
+bool traceReplaying() {
+    return replaying;
+}
+
+void requestTraceAction(TraceAction action) {
+    pendingAction = action;
+}
+
+void setTraceCommandHandler(void (*handler)(const char*)) {
+    commandHandler = handler;
+}
+
+void setTraceEdgeHandler(void (*handler)(uint8_t, bool, unsigned long)) {
+    edgeHandler = handler;
+}
+
+// Append the records waiting in the ring to /trace.bin: all of them, or
+// only once a chunk is waiting. They stay reserved in the ring until written.
+static void streamRecords(bool all) {
+    portENTER_CRITICAL(&traceMux);
+    size_t count = unstreamed;
+    size_t start = (ringHead + TRACE_RECORDS - count) % TRACE_RECORDS;
+    portEXIT_CRITICAL(&traceMux);
+    if (count == 0 || (!all && count < TRACE_STREAM_CHUNK) || !traceFile) return;
+
+    // Oldest part first, then the part wrapped to the front of the ring
+    size_t first = count < TRACE_RECORDS - start ? count : TRACE_RECORDS - start;
+    size_t bytes = traceFile.write((const uint8_t*)&ring[start], first * sizeof(TraceRecord));
+    bytes += traceFile.write((const uint8_t*)ring, (count - first) * sizeof(TraceRecord));
+
+    portENTER_CRITICAL(&traceMux);
+    unstreamed -= count;
+    fileRecords += bytes / sizeof(TraceRecord);
+    // A short write is a full filesystem
+    if (bytes != count * sizeof(TraceRecord)) fileFull = true;
+    portEXIT_CRITICAL(&traceMux);
+}
+
+static void traceStop() {
+    if (!recording) return;
+    recording = false;
+    streamRecords(true);
+    traceFile.close();
+    Serial.println("Trace: stopped, " + String(fileRecords) + " records in /trace.bin");
+}
+
+static void traceStart() {
+    if (replayActive) return;
+    // A new trace replaces the one being recorded
+    traceStop();
+    if (!ring) ring = (TraceRecord*)malloc(sizeof(TraceRecord) * TRACE_RECORDS);
+    if (!snapshotBuf) snapshotBuf = (uint8_t*)malloc(4 + controlStateSize());
+    if (!ring || !snapshotBuf) {
+        Serial.println("Trace: out of memory");
+        return;
+    }
+    traceFile = LittleFS.open("/trace.bin", "w");
+    if (!traceFile) {
+        Serial.println("Trace: cannot open /trace.bin");
+        return;
+    }
+    ringHead = 0;
+    ringCount = 0;
+    unstreamed = 0;
+    fileRecords = 0;
+    droppedRecords = 0;
+    fileFull = false;
+    recording = true;
+    recordSnapshot();
+    Serial.println("Trace: recording to /trace.bin");
+}
+
+// Write out what is waiting now, the file then holds the whole trace so far
+static bool traceFlush() {
+    if (!recording) return false;
+    streamRecords(true);
+    Serial.println("Trace: " + String(fileRecords) + " records in /trace.bin");
+    return true;
+}
+
+// The newest records, still in the ring, one per line: time type pin value (hex)
+static void traceDump() {
+    if (!ring || ringCount == 0) return;
+
+    bool wasRecording = recording;
+    recording = false;
+
+    Serial.println("TRACE BEGIN " + String((unsigned long)ringCount));
+    size_t start = (ringHead + TRACE_RECORDS - ringCount) % TRACE_RECORDS;
+    for (size_t i = 0; i < ringCount; i++) {
+        const TraceRecord& rec = ring[(start + i) % TRACE_RECORDS];
+        Serial.printf("%08lx %02x %02x %04x\n", (unsigned long)rec.time, rec.type, rec.pin, rec.value);
+    }
+    Serial.println("TRACE END");
+
+    recording = wasRecording;
+}
+
+unsigned long traceClock() {
+    return replayClockUs / 1000ULL;
+}
+
+unsigned long traceClockUs() {
+    return (unsigned long)replayClockUs;
+}
+
+void traceAdvance(unsigned long us) {
+    replayClockUs += us;
+}
+
+static bool isOutputRecord(uint8_t type) {
+    return type == TRACE_PIN_OUT || type == TRACE_FRAME;
+}
+
+static bool isInputRecord(uint8_t type) {
+    return (type >= TRACE_ANALOG && type <= TRACE_TEMPERATURE) || type == TRACE_DUE || type == TRACE_TICK;
+}
+
+// Replay clock at an input: its millis(), or for a pass start the micros()
+// whose low 16 bits were recorded, nearest the middle of that millisecond
+static uint64_t inputClockUs(const TraceRecord& rec) {
+    uint64_t ms = (uint64_t)rec.time * 1000ULL;
+    if (rec.type != TRACE_TICK) return ms;
+    uint64_t near = ms + 500;
+    int32_t diff = (int16_t)(rec.value - (uint16_t)near);
+    return near + diff;
+}
+
+// Record i of the trace, reading the window around it in from the file
+static TraceRecord recordAt(TraceWindow& w, size_t i) {
+    if (i < w.base || i >= w.base + w.count) {
+        w.base = i;
+        w.count = 0;
+        if (w.file.seek(i * sizeof(TraceRecord))) {
+            w.count = w.file.read((uint8_t*)w.buf, REPLAY_WINDOW * sizeof(TraceRecord)) / sizeof(TraceRecord);
+        }
+        // Past what could be read: an empty record ends every scan
+        if (i >= w.base + w.count) return TraceRecord{};
+    }
+    return w.buf[i - w.base];
+}
+
+// Bytes of the payload records behind the record at `at`
+static size_t readPayload(size_t at, uint8_t* out, size_t len) {
+    size_t n = 0;
+    for (size_t i = at + 1; i < replayCount && n < len; i++) {
+        TraceRecord rec = recordAt(inputWindow, i);
+        if (rec.type != TRACE_PAYLOAD) break;
+        uint8_t b[7] = {
+            (uint8_t)rec.time, (uint8_t)(rec.time >> 8), (uint8_t)(rec.time >> 16),
+            (uint8_t)(rec.time >> 24), rec.pin, (uint8_t)rec.value, (uint8_t)(rec.value >> 8)
+        };
+        for (int j = 0; j < 7 && n < len; j++) out[n++] = b[j];
+    }
+    return n;
+}
+
+// Rebuild a recorded command and hand it to the command handler
+static void dispatchCommand(size_t at, uint8_t len) {
+    char text[256];
+    size_t n = readPayload(at, (uint8_t*)text, len);
+    text[n] = '\0';
+
+    if (commandHandler) commandHandler(text);
+}
+
+// Commands, client counts and input edges are events: they are applied at
+// their place in the stream rather than read by a HAL call
+static bool dispatchEvent(size_t at) {
+    TraceRecord rec = recordAt(inputWindow, at);
+    if (rec.type == TRACE_COMMAND || rec.type == TRACE_EDGE) {
+        if (replayClockUs < (uint64_t)rec.time * 1000ULL) replayClockUs = (uint64_t)rec.time * 1000ULL;
+        if (rec.type == TRACE_COMMAND) {
+            dispatchCommand(at, rec.pin);
+        } else if (edgeHandler) {
+            uint32_t timeUs = 0;
+            readPayload(at, (uint8_t*)&timeUs, sizeof(timeUs));
+            edgeHandler(rec.pin, rec.value, timeUs);
+        }
+        return true;
+    }
+    if (rec.type == TRACE_CLIENTS) {
+        replayClients = rec.value;
+        return true;
+    }
+    return false;
+}
+
+bool traceNextInput(uint8_t type, uint8_t pin, uint16_t* value) {
+    if (replayDone) return false;
+    while (inputCursor < replayCount) {
+        size_t at = inputCursor;
+        TraceRecord rec = recordAt(inputWindow, at);
+
+        if (!isInputRecord(rec.type)) {
+            inputCursor++;
+            dispatchEvent(at);
+            continue;
+        }
+
+        uint64_t clockUs = inputClockUs(rec);
+        if (replayClockUs < clockUs) replayClockUs = clockUs;
+
+        // The code asked for something else: stop here, with the record left
+        // unread, rather than carry on one input out of step
+        if (rec.type != type || rec.pin != pin) {
+            desynced = true;
+            desyncAt = at;
+            desyncType = type;
+            desyncPin = pin;
+            replayDone = true;
+            return false;
+        }
+        inputCursor++;
+        *value = rec.value;
+        return true;
+    }
+
+    replayDone = true;
+    return false;
+}
+
+void tracePollEvents() {
+    while (!replayDone && inputCursor < replayCount && !isInputRecord(recordAt(inputWindow, inputCursor).type)) {
+        dispatchEvent(inputCursor++);
+    }
+}
+
+void traceCheckOutput(uint8_t type, uint8_t pin, uint16_t value) {
+    // Nothing after a desync lines up any more, and the rest of the pass
+    // that ran out of trace runs on made-up inputs
+    if (desynced || replayDone) return;
+    while (outputCursor < replayCount && !isOutputRecord(recordAt(outputWindow, outputCursor).type)) {
+        outputCursor++;
+    }
+    if (outputCursor >= replayCount) {
+        outputsExtra++;
+        return;
+    }
+
+    TraceRecord expected = recordAt(outputWindow, outputCursor++);
+    if (expected.type == type && expected.pin == pin && expected.value == value) {
+        outputsMatched++;
+        return;
+    }
+
+    outputsMismatched++;
+    if (outputsMismatched <= REPLAY_MAX_REPORTED_MISMATCHES) {
+        Serial.printf("Replay mismatch at %lu ms: expected %02x/%02x/%04x got %02x/%02x/%04x\n",
+                      traceClock(), expected.type, expected.pin, expected.value, type, pin, value);
+    }
+}
+
+static bool openWindow(TraceWindow& w) {
+    w.file = LittleFS.open("/trace.bin", "r");
+    w.buf = (TraceRecord*)malloc(sizeof(TraceRecord) * REPLAY_WINDOW);
+    w.base = w.count = 0;
+    return w.file && w.buf;
+}
+
+static void closeWindow(TraceWindow& w) {
+    w.file.close();
+    free(w.buf);
+    w.buf = nullptr;
+}
+
+// The trace is read from /trace.bin a window at a time, so it can be longer
+// than the RAM ring
+static bool loadReplay() {
+    if (!openWindow(inputWindow) || !openWindow(outputWindow)) return false;
+    replayCount = inputWindow.file.size() / sizeof(TraceRecord);
+    return replayCount > 0;
+}
+
+static void freeReplay() {
+    closeWindow(inputWindow);
+    closeWindow(outputWindow);
+    free(replaySwap);
+    replaySwap = nullptr;
+    replayCount = 0;
+}
+
+// Load a trace and start from its first snapshot; the ticks run in slices
+// from the loop (traceReplaySlice)
+static void traceReplayBegin() {
+    if (replayActive) return;
+    // A trace being recorded is finished first
+    traceStop();
+    if (!loadReplay()) {
+        Serial.println("Trace: nothing to replay");
+        freeReplay();
+        return;
+    }
+
+    size_t start = 0;
+    while (start < replayCount && recordAt(inputWindow, start).type != TRACE_STATE) start++;
+    if (start >= replayCount) {
+        Serial.println("Trace: no state snapshot in trace");
+        freeReplay();
+        return;
+    }
+
+    // The control state block only fits the firmware that recorded it
+    size_t size = 4 + controlStateSize();
+    TraceRecord state = recordAt(inputWindow, start);
+    if (state.value != size) {
+        Serial.println("Trace: snapshot is " + String(state.value) + " bytes, this firmware keeps " +
+                       String((unsigned long)size));
+        freeReplay();
+        return;
+    }
+    uint8_t* snapshot = (uint8_t*)malloc(size);
+    replaySwap = (uint8_t*)malloc(controlStateSize());
+    if (!snapshot || !replaySwap || readPayload(start, snapshot, size) != size) {
+        Serial.println("Trace: cannot load snapshot");
+        free(snapshot);
+        freeReplay();
+        return;
+    }
+
+    // Replay state goes into the modules' replay copies and the swap buffer,
+    // the live values are not touched
+    uint32_t us;
+    memcpy(&us, snapshot, 4);
+    loadReplayState(snapshot + 4, replaySwap);
+    free(snapshot);
+
+    replayClients = 0;
+    inputCursor = outputCursor = start + 1;
+    // The snapshot's micros() gives the part below its millisecond
+    replayClockUs = (uint64_t)state.time * 1000ULL + (uint32_t)(us - state.time * 1000UL);
+    replayDone = desynced = false;
+    replayStart = start;
+    replayTicks = replayWallUs = 0;
+    outputsMatched = outputsMismatched = outputsExtra = outputsMissing = 0;
+    replayResult = "running";
+    halBeginReplay();
+    replayActive = true;
+    Serial.println("Trace: replaying " + String((unsigned long)(replayCount - start)) + " records");
+}
+
+static void traceReplayEnd() {
+    replayActive = false;
+
+    if (!desynced) {
+        for (size_t i = outputCursor; i < replayCount; i++) {
+            if (isOutputRecord(recordAt(outputWindow, i).type)) outputsMissing++;
+        }
+    }
+    replayTraceMs = recordAt(outputWindow, replayCount - 1).time - recordAt(outputWindow, replayStart).time;
+
+    Serial.println("Replay: " + String((unsigned long)(replayCount - replayStart)) + " records, " +
+                   String(replayTicks) + " ticks, " + String(replayTraceMs) + " ms of trace in " +
+                   String(replayWallUs / 1000) + " ms");
+    if (desynced) {
+        TraceRecord rec = recordAt(inputWindow, desyncAt);
+        Serial.printf("Replay: input desync at %lu ms (record %u): trace has %02x/%02x, code read %02x/%02x\n",
+                      (unsigned long)rec.time, (unsigned)desyncAt, rec.type, rec.pin, desyncType, desyncPin);
+    } else if (!replayDone) {
+        Serial.println("Replay: stopped after " + String(replayTicks) + " ticks");
+    }
+    Serial.println("Replay: outputs matched " + String(outputsMatched) +
+                   ", mismatched " + String(outputsMismatched) +
+                   ", missing " + String(outputsMissing) +
+                   ", extra " + String(outputsExtra));
+    bool pass = replayDone && !desynced && outputsMismatched == 0 && outputsMissing == 0 && outputsExtra == 0;
+    replayResult = pass ? "pass" : "diff";
+    Serial.println(pass ? "Replay: PASS" : "Replay: DIFF");
+
+    freeReplay();
+}
+
+// One slice: the replay's control state is swapped in, ticks run on the
+// virtual clock, and the live state is swapped back before the loop goes on
+static void traceReplaySlice(void (*tick)()) {
+    unsigned long sliceStart = micros();
+    swapControlState(replaySwap);
+    replaying = true;
+    while (!replayDone && replayTicks < REPLAY_MAX_TICKS && micros() - sliceStart < REPLAY_SLICE_US) {
+        tick();
+        replayTicks++;
+    }
+    replaying = false;
+    swapControlState(replaySwap);
+    replayWallUs += micros() - sliceStart;
+
+    if (replayDone || replayTicks >= REPLAY_MAX_TICKS) traceReplayEnd();
+}
+
+void startTrace(void (*tick)()) {
+    TraceAction action = pendingAction;
+    pendingAction = TRACE_ACTION_NONE;
+
+    switch (action) {
+        case TRACE_ACTION_START:  traceStart(); break;
+        case TRACE_ACTION_STOP:
+            // Also ends a replay early
+            if (replayActive) traceReplayEnd();
+            else traceStop();
+            break;
+        case TRACE_ACTION_FLUSH:  traceFlush(); break;
+        case TRACE_ACTION_DUMP:   traceDump(); break;
+        case TRACE_ACTION_REPLAY: traceReplayBegin(); break;
+        default: break;
+    }
+
+    if (replayActive) traceReplaySlice(tick);
+
+    if (recording) {
+        streamRecords(false);
+        // A trace with a hole in it would not replay past the hole, so it
+        // ends at the last record before one
+        if (droppedRecords > 0) {
+            Serial.println(fileFull ? "Trace: /trace.bin full" : "Trace: stream fell behind");
+            traceStop();
+        }
+    }
+}
+
+String traceStatsJson() {
+    String json = "{\"recording\":" + String(recording ? "true" : "false");
+    json += ",\"records\":" + String(fileRecords);
+    json += ",\"waiting\":" + String((unsigned long)unstreamed);
+    json += ",\"dropped\":" + String(droppedRecords);
+    json += ",\"ringRecords\":" + String((unsigned long)TRACE_RECORDS);
+    json += ",\"fileRecords\":" + String((unsigned long)TRACE_FILE_RECORDS);
+    json += ",\"replay\":{\"result\":\"" + String(replayResult) + "\"";
+    json += ",\"ticks\":" + String(replayTicks);
+    json += ",\"traceMs\":" + String(replayTraceMs);
+    json += ",\"matched\":" + String(outputsMatched);
+    json += ",\"mismatched\":" + String(outputsMismatched);
+    json += ",\"missing\":" + String(outputsMissing);
+    json += ",\"extra\":" + String(outputsExtra);
+    json += ",\"desync\":" + String(desynced ? "true" : "false");
+    json += "}}";
+    return json;
+}
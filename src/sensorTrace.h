@@ -0,0 +1,94 @@
+#ifndef SENSORTRACE_H
+#define SENSORTRACE_H
+
+#include <Arduino.h>
+
+// Binary sensor trace: every HAL input (and actuator/WebSocket output) as a
+// fixed 8-byte record, captured into a RAM ring buffer that the loop streams
+// to LittleFS (/trace.bin), up to about a minute of traffic. The newest
+// records can also be dumped to Serial. A trace can be replayed through the
+// real room/door code with a virtual clock, faster than real time, and the
+// outputs are diffed against the ones recorded with it (tools/trace_replay.cpp
+// does the same on the host).
+// Replay starts from the snapshot of the whole control state (controlState.h)
+// taken when recording started, reads the file a window at a time and runs
+// from the loop in bounded slices, with the live state swapped out for each
+// one. It stops at the first input the code asks for that is not the next
+// one in the trace. If the stream falls behind or the file fills up, the
+// trace ends at the last record before the gap. Trace commands are taken in
+// SENSOR_TRACE builds, stats are on GET /trace.
+
+enum TraceType : uint8_t {
+    TRACE_ANALOG = 1,       // pin, analogRead value
+    TRACE_DIGITAL,          // pin, digitalRead level
+    TRACE_PULSE,            // pin, pulseIn duration in us
+    TRACE_HUMIDITY,         // tenths of %, 0x8000 = NaN
+    TRACE_TEMPERATURE,      // tenths of C, 0x8000 = NaN
+    TRACE_CLIENTS,          // connected WebSocket clients (on change and in snapshots)
+    TRACE_COMMAND,          // pin = length, text follows in TRACE_PAYLOAD records
+    TRACE_PAYLOAD,          // 7 bytes of text or state
+    TRACE_STATE,            // value = length, micros() and the control state follow
+                            // in TRACE_PAYLOAD records (first in a trace, replay
+                            // starts here)
+    TRACE_CALIBRATION,      // unused, calibration is part of TRACE_STATE
+    TRACE_PIN_OUT,          // pin, level written (only on change); LEDC lights: new target in %
+    TRACE_FRAME,            // pin/value = 24-bit hash of an outgoing frame
+    TRACE_EDGE,             // pin, level; the edge's micros() follows in a
+                            // TRACE_PAYLOAD record
+    TRACE_DUE,              // pin = frame class, value = a subscriber was due
+    TRACE_TICK              // a control pass starts, value = low 16 bits of micros()
+};
+
+struct TraceRecord {
+    uint32_t time;          // millis() when recorded
+    uint8_t type;
+    uint8_t pin;
+    uint16_t value;
+};
+
+// Deferred actions, run from the loop by startTrace()
+enum TraceAction {
+    TRACE_ACTION_NONE,
+    TRACE_ACTION_START,
+    TRACE_ACTION_STOP,
+    TRACE_ACTION_FLUSH,
+    TRACE_ACTION_DUMP,
+    TRACE_ACTION_REPLAY
+};
+
+void requestTraceAction(TraceAction action);
+
+// Call every loop; tick() is one control loop pass, run in slices while a
+// replay is going
+void startTrace(void (*tick)());
+
+// Handler for commands found in a trace during replay
+void setTraceCommandHandler(void (*handler)(const char*));
+
+// Handler for input edges found in a trace during replay
+void setTraceEdgeHandler(void (*handler)(uint8_t pin, bool level, unsigned long timeUs));
+
+bool traceRecording();
+bool traceReplaying();
+
+// Recording (no-ops unless recording)
+void traceRecord(uint8_t type, uint8_t pin, uint16_t value);
+void traceRecordText(uint8_t type, const char* text);
+void traceRecordEdge(uint8_t pin, bool level, uint32_t timeUs);
+uint32_t traceHash(const char* text);
+void traceClientsChanged(uint16_t count);
+
+// Replay
+unsigned long traceClock();
+unsigned long traceClockUs();
+void traceAdvance(unsigned long us);
+bool traceNextInput(uint8_t type, uint8_t pin, uint16_t* value);
+// Apply queued events (commands, edges) up to the next input record
+void tracePollEvents();
+void traceCheckOutput(uint8_t type, uint8_t pin, uint16_t value);
+size_t traceClientCount();
+
+// Stream and last replay result
+String traceStatsJson();
+
+#endif
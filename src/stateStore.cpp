@@ -0,0 +1,322 @@
+#include "stateStore.h"
+#include <LittleFS.h>
+#include "doorSystem.h"
+#include "roomSystem_1.h"
+#include "roomSystem_2.h"
+
+// Control state is written once it has been stable for a short window,
+// calibration drifts constantly so it is only saved every few minutes
+const unsigned long CONTROL_COALESCE_MS = 3000;
+const unsigned long CALIBRATION_SAVE_INTERVAL = 600000;
+const unsigned long STATE_POLL_INTERVAL = 250;
+
+// Journal file: groups of 8-byte delta records, rewritten as one snapshot
+// group once it grows past JOURNAL_COMPACT_BYTES
+static const char* JOURNAL_PATH = "/state.jnl";
+static const char* JOURNAL_TMP_PATH = "/state.tmp";
+const size_t JOURNAL_COMPACT_BYTES = 2048;
+const uint8_t RECORD_MAGIC = 0xA5;
+
+enum JournalField : uint8_t {
+    JF_ROOM1_OVERRIDE,
+    JF_ROOM1_TARGET,
+    JF_ROOM2_OVERRIDE,
+    JF_ROOM2_TARGET,
+    JF_ROOM2_STATE,
+    JF_DOOR_OPEN,
+    JF_CONTROL_COUNT,
+    JF_ENVIRONMENT = JF_CONTROL_COUNT,
+    JF_THRESHOLD,
+    JF_BASELINE,
+    JF_FIELD_COUNT,
+    JF_COMMIT = 0xF0        // closes a group, value = records before it
+};
+
+struct JournalRecord {
+    uint8_t magic;
+    uint8_t field;
+    int16_t value;
+    uint16_t group;         // all records of a group share this
+    uint16_t crc;           // CRC-16 of the first 6 bytes
+};
+
+// Values as of the last group written (or replayed)
+static int16_t journaled[JF_FIELD_COUNT];
+static bool journalReady = false;
+static uint16_t nextGroup = 0;
+static size_t journalBytes = 0;
+static bool compactPending = false;
+static bool journalDamaged = false;
+
+static bool controlDirty = false;
+static unsigned long controlDirtySince = 0;
+static unsigned long lastCalibrationSave = 0;
+static unsigned long lastPoll = 0;
+
+// Write amplification: field changes saved vs bytes written to flash
+static unsigned long fieldChanges = 0;
+static unsigned long groupsWritten = 0;
+static unsigned long bytesWritten = 0;
+static unsigned long compactions = 0;
+static unsigned long replayUs = 0;
+static unsigned long groupsReplayed = 0;
+static unsigned long recordsDropped = 0;
+
+static void captureFields(int16_t* f) {
+    f[JF_ROOM1_OVERRIDE] = room1_override;
+    f[JF_ROOM1_TARGET] = room1_manualTarget;
+    f[JF_ROOM2_OVERRIDE] = room2_override;
+    f[JF_ROOM2_TARGET] = room2_manualTarget;
+    f[JF_ROOM2_STATE] = room2_state;
+    f[JF_DOOR_OPEN] = doorOpen;
+    f[JF_ENVIRONMENT] = currentEnv;
+    f[JF_THRESHOLD] = dynamicThreshold;
+    f[JF_BASELINE] = baselineNoise;
+}
+
+static void applyField(uint8_t field, int16_t value) {
+    switch (field) {
+        case JF_ROOM1_OVERRIDE: room1_override = value; break;
+        case JF_ROOM1_TARGET:   room1_manualTarget = value; break;
+        case JF_ROOM2_OVERRIDE: room2_override = value; break;
+        case JF_ROOM2_TARGET:   room2_manualTarget = value; break;
+        case JF_ROOM2_STATE:    room2_state = value; break;
+        case JF_DOOR_OPEN:      doorOpen = value; break;
+        case JF_ENVIRONMENT:
+            if (value >= QUIET && value <= NOISY) currentEnv = (Environment)value;
+            break;
+        case JF_THRESHOLD:      dynamicThreshold = value; break;
+        case JF_BASELINE:       baselineNoise = value; break;
+        default: break;
+    }
+}
+
+// CRC-16/CCITT
+static uint16_t crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static void makeRecord(JournalRecord& rec, uint8_t field, int16_t value, uint16_t group) {
+    rec.magic = RECORD_MAGIC;
+    rec.field = field;
+    rec.value = value;
+    rec.group = group;
+    rec.crc = crc16((const uint8_t*)&rec, offsetof(JournalRecord, crc));
+}
+
+static bool validRecord(const JournalRecord& rec) {
+    return rec.magic == RECORD_MAGIC &&
+           rec.crc == crc16((const uint8_t*)&rec, offsetof(JournalRecord, crc));
+}
+
+// Build a group of the selected fields plus its commit record
+static size_t buildGroup(JournalRecord* out, const int16_t* fields, const bool* include) {
+    size_t n = 0;
+    for (int f = 0; f < JF_FIELD_COUNT; f++) {
+        if (include[f]) makeRecord(out[n++], f, fields[f], nextGroup);
+    }
+    makeRecord(out[n], JF_COMMIT, n, nextGroup);
+    n++;
+    nextGroup++;
+    return n;
+}
+
+// A group only counts once its commit record is read back intact, so a
+// write cut short by a reset leaves the previous state in place
+static void replayJournal() {
+    File file = LittleFS.open(JOURNAL_PATH, "r");
+    if (!file) return;
+
+    int16_t pending[JF_FIELD_COUNT];
+    bool have[JF_FIELD_COUNT];
+    int pendingCount = 0;
+    uint16_t group = 0;
+    bool inGroup = false;
+
+    JournalRecord buf[32];
+    size_t got;
+    bool stop = false;
+    while (!stop && (got = file.read((uint8_t*)buf, sizeof(buf)) / sizeof(JournalRecord)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            const JournalRecord& rec = buf[i];
+            if (!validRecord(rec)) {
+                journalDamaged = true;
+                stop = true;
+                break;
+            }
+            journalBytes += sizeof(JournalRecord);
+
+            if (!inGroup || rec.group != group) {
+                recordsDropped += pendingCount;
+                memset(have, 0, sizeof(have));
+                pendingCount = 0;
+                group = rec.group;
+                inGroup = true;
+            }
+
+            if (rec.field == JF_COMMIT) {
+                if (rec.value == pendingCount) {
+                    for (int f = 0; f < JF_FIELD_COUNT; f++) {
+                        if (have[f]) applyField(f, pending[f]);
+                    }
+                    groupsReplayed++;
+                } else {
+                    recordsDropped += pendingCount;
+                }
+                pendingCount = 0;
+                inGroup = false;
+                nextGroup = rec.group + 1;
+            } else if (rec.field < JF_FIELD_COUNT) {
+                pending[rec.field] = rec.value;
+                have[rec.field] = true;
+                pendingCount++;
+            }
+        }
+    }
+    recordsDropped += pendingCount;
+    file.close();
+}
+
+// Rewrite the journal as a single snapshot group; the rename replaces the
+// old file in one step, so a reset leaves either the old or the new journal
+static bool compactJournal() {
+    int16_t fields[JF_FIELD_COUNT];
+    bool all[JF_FIELD_COUNT];
+    captureFields(fields);
+    for (int f = 0; f < JF_FIELD_COUNT; f++) all[f] = true;
+
+    JournalRecord records[JF_FIELD_COUNT + 1];
+    size_t n = buildGroup(records, fields, all);
+
+    File file = LittleFS.open(JOURNAL_TMP_PATH, "w");
+    if (!file) return false;
+    size_t written = file.write((const uint8_t*)records, n * sizeof(JournalRecord));
+    file.close();
+    if (written != n * sizeof(JournalRecord) || !LittleFS.rename(JOURNAL_TMP_PATH, JOURNAL_PATH)) {
+        LittleFS.remove(JOURNAL_TMP_PATH);
+        return false;
+    }
+
+    memcpy(journaled, fields, sizeof(journaled));
+    journalBytes = written;
+    bytesWritten += written;
+    compactions++;
+    compactPending = false;
+    return true;
+}
+
+// Append the fields that differ from the journal as one group
+static void appendChanges(const int16_t* fields, int first, int last) {
+    bool changed[JF_FIELD_COUNT] = {false};
+    int count = 0;
+    for (int f = first; f < last; f++) {
+        if (fields[f] == journaled[f]) continue;
+        changed[f] = true;
+        count++;
+    }
+    if (count == 0) return;
+
+    JournalRecord records[JF_FIELD_COUNT + 1];
+    size_t n = buildGroup(records, fields, changed);
+
+    File file = LittleFS.open(JOURNAL_PATH, "a");
+    if (!file) return;
+    size_t written = file.write((const uint8_t*)records, n * sizeof(JournalRecord));
+    file.close();
+    if (written != n * sizeof(JournalRecord)) return;
+
+    for (int f = first; f < last; f++) journaled[f] = fields[f];
+    fieldChanges += count;
+    groupsWritten++;
+    bytesWritten += written;
+    journalBytes += written;
+    if (journalBytes >= JOURNAL_COMPACT_BYTES) compactPending = true;
+}
+
+uint16_t stateBootId() {
+    static uint16_t bootId = 0;
+    if (bootId == 0) bootId = (esp_random() % 0xFFFF) + 1;
+    return bootId;
+}
+
+bool loadState() {
+    stateBootId();
+    unsigned long start = micros();
+    replayJournal();
+    replayUs = micros() - start;
+
+    journalReady = true;
+    captureFields(journaled);
+    lastCalibrationSave = millis();
+
+    bool restored = groupsReplayed > 0;
+    if (restored) {
+        Serial.println("State journal: " + String(groupsReplayed) + " groups replayed in " +
+                       String(replayUs) + " us");
+    } else {
+        Serial.println("No saved state, using defaults");
+    }
+    // Start from one clean snapshot: creates the journal on first boot, and
+    // nothing may be appended behind a damaged or unfinished tail
+    compactPending = !restored || journalDamaged || recordsDropped > 0 ||
+                     journalBytes > (JF_FIELD_COUNT + 1) * sizeof(JournalRecord);
+    return restored;
+}
+
+void startStateStore() {
+    if (!journalReady) return;
+
+    unsigned long now = millis();
+    if (now - lastPoll < STATE_POLL_INTERVAL) return;
+    lastPoll = now;
+
+    int16_t fields[JF_FIELD_COUNT];
+    captureFields(fields);
+
+    // Control state: coalesce bursts of changes into one group
+    if (memcmp(fields, journaled, sizeof(int16_t) * JF_CONTROL_COUNT) != 0) {
+        if (!controlDirty) {
+            controlDirty = true;
+            controlDirtySince = now;
+        }
+        if (now - controlDirtySince >= CONTROL_COALESCE_MS) {
+            appendChanges(fields, 0, JF_CONTROL_COUNT);
+            controlDirty = false;
+        }
+    } else {
+        controlDirty = false;
+    }
+
+    // Calibration: rate limited, only written when it actually moved
+    if (now - lastCalibrationSave >= CALIBRATION_SAVE_INTERVAL) {
+        lastCalibrationSave = now;
+        appendChanges(fields, JF_CONTROL_COUNT, JF_FIELD_COUNT);
+    }
+
+    // Compact while nothing is waiting to be written
+    if (compactPending && !controlDirty) compactJournal();
+}
+
+String stateStoreStatsJson() {
+    // Each field change carries 2 bytes of payload
+    unsigned long payload = fieldChanges * sizeof(int16_t);
+    String json = "{";
+    json += "\"journalBytes\":" + String((unsigned long)journalBytes);
+    json += ",\"groupsWritten\":" + String(groupsWritten);
+    json += ",\"fieldChanges\":" + String(fieldChanges);
+    json += ",\"bytesWritten\":" + String(bytesWritten);
+    json += ",\"compactions\":" + String(compactions);
+    json += ",\"writeAmplification\":" + String(payload ? (float)bytesWritten / payload : 0.0f, 2);
+    json += ",\"groupsReplayed\":" + String(groupsReplayed);
+    json += ",\"recordsDropped\":" + String(recordsDropped);
+    json += ",\"replayUs\":" + String(replayUs);
+    json += "}";
+    return json;
+}
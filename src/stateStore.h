@@ -0,0 +1,25 @@
+#ifndef STATESTORE_H
+#define STATESTORE_H
+
+#include <Arduino.h>
+
+// Control state and calibration are kept in a journal on LittleFS
+// (/state.jnl): changes are appended as small CRC-checked delta groups,
+// coalesced over a short window, and the file is compacted into a single
+// snapshot group once it grows. Only complete groups are replayed at boot.
+
+// Replay the journal (call after LittleFS is mounted, before the rooms start)
+bool loadState();
+
+// Coalesced journal writes and compaction, call every loop
+void startStateStore();
+
+// Journal size, bytes written per field change, replay time
+String stateStoreStatsJson();
+
+// Random id of this boot (1-65535), drawn once by loadState(). The REST
+// ETags and the WebSocket alert frames both carry it, so a client can match
+// the two and tell them from an earlier boot's.
+uint16_t stateBootId();
+
+#endif
@@ -0,0 +1,219 @@
+#include "telemetry.h"
+
+#ifdef TELEMETRY
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "roomSystem_1.h"
+#include "roomSystem_2.h"
+#include "sensorTrace.h"
+
+// Sensor values owned by main.cpp
+extern float temperature;
+extern float humidity;
+extern float distance;
+extern bool wifiConnected;
+
+// Default destination: a multicast group any collector on the AP can join
+#ifndef TELEMETRY_HOST
+#define TELEMETRY_HOST "239.10.0.1"
+#endif
+#ifndef TELEMETRY_PORT
+#define TELEMETRY_PORT 5005
+#endif
+
+const unsigned long TELEMETRY_SAMPLE_US = 1000;
+const unsigned long TELEMETRY_FLUSH_MS = 100;
+// Stays under a 1500-byte MTU with IP/UDP headers
+const size_t TELEMETRY_PACKET_BYTES = 1400;
+const uint32_t TELEMETRY_MAGIC = 0x31544C44;   // "DLT1"
+const uint16_t TELEMETRY_NONE = 0xFFFF;
+const int16_t TELEMETRY_NAN = (int16_t)0x8000;
+
+struct __attribute__((packed)) TelemetryHeader {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t sendUs;
+    uint16_t count;
+    uint16_t sampleBytes;
+};
+
+struct __attribute__((packed)) TelemetrySample {
+    uint32_t timeUs;
+    uint16_t ldr;
+    uint16_t soundAmplitude;
+    uint16_t soundBaseline;
+    uint16_t soundThreshold;
+    uint16_t distanceMm;
+    int16_t temperature;
+    int16_t humidity;
+    uint16_t loopUs;
+};
+
+static_assert(sizeof(TelemetryHeader) == 16, "header layout is part of the protocol");
+static_assert(sizeof(TelemetrySample) == 20, "sample layout is part of the protocol");
+
+const size_t SAMPLES_PER_PACKET =
+    (TELEMETRY_PACKET_BYTES - sizeof(TelemetryHeader)) / sizeof(TelemetrySample);
+
+// One datagram, filled in place and handed to the stack when complete
+static uint8_t packet[sizeof(TelemetryHeader) + SAMPLES_PER_PACKET * sizeof(TelemetrySample)];
+static size_t sampleCount = 0;
+static unsigned long packetStartMs = 0;
+static unsigned long lastSampleUs = 0;
+
+static WiFiUDP udp;
+static IPAddress target;
+static uint16_t targetPort = TELEMETRY_PORT;
+static bool targetSet = false;
+static bool enabled = true;
+
+// Set from the WebSocket task, applied by startTelemetry()
+static IPAddress pendingTarget;
+static uint16_t pendingPort = 0;
+static bool pendingEnabled = true;
+static volatile bool targetPending = false;
+
+static uint32_t seq = 0;
+static unsigned long packetsSent = 0;
+static unsigned long packetsDropped = 0;
+static unsigned long samplesTaken = 0;
+static unsigned long rateWindowStart = 0;
+static unsigned long rateWindowSamples = 0;
+static unsigned long samplesPerSec = 0;
+
+static uint16_t clampU16(long v) {
+    if (v < 0) return 0;
+    if (v > 0xFFFE) return 0xFFFE;
+    return v;
+}
+
+static int16_t packTenths(float v) {
+    if (isnan(v)) return TELEMETRY_NAN;
+    return (int16_t)lroundf(v * 10.0f);
+}
+
+static void sendPacket() {
+    TelemetryHeader* header = (TelemetryHeader*)packet;
+    header->magic = TELEMETRY_MAGIC;
+    header->seq = seq++;
+    header->sendUs = micros();
+    header->count = sampleCount;
+    header->sampleBytes = sizeof(TelemetrySample);
+    size_t len = sizeof(TelemetryHeader) + sampleCount * sizeof(TelemetrySample);
+
+    // Non-blocking socket: a full send queue fails here and the packet is
+    // dropped (the receiver sees the sequence gap)
+    if (udp.beginPacket(target, targetPort) && udp.write(packet, len) == len && udp.endPacket()) {
+        packetsSent++;
+    } else {
+        packetsDropped++;
+    }
+    sampleCount = 0;
+}
+
+bool requestTelemetryTarget(const char* spec) {
+    if (strcmp(spec, "off") == 0) {
+        pendingEnabled = false;
+        targetPending = true;
+        return true;
+    }
+
+    char host[24];
+    size_t hostLen = strcspn(spec, ":");
+    if (hostLen == 0 || hostLen >= sizeof(host)) return false;
+    memcpy(host, spec, hostLen);
+    host[hostLen] = '\0';
+
+    long port = TELEMETRY_PORT;
+    if (spec[hostLen] == ':') {
+        char* end;
+        port = strtol(spec + hostLen + 1, &end, 10);
+        if (*end != '\0' || port <= 0 || port > 65535) return false;
+    }
+
+    IPAddress ip;
+    if (!ip.fromString(host)) return false;
+    pendingTarget = ip;
+    pendingPort = port;
+    pendingEnabled = true;
+    targetPending = true;
+    return true;
+}
+
+void startTelemetry(unsigned long loopUs) {
+    if (targetPending) {
+        targetPending = false;
+        enabled = pendingEnabled;
+        if (enabled) {
+            target = pendingTarget;
+            targetPort = pendingPort;
+            targetSet = true;
+        }
+        sampleCount = 0;
+    }
+    if (!targetSet) {
+        targetSet = target.fromString(TELEMETRY_HOST);
+    }
+    // Replayed traces run on a virtual clock, their values are not live
+    if (!enabled || !targetSet || !wifiConnected || traceReplaying()) return;
+
+    unsigned long nowUs = micros();
+    if (nowUs - lastSampleUs < TELEMETRY_SAMPLE_US) return;
+    lastSampleUs = nowUs;
+
+    unsigned long nowMs = millis();
+    if (sampleCount == 0) packetStartMs = nowMs;
+
+    TelemetrySample* s = (TelemetrySample*)(packet + sizeof(TelemetryHeader)) + sampleCount;
+    s->timeUs = nowUs;
+    s->ldr = clampU16(ldrValue);
+    s->soundAmplitude = clampU16(soundAmplitude);
+    s->soundBaseline = clampU16(baselineNoise);
+    s->soundThreshold = clampU16(dynamicThreshold);
+    s->distanceMm = isnan(distance) ? TELEMETRY_NONE : clampU16(lroundf(distance * 10.0f));
+    s->temperature = packTenths(temperature);
+    s->humidity = packTenths(humidity);
+    s->loopUs = clampU16(loopUs);
+    sampleCount++;
+    samplesTaken++;
+
+    rateWindowSamples++;
+    if (nowMs - rateWindowStart >= 1000) {
+        samplesPerSec = rateWindowSamples * 1000 / (nowMs - rateWindowStart);
+        rateWindowStart = nowMs;
+        rateWindowSamples = 0;
+    }
+
+    if (sampleCount >= SAMPLES_PER_PACKET || nowMs - packetStartMs >= TELEMETRY_FLUSH_MS) {
+        sendPacket();
+    }
+}
+
+String telemetryStatsJson() {
+    String json = "{\"enabled\":" + String(enabled ? "true" : "false");
+    json += ",\"target\":\"" + target.toString() + ":" + String(targetPort) + "\"";
+    json += ",\"samplesPerPacket\":" + String((unsigned)SAMPLES_PER_PACKET);
+    json += ",\"samples\":" + String(samplesTaken);
+    json += ",\"samplesPerSec\":" + String(samplesPerSec);
+    json += ",\"packetsSent\":" + String(packetsSent);
+    json += ",\"packetsDropped\":" + String(packetsDropped);
+    json += ",\"seq\":" + String(seq);
+    json += "}";
+    return json;
+}
+
+#else
+
+bool requestTelemetryTarget(const char*) {
+    return false;
+}
+
+void startTelemetry(unsigned long) {
+}
+
+String telemetryStatsJson() {
+    return "{\"enabled\":false}";
+}
+
+#endif
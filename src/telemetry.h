@@ -0,0 +1,31 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+
+// Raw sensor stream over UDP for local collectors (build with TELEMETRY, see
+// env:esp32dev_telemetry). One fixed-layout sample per loop pass (at most
+// every TELEMETRY_SAMPLE_US) is packed into a static datagram, sent when it
+// is full or TELEMETRY_FLUSH_MS old. Packets carry a sequence number so the
+// receiver (tools/telemetry_rx.cpp) can count gaps; a packet the network
+// stack cannot take right away is dropped, never retried.
+// Without TELEMETRY these are empty.
+//
+// Datagram, little-endian:
+//   header  u32 magic "DLT1", u32 seq, u32 sendUs, u16 count, u16 sampleBytes
+//   sample  u32 timeUs, u16 ldr, u16 soundAmplitude, u16 soundBaseline,
+//           u16 soundThreshold, u16 distanceMm (0xFFFF = none),
+//           i16 temperature (0.1 C), i16 humidity (0.1 %) (0x8000 = NaN),
+//           u16 loopUs (saturated)
+
+// Destination: "telemetry:<ip>[:port]" (unicast or multicast group) or
+// "telemetry:off". Applied from the loop.
+bool requestTelemetryTarget(const char* spec);
+
+// Take a sample and send a packet when due, call every loop
+void startTelemetry(unsigned long loopUs);
+
+// Destination, packets sent/dropped, samples per second
+String telemetryStatsJson();
+
+#endif
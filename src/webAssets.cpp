@@ -0,0 +1,46 @@
+#include "webAssets.h"
+
+#ifdef EMBED_WEB_ASSETS
+
+#include "webAssets_data.h"
+
+// Send straight from the flash-mapped array, no filesystem and no RAM copy
+static void sendAsset(AsyncWebServerRequest *request, const WebAsset& asset) {
+    const AsyncWebHeader* match = request->getHeader("If-None-Match");
+    if (match && match->value() == asset.etag) {
+        AsyncWebServerResponse *response = request->beginResponse(304, "text/plain", "");
+        response->addHeader("ETag", asset.etag);
+        request->send(response);
+        return;
+    }
+
+    AsyncWebServerResponse *response = request->beginResponse(200, asset.mime, asset.data, asset.length);
+    if (asset.gzipped) response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+bool serveEmbeddedAssets(AsyncWebServer& server) {
+    for (size_t i = 0; i < webAssetCount; i++) {
+        const WebAsset& asset = webAssets[i];
+        server.on(asset.path, HTTP_GET, [&asset](AsyncWebServerRequest *request){
+            sendAsset(request, asset);
+        });
+        if (strcmp(asset.path, "/index.html") == 0) {
+            server.on("/", HTTP_GET, [&asset](AsyncWebServerRequest *request){
+                sendAsset(request, asset);
+            });
+        }
+    }
+    Serial.println("Serving " + String((unsigned)webAssetCount) + " embedded web assets");
+    return true;
+}
+
+#else
+
+bool serveEmbeddedAssets(AsyncWebServer&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef WEBASSETS_H
+#define WEBASSETS_H
+
+#include <ESPAsyncWebServer.h>
+
+// One file from data/ compiled into flash (see tools/embed_assets.py)
+struct WebAsset {
+    const char* path;
+    const char* mime;
+    const char* etag;
+    bool gzipped;
+    const uint8_t* data;
+    size_t length;
+};
+
+// Register routes for the embedded UI files.
+// Returns false when the firmware was built without EMBED_WEB_ASSETS,
+// in which case the UI has to be served from LittleFS.
+bool serveEmbeddedAssets(AsyncWebServer& server);
+
+#endif
@@ -0,0 +1,588 @@
+#include "wsOutbox.h"
+#include "latencyTrace.h"
+#include "stateStore.h"
+
+const int OUTBOX_MAX_GROUPS = OUTBOX_MAX_CLIENTS;
+const int ALERT_SLOTS = 16;
+const size_t OUTBOX_FRAME_LEN = 256;
+const size_t OUTBOX_ALERT_LEN = 128;
+const unsigned long MAX_TOPIC_INTERVAL = 3600000;
+
+// Full state frames carry every state topic: they go out no more often than
+// this, or than the slowest state topic the group asked for
+const unsigned long FULL_STATE_MIN_INTERVAL = 500;
+
+// State frames are handed to a client only while fewer than this many
+// messages are queued on its socket, whatever is newer waits here
+const size_t STATE_QUEUE_LIMIT = 3;
+
+// Backpressure: a client still at STATE_QUEUE_LIMIT when state is due has
+// its state interval doubled (up to MAX_STATE_INTERVAL), an empty queue
+// halves it again
+const unsigned long MIN_STATE_INTERVAL = 0;
+const unsigned long BACKOFF_STEP = 250;
+const unsigned long MAX_STATE_INTERVAL = 4000;
+
+// Unacknowledged alerts are sent again after ALERT_RETRY_MS, doubling up to
+// ALERT_MAX_RETRY_MS; after ALERT_MAX_RETRIES the client is given up on
+const unsigned long ALERT_RETRY_MS = 1000;
+const unsigned long ALERT_MAX_RETRY_MS = 8000;
+const uint8_t ALERT_MAX_RETRIES = 5;
+// Alerts older than this are not replayed to a reconnecting client
+const unsigned long ALERT_RESUME_MS = 600000;
+
+const uint8_t ALL_TOPICS = (1 << TOPIC_COUNT) - 1;
+const uint8_t STATE_TOPICS = (1 << TOPIC_ENV) | (1 << TOPIC_ROOMS) |
+                             (1 << TOPIC_DOOR) | (1 << TOPIC_SOUND);
+
+static const char* const topicNames[TOPIC_COUNT] = {
+    "env", "rooms", "door", "sound", "alerts"
+};
+
+// Topic of each state class (FRAME_STATE needs every state topic)
+static const int8_t classTopic[FRAME_CLASS_COUNT] = {
+    -1, TOPIC_ROOMS, TOPIC_ENV, TOPIC_DOOR, TOPIC_SOUND
+};
+
+// Only published again when the content changes
+static const bool classDedup[FRAME_CLASS_COUNT] = {
+    false, true, false, true, true
+};
+
+struct Subscription {
+    uint8_t topics;
+    uint32_t intervalMs[TOPIC_COUNT];
+};
+
+struct SubGroup {
+    uint8_t members;
+    Subscription sub;
+    unsigned long lastSend[FRAME_CLASS_COUNT];
+    bool sentOnce[FRAME_CLASS_COUNT];
+};
+
+struct OutboxClient {
+    bool used;
+    uint32_t id;
+    AsyncWebSocketClient* socket;
+    int8_t group;
+    uint32_t sentVersion[FRAME_CLASS_COUNT];
+    uint32_t nextAlert;
+    bool acks;                  // client acknowledges alerts
+    uint32_t ackedAlert;        // first alert not acknowledged yet
+    unsigned long alertSentAt;
+    unsigned long retryMs;
+    uint8_t retries;
+    unsigned long stateInterval;
+    unsigned long lastStateSend;
+    unsigned long sent;
+    unsigned long superseded;
+    unsigned long alertsLost;
+    unsigned long alertsRetried;
+    unsigned long ackMsAvg;
+    unsigned long ackMsMax;
+    size_t maxQueue;
+    uint16_t drainTrace;        // traced frame waiting to leave the socket queue
+};
+
+static OutboxClient clients[OUTBOX_MAX_CLIENTS];
+static SubGroup groups[OUTBOX_MAX_GROUPS];
+
+// Latest frame per class, shared by all clients (fixed buffers, no heap)
+static char latest[FRAME_CLASS_COUNT][OUTBOX_FRAME_LEN];
+static uint32_t latestVersion[FRAME_CLASS_COUNT];
+// Latency trace id added to the latest frame, 0 for none
+static uint16_t latestTrace[FRAME_CLASS_COUNT];
+
+// Alerts in publish order; alert n goes out as alertSeq n + 1
+static char alerts[ALERT_SLOTS][OUTBOX_ALERT_LEN];
+static unsigned long alertTime[ALERT_SLOTS];
+static uint16_t alertTrace[ALERT_SLOTS];
+static uint32_t alertSeq = 0;
+// Sequence numbers restart at boot, clients tell the runs apart by the boot
+// id (stateStore.h), the same one the REST ETags carry
+static uint16_t bootId = 0;
+
+// publishFrame() runs on both the loop and the AsyncTCP task. The lock is
+// held across socket->text(): a client's disconnect event takes it before
+// the library frees the client, so a socket pointer is valid while held.
+static SemaphoreHandle_t outboxLock = nullptr;
+
+static void lock() {
+    xSemaphoreTake(outboxLock, portMAX_DELAY);
+}
+
+static void unlock() {
+    xSemaphoreGive(outboxLock);
+}
+
+bool setWsOutbox() {
+    bootId = stateBootId();
+    outboxLock = xSemaphoreCreateMutex();
+    return outboxLock != nullptr;
+}
+
+static bool subscribed(const Subscription& sub, int cls) {
+    if (cls == FRAME_ALERT) return sub.topics & (1 << TOPIC_ALERTS);
+    if (classTopic[cls] < 0) return (sub.topics & STATE_TOPICS) == STATE_TOPICS;
+    return sub.topics & (1 << classTopic[cls]);
+}
+
+static uint32_t classInterval(const Subscription& sub, int cls) {
+    if (classTopic[cls] >= 0) return sub.intervalMs[classTopic[cls]];
+    uint32_t interval = FULL_STATE_MIN_INTERVAL;
+    for (int t = 0; t < TOPIC_COUNT; t++) {
+        if ((STATE_TOPICS & (1 << t)) && sub.intervalMs[t] > interval) interval = sub.intervalMs[t];
+    }
+    return interval;
+}
+
+static bool groupDue(const SubGroup& g, int cls, unsigned long now) {
+    if (!subscribed(g.sub, cls)) return false;
+    if (!g.sentOnce[cls]) return true;
+    return now - g.lastSend[cls] >= classInterval(g.sub, cls);
+}
+
+// Clients with the same subscription share a group
+static int joinGroup(const Subscription& sub) {
+    int free = -1;
+    for (int i = 0; i < OUTBOX_MAX_GROUPS; i++) {
+        SubGroup& g = groups[i];
+        if (g.members == 0) {
+            if (free < 0) free = i;
+            continue;
+        }
+        if (memcmp(&g.sub, &sub, sizeof(sub)) == 0) {
+            g.members++;
+            return i;
+        }
+    }
+    if (free < 0) return -1;
+
+    SubGroup& g = groups[free];
+    memset(&g, 0, sizeof(g));
+    g.sub = sub;
+    g.members = 1;
+    return free;
+}
+
+static void leaveGroup(int group) {
+    if (group >= 0 && groups[group].members > 0) groups[group].members--;
+}
+
+static void defaultSubscription(Subscription& sub) {
+    memset(&sub, 0, sizeof(sub));
+    sub.topics = ALL_TOPICS;
+}
+
+bool wsOutboxConnect(AsyncWebSocketClient* client) {
+    Subscription sub;
+    defaultSubscription(sub);
+    bool added = false;
+
+    lock();
+    for (int i = 0; i < OUTBOX_MAX_CLIENTS; i++) {
+        OutboxClient& c = clients[i];
+        if (c.used) continue;
+
+        memset(&c, 0, sizeof(c));
+        c.used = true;
+        c.id = client->id();
+        c.socket = client;
+        c.group = joinGroup(sub);
+        // The client gets the full state on connect, start from current
+        memcpy(c.sentVersion, latestVersion, sizeof(latestVersion));
+        c.nextAlert = alertSeq;
+        c.ackedAlert = alertSeq;
+        c.retryMs = ALERT_RETRY_MS;
+        c.stateInterval = MIN_STATE_INTERVAL;
+        added = true;
+        break;
+    }
+    unlock();
+    return added;
+}
+
+void wsOutboxDisconnect(uint32_t id) {
+    lock();
+    for (int i = 0; i < OUTBOX_MAX_CLIENTS; i++) {
+        OutboxClient& c = clients[i];
+        if (!c.used || c.id != id) continue;
+        leaveGroup(c.group);
+        c.used = false;
+        c.socket = nullptr;
+    }
+    unlock();
+}
+
+static int findTopic(const char* name) {
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        if (strcmp(name, topicNames[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// "all" or a comma list of topic[=maxRateMs]
+static bool parseSubscription(const char* spec, Subscription& sub) {
+    if (strcmp(spec, "all") == 0) {
+        defaultSubscription(sub);
+        return true;
+    }
+
+    memset(&sub, 0, sizeof(sub));
+    char buf[64];
+    strlcpy(buf, spec, sizeof(buf));
+    char* save = nullptr;
+    for (char* tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(nullptr, ",", &save)) {
+        unsigned long ms = 0;
+        char* eq = strchr(tok, '=');
+        if (eq) {
+            *eq = '\0';
+            ms = strtoul(eq + 1, nullptr, 10);
+            if (ms > MAX_TOPIC_INTERVAL) ms = MAX_TOPIC_INTERVAL;
+        }
+        int topic = findTopic(tok);
+        if (topic < 0) return false;
+        sub.topics |= 1 << topic;
+        sub.intervalMs[topic] = ms;
+    }
+    return true;
+}
+
+bool wsOutboxSubscribe(uint32_t id, const char* spec) {
+    Subscription sub;
+    if (!parseSubscription(spec, sub)) return false;
+
+    bool ok = false;
+    lock();
+    for (int i = 0; i < OUTBOX_MAX_CLIENTS; i++) {
+        OutboxClient& c = clients[i];
+        if (!c.used || c.id != id) continue;
+
+        // Classes the client did not have yet go out with the next round
+        Subscription old;
+        if (c.group >= 0) old = groups[c.group].sub;
+        else memset(&old, 0, sizeof(old));
+        for (int cls = 0; cls < FRAME_CLASS_COUNT; cls++) {
+            if (subscribed(sub, cls) && !subscribed(old, cls)) c.sentVersion[cls] = latestVersion[cls] - 1;
+        }
+        if (subscribed(sub, FRAME_ALERT) && !subscribed(old, FRAME_ALERT)) {
+            c.nextAlert = alertSeq;
+            c.ackedAlert = alertSeq;
+        }
+
+        leaveGroup(c.group);
+        c.group = joinGroup(sub);
+        ok = c.group >= 0;
+        break;
+    }
+    unlock();
+    return ok;
+}
+
+static void recordAckTime(OutboxClient& c, uint32_t alert, unsigned long now) {
+    unsigned long ms = now - alertTime[alert % ALERT_SLOTS];
+    c.ackMsAvg = c.ackMsAvg == 0 ? ms : (c.ackMsAvg * 7 + ms) / 8;
+    if (ms > c.ackMsMax) c.ackMsMax = ms;
+}
+
+// "<boot>:<seq>", everything up to seq received
+bool wsOutboxAck(uint32_t id, const char* spec) {
+    char* end;
+    unsigned long boot = strtoul(spec, &end, 10);
+    if (*end != ':') return false;
+    unsigned long seq = strtoul(end + 1, &end, 10);
+    if (*end != '\0') return false;
+    unsigned long now = millis();
+
+    lock();
+    for (int i = 0; i < OUTBOX_MAX_CLIENTS; i++) {
+        OutboxClient& c = clients[i];
+        if (!c.used || c.id != id) continue;
+
+        bool first = !c.acks;
+        c.acks = true;
+        // Sequence numbers from before a reboot mean nothing now
+        if (boot != bootId) break;
+        uint32_t acked = seq;
+
+        if (first) {
+            // Reconnected: send what it missed, if still held and recent
+            uint32_t oldest = alertSeq > (uint32_t)ALERT_SLOTS ? alertSeq - ALERT_SLOTS : 0;
+            if (acked < oldest) acked = oldest;
+            while (acked < c.nextAlert && now - alertTime[acked % ALERT_SLOTS] > ALERT_RESUME_MS) acked++;
+            if (acked < c.nextAlert) {
+                c.nextAlert = acked;
+                c.ackedAlert = acked;
+            }
+        } else if (acked > c.ackedAlert && acked <= c.nextAlert) {
+            for (uint32_t a = c.ackedAlert; a < acked; a++) recordAckTime(c, a, now);
+            c.ackedAlert = acked;
+            c.retries = 0;
+            c.retryMs = ALERT_RETRY_MS;
+        }
+        break;
+    }
+    unlock();
+    return true;
+}
+
+bool frameDue(FrameClass cls) {
+    if (cls == FRAME_ALERT) return true;
+    unsigned long now = millis();
+    bool due = false;
+
+    lock();
+    for (int i = 0; i < OUTBOX_MAX_GROUPS && !due; i++) {
+        if (groups[i].members > 0 && groupDue(groups[i], cls, now)) due = true;
+    }
+    unlock();
+    return due;
+}
+
+// ,"trace":id} in place of the closing brace, if it fits
+static void addTrace(char* frame, size_t size, uint16_t traceId) {
+    size_t len = strnlen(frame, size);
+    if (traceId == 0 || len == 0 || frame[len - 1] != '}') return;
+    snprintf(frame + len - 1, size - len + 1, ",\"trace\":%u}", traceId);
+}
+
+// Same fields as the latest frame, ignoring a trace id added to it
+static bool sameAsLatest(int cls, const char* json) {
+    if (latestTrace[cls] == 0) return strncmp(latest[cls], json, OUTBOX_FRAME_LEN) == 0;
+    size_t len = strlen(json);
+    return len > 0 && strncmp(latest[cls], json, len - 1) == 0 && latest[cls][len - 1] == ',';
+}
+
+void publishFrame(FrameClass cls, const char* json, uint16_t traceId) {
+    lock();
+    if (cls == FRAME_ALERT) {
+        // {"alertSeq":n,"boot":b, followed by the alert's own fields
+        char* frame = alerts[alertSeq % ALERT_SLOTS];
+        snprintf(frame, OUTBOX_ALERT_LEN, "{\"alertSeq\":%lu,\"boot\":%u,%s",
+                 (unsigned long)alertSeq + 1, bootId, json[0] == '{' ? json + 1 : json);
+        addTrace(frame, OUTBOX_ALERT_LEN, traceId);
+        alertTime[alertSeq % ALERT_SLOTS] = millis();
+        alertTrace[alertSeq % ALERT_SLOTS] = traceId;
+        alertSeq++;
+    } else if (traceId != 0 || !(classDedup[cls] && sameAsLatest(cls, json))) {
+        // Clients still holding the previous version lose it to this one
+        for (int i = 0; i < OUTBOX_MAX_CLIENTS; i++) {
+            OutboxClient& c = clients[i];
+            if (c.used && c.sentVersion[cls] != latestVersion[cls]) c.superseded++;
+        }
+        strlcpy(latest[cls], json, OUTBOX_FRAME_LEN);
+        addTrace(latest[cls], OUTBOX_FRAME_LEN, traceId);
+        latestTrace[cls] = traceId;
+        latestVersion[cls]++;
+    }
+    unlock();
+}
+
+// Stamps the latency span of a traced frame (see latencyTrace.h)
+static void queuedTrace(OutboxClient& c, uint16_t traceId) {
+    if (traceId == 0) return;
+    spanQueued(traceId);
+    c.drainTrace = traceId;
+}
+
+// Go back to the first unacknowledged alert once the retry time has passed
+// and the earlier copies have left the socket queue
+static void retryAlerts(OutboxClient& c, unsigned long now) {
+    if (c.ackedAlert == c.nextAlert || now - c.alertSentAt < c.retryMs) return;
+    if (c.socket->queueLen() > 0) return;
+
+    if (c.retries >= ALERT_MAX_RETRIES) {
+        c.alertsLost += c.nextAlert - c.ackedAlert;
+        c.ackedAlert = c.nextAlert;
+        c.retries = 0;
+        c.retryMs = ALERT_RETRY_MS;
+        return;
+    }
+    c.alertsRetried += c.nextAlert - c.ackedAlert;
+    c.nextAlert = c.ackedAlert;
+    c.retries++;
+    c.retryMs *= 2;
+    if (c.retryMs > ALERT_MAX_RETRY_MS) c.retryMs = ALERT_MAX_RETRY_MS;
+}
+
+// Alerts first, in order; anything older than the ring is counted as lost
+static void sendAlerts(OutboxClient& c, bool wanted, unsigned long now) {
+    if (!wanted) {
+        c.nextAlert = alertSeq;
+        c.ackedAlert = alertSeq;
+        return;
+    }
+    if (alertSeq - c.ackedAlert > (uint32_t)ALERT_SLOTS) {
+        c.alertsLost += alertSeq - c.ackedAlert - ALERT_SLOTS;
+        c.ackedAlert = alertSeq - ALERT_SLOTS;
+        if (c.nextAlert < c.ackedAlert) c.nextAlert = c.ackedAlert;
+    }
+    if (c.acks) retryAlerts(c, now);
+
+    while (c.nextAlert != alertSeq && !c.socket->queueIsFull()) {
+        c.socket->text(alerts[c.nextAlert % ALERT_SLOTS]);
+        queuedTrace(c, alertTrace[c.nextAlert % ALERT_SLOTS]);
+        c.nextAlert++;
+        c.sent++;
+        c.alertSentAt = now;
+    }
+    // Clients that do not acknowledge are done once the alert is queued
+    if (!c.acks) c.ackedAlert = c.nextAlert;
+}
+
+// Frames encoded this round, one buffer per class for every recipient
+struct SendRound {
+    unsigned long now;
+    AsyncWebSocketSharedBuffer frame[FRAME_CLASS_COUNT];
+    uint32_t version[FRAME_CLASS_COUNT];
+    uint16_t trace[FRAME_CLASS_COUNT];
+    bool groupSent[OUTBOX_MAX_GROUPS][FRAME_CLASS_COUNT];
+};
+
+static AsyncWebSocketSharedBuffer sharedFrame(SendRound& round, int cls) {
+    if (!round.frame[cls]) {
+        size_t len = strnlen(latest[cls], OUTBOX_FRAME_LEN);
+        round.frame[cls] = std::make_shared<std::vector<uint8_t>>(latest[cls], latest[cls] + len);
+        round.version[cls] = latestVersion[cls];
+        round.trace[cls] = latestTrace[cls];
+    }
+    return round.frame[cls];
+}
+
+static void sendState(OutboxClient& c, SendRound& round) {
+    if (c.group < 0) return;
+    if (round.now - c.lastStateSend < c.stateInterval) return;
+
+    // Classes the client's group is due for and the client has not seen
+    const SubGroup& g = groups[c.group];
+    bool due[FRAME_CLASS_COUNT];
+    bool anyDue = false;
+    for (int cls = 0; cls < FRAME_CLASS_COUNT; cls++) {
+        due[cls] = c.sentVersion[cls] != latestVersion[cls] && latest[cls][0] != '\0' &&
+                   groupDue(g, cls, round.now);
+        anyDue = anyDue || due[cls];
+    }
+    if (!anyDue) return;
+
+    size_t queued = c.socket->queueLen();
+    if (queued > c.maxQueue) c.maxQueue = queued;
+
+    // Still behind: back off and let newer frames replace the pending ones
+    if (queued >= STATE_QUEUE_LIMIT) {
+        c.stateInterval = c.stateInterval == 0 ? BACKOFF_STEP : c.stateInterval * 2;
+        if (c.stateInterval > MAX_STATE_INTERVAL) c.stateInterval = MAX_STATE_INTERVAL;
+        c.lastStateSend = round.now;
+        return;
+    }
+
+    bool sentAny = false;
+    for (int cls = 0; cls < FRAME_CLASS_COUNT; cls++) {
+        if (!due[cls]) continue;
+        // Keep the socket queue short so the next alert does not wait
+        if (c.socket->queueLen() >= STATE_QUEUE_LIMIT) break;
+
+        c.socket->text(sharedFrame(round, cls));
+        c.sentVersion[cls] = round.version[cls];
+        round.groupSent[c.group][cls] = true;
+        queuedTrace(c, round.trace[cls]);
+        c.sent++;
+        sentAny = true;
+    }
+    if (!sentAny) return;
+    c.lastStateSend = round.now;
+
+    // Caught up: speed back up
+    if (queued == 0 && c.stateInterval > MIN_STATE_INTERVAL) {
+        c.stateInterval /= 2;
+        if (c.stateInterval < BACKOFF_STEP) c.stateInterval = MIN_STATE_INTERVAL;
+    }
+}
+
+void startWsOutbox() {
+    static SendRound round;
+    round.now = millis();
+    memset(round.groupSent, 0, sizeof(round.groupSent));
+
+    lock();
+    for (int i = 0; i < OUTBOX_MAX_CLIENTS; i++) {
+        OutboxClient& c = clients[i];
+        if (!c.used) continue;
+
+        if (c.socket->status() != WS_CONNECTED) continue;
+
+        if (c.drainTrace != 0 && c.socket->queueLen() == 0) {
+            spanSent(c.drainTrace);
+            c.drainTrace = 0;
+        }
+        sendAlerts(c, c.group >= 0 && subscribed(groups[c.group].sub, FRAME_ALERT), round.now);
+        sendState(c, round);
+    }
+
+    // A group's rate window restarts when it was sent a class
+    for (int g = 0; g < OUTBOX_MAX_GROUPS; g++) {
+        for (int cls = 0; cls < FRAME_CLASS_COUNT; cls++) {
+            if (!round.groupSent[g][cls]) continue;
+            groups[g].lastSend[cls] = round.now;
+            groups[g].sentOnce[cls] = true;
+        }
+    }
+    unlock();
+
+    for (int cls = 0; cls < FRAME_CLASS_COUNT; cls++) round.frame[cls].reset();
+}
+
+static void appendTopics(String& json, const Subscription& sub) {
+    json += "[";
+    bool first = true;
+    for (int t = 0; t < TOPIC_COUNT; t++) {
+        if (!(sub.topics & (1 << t))) continue;
+        if (!first) json += ",";
+        first = false;
+        json += "{\"topic\":\"" + String(topicNames[t]) + "\",\"maxRateMs\":" + String(sub.intervalMs[t]) + "}";
+    }
+    json += "]";
+}
+
+String wsOutboxStatsJson() {
+    String json = "[";
+    bool first = true;
+
+    lock();
+    for (int i = 0; i < OUTBOX_MAX_CLIENTS; i++) {
+        const OutboxClient& c = clients[i];
+        if (!c.used) continue;
+
+        size_t queued = c.socket->queueLen();
+        uint32_t pending = 0;
+        for (int cls = 0; cls < FRAME_CLASS_COUNT; cls++) {
+            if (c.sentVersion[cls] != latestVersion[cls]) pending++;
+        }
+        pending += alertSeq - c.nextAlert;
+        uint32_t unacked = c.acks ? c.nextAlert - c.ackedAlert : 0;
+
+        if (!first) json += ",";
+        first = false;
+        json += "{\"id\":" + String(c.id);
+        json += ",\"group\":" + String(c.group);
+        json += ",\"topics\":";
+        if (c.group >= 0) appendTopics(json, groups[c.group].sub);
+        else json += "[]";
+        json += ",\"queue\":" + String((unsigned)queued);
+        json += ",\"maxQueue\":" + String((unsigned)c.maxQueue);
+        json += ",\"pending\":" + String(pending);
+        json += ",\"intervalMs\":" + String(c.stateInterval);
+        json += ",\"sent\":" + String(c.sent);
+        json += ",\"superseded\":" + String(c.superseded);
+        json += ",\"alertsLost\":" + String(c.alertsLost);
+        json += ",\"acks\":" + String(c.acks ? "true" : "false");
+        json += ",\"unacked\":" + String(unacked);
+        json += ",\"alertsRetried\":" + String(c.alertsRetried);
+        json += ",\"ackMsAvg\":" + String(c.ackMsAvg);
+        json += ",\"ackMsMax\":" + String(c.ackMsMax) + "}";
+    }
+    unlock();
+
+    json += "]";
+    return json;
+}
@@ -0,0 +1,71 @@
+#ifndef WSOUTBOX_H
+#define WSOUTBOX_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// Per-client WebSocket send queues.
+// State frames are latest-wins per class: a newer frame replaces one the
+// client has not been sent yet. Alerts are kept in order and always sent
+// before state. Clients that fall behind get state at a reduced rate.
+//
+// Alerts are the priority lane. State frames are only handed to a client
+// while its socket queue is short, so an alert never waits behind more
+// than a couple of them. Each alert carries "alertSeq" and "boot"; clients
+// that acknowledge with "ack:<boot>:<seq>" (everything up to seq) have
+// unacknowledged alerts sent again, and the first ack after a reconnect
+// replays recent alerts the client missed.
+//
+// Clients pick topics and a maximum rate per topic with
+// "sub:env=60000,door,alerts" ("sub:all" = everything as fast as produced,
+// the default). The full state frame holds every state topic, so it goes
+// out at most every 500 ms, or at the slowest of those topics' rates.
+// Clients with identical subscriptions share one group, and each frame is
+// encoded once per send round and shared by every recipient.
+enum FrameClass {
+    FRAME_STATE,        // full state (notifyClients), clients of every state topic
+    FRAME_ROOMS,        // room states and modes
+    FRAME_ENV,          // temperature/humidity
+    FRAME_DOOR,         // door lock state
+    FRAME_SOUND,        // sound detector state
+    FRAME_CLASS_COUNT,
+    FRAME_ALERT = FRAME_CLASS_COUNT   // door/heat index alerts, never dropped
+};
+
+enum Topic {
+    TOPIC_ENV,
+    TOPIC_ROOMS,
+    TOPIC_DOOR,
+    TOPIC_SOUND,
+    TOPIC_ALERTS,
+    TOPIC_COUNT
+};
+
+bool setWsOutbox();
+
+// Client bookkeeping (call from the WebSocket event handler). Connect is
+// false when all OUTBOX_MAX_CLIENTS slots are taken, close such a client.
+const int OUTBOX_MAX_CLIENTS = 8;
+bool wsOutboxConnect(AsyncWebSocketClient* client);
+void wsOutboxDisconnect(uint32_t id);
+
+// Apply a "sub:" spec (text after the prefix), false if it is malformed
+bool wsOutboxSubscribe(uint32_t id, const char* spec);
+
+// Apply an "ack:" (text after the prefix), false if it is malformed
+bool wsOutboxAck(uint32_t id, const char* spec);
+
+// True when some subscriber of this class is due, build the frame only then
+bool frameDue(FrameClass cls);
+
+// Queue a frame for every connected client; a latency trace id (see
+// latencyTrace.h) is added to it as "trace"
+void publishFrame(FrameClass cls, const char* json, uint16_t traceId = 0);
+
+// Send what each client can take, call every loop
+void startWsOutbox();
+
+// Per-client queue depth, send interval, drop counters and alert ack times
+String wsOutboxStatsJson();
+
+#endif
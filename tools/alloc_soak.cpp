@@ -0,0 +1,307 @@
+// Host soak of the allocation-free loop paths (see src/allocTrack.h).
+//
+// Runs the parts of the tick, command and send paths that build on the host
+// for days of simulated time, one pass per 10 ms, starting a day before
+// millis() wraps:
+//   tick      rule evaluation on random-walk sensor inputs, env/room/door
+//             frames and heat alerts published into the outbox, a history
+//             sample appended to the 1 KB blocks every 5 s
+//   wsEvent   a dashboard and a flooding client sending commands, each one
+//             admitted through its client's token bucket and queued, and
+//             the dashboard acking every alert it reads, with no token
+//   commands  the loop running the queued commands
+//   send      the outbox handing frames to two mock sockets, one of them slow
+// Every operator new is counted against the scope it happens in. After a
+// one-hour warm-up the tick, wsEvent and commands scopes must not allocate
+// at all, as in the device soak, and the dashboard's own commands must never
+// be refused; send allocates the shared frame buffers the
+// library takes (and the mock socket's copies) and is only reported. The sockets are
+// read empty when the warm-up ends and again at the end of the run, and no
+// more blocks may be live the second time.
+//
+// Build:  g++ -O2 -std=c++17 -Itools/mock -Isrc -o alloc_soak tools/alloc_soak.cpp src/ruleTable.cpp src/wsOutbox.cpp src/commandQueue.cpp src/historyCodec.cpp
+// Run:    ./alloc_soak --days 3
+
+#include "commandQueue.h"
+#include "historyCodec.h"
+#include "ruleTable.h"
+#include "wsOutbox.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+
+static uint32_t simMs = 0;
+
+unsigned long millis() {
+    return simMs;
+}
+
+unsigned long micros() {
+    return simMs * 1000UL;
+}
+
+// The boot id comes from src/stateStore.cpp on the device
+uint16_t stateBootId() {
+    return 4242;
+}
+
+void spanQueued(uint16_t) {
+}
+void spanSent(uint16_t) {
+}
+
+// --- Allocation counting ---
+
+enum SoakScope {
+    SCOPE_NONE = -1,
+    SCOPE_TICK,
+    SCOPE_WS_EVENT,
+    SCOPE_COMMANDS,
+    SCOPE_SEND,
+    SCOPE_COUNT
+};
+
+static const char* const scopeNames[SCOPE_COUNT] = {"tick", "wsEvent", "commands", "send"};
+
+static int scope = SCOPE_NONE;
+static bool steady = false;
+static uint64_t allocs[SCOPE_COUNT];
+static uint64_t steadyAllocs[SCOPE_COUNT];
+static long liveBlocks = 0;
+
+static void* countedNew(size_t size) {
+    if (scope != SCOPE_NONE) {
+        allocs[scope]++;
+        if (steady) steadyAllocs[scope]++;
+    }
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    liveBlocks++;
+    return p;
+}
+
+static void countedDelete(void* p) {
+    if (!p) return;
+    liveBlocks--;
+    free(p);
+}
+
+void* operator new(size_t size) { return countedNew(size); }
+void* operator new[](size_t size) { return countedNew(size); }
+void operator delete(void* p) noexcept { countedDelete(p); }
+void operator delete[](void* p) noexcept { countedDelete(p); }
+void operator delete(void* p, size_t) noexcept { countedDelete(p); }
+void operator delete[](void* p, size_t) noexcept { countedDelete(p); }
+
+// --- Simulated firmware pieces ---
+
+static RuleTable rules;
+static HistoryBlock block;
+static HistoryEncoder encoder;
+static uint32_t blockSeq = 0;
+static uint32_t blocksSealed = 0;
+static bool room1Manual = false;
+static bool doorOpen = false;
+
+static void addRule(uint8_t out, uint8_t in, uint8_t op, float value, float hyst = 0) {
+    ruleTableAddRule(rules, out, false);
+    ruleTableAddCondition(rules, in, op, value, hyst, 0);
+}
+
+static void buildRules() {
+    ruleTableClear(rules);
+    addRule(RULE_OUT_ROOM1_DARK, RULE_IN_LDR, OP_GT, 4000, 50);
+    addRule(RULE_OUT_PRESENCE, RULE_IN_DISTANCE, OP_LE, 10);
+    addRule(RULE_OUT_GREET_HOT, RULE_IN_TEMPERATURE, OP_GE, 32);
+    addRule(RULE_OUT_HEAT_CAUTION, RULE_IN_HEAT_INDEX, OP_GE, 27);
+    addRule(RULE_OUT_HEAT_DANGER, RULE_IN_HEAT_INDEX, OP_GE, 42);
+    ruleTableFinish(rules);
+}
+
+// Commands as handleCommand() takes them, without the hardware
+static void runCommand(const char* cmd) {
+    if (strcmp(cmd, "room1:ON") == 0) room1Manual = true;
+    else if (strcmp(cmd, "room1:AUTO") == 0) room1Manual = false;
+    else if (strcmp(cmd, "unlockDoor") == 0) doorOpen = true;
+    else if (strcmp(cmd, "lockDoor") == 0) doorOpen = false;
+}
+
+struct Walk {
+    float value, low, high, step;
+    float next(std::mt19937& rng) {
+        std::uniform_real_distribution<float> d(-step, step);
+        value += d(rng);
+        if (value < low) value = low;
+        if (value > high) value = high;
+        return value;
+    }
+};
+
+static void tick(std::mt19937& rng) {
+    static Walk ldr = {3000, 0, 4095, 40};
+    static Walk distance = {100, 2, 400, 5};
+    static Walk temp = {28, 15, 45, 0.05f};
+    static bool wasDark = false, wasHot = false, wasDanger = false;
+    static bool lastDoor = false;
+
+    ruleTableSetInput(rules, RULE_IN_LDR, ldr.next(rng), simMs);
+    ruleTableSetInput(rules, RULE_IN_DISTANCE, distance.next(rng), simMs);
+    float t = temp.next(rng);
+    ruleTableSetInput(rules, RULE_IN_TEMPERATURE, t, simMs);
+    ruleTableSetInput(rules, RULE_IN_HEAT_INDEX, t + 2, simMs);
+
+    char json[160];
+    bool dark = ruleTableOutput(rules, RULE_OUT_ROOM1_DARK);
+    if (dark != wasDark && frameDue(FRAME_ROOMS)) {
+        snprintf(json, sizeof(json), "{\"room1\":\"%s\",\"room1Mode\":\"%s\"}",
+                 dark ? "ON" : "OFF", room1Manual ? "MANUAL" : "AUTO");
+        publishFrame(FRAME_ROOMS, json);
+        wasDark = dark;
+    }
+    if (simMs % 2000 == 0 && frameDue(FRAME_ENV)) {
+        snprintf(json, sizeof(json), "{\"temperature\":%.1f,\"humidity\":55.0}", t);
+        publishFrame(FRAME_ENV, json);
+    }
+    if (doorOpen != lastDoor) {
+        publishFrame(FRAME_DOOR, doorOpen ? "{\"door\":\"UNLOCKED\"}" : "{\"door\":\"LOCKED\"}");
+        lastDoor = doorOpen;
+    }
+    bool hot = ruleTableOutput(rules, RULE_OUT_HEAT_CAUTION);
+    bool danger = ruleTableOutput(rules, RULE_OUT_HEAT_DANGER);
+    if ((hot && !wasHot) || (danger && !wasDanger)) {
+        publishFrame(FRAME_ALERT, danger ? "{\"alert\":\"Heat index: Danger\"}"
+                                         : "{\"alert\":\"Heat index: Caution\"}");
+    }
+    wasHot = hot;
+    wasDanger = danger;
+
+    if (simMs % 5000 == 0) {
+        int16_t tenths = historyTenths(t);
+        if (!historyBlockAppend(block, encoder, simMs / 1000, tenths, 550)) {
+            historyBlockFinish(block, true);
+            blocksSealed++;
+            historyBlockBegin(block, encoder, ++blockSeq);
+            historyBlockAppend(block, encoder, simMs / 1000, tenths, 550);
+        }
+    }
+}
+
+static const char* const dashboardCommands[] = {
+    "room1:ON", "room1:AUTO", "unlockDoor", "lockDoor", "getReadings"
+};
+
+static unsigned long dashboardRefused = 0;
+
+// As onWsEvent(): acks straight to the outbox, commands a token first, then
+// the queue
+static void receive(uint32_t id, const char* msg) {
+    if (strncmp(msg, "ack:", 4) == 0) {
+        wsOutboxAck(id, msg + 4);
+    } else if (admitCommand(id) == CMD_ADMITTED) {
+        queueCommand(id, msg);
+    } else if (id == 1) {
+        dashboardRefused++;
+    }
+}
+
+// The dashboard acks each alert it reads, as data/script.js does
+static void drain(AsyncWebSocketClient& socket, size_t n) {
+    while (n-- > 0 && !socket.queue.empty()) {
+        unsigned long seq;
+        unsigned boot;
+        bool alert = sscanf(socket.queue.front().c_str(), "{\"alertSeq\":%lu,\"boot\":%u", &seq, &boot) == 2;
+        socket.queue.pop_front();
+        if (alert && socket.id() == 1) {
+            char ack[32];
+            snprintf(ack, sizeof(ack), "ack:%u:%lu", boot, seq);
+            scope = SCOPE_WS_EVENT;
+            receive(socket.id(), ack);
+            scope = SCOPE_NONE;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int days = 3;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--days") == 0) days = atoi(argv[i + 1]);
+    }
+    if (days < 1) {
+        fprintf(stderr, "usage: %s [--days N]\n", argv[0]);
+        return 2;
+    }
+
+    const uint32_t STEP_MS = 10;
+    const uint32_t WARMUP_MS = 3600000;
+    const uint64_t RUN_MS = (uint64_t)days * 86400000ULL;
+    // A day before millis() wraps, so the run crosses it
+    simMs = 0xFFFFFFFFu - 86400000u + 1;
+
+    std::mt19937 rng(7);
+    buildRules();
+    setWsOutbox();
+    setCommandQueue();
+    historyBlockBegin(block, encoder, blockSeq);
+
+    AsyncWebSocketClient dashboard(1);
+    AsyncWebSocketClient slow(2);
+    wsOutboxConnect(&dashboard);
+    wsOutboxConnect(&slow);
+    commandQueueConnect(1);
+    commandQueueConnect(3);
+
+    std::uniform_int_distribution<int> pick(0, 4);
+    long liveAtSteady = 0;
+    uint64_t passes = 0;
+
+    for (uint64_t elapsed = 0; elapsed < RUN_MS; elapsed += STEP_MS, simMs += STEP_MS) {
+        // Incoming commands: the dashboard every 2 s, the flooder every pass
+        scope = SCOPE_WS_EVENT;
+        if (simMs % 2000 == 0) receive(1, dashboardCommands[pick(rng)]);
+        receive(3, "room1:ON");
+        scope = SCOPE_NONE;
+
+        // The loop
+        scope = SCOPE_COMMANDS;
+        drainCommands(runCommand);
+        scope = SCOPE_TICK;
+        tick(rng);
+        scope = SCOPE_SEND;
+        startWsOutbox();
+        scope = SCOPE_NONE;
+
+        drain(dashboard, 1000);
+        if (simMs % 200 == 0) drain(slow, 1);
+        passes++;
+
+        if (!steady && elapsed >= WARMUP_MS) {
+            drain(dashboard, MOCK_WS_MAX_QUEUED);
+            drain(slow, MOCK_WS_MAX_QUEUED);
+            steady = true;
+            liveAtSteady = liveBlocks;
+        }
+    }
+
+    drain(dashboard, MOCK_WS_MAX_QUEUED);
+    drain(slow, MOCK_WS_MAX_QUEUED);
+
+    printf("%d simulated days, %llu passes, %u history blocks sealed\n\n",
+           days, (unsigned long long)passes, blocksSealed);
+    printf("%-8s %14s %14s\n", "scope", "allocs", "after warm-up");
+    for (int s = 0; s < SCOPE_COUNT; s++) {
+        printf("%-8s %14llu %14llu\n", scopeNames[s], (unsigned long long)allocs[s],
+               (unsigned long long)steadyAllocs[s]);
+    }
+    printf("live blocks: %ld after warm-up, %ld at the end\n", liveAtSteady, liveBlocks);
+    printf("dashboard commands refused: %lu\n\n", dashboardRefused);
+
+    bool pass = steady && steadyAllocs[SCOPE_TICK] == 0 && steadyAllocs[SCOPE_WS_EVENT] == 0 &&
+                steadyAllocs[SCOPE_COMMANDS] == 0 && liveBlocks <= liveAtSteady &&
+                dashboardRefused == 0;
+    printf("soak %s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 2;
+}
@@ -0,0 +1,330 @@
+// Host check of the embedded web assets (src/webAssets.cpp, built with
+// EMBED_WEB_ASSETS) against the LittleFS fallback in src/main.cpp.
+//
+// Loads data/ into the mocked LittleFS, registers both sets of routes on
+// the mocked server and requests every UI file through each, draining the
+// response the way the library does: one send buffer allocated and filled
+// per ack. Reports per file the body bytes sent, filesystem calls, heap
+// allocations and peak heap of the request, and host time per request.
+// Host time is the server-side work only; on the device flash and LittleFS
+// reads and the Wi-Fi link come on top, and grow with the bytes read and
+// sent. Checks:
+//   - include/webAssets_data.h is current: every UI file in data/ is
+//     embedded, each gzip body's CRC and length match the file
+//   - the embedded path serves the flash array itself, byte for byte, with
+//     its ETag, and works with LittleFS empty
+//   - a matching If-None-Match gets a 304 with no body, a changed one the
+//     full body
+//   - per file, no filesystem calls, no more bytes sent and a lower peak
+//     heap than from LittleFS
+//   - fewer heap allocations and less host time over the whole UI than
+//     from LittleFS (the ETag and cache headers cost a few allocations a
+//     small file from LittleFS doesn't make)
+//
+// Build:  python tools/embed_assets.py && g++ -O2 -std=c++17 -DEMBED_WEB_ASSETS -Itools/mock -Isrc -Iinclude -o asset_bench tools/asset_bench.cpp src/webAssets.cpp
+// Run:    ./asset_bench   (from the repository root)
+
+#include "webAssets.h"
+#include "webAssets_data.h"
+#include <LittleFS.h>
+
+#include <time.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <set>
+#include <string>
+
+const char* DATA_DIR = "data";
+
+// Runtime config, not part of the UI (as SKIP in tools/embed_assets.py)
+const char* NOT_UI = "/rules.json";
+
+const int TIMING_PASSES = 200;
+
+// --- Heap use of one request ---
+//
+// Every allocation carries its size in a header, and whether it was made
+// while counting, so frees of older blocks don't count against the request.
+
+static bool counting = false;
+static unsigned allocCount = 0;
+static long liveBytes = 0;
+static long peakBytes = 0;
+
+struct Block {
+    const uint8_t* start;
+    size_t length;
+};
+static Block blocks[4096];
+static size_t blockCount = 0;
+
+void* operator new(size_t n) {
+    size_t* p = (size_t*)malloc(n + 2 * sizeof(size_t));
+    if (!p) throw std::bad_alloc();
+    p[0] = n;
+    p[1] = counting;
+    if (counting) {
+        allocCount++;
+        liveBytes += n;
+        if (liveBytes > peakBytes) peakBytes = liveBytes;
+        if (blockCount < sizeof(blocks) / sizeof(blocks[0])) blocks[blockCount++] = {(const uint8_t*)(p + 2), n};
+    }
+    return p + 2;
+}
+
+// Out of line, or GCC pairs the inlined new with free() and warns
+__attribute__((noinline)) static void release(void* ptr) {
+    if (!ptr) return;
+    size_t* p = (size_t*)ptr - 2;
+    if (p[1]) liveBytes -= p[0];
+    free(p);
+}
+
+void operator delete(void* ptr) noexcept {
+    release(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    release(ptr);
+}
+
+// True when data points into a block the request allocated
+static bool onHeap(const uint8_t* data) {
+    for (size_t i = 0; i < blockCount; i++) {
+        if (data >= blocks[i].start && data < blocks[i].start + blocks[i].length) return true;
+    }
+    return false;
+}
+
+// --- Serving ---
+
+struct Served {
+    int code = 0;
+    std::string body;
+    std::string etag;
+    std::string encoding;
+    bool copied = false;        // body sent from a heap block
+    unsigned fsCalls = 0;       // exists(), open() and file reads
+    unsigned allocs = 0;
+    long peak = 0;
+};
+
+static double nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static Served serve(AsyncWebServer& server, const char* url, const char* ifNoneMatch = nullptr) {
+    Served out;
+    out.body.reserve(1 << 20);
+    MockServeStats stats;
+    AsyncWebServerRequest request(url, &stats);
+    if (ifNoneMatch) request.headers.emplace_back("If-None-Match", ifNoneMatch);
+
+    allocCount = 0;
+    liveBytes = peakBytes = 0;
+    blockCount = 0;
+    counting = true;
+    if (server.handle(request)) {
+        AsyncWebServerResponse* response = request.response.get();
+        while (!response->done()) {
+            std::unique_ptr<uint8_t[]> buf(new uint8_t[MOCK_TCP_SND_BUF]);
+            size_t n = response->fill(buf.get(), MOCK_TCP_SND_BUF);
+            if (n == 0) break;
+            out.body.append((const char*)buf.get(), n);
+        }
+    }
+    counting = false;
+
+    AsyncWebServerResponse* response = request.response.get();
+    if (!response) return out;
+    out.code = response->code;
+    out.copied = response->content && onHeap(response->content);
+    if (const AsyncWebHeader* h = response->header("ETag")) out.etag = h->value().c_str();
+    if (const AsyncWebHeader* h = response->header("Content-Encoding")) out.encoding = h->value().c_str();
+    out.fsCalls = stats.fsLookups + response->fileReads;
+    out.allocs = allocCount;
+    out.peak = peakBytes;
+    return out;
+}
+
+static double timeServe(AsyncWebServer& server, const char* url) {
+    double start = nowUs();
+    for (int i = 0; i < TIMING_PASSES; i++) serve(server, url);
+    return (nowUs() - start) / TIMING_PASSES;
+}
+
+// As src/main.cpp registers them without EMBED_WEB_ASSETS
+static void serveFromLittleFS(AsyncWebServer& server) {
+    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(LittleFS, "/index.html", "text/html");
+    });
+    server.on("/login.html", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(LittleFS, "/login.html", "text/html");
+    });
+    server.on("/script.js", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(LittleFS, "/script.js", "application/javascript");
+    });
+    server.on("/chart.js", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(LittleFS, "/chart.js", "application/javascript");
+    });
+    server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(LittleFS, "/style.css", "text/css");
+    });
+    server.serveStatic("/assets/", LittleFS, "/assets/");
+}
+
+// The LittleFS routes only serve index.html at /
+static const char* urlOf(const WebAsset& asset) {
+    return strcmp(asset.path, "/index.html") == 0 ? "/" : asset.path;
+}
+
+// --- data/ ---
+
+static bool loadData() {
+    namespace fs = std::filesystem;
+    if (!fs::is_directory(DATA_DIR)) return false;
+    for (const auto& entry : fs::recursive_directory_iterator(DATA_DIR)) {
+        if (!entry.is_regular_file()) continue;
+        std::ifstream in(entry.path(), std::ios::binary);
+        std::string path = "/" + fs::relative(entry.path(), DATA_DIR).generic_string();
+        LittleFS.files[path].assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    return true;
+}
+
+static uint32_t crc32(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) crc = crc >> 1 ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static uint32_t le32(const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// A gzip body ends with the CRC32 and length of what it decompresses to
+static bool matchesFile(const WebAsset& asset) {
+    auto it = LittleFS.files.find(asset.path);
+    if (it == LittleFS.files.end()) return false;
+    const std::vector<uint8_t>& file = it->second;
+    if (!asset.gzipped) {
+        return asset.length == file.size() && memcmp(asset.data, file.data(), file.size()) == 0;
+    }
+    if (asset.length < 18) return false;
+    const uint8_t* trailer = asset.data + asset.length - 8;
+    return le32(trailer) == crc32(file.data(), file.size()) && le32(trailer + 4) == (uint32_t)file.size();
+}
+
+static bool failed = false;
+
+static void check(const char* name, bool ok) {
+    printf("%-56s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok) failed = true;
+}
+
+int main() {
+    if (!loadData()) {
+        fprintf(stderr, "asset_bench: no %s/ here, run it from the repository root\n", DATA_DIR);
+        return 1;
+    }
+
+    AsyncWebServer embedded;
+    AsyncWebServer fromFs;
+    serveEmbeddedAssets(embedded);
+    serveFromLittleFS(fromFs);
+
+    // The header against data/
+    std::set<std::string> uiFiles;
+    for (const auto& file : LittleFS.files) {
+        if (file.first != NOT_UI) uiFiles.insert(file.first);
+    }
+    std::set<std::string> embeddedFiles;
+    bool current = true;
+    for (size_t i = 0; i < webAssetCount; i++) {
+        embeddedFiles.insert(webAssets[i].path);
+        if (!matchesFile(webAssets[i])) {
+            printf("    %s differs from %s%s\n", webAssets[i].path, DATA_DIR, webAssets[i].path);
+            current = false;
+        }
+    }
+    check("header: every UI file in data/ embedded", embeddedFiles == uiFiles);
+    check("header: bodies match data/ (gzip CRC and length)", current);
+
+    // Embedded, with LittleFS empty
+    MockFiles files;
+    std::swap(files, LittleFS.files);
+    bool served = true, exact = true, headers = true, notModified = true, changed = true, noFs = true;
+    std::vector<Served> fromFlash;
+    for (size_t i = 0; i < webAssetCount; i++) {
+        const WebAsset& asset = webAssets[i];
+        Served s = serve(embedded, urlOf(asset));
+        served = served && s.code == 200;
+        exact = exact && !s.copied && s.body.size() == asset.length &&
+                memcmp(s.body.data(), asset.data, asset.length) == 0;
+        headers = headers && s.etag == asset.etag && s.encoding == (asset.gzipped ? "gzip" : "");
+        noFs = noFs && s.fsCalls == 0;
+
+        Served cached = serve(embedded, urlOf(asset), asset.etag);
+        notModified = notModified && cached.code == 304 && cached.body.empty() && cached.etag == asset.etag;
+        Served stale = serve(embedded, urlOf(asset), "\"0000000000000000\"");
+        changed = changed && stale.code == 200 && stale.body.size() == asset.length;
+        fromFlash.push_back(s);
+    }
+    std::swap(files, LittleFS.files);
+    check("embedded: every file served with LittleFS empty", served);
+    check("embedded: body is the flash array, byte for byte", exact);
+    check("embedded: ETag and Content-Encoding headers", headers);
+    check("embedded: matching If-None-Match gets 304, no body", notModified);
+    check("embedded: changed If-None-Match gets the full body", changed);
+    check("embedded: no filesystem calls", noFs);
+
+    // Against LittleFS
+    printf("\n%-30s %19s %15s %15s %17s %17s\n", "", "body bytes", "fs calls", "allocations",
+           "peak heap bytes", "host us/request");
+    printf("%-30s %9s %9s %7s %7s %7s %7s %8s %8s %8s %8s\n", "file", "flash", "LittleFS", "flash",
+           "LFS", "flash", "LFS", "flash", "LittleFS", "flash", "LittleFS");
+    bool rawFiles = true, fewerBytes = true, lowerPeak = true;
+    double flashUs = 0, fsUs = 0;
+    size_t flashBytes = 0, fsBytes = 0;
+    unsigned flashAllocs = 0, fsAllocs = 0;
+    for (size_t i = 0; i < webAssetCount; i++) {
+        const WebAsset& asset = webAssets[i];
+        const Served& e = fromFlash[i];
+        Served f = serve(fromFs, urlOf(asset));
+        const std::vector<uint8_t>& file = LittleFS.files[asset.path];
+        rawFiles = rawFiles && f.code == 200 && f.body.size() == file.size() &&
+                   memcmp(f.body.data(), file.data(), file.size()) == 0;
+        fewerBytes = fewerBytes && e.body.size() <= f.body.size();
+        lowerPeak = lowerPeak && e.peak < f.peak;
+
+        double eUs = timeServe(embedded, urlOf(asset));
+        double fUs = timeServe(fromFs, urlOf(asset));
+        flashUs += eUs;
+        fsUs += fUs;
+        flashBytes += e.body.size();
+        fsBytes += f.body.size();
+        flashAllocs += e.allocs;
+        fsAllocs += f.allocs;
+        printf("%-30s %9zu %9zu %7u %7u %7u %7u %8ld %8ld %8.1f %8.1f\n", asset.path, e.body.size(),
+               f.body.size(), e.fsCalls, f.fsCalls, e.allocs, f.allocs, e.peak, f.peak, eUs, fUs);
+    }
+    printf("%-30s %9zu %9zu %15s %7u %7u %17s %8.1f %8.1f\n\n", "whole UI", flashBytes, fsBytes, "",
+           flashAllocs, fsAllocs, "", flashUs, fsUs);
+
+    check("littlefs: serves the files from data/", rawFiles);
+    check("embedded: no more body bytes than LittleFS, per file", fewerBytes);
+    check("embedded: lower peak heap than LittleFS, per file", lowerPeak);
+    check("embedded: fewer heap allocations over the whole UI", flashAllocs < fsAllocs);
+    check("embedded: less host time over the whole UI", flashUs < fsUs);
+
+    return failed ? 2 : 0;
+}
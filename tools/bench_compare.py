@@ -0,0 +1,120 @@
+# Compares on-device benchmark results (env:esp32dev_bench) with a stored
+# baseline and fails when a kernel got slower than the threshold.
+#
+# Results come from the device (http://<ip>/bench), a saved JSON file, or a
+# serial log containing the "BENCH {...}" line the firmware prints. Host runs
+# of tools/kernel_bench.cpp print the same line; keep them against their own
+# baseline (--baseline host_baseline.json), host and device times differ.
+#
+#   python tools/bench_compare.py http://192.168.4.1/bench
+#   python tools/bench_compare.py monitor.log --threshold 5
+#   python tools/bench_compare.py results.json --update   (store as baseline)
+#
+# Exit status: 0 = no regression, 1 = regression, 2 = bad input.
+
+import argparse
+import json
+import os
+import sys
+import urllib.request
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DEFAULT_BASELINE = os.path.join(PROJECT_DIR, "tools", "bench_baseline.json")
+
+# Compared per kernel (median is the least noisy of the batch statistics)
+METRIC = "median_ns"
+
+
+def load_results(source):
+    if source.startswith("http://") or source.startswith("https://"):
+        with urllib.request.urlopen(source, timeout=10) as response:
+            text = response.read().decode("utf-8")
+    else:
+        with open(source, encoding="utf-8", errors="replace") as f:
+            text = f.read()
+
+    # Serial log: use the last BENCH line
+    lines = [l for l in text.splitlines() if l.startswith("BENCH ")]
+    if lines:
+        text = lines[-1][len("BENCH "):]
+
+    data = json.loads(text)
+    if not data.get("benchmarks"):
+        raise ValueError("no benchmark results (is this a BENCH build?)")
+    return data
+
+
+def by_name(data):
+    return {b["name"]: b for b in data["benchmarks"]}
+
+
+def compare(results, baseline, threshold):
+    current = by_name(results)
+    base = by_name(baseline)
+    regressions = 0
+
+    print(f"{'kernel':<20} {'baseline':>12} {'current':>12} {'change':>9}")
+    for name, b in current.items():
+        if name not in base:
+            print(f"{name:<20} {'-':>12} {b[METRIC]:>12} {'new':>9}")
+            continue
+        old = base[name][METRIC]
+        new = b[METRIC]
+        change = (new - old) * 100.0 / old if old else 0.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<20} {old:>12} {new:>12} {change:>+8.1f}%{flag}")
+
+    for name in base:
+        if name not in current:
+            print(f"{name:<20} {base[name][METRIC]:>12} {'-':>12} {'missing':>9}")
+
+    ctx_old = baseline.get("context", {})
+    ctx_new = results.get("context", {})
+    if ctx_old.get("cpuMHz") != ctx_new.get("cpuMHz"):
+        print(f"warning: CPU clock differs ({ctx_old.get('cpuMHz')} vs {ctx_new.get('cpuMHz')} MHz)")
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare benchmark results with a baseline")
+    parser.add_argument("results", help="URL, JSON file or serial log")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE)
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="allowed slowdown in percent (default 10)")
+    parser.add_argument("--update", action="store_true", help="store the results as the baseline")
+    args = parser.parse_args()
+
+    try:
+        results = load_results(args.results)
+    except (OSError, ValueError) as e:
+        print(f"cannot read results: {e}", file=sys.stderr)
+        return 2
+
+    if args.update:
+        with open(args.baseline, "w", encoding="utf-8") as f:
+            json.dump(results, f, indent=2)
+            f.write("\n")
+        print(f"baseline written to {args.baseline}")
+        return 0
+
+    try:
+        with open(args.baseline, encoding="utf-8") as f:
+            baseline = json.load(f)
+    except (OSError, ValueError) as e:
+        print(f"cannot read baseline: {e} (create one with --update)", file=sys.stderr)
+        return 2
+
+    regressions = compare(results, baseline, args.threshold)
+    if regressions:
+        print(f"{regressions} kernel(s) slower than {args.threshold:g}%")
+        return 1
+    print("no regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,262 @@
+// Host check of the interrupt edge capture and debouncing (src/gpioEdges.cpp).
+//
+// Builds the real module against mocked GPIO registers and interrupts
+// (tools/mock/) and injects edges the way the ISR sees them, on a simulated
+// micros() clock. The loop is polled at uneven intervals, including passes
+// far longer than the debounce windows. Checks:
+//   - a clean press and release give two events with the exact edge times
+//   - a burst of bounces gives one event, timed at its first edge
+//   - a glitch that returns to the same level gives none
+//   - a press shorter than a loop pass still gives both events
+//   - thousands of random bouncing presses on the button and a touch pad,
+//     with glitches in between, give exactly the expected events
+//   - more edges than the ring holds between two passes are counted, not
+//     blocked on
+// and reports the host time of the longest nextInputEvent() call: nothing
+// in it waits for a debounce window to pass. unsigned long is 64 bits on
+// the host, so the micros() wrap is not simulated.
+//
+// Build:  g++ -O2 -std=c++17 -Itools/mock -Isrc -o edge_sim tools/edge_sim.cpp src/gpioEdges.cpp
+// Run:    ./edge_sim
+
+#include "gpioEdges.h"
+#include <soc/gpio_reg.h>
+
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Same pins and windows as src/doorSystem.cpp
+const uint8_t BUTTON_PIN = 13;
+const uint8_t TOUCH_PIN = 2;
+const unsigned long BUTTON_DEBOUNCE_US = 20000;
+const unsigned long TOUCH_DEBOUNCE_US = 5000;
+
+static uint32_t simUs = 0;
+uint32_t mockGpioIn[2];
+
+unsigned long micros() {
+    return simUs;
+}
+unsigned long millis() {
+    return simUs / 1000;
+}
+unsigned long halMicros() {
+    return simUs;
+}
+
+// Never recording, replaying or in a dry run here
+bool traceReplaying() {
+    return false;
+}
+void traceRecordEdge(uint8_t, bool, uint32_t) {
+}
+void tracePollEvents() {
+}
+void setTraceEdgeHandler(void (*)(uint8_t, bool, unsigned long)) {
+}
+void keepControlState(void*, size_t, void*, portMUX_TYPE*) {
+}
+bool halDryRun() {
+    return false;
+}
+
+// --- GPIO mock ---
+
+static void (*isr[40])(void*);
+static void* isrArg[40];
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+int digitalRead(uint8_t pin) {
+    return (mockGpioIn[pin / 32] >> (pin & 31)) & 1;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int) {
+    isr[pin] = handler;
+    isrArg[pin] = arg;
+}
+
+// Set the level and run the interrupt, as the hardware does on a change
+static void edge(uint8_t pin, bool level, uint32_t atUs) {
+    simUs = atUs;
+    if (level) mockGpioIn[pin / 32] |= 1u << (pin & 31);
+    else mockGpioIn[pin / 32] &= ~(1u << (pin & 31));
+    isr[pin](isrArg[pin]);
+}
+
+// --- Loop side ---
+
+struct Expected {
+    int input;
+    bool pressed;
+    uint32_t timeUs;
+};
+
+static std::vector<InputEvent> got;
+static double longestCallNs = 0;
+
+static double nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void poll(uint32_t atUs) {
+    simUs = atUs;
+    for (;;) {
+        InputEvent ev;
+        double start = nowNs();
+        bool more = nextInputEvent(&ev);
+        double ns = nowNs() - start;
+        if (ns > longestCallNs) longestCallNs = ns;
+        if (!more) break;
+        got.push_back(ev);
+    }
+}
+
+static bool failed = false;
+
+static void check(const char* name, const std::vector<Expected>& expect) {
+    bool ok = got.size() == expect.size();
+    for (size_t i = 0; ok && i < got.size(); i++) {
+        ok = got[i].input == expect[i].input && got[i].pressed == expect[i].pressed &&
+             got[i].timeUs == expect[i].timeUs;
+    }
+    printf("%-36s %s (%zu events)\n", name, ok ? "ok" : "MISMATCH", got.size());
+    if (!ok) {
+        failed = true;
+        for (const InputEvent& ev : got) {
+            printf("    input %d %s at %lu us\n", ev.input, ev.pressed ? "pressed" : "released", ev.timeUs);
+        }
+    }
+    got.clear();
+}
+
+int main() {
+    int button = addEdgeInput(BUTTON_PIN, BUTTON_DEBOUNCE_US);
+    int touch = addEdgeInput(TOUCH_PIN, TOUCH_DEBOUNCE_US);
+
+    uint32_t t = 1000000;
+    poll(t);
+
+    // Clean press and release
+    edge(BUTTON_PIN, true, t + 1000);
+    poll(t + 50000);
+    edge(BUTTON_PIN, false, t + 200000);
+    poll(t + 250000);
+    check("clean press", {{button, true, t + 1000}, {button, false, t + 200000}});
+
+    // Bouncing press (ends high) and release (ends low), polled mid-burst
+    t += 300000;
+    const uint32_t bounce[] = {0, 300, 700, 1500, 2600, 4000, 6100};
+    for (int i = 0; i < 7; i++) edge(BUTTON_PIN, i % 2 == 0, t + bounce[i]);
+    poll(t + 10000);
+    poll(t + 40000);
+    for (int i = 0; i < 7; i++) edge(BUTTON_PIN, i % 2 == 1, t + 100000 + bounce[i]);
+    poll(t + 150000);
+    check("bouncing press", {{button, true, t}, {button, false, t + 100000}});
+
+    // Glitch: up and straight back down
+    t += 200000;
+    edge(BUTTON_PIN, true, t);
+    edge(BUTTON_PIN, false, t + 800);
+    poll(t + 50000);
+    check("glitch dropped", {});
+
+    // 30 ms press inside one 120 ms loop pass, on the touch pad
+    t += 100000;
+    edge(TOUCH_PIN, true, t + 10000);
+    edge(TOUCH_PIN, false, t + 40000);
+    poll(t + 120000);
+    check("press shorter than a pass", {{touch, true, t + 10000}, {touch, false, t + 40000}});
+
+    // Random bouncing presses on both inputs, loop passes of 1-80 ms
+    std::mt19937 rng(33);
+    struct Pad {
+        uint8_t pin;
+        int input;
+        unsigned long debounceUs;
+        bool level;
+        uint32_t nextUs;
+    } pads[2] = {{BUTTON_PIN, button, BUTTON_DEBOUNCE_US, false, 0},
+                 {TOUCH_PIN, touch, TOUCH_DEBOUNCE_US, false, 0}};
+    struct Injected {
+        uint32_t atUs;
+        int pad;
+        bool level;
+    };
+    std::vector<Injected> edges;
+    std::vector<Expected> expect;
+
+    t += 200000;
+    for (Pad& p : pads) p.nextUs = t;
+    const int PRESSES = 5000;
+    for (int n = 0; n < PRESSES; n++) {
+        for (int k = 0; k < 2; k++) {
+            Pad& p = pads[k];
+            uint32_t at = p.nextUs;
+            // A burst of 1-9 edges with gaps shorter than the window, ending
+            // on the new level
+            int count = 1 + 2 * std::uniform_int_distribution<int>(0, 4)(rng);
+            bool level = p.level;
+            uint32_t first = at;
+            for (int i = 0; i < count; i++) {
+                level = !level;
+                edges.push_back({at, k, level});
+                at += std::uniform_int_distribution<uint32_t>(50, p.debounceUs * 3 / 4)(rng);
+            }
+            p.level = level;
+            expect.push_back({p.input, level, first});
+
+            // Stable for a while, maybe with a glitch in the middle
+            uint32_t stable = std::uniform_int_distribution<uint32_t>(p.debounceUs * 3, 400000)(rng);
+            uint32_t settled = at + p.debounceUs + 1000;
+            if (std::uniform_int_distribution<int>(0, 3)(rng) == 0) {
+                edges.push_back({settled, k, !level});
+                edges.push_back({settled + 300, k, level});
+                settled += 300 + p.debounceUs + 1000;
+            }
+            p.nextUs = settled + stable;
+        }
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const Injected& a, const Injected& b) {
+        return a.atUs < b.atUs;
+    });
+    std::sort(expect.begin(), expect.end(), [](const Expected& a, const Expected& b) {
+        return a.timeUs < b.timeUs;
+    });
+
+    uint32_t nextPoll = t + 1000;
+    for (const Injected& e : edges) {
+        while (nextPoll < e.atUs) {
+            poll(nextPoll);
+            nextPoll += std::uniform_int_distribution<uint32_t>(1000, 80000)(rng);
+        }
+        edge(pads[e.pad].pin, e.level, e.atUs);
+    }
+    poll(edges.back().atUs + 100000);
+    // Events come out per pass in input order, so compare sorted by time
+    std::sort(got.begin(), got.end(), [](const InputEvent& a, const InputEvent& b) {
+        return a.timeUs < b.timeUs;
+    });
+    check("random bouncing presses", expect);
+
+    // Ring overflow: 100 edges between two passes
+    unsigned long before = edgeOverflows();
+    t = simUs + 100000;
+    for (int i = 0; i < 100; i++) edge(BUTTON_PIN, i % 2 == 0, t + i * 10);
+    poll(t + 100000);
+    got.clear();
+    bool counted = edgeOverflows() - before == 100 - 64;
+    printf("%-36s %s (%lu dropped)\n", "ring overflow counted", counted ? "ok" : "MISMATCH",
+           edgeOverflows() - before);
+    if (!counted) failed = true;
+
+    printf("\nlongest nextInputEvent() call: %.0f ns (host)\n", longestCallNs);
+    return failed ? 2 : 0;
+}
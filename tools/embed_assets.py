@@ -0,0 +1,101 @@
+# Converts data/ into include/webAssets_data.h for the embedded-assets build.
+# Every file is gzipped (when that makes it smaller), given a content hash
+# ETag and a MIME type, and emitted as a constexpr array linked into flash.
+#
+# Used as a PlatformIO pre: script (see env:esp32dev_embedded), or run by
+# hand: python tools/embed_assets.py
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+DATA_DIR = os.path.join(PROJECT_DIR, "data")
+OUT_FILE = os.path.join(PROJECT_DIR, "include", "webAssets_data.h")
+
+# Runtime config read from LittleFS, not part of the UI
+SKIP = {"rules.json"}
+
+MIME_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".ico": "image/x-icon",
+    ".ttf": "font/ttf",
+    ".woff": "font/woff",
+    ".woff2": "font/woff2",
+}
+
+
+def collect():
+    assets = []
+    for root, _, files in os.walk(DATA_DIR):
+        for name in sorted(files):
+            if name in SKIP:
+                continue
+            full = os.path.join(root, name)
+            url = "/" + os.path.relpath(full, DATA_DIR).replace(os.sep, "/")
+            with open(full, "rb") as f:
+                raw = f.read()
+            packed = gzip.compress(raw, compresslevel=9, mtime=0)
+            gzipped = len(packed) < len(raw)
+            body = packed if gzipped else raw
+            etag = '"' + hashlib.sha1(raw).hexdigest()[:16] + '"'
+            mime = MIME_TYPES.get(os.path.splitext(name)[1].lower(), "application/octet-stream")
+            assets.append((url, mime, etag, gzipped, body))
+    assets.sort(key=lambda a: a[0])
+    return assets
+
+
+def render(assets):
+    out = [
+        "// Generated by tools/embed_assets.py from data/ - do not edit",
+        "#ifndef WEBASSETS_DATA_H",
+        "#define WEBASSETS_DATA_H",
+        "",
+        "#include <stdint.h>",
+        "#include <stddef.h>",
+        "",
+    ]
+    for i, (url, _, _, _, body) in enumerate(assets):
+        out.append("// %s" % url)
+        out.append("constexpr uint8_t webAsset%d[%d] = {" % (i, len(body)))
+        for j in range(0, len(body), 20):
+            out.append("    " + ",".join("0x%02x" % b for b in body[j:j + 20]) + ",")
+        out.append("};")
+        out.append("")
+    out.append("constexpr WebAsset webAssets[] = {")
+    for i, (url, mime, etag, gzipped, body) in enumerate(assets):
+        etag_c = etag.replace('"', '\\"')
+        out.append('    {"%s", "%s", "%s", %s, webAsset%d, %d},' %
+                   (url, mime, etag_c, "true" if gzipped else "false", i, len(body)))
+    out.append("};")
+    out.append("")
+    out.append("constexpr size_t webAssetCount = %d;" % len(assets))
+    out.append("")
+    out.append("#endif")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    text = render(collect())
+    # Only touch the header when the assets changed, to keep builds incremental
+    if os.path.exists(OUT_FILE):
+        with open(OUT_FILE) as f:
+            if f.read() == text:
+                return
+    with open(OUT_FILE, "w") as f:
+        f.write(text)
+    print("Embedded web assets written to %s" % OUT_FILE)
+
+
+main()
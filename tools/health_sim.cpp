@@ -0,0 +1,196 @@
+// Host check of the sensor circuit breakers (src/sensorHealth.cpp) under
+// injected faults.
+//
+// Builds the real module and drives it the way the loop does: the
+// ultrasonic sensor once per 10 ms pass, the DHT every 5 s, each read
+// asking sensorShouldRead() first. Injected faults fail reads the way
+// SENSOR_FAULTS builds do: an ultrasonic read costs the full 30 ms pulseIn
+// timeout, a DHT read comes back NaN. Checks:
+//   - healthy sensors report ok and never trip
+//   - a faulted sensor trips after its failure threshold and is then only
+//     probed, each failed probe doubling the backoff up to its maximum
+//   - time lost to failing ultrasonic reads stays bounded while open
+//   - once the fault clears, the next probe closes the breaker and the
+//     status goes back through degraded to ok
+//   - a DHT with no good sample for longer than its stale time is stale
+//   - failures fed in during a replay slice (virtual clock, replay table)
+//     leave the live counters alone, and /api/health keeps reporting the
+//     live status and age on the real clock
+//
+// Build:  g++ -O2 -std=c++17 -Itools/mock -Isrc -o health_sim tools/health_sim.cpp src/sensorHealth.cpp
+// Run:    ./health_sim
+
+#include "sensorHealth.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static unsigned long simMs = 0;
+static unsigned long replayMs = 0;
+static bool replaying = false;
+
+unsigned long millis() {
+    return simMs;
+}
+
+// The replay clock runs on its own, as traceClock() does
+bool traceReplaying() {
+    return replaying;
+}
+unsigned long halMillis() {
+    return replaying ? replayMs : simMs;
+}
+
+void keepControlState(void*, size_t, void*, portMUX_TYPE*) {
+}
+
+// --- Injected faults, read as the loop reads ---
+
+static bool ultrasonicFault = false;
+static bool dhtFault = false;
+static unsigned long lostMs = 0;        // time spent in failing reads
+
+static void readUltrasonic() {
+    if (!sensorShouldRead(SENSOR_ULTRASONIC)) return;
+    if (ultrasonicFault) {
+        simMs += 30;
+        lostMs += 30;
+        sensorFailure(SENSOR_ULTRASONIC, true);
+    } else {
+        simMs += 1;
+        sensorSuccess(SENSOR_ULTRASONIC);
+    }
+}
+
+static void readDHT() {
+    if (!sensorShouldRead(SENSOR_DHT)) return;
+    if (dhtFault) sensorFailure(SENSOR_DHT, false);
+    else sensorSuccess(SENSOR_DHT);
+}
+
+// Loop passes for ms of simulated time
+static void run(unsigned long ms) {
+    static unsigned long lastDHT = 0;
+    for (unsigned long end = simMs + ms; simMs < end;) {
+        readUltrasonic();
+        if (simMs - lastDHT >= 5000) {
+            lastDHT = simMs;
+            readDHT();
+        }
+        simMs += 10;
+    }
+}
+
+// --- JSON fields ---
+
+static std::string sensorJson(const char* name) {
+    std::string json = sensorHealthJson().c_str();
+    size_t at = json.find(std::string("\"") + name + "\":{");
+    if (at == std::string::npos) return "";
+    return json.substr(at, json.find('}', at) - at + 1);
+}
+
+static long field(const char* name, const char* key) {
+    std::string json = sensorJson(name);
+    size_t at = json.find(std::string("\"") + key + "\":");
+    if (at == std::string::npos) return -1;
+    return atol(json.c_str() + at + strlen(key) + 3);
+}
+
+static bool statusIs(const char* name, const char* status) {
+    return sensorJson(name).find(std::string("\"status\":\"") + status + "\"") != std::string::npos;
+}
+
+static bool failed = false;
+
+static void check(const char* name, bool ok) {
+    printf("%-50s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok) {
+        failed = true;
+        printf("    %s\n    %s\n", sensorJson("dht").c_str(), sensorJson("ultrasonic").c_str());
+    }
+}
+
+int main() {
+    setSensorHealth();
+
+    // Healthy
+    run(60000);
+    check("healthy: both ok", statusIs("dht", "ok") && statusIs("ultrasonic", "ok"));
+    check("healthy: no failures, no trips",
+          field("dht", "failures") == 0 && field("ultrasonic", "trips") == 0);
+
+    // Ultrasonic unplugged: 5 failures in a row trip it
+    ultrasonicFault = true;
+    long readsBefore = field("ultrasonic", "reads");
+    for (int i = 0; i < 4; i++) readUltrasonic();
+    check("ultrasonic: degraded below the threshold",
+          statusIs("ultrasonic", "degraded") && field("ultrasonic", "trips") == 0);
+    readUltrasonic();
+    check("ultrasonic: trips on the 5th failure",
+          statusIs("ultrasonic", "failed") && field("ultrasonic", "trips") == 1 &&
+          field("ultrasonic", "backoffMs") == 500);
+
+    // Probes every backoff, doubling to the 8 s cap
+    bool doubled = true;
+    long expect = 500;
+    for (int probe = 0; probe < 6; probe++) {
+        long failuresBefore = field("ultrasonic", "failures");
+        run(expect + 20);
+        expect = expect * 2 > 8000 ? 8000 : expect * 2;
+        doubled = doubled && field("ultrasonic", "failures") == failuresBefore + 1 &&
+                  field("ultrasonic", "backoffMs") == expect;
+    }
+    check("ultrasonic: one probe per backoff, doubling", doubled);
+
+    lostMs = 0;
+    run(60000);
+    check("ultrasonic: under 1% of a minute lost while open", lostMs < 600);
+    check("ultrasonic: reads skipped while open", field("ultrasonic", "skipped") > 1000);
+    check("ultrasonic: still one trip", field("ultrasonic", "trips") == 1);
+    check("dht: untouched by the ultrasonic fault", statusIs("dht", "ok"));
+
+    // Plugged back in: the next probe closes it
+    ultrasonicFault = false;
+    run(8100);
+    check("ultrasonic: probe closes the breaker",
+          !statusIs("ultrasonic", "failed") && field("ultrasonic", "backoffMs") == 0);
+    run(2000);
+    check("ultrasonic: ok again once the error rate decays", statusIs("ultrasonic", "ok"));
+    check("ultrasonic: reads counted throughout", field("ultrasonic", "reads") > readsBefore);
+
+    // DHT: 3 NaN reads trip it, no good sample for 30 s is also stale
+    dhtFault = true;
+    run(10000);
+    check("dht: degraded below the threshold", statusIs("dht", "degraded"));
+    run(5000);
+    check("dht: trips on the 3rd failure",
+          statusIs("dht", "failed") && field("dht", "trips") == 1 && field("dht", "backoffMs") == 10000);
+    run(40000);
+    check("dht: good sample ages past the stale time", field("dht", "lastGoodAgeMs") > 30000);
+    dhtFault = false;
+    run(300000);
+    check("dht: recovers once the fault clears", statusIs("dht", "ok") && field("dht", "trips") == 1);
+
+    // A replay slice: failures go to the replay copy on the virtual clock
+    long liveReads = field("ultrasonic", "reads");
+    long liveFailures = field("ultrasonic", "failures");
+    replaying = true;
+    replayMs = simMs + 3600000;
+    ultrasonicFault = true;
+    for (int i = 0; i < 5; i++) {
+        if (sensorShouldRead(SENSOR_ULTRASONIC)) sensorFailure(SENSOR_ULTRASONIC, true);
+    }
+    check("replay: replay table trips on its own", sensorStatus(SENSOR_ULTRASONIC) == SENSOR_FAILED);
+    check("replay: /api/health shows the live status",
+          statusIs("ultrasonic", "ok") && statusIs("dht", "ok"));
+    check("replay: live counters untouched",
+          field("ultrasonic", "reads") == liveReads && field("ultrasonic", "failures") == liveFailures);
+    check("replay: ages on the real clock", field("ultrasonic", "lastGoodAgeMs") < 1000);
+    replaying = false;
+    ultrasonicFault = false;
+    check("after replay: live status still ok", sensorStatus(SENSOR_ULTRASONIC) == SENSOR_OK);
+
+    return failed ? 2 : 0;
+}
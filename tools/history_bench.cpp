@@ -0,0 +1,241 @@
+// Host benchmark for the history codec (src/historyCodec.cpp).
+//
+// Encodes a series of temperature/humidity samples into 1 KB blocks exactly
+// as the firmware does, decodes them again, checks the round trip and
+// reports bytes per sample and encode/decode throughput. Input is one of:
+//   --trace trace.bin   a sensor trace (/trace.bin, see src/sensorTrace.h),
+//                       one sample per DHT read
+//   --csv history.csv   time,temperature,humidity rows (GET /history output)
+//   --days N            synthetic 5 s data: daily cycle, DHT22 noise, the
+//                       odd failed read (default, 28 days)
+//
+// Build:  g++ -O2 -std=c++17 -Isrc -o history_bench tools/history_bench.cpp src/historyCodec.cpp
+// Run:    ./history_bench --trace trace.bin
+
+#include "historyCodec.h"
+
+#include <time.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Must match src/historyStore.cpp
+static const uint32_t HISTORY_SLOTS = 512;
+
+// Trace records, must match src/sensorTrace.h
+static const uint8_t TRACE_HUMIDITY = 4;
+static const uint8_t TRACE_TEMPERATURE = 5;
+static const uint16_t TRACE_NAN = 0x8000;
+
+struct Sample {
+    uint32_t time;
+    int16_t temp;
+    int16_t hum;
+};
+
+struct Options {
+    std::string trace;
+    std::string csv;
+    int days = 28;
+    int repeat = 20;        // timing passes
+};
+
+static double nowSec() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool loadTrace(const std::string& path, std::vector<Sample>& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    uint8_t rec[8];
+    bool haveHum = false;
+    uint16_t hum = TRACE_NAN;
+    while (fread(rec, 1, sizeof(rec), f) == sizeof(rec)) {
+        uint32_t timeMs = rec[0] | rec[1] << 8 | rec[2] << 16 | (uint32_t)rec[3] << 24;
+        uint8_t type = rec[4];
+        uint16_t value = rec[6] | rec[7] << 8;
+        // halReadDHT records humidity, then temperature
+        if (type == TRACE_HUMIDITY) {
+            hum = value;
+            haveHum = true;
+        } else if (type == TRACE_TEMPERATURE && haveHum) {
+            out.push_back({timeMs / 1000, (int16_t)value, (int16_t)hum});
+            haveHum = false;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static int16_t parseTenths(const char* s) {
+    if (*s == '\0' || *s == '\n' || *s == '\r') return HISTORY_NAN;
+    return historyTenths(strtof(s, nullptr));
+}
+
+static bool loadCsv(const std::string& path, std::vector<Sample>& out) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        char* end;
+        unsigned long time = strtoul(line, &end, 10);
+        if (end == line || *end != ',') continue;   // header
+        char* temp = end + 1;
+        char* hum = strchr(temp, ',');
+        if (!hum) continue;
+        *hum++ = '\0';
+        out.push_back({(uint32_t)time, parseTenths(temp), parseTenths(hum)});
+    }
+    fclose(f);
+    return true;
+}
+
+// Slow daily swing, DHT22 noise around it, about one failed read in 2000
+static void synthesize(int days, std::vector<Sample>& out) {
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, 0.08);
+    std::uniform_int_distribution<int> fail(0, 1999);
+    uint32_t time = 1735689600;   // 2025-01-01
+    for (uint32_t i = 0; i < (uint32_t)days * 17280; i++, time += 5) {
+        double day = i / 17280.0 * 2 * M_PI;
+        double temp = 22.0 + 3.0 * sin(day) + 0.5 * sin(day * 7.3) + noise(rng);
+        double hum = 48.0 - 8.0 * sin(day) + 2.0 * sin(day * 3.1) + 3 * noise(rng);
+        if (fail(rng) == 0) out.push_back({time, HISTORY_NAN, HISTORY_NAN});
+        else out.push_back({time, historyTenths(temp), historyTenths(hum)});
+    }
+}
+
+static void encodeAll(const std::vector<Sample>& samples, std::vector<HistoryBlock>& blocks) {
+    blocks.clear();
+    HistoryEncoder enc;
+    blocks.emplace_back();
+    historyBlockBegin(blocks.back(), enc, 1);
+    for (const Sample& s : samples) {
+        if (historyBlockAppend(blocks.back(), enc, s.time, s.temp, s.hum)) continue;
+        historyBlockFinish(blocks.back(), true);
+        uint32_t seq = blocks.back().header.seq + 1;
+        blocks.emplace_back();
+        historyBlockBegin(blocks.back(), enc, seq);
+        historyBlockAppend(blocks.back(), enc, s.time, s.temp, s.hum);
+    }
+    historyBlockFinish(blocks.back(), false);
+}
+
+static size_t decodeAll(const std::vector<HistoryBlock>& blocks, std::vector<Sample>* out) {
+    size_t n = 0;
+    uint64_t sum = 0;
+    for (const HistoryBlock& block : blocks) {
+        HistoryDecoder dec;
+        historyDecodeBegin(dec);
+        Sample s;
+        while (historyDecodeNext(block, dec, &s.time, &s.temp, &s.hum)) {
+            if (out) out->push_back(s);
+            sum += s.time + s.temp + s.hum;
+            n++;
+        }
+    }
+    // Keeps the decode loop from being optimised away
+    if (sum == 1) printf(" ");
+    return n;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: history_bench [--trace FILE | --csv FILE | --days N] [--repeat N]\n");
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        if (arg == "--trace") opt.trace = argv[++i];
+        else if (arg == "--csv") opt.csv = argv[++i];
+        else if (arg == "--days") opt.days = atoi(argv[++i]);
+        else if (arg == "--repeat") opt.repeat = atoi(argv[++i]);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    std::vector<Sample> samples;
+    std::string source;
+    if (!opt.trace.empty()) {
+        if (!loadTrace(opt.trace, samples)) {
+            fprintf(stderr, "cannot read %s\n", opt.trace.c_str());
+            return 1;
+        }
+        source = opt.trace;
+    } else if (!opt.csv.empty()) {
+        if (!loadCsv(opt.csv, samples)) {
+            fprintf(stderr, "cannot read %s\n", opt.csv.c_str());
+            return 1;
+        }
+        source = opt.csv;
+    } else {
+        synthesize(opt.days, samples);
+        source = "synthetic, " + std::to_string(opt.days) + " days";
+    }
+    if (samples.size() < 2) {
+        fprintf(stderr, "need at least 2 samples (%zu found)\n", samples.size());
+        return 1;
+    }
+
+    std::vector<HistoryBlock> blocks;
+    encodeAll(samples, blocks);
+
+    // Round trip (times that went backwards are stored as the previous one)
+    std::vector<Sample> decoded;
+    decodeAll(blocks, &decoded);
+    size_t mismatches = decoded.size() == samples.size() ? 0 : 1;
+    uint32_t prevTime = 0;
+    for (size_t i = 0; i < decoded.size() && i < samples.size(); i++) {
+        uint32_t expect = samples[i].time < prevTime ? prevTime : samples[i].time;
+        prevTime = expect;
+        if (decoded[i].time != expect || decoded[i].temp != samples[i].temp ||
+            decoded[i].hum != samples[i].hum) mismatches++;
+    }
+    for (const HistoryBlock& block : blocks) {
+        if (!historyBlockValid(block)) mismatches++;
+    }
+
+    double start = nowSec();
+    for (int r = 0; r < opt.repeat; r++) encodeAll(samples, blocks);
+    double encodeSec = (nowSec() - start) / opt.repeat;
+
+    start = nowSec();
+    for (int r = 0; r < opt.repeat; r++) decodeAll(blocks, nullptr);
+    double decodeSec = (nowSec() - start) / opt.repeat;
+
+    uint64_t bits = 0;
+    for (const HistoryBlock& block : blocks) bits += block.header.bits;
+    size_t n = samples.size();
+    double flashBytes = (double)blocks.size() * HISTORY_BLOCK_BYTES;
+    double interval = (double)(samples.back().time - samples.front().time) / (n - 1);
+    double perBlock = (double)n / blocks.size();
+    double retentionDays = perBlock * (HISTORY_SLOTS - 1) * interval / 86400.0;
+
+    printf("source            %s\n", source.c_str());
+    printf("samples           %zu (every %.1f s)\n", n, interval);
+    printf("blocks            %zu x %zu bytes\n", blocks.size(), HISTORY_BLOCK_BYTES);
+    printf("payload bits      %.2f per sample\n", (double)bits / n);
+    printf("flash bytes       %.3f per sample (raw u32 + 2 floats: 12, ratio %.1fx)\n",
+           flashBytes / n, 12.0 * n / flashBytes);
+    printf("samples per block %.0f\n", perBlock);
+    printf("retention         %.1f days in %u slots\n", retentionDays, HISTORY_SLOTS - 1);
+    printf("encode            %.2f Msamples/s (%.1f ns/sample)\n", n / encodeSec / 1e6, encodeSec * 1e9 / n);
+    printf("decode            %.2f Msamples/s (%.1f ns/sample)\n", n / decodeSec / 1e6, decodeSec * 1e9 / n);
+    printf("round trip        %s\n", mismatches ? "MISMATCH" : "ok");
+    return mismatches ? 2 : 0;
+}
@@ -0,0 +1,284 @@
+// Host check of the state journal recovery (src/stateStore.cpp).
+//
+// Builds the real module against an in-memory LittleFS (tools/mock/) and
+// writes a journal the way the device does: a snapshot group at first boot,
+// then coalesced control groups and rate-limited calibration groups on a
+// simulated millis() clock, noting the file size and the saved fields after
+// every committed group. Each damaged copy is then booted in a fresh
+// process (fork), so every boot starts from the module's power-on state:
+//   - the journal cut short at every byte offset
+//   - every byte of the journal flipped, whole and by a single bit
+// Checks, for each one:
+//   - loadState() restores exactly the fields of the last group committed
+//     before the cut or the damaged record, or the defaults if none was
+//   - the compaction that follows leaves a journal that a second boot, from
+//     scrambled fields, restores to the same values
+//
+// Build:  g++ -O2 -std=c++17 -Itools/mock -Isrc -o journal_fuzz tools/journal_fuzz.cpp src/stateStore.cpp
+// Run:    ./journal_fuzz [seed]
+
+#include "stateStore.h"
+#include "doorSystem.h"
+#include "roomSystem_1.h"
+#include "roomSystem_2.h"
+#include <LittleFS.h>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <random>
+
+// The fields the journal keeps, in place of the room and door modules
+bool room1_override = false;
+bool room1_manualTarget = false;
+bool room2_override = false;
+bool room2_manualTarget = false;
+bool room2_state = false;
+bool doorOpen = false;
+Environment currentEnv = NORMAL;
+int dynamicThreshold = 35;
+int baselineNoise = 0;
+
+static unsigned long simMs = 0;
+
+unsigned long millis() {
+    return simMs;
+}
+unsigned long micros() {
+    return simMs * 1000;
+}
+uint32_t esp_random() {
+    return 4242;
+}
+
+// Same paths and timing as src/stateStore.cpp
+static const char* JOURNAL_PATH = "/state.jnl";
+const unsigned long STATE_POLL_MS = 250;
+const unsigned long COALESCE_MS = 3000;
+const unsigned long CALIBRATION_MS = 600000;
+// Stays below the compaction size, so the whole history is one file
+const size_t JOURNAL_LIMIT = 1800;
+
+const int FIELD_COUNT = 9;
+const int CONTROL_FIELDS = 6;
+
+struct Fields {
+    int v[FIELD_COUNT];
+    bool operator==(const Fields& o) const { return memcmp(v, o.v, sizeof(v)) == 0; }
+};
+
+static Fields capture() {
+    return {{room1_override, room1_manualTarget, room2_override, room2_manualTarget, room2_state,
+             doorOpen, currentEnv, dynamicThreshold, baselineNoise}};
+}
+
+static void apply(const Fields& f) {
+    room1_override = f.v[0];
+    room1_manualTarget = f.v[1];
+    room2_override = f.v[2];
+    room2_manualTarget = f.v[3];
+    room2_state = f.v[4];
+    doorOpen = f.v[5];
+    currentEnv = (Environment)f.v[6];
+    dynamicThreshold = f.v[7];
+    baselineNoise = f.v[8];
+}
+
+// A committed group: the journal up to end restores these fields
+struct Checkpoint {
+    size_t end;
+    Fields fields;
+};
+
+// Written by the generating process, read by the parent
+struct Shared {
+    uint8_t journal[4096];
+    size_t size;
+    Checkpoint points[512];
+    int count;
+};
+
+static Shared* shared;
+
+static size_t journalSize() {
+    auto it = LittleFS.files.find(JOURNAL_PATH);
+    return it == LittleFS.files.end() ? 0 : it->second.size();
+}
+
+// Poll the store until it has written a group or the time is up
+static void runStore(unsigned long forMs, Fields& saved, int first, int last) {
+    size_t before = journalSize();
+    for (unsigned long t = 0; t <= forMs; t += STATE_POLL_MS) {
+        simMs += STATE_POLL_MS;
+        startStateStore();
+        if (journalSize() == before) continue;
+        Fields now = capture();
+        for (int f = first; f < last; f++) saved.v[f] = now.v[f];
+        shared->points[shared->count++] = {journalSize(), saved};
+        return;
+    }
+}
+
+static void generate(unsigned seed) {
+    std::mt19937 rng(seed);
+    simMs = 1000;
+
+    // First boot: no journal, the defaults become the snapshot group
+    loadState();
+    Fields saved = capture();
+    runStore(STATE_POLL_MS, saved, 0, FIELD_COUNT);
+
+    while (journalSize() < JOURNAL_LIMIT) {
+        if (std::uniform_int_distribution<int>(0, 4)(rng) == 0) {
+            // Calibration moved, saved on the next interval
+            currentEnv = (Environment)std::uniform_int_distribution<int>(QUIET, NOISY)(rng);
+            dynamicThreshold = std::uniform_int_distribution<int>(10, 60)(rng);
+            baselineNoise = std::uniform_int_distribution<int>(0, 400)(rng);
+            simMs += CALIBRATION_MS;
+            runStore(STATE_POLL_MS, saved, CONTROL_FIELDS, FIELD_COUNT);
+        } else {
+            // A burst of commands, coalesced into one group
+            int changes = std::uniform_int_distribution<int>(1, 4)(rng);
+            for (int i = 0; i < changes; i++) {
+                Fields f = capture();
+                f.v[std::uniform_int_distribution<int>(0, CONTROL_FIELDS - 1)(rng)] ^= 1;
+                apply(f);
+            }
+            runStore(COALESCE_MS + 1000, saved, 0, CONTROL_FIELDS);
+        }
+    }
+
+    const std::vector<uint8_t>& data = LittleFS.files[JOURNAL_PATH];
+    memcpy(shared->journal, data.data(), data.size());
+    shared->size = data.size();
+}
+
+// Fields of the last group committed within the first end bytes
+static Fields expectedAt(size_t end, const Fields& defaults) {
+    Fields expect = defaults;
+    for (int i = 0; i < shared->count && shared->points[i].end <= end; i++) {
+        expect = shared->points[i].fields;
+    }
+    return expect;
+}
+
+// Outcome of one boot, as the child's exit status
+enum BootResult { BOOT_OK, BOOT_WRONG_STATE, BOOT_WRONG_AFTER_COMPACT, BOOT_CRASHED };
+
+static int runChild(void (*body)(const std::vector<uint8_t>&, const Fields&),
+                    const std::vector<uint8_t>& journal, const Fields& expect) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        body(journal, expect);
+        _exit(BOOT_OK);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : BOOT_CRASHED;
+}
+
+// Second boot, from the compacted journal and scrambled fields
+static void bootAgain(const std::vector<uint8_t>&, const Fields& expect) {
+    Fields scrambled = expect;
+    for (int f = 0; f < CONTROL_FIELDS; f++) scrambled.v[f] ^= 1;
+    scrambled.v[6] = (scrambled.v[6] + 1) % 3;
+    scrambled.v[7] += 7;
+    scrambled.v[8] += 7;
+    apply(scrambled);
+    loadState();
+    if (!(capture() == expect)) _exit(BOOT_WRONG_AFTER_COMPACT);
+}
+
+static void boot(const std::vector<uint8_t>& journal, const Fields& expect) {
+    LittleFS.files[JOURNAL_PATH] = journal;
+    simMs = 1000;
+    loadState();
+    if (!(capture() == expect)) _exit(BOOT_WRONG_STATE);
+
+    // The next loop pass compacts a damaged or unfinished journal
+    simMs += STATE_POLL_MS;
+    startStateStore();
+    int result = runChild(bootAgain, {}, expect);
+    if (result != BOOT_OK) _exit(result);
+}
+
+static bool failed = false;
+
+static void report(const char* name, int cases, int wrong, int wrongAfter, int crashed,
+                   long firstBad) {
+    bool ok = wrong == 0 && wrongAfter == 0 && crashed == 0;
+    printf("%-30s %s (%d cases", name, ok ? "ok" : "MISMATCH", cases);
+    if (!ok) {
+        printf(", %d wrong state, %d wrong after compaction, %d crashed, first at byte %ld",
+               wrong, wrongAfter, crashed, firstBad);
+        failed = true;
+    }
+    printf(")\n");
+}
+
+int main(int argc, char** argv) {
+    unsigned seed = argc > 1 ? (unsigned)atoi(argv[1]) : 37;
+
+    shared = (Shared*)mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    Fields defaults = capture();
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        generate(seed);
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    std::vector<uint8_t> journal(shared->journal, shared->journal + shared->size);
+    printf("journal: %zu bytes, %d committed groups (seed %u)\n\n", journal.size(),
+           shared->count, seed);
+    if (shared->count < 2) {
+        printf("journal generation failed\n");
+        return 1;
+    }
+
+    // Cut short at every offset, including the empty file and the whole one
+    int wrong = 0, wrongAfter = 0, crashed = 0;
+    long firstBad = -1;
+    for (size_t end = 0; end <= journal.size(); end++) {
+        std::vector<uint8_t> cut(journal.begin(), journal.begin() + end);
+        int result = runChild(boot, cut, expectedAt(end, defaults));
+        if (result == BOOT_OK) continue;
+        if (firstBad < 0) firstBad = end;
+        if (result == BOOT_WRONG_STATE) wrong++;
+        else if (result == BOOT_WRONG_AFTER_COMPACT) wrongAfter++;
+        else crashed++;
+    }
+    report("truncated at every byte", journal.size() + 1, wrong, wrongAfter, crashed, firstBad);
+
+    // Flip each byte, whole and by one bit: the records up to the damaged
+    // one are all that may be used
+    const uint8_t masks[] = {0xFF, 0x01};
+    const char* names[] = {"every byte inverted", "every byte, one bit flipped"};
+    for (int m = 0; m < 2; m++) {
+        wrong = wrongAfter = crashed = 0;
+        firstBad = -1;
+        for (size_t at = 0; at < journal.size(); at++) {
+            std::vector<uint8_t> bad = journal;
+            bad[at] ^= masks[m];
+            size_t recordStart = at - at % 8;
+            int result = runChild(boot, bad, expectedAt(recordStart, defaults));
+            if (result == BOOT_OK) continue;
+            if (firstBad < 0) firstBad = at;
+            if (result == BOOT_WRONG_STATE) wrong++;
+            else if (result == BOOT_WRONG_AFTER_COMPACT) wrongAfter++;
+            else crashed++;
+        }
+        report(names[m], journal.size(), wrong, wrongAfter, crashed, firstBad);
+    }
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,443 @@
+// Host benchmark of the firmware's hot kernels: the BENCH suite of
+// src/bench.cpp, run against the real control code.
+//
+// Builds src/main.cpp with the room, door, HAL, outbox and command queue
+// modules. The rule engine, REST API and history store are stood in for
+// here (they need ArduinoJson, which the host has no copy of); the rules
+// are the built-in defaults. setup() runs as on the device, then a scripted
+// session drives loop() with a dashboard connected: claps on the
+// microphone, the LDR crossing the dark threshold, someone walking up to
+// the distance sensor, the DHT warming through the heat index bands, door
+// button presses and WebSocket commands delivered through onWsEvent.
+// Midway the suite runs, as "bench:run" would, and loop() itself is timed
+// as one more kernel. Delays move the simulated clock without sleeping, so
+// a kernel that waits (detect_clap) times its own code only. The cycle
+// counter is the host clock (cpuMHz 1000), so tools/bench_compare.py warns
+// when host results meet a device baseline. Checks:
+//   - every kernel has results
+//   - the suite leaves the control state as it found it
+//   - its dry runs write no pins, fade no lights and send no frames, and
+//     only lcd_print and the redraw after the suite reach the panel
+//   - the session reached the dashboard: room 1 lit at dusk, room 2 by a
+//     clap, commands, the door unlocked, the top heat index alert
+// Results go out as a "BENCH {...}" line, as the firmware prints them.
+//
+// Build:  g++ -O2 -std=c++17 -DBENCH -Itools/mock -Isrc -Iinclude -o kernel_bench tools/kernel_bench.cpp src/main.cpp src/bench.cpp src/roomSystem_1.cpp src/roomSystem_2.cpp src/roomSystem_3.cpp src/doorSystem.cpp src/lcd.cpp src/hal.cpp src/controlState.cpp src/gpioEdges.cpp src/ledcLights.cpp src/lightSequence.cpp src/sensorHealth.cpp src/sensorTrace.cpp src/latencyTrace.cpp src/wsOutbox.cpp src/commandQueue.cpp src/stateStore.cpp src/ruleTable.cpp src/allocTrack.cpp src/telemetry.cpp src/webAssets.cpp
+// Run:    ./kernel_bench > bench.log
+//         python tools/bench_compare.py bench.log --baseline host_baseline.json [--update]
+
+#include "bench.h"
+#include "controlState.h"
+#include "hal.h"
+#include "historyStore.h"
+#include "lcd.h"
+#include "restApi.h"
+#include "roomSystem_3.h"
+#include "ruleEngine.h"
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// The firmware's entry points and the socket server it owns
+void setup();
+void loop();
+extern AsyncWebSocket ws;
+
+// Pins, as in src/roomSystem_*.cpp and src/doorSystem.cpp
+const uint8_t LDR_PIN = 34;
+const uint8_t SOUND_PIN = 35;
+const uint8_t BUTTON_PIN = 13;
+
+const unsigned long SESSION_MS = 120000;
+const unsigned long SUITE_AT_MS = 60000;
+
+// loop() timed as the suite times its kernels
+const int LOOP_REPS = 15;
+const int LOOP_PASSES = 50;
+
+// --- Clock: only delays move it ---
+
+static unsigned long simUs = 0;
+
+unsigned long micros() {
+    return simUs;
+}
+unsigned long millis() {
+    return simUs / 1000;
+}
+void delay(unsigned long ms) {
+    simUs += ms * 1000;
+}
+void delayMicroseconds(unsigned int us) {
+    simUs += us;
+}
+
+uint32_t esp_random() {
+    return (uint32_t)random();
+}
+
+// --- Hardware, scripted ---
+
+uint32_t mockGpioIn[2];
+
+static unsigned long pinWrites = 0;
+static unsigned long lightFades = 0;
+
+static int ldrValue = 3000;
+static bool clapNow = false;
+static float distanceCm = 200;
+
+void pinMode(uint8_t, uint8_t) {
+}
+void digitalWrite(uint8_t, uint8_t) {
+    pinWrites++;
+}
+int digitalRead(uint8_t pin) {
+    return pin < 32 ? (mockGpioIn[0] >> pin) & 1 : (mockGpioIn[1] >> (pin - 32)) & 1;
+}
+
+// Microphone: a quiet room with a sharp peak when a clap is due
+int analogRead(uint8_t pin) {
+    if (pin == LDR_PIN) return ldrValue + (int)(random() % 21) - 10;
+    if (pin == SOUND_PIN) {
+        int noise = 4 + (int)(random() % 6);
+        if (clapNow) {
+            clapNow = false;
+            return 200;
+        }
+        return noise;
+    }
+    return (int)(random() % 4096);
+}
+
+unsigned long pulseIn(uint8_t, uint8_t, unsigned long timeout) {
+    unsigned long us = (unsigned long)(distanceCm * 58);
+    if (us > timeout) {
+        simUs += timeout;
+        return 0;
+    }
+    simUs += us;
+    return us;
+}
+
+static void (*edgeHandlers[40])(void*);
+static void* edgeArgs[40];
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int) {
+    edgeHandlers[pin] = handler;
+    edgeArgs[pin] = arg;
+}
+
+static void edge(uint8_t pin, bool level) {
+    if (level) mockGpioIn[0] |= 1u << pin;
+    else mockGpioIn[0] &= ~(1u << pin);
+    if (edgeHandlers[pin]) edgeHandlers[pin](edgeArgs[pin]);
+}
+
+// Lights: every fade counts, stage timers fire at once
+esp_err_t ledc_timer_config(const ledc_timer_config_t*) {
+    return ESP_OK;
+}
+esp_err_t ledc_channel_config(const ledc_channel_config_t*) {
+    return ESP_OK;
+}
+esp_err_t ledc_fade_func_install(int) {
+    return ESP_OK;
+}
+esp_err_t ledc_set_fade_with_time(ledc_mode_t, ledc_channel_t, uint32_t, int) {
+    lightFades++;
+    return ESP_OK;
+}
+esp_err_t ledc_fade_start(ledc_mode_t, ledc_channel_t, ledc_fade_mode_t) {
+    return ESP_OK;
+}
+
+struct MockTimer {
+    void (*callback)(void*);
+    void* arg;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    *out = new MockTimer{args->callback, args->arg};
+    return ESP_OK;
+}
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t) {
+    timer->callback(timer->arg);
+    return ESP_OK;
+}
+esp_err_t esp_timer_stop(esp_timer_handle_t) {
+    return ESP_OK;
+}
+
+// --- Stand-ins for the modules that need ArduinoJson ---
+
+static RuleTable rules;
+
+static void addRule(uint8_t out, uint8_t in, uint8_t op, float value, float hyst = 0) {
+    ruleTableAddRule(rules, out, false);
+    ruleTableAddCondition(rules, in, op, value, hyst, 0);
+}
+
+// Same as defaultRules in src/ruleEngine.cpp
+bool loadRules() {
+    ruleTableClear(rules);
+    keepControlState(rules.state);
+    addRule(RULE_OUT_ROOM1_DARK, RULE_IN_LDR, OP_GT, 4000, 50);
+    addRule(RULE_OUT_CLAP, RULE_IN_SOUND_RATIO, OP_GT, 0.35f);
+    ruleTableAddRule(rules, RULE_OUT_ENV_QUIET, false);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_AVG, OP_LT, 15, 0, 0);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_VAR, OP_LT, 50, 0, 0);
+    ruleTableAddRule(rules, RULE_OUT_ENV_NOISY, true);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_AVG, OP_GT, 30, 0, 0);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_VAR, OP_GT, 200, 0, 0);
+    addRule(RULE_OUT_PRESENCE, RULE_IN_DISTANCE, OP_LE, 10);
+    addRule(RULE_OUT_GREET_HOT, RULE_IN_TEMPERATURE, OP_GE, 32);
+    addRule(RULE_OUT_GREET_COLD, RULE_IN_TEMPERATURE, OP_LT, 22);
+    addRule(RULE_OUT_HEAT_CAUTION, RULE_IN_HEAT_INDEX, OP_GE, 27);
+    addRule(RULE_OUT_HEAT_EXTREME_CAUTION, RULE_IN_HEAT_INDEX, OP_GE, 33);
+    addRule(RULE_OUT_HEAT_DANGER, RULE_IN_HEAT_INDEX, OP_GE, 42);
+    addRule(RULE_OUT_HEAT_EXTREME_DANGER, RULE_IN_HEAT_INDEX, OP_GE, 52);
+    ruleTableFinish(rules);
+    return false;
+}
+void requestRulesReload() {
+}
+void startRules() {
+}
+bool checkRulesFile(const char*) {
+    return false;
+}
+void setRuleInput(RuleInput input, float value) {
+    ruleTableSetInput(rules, input, value, halMillis());
+}
+bool ruleOutput(RuleOutput output) {
+    return ruleTableOutput(rules, output);
+}
+
+void setRestApi(AsyncWebServer&, void (*)(char*, size_t), void (*)(const char*)) {
+}
+void startRestApi() {
+}
+
+bool setHistory(AsyncWebServer&) {
+    return true;
+}
+bool requestHistoryClock(const char*) {
+    return true;
+}
+void startHistory(float, float) {
+}
+void requestHistoryLap() {
+}
+
+// --- The dashboard ---
+
+static AsyncWebSocketClient dashboard(1);
+
+// What the session has to show on the dashboard
+static const char* const sessionShows[] = {
+    "\"room1\":\"ON\",\"room1Mode\":\"AUTO\"",    // dusk on the LDR
+    "\"room2\":\"ON\",\"room2Mode\":\"AUTO\"",    // a clap
+    "\"room1Mode\":\"MANUAL\"",                   // commands
+    "\"door\":\"UNLOCKED\"",
+    "\"heatIndexAlert\":\"extreme_danger\"",
+};
+const int SESSION_SHOWS = sizeof(sessionShows) / sizeof(sessionShows[0]);
+static bool shown[SESSION_SHOWS];
+
+static void wsEvent(AwsEventType type, const char* text = "") {
+    AwsFrameInfo info = {};
+    info.final = 1;
+    info.opcode = WS_TEXT;
+    info.len = strlen(text);
+    ws.eventHandler(&ws, &dashboard, type, &info, (uint8_t*)text, strlen(text));
+}
+
+// The browser keeps up: everything queued is read every pass
+static void drainDashboard() {
+    for (const std::string& frame : dashboard.queue) {
+        for (int i = 0; i < SESSION_SHOWS; i++) {
+            if (frame.find(sessionShows[i]) != std::string::npos) shown[i] = true;
+        }
+    }
+    dashboard.queue.clear();
+}
+
+// --- The session ---
+
+struct Step {
+    unsigned long ms;
+    void (*run)();
+};
+
+static const char* const sessionCommands[] = {
+    "room1:ON", "room2:OFF", "unlockDoor", "room1:AUTO", "lockDoor", "room2:AUTO", "getReadings"
+};
+static int nextCommand = 0;
+
+static void sendCommand() {
+    wsEvent(WS_EVT_DATA, sessionCommands[nextCommand++ % 7]);
+}
+static void clap() {
+    clapNow = true;
+}
+static void dusk() {
+    ldrValue = 4090;
+}
+static void dawn() {
+    ldrValue = 2500;
+}
+static void walkUp() {
+    distanceCm = 6;
+}
+static void walkAway() {
+    distanceCm = 200;
+}
+static void pressButton() {
+    edge(BUTTON_PIN, true);
+}
+static void releaseButton() {
+    edge(BUTTON_PIN, false);
+}
+
+// The DHT warms through every heat index band and back over the session
+static void weather() {
+    float t = millis() / 1000.0f;
+    dht22.temperature = 24 + 14 * sinf(t / 19.0f);
+    dht22.humidity = 55 + 25 * sinf(t / 31.0f);
+}
+
+static std::vector<Step> session;
+
+static void buildSession() {
+    for (unsigned long ms = 2000; ms < SESSION_MS; ms += 2000) {
+        session.push_back({ms, sendCommand});
+        session.push_back({ms + 700, clap});
+        session.push_back({ms + 1000, weather});
+    }
+    for (unsigned long ms = 5000; ms < SESSION_MS; ms += 20000) {
+        session.push_back({ms, dusk});
+        session.push_back({ms + 8000, dawn});
+        session.push_back({ms + 3000, walkUp});
+        session.push_back({ms + 9000, walkAway});
+        session.push_back({ms + 12000, pressButton});
+        session.push_back({ms + 12150, releaseButton});
+    }
+}
+
+// Runs the session until ms, each step once
+static size_t nextStep = 0;
+
+static void runUntil(unsigned long ms) {
+    while (millis() < ms) {
+        while (nextStep < session.size() && session[nextStep].ms <= millis()) session[nextStep++].run();
+        loop();
+        drainDashboard();
+    }
+}
+
+// --- Results ---
+
+static std::string field(const std::string& json, const std::string& kernel, const char* key) {
+    size_t at = json.find("\"name\":\"" + kernel + "\"");
+    if (at == std::string::npos) return "";
+    at = json.find(std::string("\"") + key + "\":", at);
+    if (at == std::string::npos) return "";
+    at += strlen(key) + 3;
+    return json.substr(at, json.find_first_of(",}", at) - at);
+}
+
+static bool failed = false;
+
+static void check(const char* name, bool ok) {
+    printf("%-56s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok) failed = true;
+}
+
+// Same statistics as src/bench.cpp
+static std::string timeLoop() {
+    uint32_t samples[LOOP_REPS];
+    uint64_t sum = 0;
+    for (int rep = 0; rep < LOOP_REPS; rep++) {
+        uint32_t start = ESP.getCycleCount();
+        for (int i = 0; i < LOOP_PASSES; i++) {
+            while (nextStep < session.size() && session[nextStep].ms <= millis()) session[nextStep++].run();
+            loop();
+            drainDashboard();
+        }
+        samples[rep] = (ESP.getCycleCount() - start) / LOOP_PASSES;
+        sum += samples[rep];
+    }
+    std::sort(samples, samples + LOOP_REPS);
+    return "{\"name\":\"loop\",\"iterations\":" + std::to_string(LOOP_PASSES) +
+           ",\"median_ns\":" + std::to_string(samples[LOOP_REPS / 2]) +
+           ",\"mean_ns\":" + std::to_string(sum / LOOP_REPS) +
+           ",\"min_ns\":" + std::to_string(samples[0]) +
+           ",\"max_ns\":" + std::to_string(samples[LOOP_REPS - 1]) + "}";
+}
+
+int main() {
+    srandom(1);
+    buildSession();
+    std::sort(session.begin(), session.end(), [](const Step& a, const Step& b) { return a.ms < b.ms; });
+
+    setup();
+    ws.clients = 1;
+    wsEvent(WS_EVT_CONNECT);
+    runUntil(SUITE_AT_MS);
+
+    // What one lcd_print iteration and the closing redraw cost on the bus
+    halSetDryRun(false);
+    unsigned long before = LiquidCrystal_I2C::busWrites;
+    lcd.setCursor(6, 2);
+    lcd.print("23.4");
+    unsigned long lcdPrintBus = LiquidCrystal_I2C::busWrites - before;
+    before = LiquidCrystal_I2C::busWrites;
+    showLCD();
+    unsigned long redrawBus = LiquidCrystal_I2C::busWrites - before;
+
+    std::vector<uint8_t> stateBefore(controlStateSize()), stateAfter(controlStateSize());
+    saveControlState(stateBefore.data());
+    unsigned long writesBefore = pinWrites, fadesBefore = lightFades, busBefore = LiquidCrystal_I2C::busWrites;
+    size_t queuedBefore = dashboard.queue.size();
+
+    requestBenchmarks();
+    startBenchmarks();
+
+    saveControlState(stateAfter.data());
+    unsigned long suiteBus = LiquidCrystal_I2C::busWrites - busBefore;
+    std::string json = benchResultsJson().c_str();
+
+    static const char* const kernels[] = {
+        "state_json", "ws_command", "update_baseline", "detect_clap", "auto_adapt",
+        "heat_index", "heat_index_level", "lcd_print", "control_tick"
+    };
+    bool all = true;
+    for (const char* k : kernels) all = all && !field(json, k, "median_ns").empty();
+    check("every kernel has results", all);
+    check("suite leaves the control state as it found it", stateBefore == stateAfter);
+    check("suite writes no pins and fades no lights",
+          pinWrites == writesBefore && lightFades == fadesBefore);
+    check("suite sends no frames", dashboard.queue.size() == queuedBefore);
+    long reps = atol(json.c_str() + json.find("\"reps\":") + 7);
+    long lcdIterations = atol(field(json, "lcd_print", "iterations").c_str());
+    check("only lcd_print and the redraw reach the panel",
+          suiteBus == (unsigned long)(1 + reps * lcdIterations) * lcdPrintBus + redrawBus);
+
+    // The rest of the session, with loop() timed as a kernel
+    json.insert(json.rfind("]}"), "," + timeLoop());
+    runUntil(SESSION_MS);
+    check("session: LDR, clap, commands, door and heat alerts shown",
+          std::all_of(shown, shown + SESSION_SHOWS, [](bool b) { return b; }));
+
+    printf("\n%-20s %12s\n", "kernel", "median ns");
+    for (const char* k : kernels) printf("%-20s %12s\n", k, field(json, k, "median_ns").c_str());
+    printf("%-20s %12s\n\n", "loop", field(json, "loop", "median_ns").c_str());
+    printf("BENCH %s\n", json.c_str());
+
+    return failed ? 2 : 0;
+}
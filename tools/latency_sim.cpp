@@ -0,0 +1,401 @@
+// Host check of the input-to-dashboard latency spans (src/latencyTrace.cpp,
+// LATENCY_TRACE builds) against the real control code.
+//
+// Builds src/main.cpp with the room, door, HAL, outbox and command queue
+// modules, as tools/kernel_bench.cpp does, with the rule engine, REST API
+// and history store stood in for and the built-in default rules. setup()
+// runs as on the device, then a minute of door button presses, claps and
+// WebSocket commands drives loop() with a dashboard connected. The
+// dashboard reads every frame each pass and answers traced frames with
+// "rx:<id>" a network round trip later, as data/script.js does. Delays move
+// the simulated clock, so the stages measure the firmware's own waits: the
+// clap's sample window, the 500 ms frame cadence, the outbox and the echo.
+// It prints the per-stage breakdown of GET /latency and checks:
+//   - every press, clap and command opens a span, and each kind reaches
+//     the echo; every traced frame's id is one the dashboard answered
+//   - every span that reached the socket was echoed
+//   - commands change state within their own pass, claps within their
+//     sample window, and no stage takes longer than the firmware allows
+//     (a frame within the 500 ms cadence, queued and sent within a pass)
+//   - the stages add up to the total, and nothing lands in the replay table
+//
+// Build:  g++ -O2 -std=c++17 -DLATENCY_TRACE -Itools/mock -Isrc -Iinclude -o latency_sim tools/latency_sim.cpp src/main.cpp src/bench.cpp src/roomSystem_1.cpp src/roomSystem_2.cpp src/roomSystem_3.cpp src/doorSystem.cpp src/lcd.cpp src/hal.cpp src/controlState.cpp src/gpioEdges.cpp src/ledcLights.cpp src/lightSequence.cpp src/sensorHealth.cpp src/sensorTrace.cpp src/latencyTrace.cpp src/wsOutbox.cpp src/commandQueue.cpp src/stateStore.cpp src/ruleTable.cpp src/allocTrack.cpp src/telemetry.cpp src/webAssets.cpp
+// Run:    ./latency_sim
+
+#include "controlState.h"
+#include "hal.h"
+#include "historyStore.h"
+#include "latencyTrace.h"
+#include "restApi.h"
+#include "ruleEngine.h"
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+// The firmware's entry points and the socket server it owns
+void setup();
+void loop();
+extern AsyncWebSocket ws;
+
+// Pins, as in src/roomSystem_*.cpp and src/doorSystem.cpp
+const uint8_t LDR_PIN = 34;
+const uint8_t SOUND_PIN = 35;
+const uint8_t BUTTON_PIN = 13;
+
+const unsigned long SESSION_MS = 60000;
+const unsigned long ECHO_RTT_MS = 20;
+
+// detectClap() in src/roomSystem_2.cpp: 20 samples 500 us apart, then the
+// sample 5 ms later that tells a clap from a rising noise
+const unsigned long CLAP_SENSE_US = 20 * 500 + 5000;
+
+// --- Clock: only delays move it ---
+
+static unsigned long simUs = 0;
+
+unsigned long micros() {
+    return simUs;
+}
+unsigned long millis() {
+    return simUs / 1000;
+}
+void delay(unsigned long ms) {
+    simUs += ms * 1000;
+}
+void delayMicroseconds(unsigned int us) {
+    simUs += us;
+}
+
+uint32_t esp_random() {
+    return (uint32_t)random();
+}
+
+// --- Hardware, scripted ---
+
+uint32_t mockGpioIn[2];
+
+static bool clapNow = false;
+static unsigned long clapUntilUs = 0;
+
+void pinMode(uint8_t, uint8_t) {
+}
+void digitalWrite(uint8_t, uint8_t) {
+}
+int digitalRead(uint8_t pin) {
+    return pin < 32 ? (mockGpioIn[0] >> pin) & 1 : (mockGpioIn[1] >> (pin - 32)) & 1;
+}
+
+// A lit room, and one quiet enough that only the scripted claps count:
+// its noise stays under the clap ratio however the threshold adapts. A clap
+// is 2 ms of sound from the next time the microphone is read.
+int analogRead(uint8_t pin) {
+    if (pin == LDR_PIN) return 3000 + (int)(random() % 21) - 10;
+    if (pin == SOUND_PIN) {
+        if (clapNow) {
+            clapNow = false;
+            clapUntilUs = simUs + 2000;
+        }
+        return simUs < clapUntilUs ? 200 : (int)(random() % 3);
+    }
+    return (int)(random() % 4096);
+}
+
+// Nobody at the distance sensor: every read is a 2 m echo
+unsigned long pulseIn(uint8_t, uint8_t, unsigned long) {
+    simUs += 200 * 58;
+    return 200 * 58;
+}
+
+static void (*edgeHandlers[40])(void*);
+static void* edgeArgs[40];
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int) {
+    edgeHandlers[pin] = handler;
+    edgeArgs[pin] = arg;
+}
+
+static void edge(uint8_t pin, bool level) {
+    if (level) mockGpioIn[0] |= 1u << pin;
+    else mockGpioIn[0] &= ~(1u << pin);
+    if (edgeHandlers[pin]) edgeHandlers[pin](edgeArgs[pin]);
+}
+
+// Lights fade at once
+esp_err_t ledc_timer_config(const ledc_timer_config_t*) {
+    return ESP_OK;
+}
+esp_err_t ledc_channel_config(const ledc_channel_config_t*) {
+    return ESP_OK;
+}
+esp_err_t ledc_fade_func_install(int) {
+    return ESP_OK;
+}
+esp_err_t ledc_set_fade_with_time(ledc_mode_t, ledc_channel_t, uint32_t, int) {
+    return ESP_OK;
+}
+esp_err_t ledc_fade_start(ledc_mode_t, ledc_channel_t, ledc_fade_mode_t) {
+    return ESP_OK;
+}
+
+struct MockTimer {
+    void (*callback)(void*);
+    void* arg;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    *out = new MockTimer{args->callback, args->arg};
+    return ESP_OK;
+}
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t) {
+    timer->callback(timer->arg);
+    return ESP_OK;
+}
+esp_err_t esp_timer_stop(esp_timer_handle_t) {
+    return ESP_OK;
+}
+
+// --- Stand-ins for the modules that need ArduinoJson ---
+
+static RuleTable rules;
+
+static void addRule(uint8_t out, uint8_t in, uint8_t op, float value, float hyst = 0) {
+    ruleTableAddRule(rules, out, false);
+    ruleTableAddCondition(rules, in, op, value, hyst, 0);
+}
+
+// Same as defaultRules in src/ruleEngine.cpp
+bool loadRules() {
+    ruleTableClear(rules);
+    keepControlState(rules.state);
+    addRule(RULE_OUT_ROOM1_DARK, RULE_IN_LDR, OP_GT, 4000, 50);
+    addRule(RULE_OUT_CLAP, RULE_IN_SOUND_RATIO, OP_GT, 0.35f);
+    ruleTableAddRule(rules, RULE_OUT_ENV_QUIET, false);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_AVG, OP_LT, 15, 0, 0);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_VAR, OP_LT, 50, 0, 0);
+    ruleTableAddRule(rules, RULE_OUT_ENV_NOISY, true);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_AVG, OP_GT, 30, 0, 0);
+    ruleTableAddCondition(rules, RULE_IN_NOISE_VAR, OP_GT, 200, 0, 0);
+    addRule(RULE_OUT_PRESENCE, RULE_IN_DISTANCE, OP_LE, 10);
+    addRule(RULE_OUT_GREET_HOT, RULE_IN_TEMPERATURE, OP_GE, 32);
+    addRule(RULE_OUT_GREET_COLD, RULE_IN_TEMPERATURE, OP_LT, 22);
+    addRule(RULE_OUT_HEAT_CAUTION, RULE_IN_HEAT_INDEX, OP_GE, 27);
+    addRule(RULE_OUT_HEAT_EXTREME_CAUTION, RULE_IN_HEAT_INDEX, OP_GE, 33);
+    addRule(RULE_OUT_HEAT_DANGER, RULE_IN_HEAT_INDEX, OP_GE, 42);
+    addRule(RULE_OUT_HEAT_EXTREME_DANGER, RULE_IN_HEAT_INDEX, OP_GE, 52);
+    ruleTableFinish(rules);
+    return false;
+}
+void requestRulesReload() {
+}
+void startRules() {
+}
+bool checkRulesFile(const char*) {
+    return false;
+}
+void setRuleInput(RuleInput input, float value) {
+    ruleTableSetInput(rules, input, value, halMillis());
+}
+bool ruleOutput(RuleOutput output) {
+    return ruleTableOutput(rules, output);
+}
+
+void setRestApi(AsyncWebServer&, void (*)(char*, size_t), void (*)(const char*)) {
+}
+void startRestApi() {
+}
+
+bool setHistory(AsyncWebServer&) {
+    return true;
+}
+bool requestHistoryClock(const char*) {
+    return true;
+}
+void startHistory(float, float) {
+}
+void requestHistoryLap() {
+}
+
+// --- The dashboard ---
+
+static AsyncWebSocketClient dashboard(1);
+
+struct Echo {
+    unsigned long ms;
+    std::string text;
+};
+static std::vector<Echo> echoes;
+static std::set<long> tracedIds;
+static std::set<long> echoedIds;
+
+static void wsEvent(AwsEventType type, const char* text = "") {
+    AwsFrameInfo info = {};
+    info.final = 1;
+    info.opcode = WS_TEXT;
+    info.len = strlen(text);
+    ws.eventHandler(&ws, &dashboard, type, &info, (uint8_t*)text, strlen(text));
+}
+
+// Reads everything queued; traced frames are answered a round trip later
+static void drainDashboard() {
+    for (const std::string& frame : dashboard.queue) {
+        size_t at = frame.find("\"trace\":");
+        if (at == std::string::npos) continue;
+        long id = atol(frame.c_str() + at + 8);
+        tracedIds.insert(id);
+        echoes.push_back({millis() + ECHO_RTT_MS, "rx:" + std::to_string(id)});
+    }
+    dashboard.queue.clear();
+
+    for (size_t i = 0; i < echoes.size();) {
+        if (echoes[i].ms > millis()) {
+            i++;
+            continue;
+        }
+        wsEvent(WS_EVT_DATA, echoes[i].text.c_str());
+        echoedIds.insert(atol(echoes[i].text.c_str() + 3));
+        echoes.erase(echoes.begin() + i);
+    }
+}
+
+// --- The session ---
+
+struct Step {
+    unsigned long ms;
+    void (*run)();
+};
+
+// Room 2 is left to the claps
+static const char* const sessionCommands[] = {
+    "room1:ON", "unlockDoor", "room1:OFF", "lockDoor", "room1:AUTO"
+};
+static int nextCommand = 0;
+
+static void sendCommand() {
+    wsEvent(WS_EVT_DATA, sessionCommands[nextCommand++ % 5]);
+}
+static int claps = 0;
+static int presses = 0;
+
+static void clap() {
+    clapNow = true;
+    claps++;
+}
+static void pressButton() {
+    edge(BUTTON_PIN, true);
+    presses++;
+}
+static void releaseButton() {
+    edge(BUTTON_PIN, false);
+}
+
+static std::vector<Step> session;
+
+static void buildSession() {
+    for (unsigned long ms = 2000; ms < SESSION_MS; ms += 2000) {
+        session.push_back({ms, sendCommand});
+        session.push_back({ms + 700, clap});
+    }
+    for (unsigned long ms = 3300; ms < SESSION_MS; ms += 5000) {
+        session.push_back({ms, pressButton});
+        session.push_back({ms + 150, releaseButton});
+    }
+    std::sort(session.begin(), session.end(), [](const Step& a, const Step& b) { return a.ms < b.ms; });
+}
+
+// --- GET /latency ---
+
+static std::string stats;
+
+// A number in the table of event, optionally in one of its intervals
+static long stat(const char* table, const char* event, const char* interval, const char* key) {
+    size_t at = stats.find(std::string("\"") + table + "\":");
+    at = stats.find(std::string("\"") + event + "\":", at);
+    if (interval) at = stats.find(std::string("\"") + interval + "\":", at);
+    at = stats.find(std::string("\"") + key + "\":", at);
+    if (at == std::string::npos) return -1;
+    return atol(stats.c_str() + at + strlen(key) + 3);
+}
+
+static bool failed = false;
+
+static void check(const char* name, bool ok) {
+    printf("%-56s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok) failed = true;
+}
+
+int main() {
+    srandom(1);
+    buildSession();
+
+    setup();
+    ws.clients = 1;
+    wsEvent(WS_EVT_CONNECT);
+
+    // The longest pass, the bound for stages that take one
+    unsigned long passUs = 0;
+    size_t nextStep = 0;
+    while (millis() < SESSION_MS + 2000) {
+        while (nextStep < session.size() && session[nextStep].ms <= millis()) session[nextStep++].run();
+        unsigned long start = micros();
+        loop();
+        passUs = std::max(passUs, micros() - start);
+        drainDashboard();
+    }
+    stats = latencyStatsJson().c_str();
+
+    static const char* const events[] = {"button", "clap", "command"};
+    static const char* const intervals[] = {"sense", "publish", "outbox", "socket", "echo", "total"};
+    printf("%-8s %5s", "event", "spans");
+    for (const char* in : intervals) printf(" %9s", in);
+    printf("    (count, p90 and max ms)\n");
+    for (const char* ev : events) {
+        printf("%-8s %5ld", ev, stat("live", ev, nullptr, "spans"));
+        for (const char* in : intervals) printf(" %9ld", stat("live", ev, in, "count"));
+        printf("\n%14s", "");
+        for (const char* in : intervals) printf(" %9.1f", stat("live", ev, in, "p90Us") / 1000.0);
+        printf("\n%14s", "");
+        for (const char* in : intervals) printf(" %9.1f", stat("live", ev, in, "maxUs") / 1000.0);
+        printf("\n");
+    }
+    printf("longest pass %.1f ms\n\n", passUs / 1000.0);
+
+    bool echoed = true, allEchoed = true, bounded = true, adds = true;
+    for (const char* ev : events) {
+        echoed = echoed && stat("live", ev, "echo", "count") > 0;
+        allEchoed = allEchoed && stat("live", ev, "echo", "count") == stat("live", ev, "socket", "count");
+        // Frames go out at least every 500 ms, and are queued and drained
+        // within the pass that built them and the next
+        bounded = bounded && stat("live", ev, "publish", "maxUs") <= (long)(500000 + passUs) &&
+                  stat("live", ev, "outbox", "maxUs") <= (long)passUs &&
+                  stat("live", ev, "socket", "maxUs") <= (long)(2 * passUs) &&
+                  stat("live", ev, "echo", "maxUs") <= (long)((ECHO_RTT_MS + 1) * 1000 + passUs);
+        long parts = 0;
+        for (int i = 0; i < 4; i++) parts += stat("live", ev, intervals[i], "maxUs");
+        adds = adds && stat("live", ev, "total", "maxUs") <= parts &&
+               stat("live", ev, "total", "count") == stat("live", ev, "socket", "count");
+    }
+    check("one span per press, clap and command",
+          stat("live", "button", nullptr, "spans") == presses &&
+          stat("live", "clap", nullptr, "spans") == claps &&
+          stat("live", "command", nullptr, "spans") == nextCommand);
+    check("button, clap and command spans reach the echo", echoed);
+    check("every traced frame's id was answered",
+          !tracedIds.empty() && tracedIds == echoedIds);
+    check("every span sent was echoed", allEchoed);
+    check("commands change state within their pass",
+          stat("live", "command", "sense", "maxUs") <= (long)passUs);
+    check("claps change state within their sample window",
+          stat("live", "clap", "sense", "maxUs") > 0 && stat("live", "clap", "sense", "maxUs") <= (long)CLAP_SENSE_US);
+    check("no stage longer than the firmware allows", bounded);
+    check("stages add up to the total", adds);
+    check("nothing in the replay table",
+          stat("replay", "button", nullptr, "spans") == 0 && stat("replay", "clap", nullptr, "spans") == 0 &&
+          stat("replay", "command", nullptr, "spans") == 0);
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,336 @@
+// Host check of the Room 1 lighting engine (src/ledcLights.cpp).
+//
+// Builds the real engine against a mock of the LEDC driver and esp_timer
+// (tools/mock/), runs it on a simulated millisecond clock and checks:
+//   - the fade starts (time, channel, duty) of on, off, turn-round mid
+//     sequence, dimming and repeated requests
+//   - that the lit count the engine keeps in RAM matches the mocked
+//     hardware duty at every millisecond
+// It then runs an hour of loop passes through the old software stepper and
+// through the engine, and reports the hardware calls and host time per pass.
+//
+// Build:  g++ -O2 -std=c++17 -Itools/mock -Isrc -o light_sim tools/light_sim.cpp src/ledcLights.cpp src/lightSequence.cpp
+// Run:    ./light_sim
+
+#include "ledcLights.h"
+#include "lightSequence.h"
+#include "sensorTrace.h"
+#include <driver/ledc.h>
+#include <esp_timer.h>
+
+#include <time.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static uint32_t simMs = 0;
+
+unsigned long millis() {
+    return simMs;
+}
+
+// Trace hooks, never replaying or in a dry run here
+bool traceReplaying() {
+    return false;
+}
+void traceRecord(uint8_t, uint8_t, uint16_t) {
+}
+void traceCheckOutput(uint8_t, uint8_t, uint16_t) {
+}
+void keepControlState(void*, size_t, void*, portMUX_TYPE*) {
+}
+bool halDryRun() {
+    return false;
+}
+
+// --- LEDC mock ---
+
+struct MockChannel {
+    bool configured;
+    uint32_t fromDuty;
+    uint32_t toDuty;
+    uint32_t startMs;
+    uint32_t fadeMs;
+    uint32_t nextDuty;        // set by ledc_set_fade_with_time
+    uint32_t nextFadeMs;
+};
+
+struct FadeStart {
+    uint32_t timeMs;
+    int channel;
+    uint32_t duty;
+};
+
+static MockChannel channels[8];
+static std::vector<FadeStart> fadeLog;
+static uint64_t hardwareCalls = 0;
+
+static uint32_t channelDuty(const MockChannel& c, uint32_t now) {
+    int32_t t = (int32_t)(now - c.startMs);
+    if (t <= 0) return c.fromDuty;
+    if ((uint32_t)t >= c.fadeMs) return c.toDuty;
+    return c.fromDuty + ((int32_t)c.toDuty - (int32_t)c.fromDuty) * t / (int32_t)c.fadeMs;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t*) {
+    hardwareCalls++;
+    return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* config) {
+    hardwareCalls++;
+    MockChannel& c = channels[config->channel];
+    memset(&c, 0, sizeof(c));
+    c.configured = true;
+    c.fromDuty = c.toDuty = config->duty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_func_install(int) {
+    hardwareCalls++;
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t, ledc_channel_t channel, uint32_t duty, int ms) {
+    hardwareCalls++;
+    MockChannel& c = channels[channel];
+    if (!c.configured || duty > LIGHT_MAX_DUTY) return ESP_FAIL;
+    c.nextDuty = duty;
+    c.nextFadeMs = ms;
+    return ESP_OK;
+}
+
+// A new fade starts from wherever the running one has got to
+esp_err_t ledc_fade_start(ledc_mode_t, ledc_channel_t channel, ledc_fade_mode_t) {
+    hardwareCalls++;
+    MockChannel& c = channels[channel];
+    if (!c.configured) return ESP_FAIL;
+    c.fromDuty = channelDuty(c, simMs);
+    c.toDuty = c.nextDuty;
+    c.startMs = simMs;
+    c.fadeMs = c.nextFadeMs;
+    fadeLog.push_back({simMs, (int)channel, c.nextDuty});
+    return ESP_OK;
+}
+
+// --- esp_timer mock ---
+
+struct MockTimer {
+    void (*callback)(void*);
+    void* arg;
+    bool armed;
+    uint32_t dueMs;
+};
+
+static MockTimer timers[8];
+static int numTimers = 0;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    if (numTimers >= 8) return ESP_FAIL;
+    MockTimer& t = timers[numTimers++];
+    t.callback = args->callback;
+    t.arg = args->arg;
+    t.armed = false;
+    *out = &t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    hardwareCalls++;
+    if (timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = true;
+    timer->dueMs = simMs + (uint32_t)(timeoutUs / 1000);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    hardwareCalls++;
+    if (!timer->armed) return ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    return ESP_OK;
+}
+
+static void fireTimers() {
+    for (int i = 0; i < numTimers; i++) {
+        MockTimer& t = timers[i];
+        if (t.armed && (int32_t)(simMs - t.dueMs) >= 0) {
+            t.armed = false;
+            t.callback(t.arg);
+        }
+    }
+}
+
+// --- Sequence checks ---
+
+static const uint8_t PINS[] = {25, 33, 32};
+const int LIGHTS = 3;
+
+struct Step {
+    uint32_t timeMs;
+    uint8_t percent;
+};
+
+static bool failed = false;
+
+// One simulated ms: due stage timers, then the check of the RAM lit count
+// against the mocked hardware
+static int litMismatches = 0;
+
+static void tick() {
+    fireTimers();
+    int lit = 0;
+    for (int i = 0; i < LIGHTS; i++) {
+        if (channelDuty(channels[i], simMs) > 0) lit++;
+    }
+    if (lit != ledcLightsLit(simMs)) litMismatches++;
+}
+
+// Lights off and settled, then steps at offsets from there to endMs; fade
+// start times are compared as offsets too. The clock never goes back, the
+// engine (like the device) only ever sees it move forward.
+static void scenario(const char* name, std::vector<Step> steps, uint32_t endMs,
+                     std::vector<FadeStart> expect) {
+    ledcLightsTo(0, simMs);
+    for (uint32_t settle = simMs + 2000; simMs < settle; simMs++) tick();
+    fadeLog.clear();
+    litMismatches = 0;
+
+    uint32_t base = simMs;
+    size_t next = 0;
+    for (; simMs <= base + endMs; simMs++) {
+        while (next < steps.size() && base + steps[next].timeMs == simMs) {
+            ledcLightsTo(steps[next++].percent, simMs);
+        }
+        tick();
+    }
+
+    bool ok = litMismatches == 0 && fadeLog.size() == expect.size();
+    for (size_t i = 0; ok && i < fadeLog.size(); i++) {
+        const FadeStart& f = fadeLog[i];
+        ok = f.timeMs - base == expect[i].timeMs && f.channel == expect[i].channel &&
+             f.duty == expect[i].duty;
+    }
+
+    printf("%-12s %s", name, ok ? "ok" : "MISMATCH");
+    if (litMismatches) printf(" (lit count differs on %d ms)", litMismatches);
+    printf("\n");
+    if (!ok) {
+        failed = true;
+        for (const FadeStart& f : fadeLog) {
+            printf("    fade at %u ms: channel %d -> %u\n", f.timeMs - base, f.channel, f.duty);
+        }
+    }
+}
+
+// --- Loop cost, old stepper against the engine ---
+
+// The software sequencer the engine replaced, with its pin reads and writes
+static uint8_t pinLevel[40];
+
+static int oldDigitalRead(uint8_t pin) {
+    hardwareCalls++;
+    return pinLevel[pin];
+}
+
+static void oldDigitalWrite(uint8_t pin, uint8_t value) {
+    hardwareCalls++;
+    pinLevel[pin] = value;
+}
+
+static bool oldStepper(bool targetOn, uint32_t now) {
+    static int ledStage = 0;
+    static uint32_t lastStepTime = 0;
+    static bool turningOn = false;
+
+    if (targetOn && !turningOn) {
+        turningOn = true;
+        ledStage = 0;
+        lastStepTime = now;
+    } else if (!targetOn && turningOn) {
+        turningOn = false;
+        ledStage = 2;
+        lastStepTime = now;
+    }
+    if (now - lastStepTime >= 300) {
+        lastStepTime = now;
+        if (turningOn) {
+            oldDigitalWrite(PINS[ledStage], 1);
+            if (ledStage < 2) ledStage++;
+        } else {
+            oldDigitalWrite(PINS[ledStage], 0);
+            if (ledStage > 0) ledStage--;
+        }
+    }
+    return oldDigitalRead(PINS[0]) || oldDigitalRead(PINS[1]) || oldDigitalRead(PINS[2]);
+}
+
+static bool engineStep(bool targetOn, uint32_t now) {
+    static bool lastTarget = false;
+    if (targetOn != lastTarget) {
+        lastTarget = targetOn;
+        ledcLightsTo(targetOn ? 100 : 0, now);
+    }
+    return ledcLightsLit(now) > 0;
+}
+
+static double nowSec() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// One pass per ms for an hour, the lights switched every 30 s
+static void loopCost(const char* name, bool (*step)(bool, uint32_t)) {
+    const uint32_t PASSES = 3600000;
+    hardwareCalls = 0;
+
+    uint32_t passesWithCalls = 0;
+    uint32_t litPasses = 0;
+    uint32_t base = simMs;
+    double start = nowSec();
+    for (; simMs - base < PASSES; simMs++) {
+        // The mock's timers stand in for the esp_timer task, for both
+        fireTimers();
+        uint64_t before = hardwareCalls;
+        if (step((simMs - base) / 30000 % 2 == 1, simMs)) litPasses++;
+        if (hardwareCalls != before) passesWithCalls++;
+    }
+    double ns = (nowSec() - start) * 1e9 / PASSES;
+
+    printf("%-12s %8.3f hw calls/pass  %7.4f%% passes touching hw  %6.1f ns/pass (host)  lit %u ms\n",
+           name, (double)hardwareCalls / PASSES, 100.0 * passesWithCalls / PASSES, ns, litPasses);
+}
+
+int main() {
+    const uint32_t FULL = LIGHT_MAX_DUTY;
+    const uint32_t HALF = lightDuty(50);
+
+    if (!setLedcLights(PINS, LIGHTS)) {
+        printf("setLedcLights failed\n");
+        return 1;
+    }
+
+    scenario("on", {{0, 100}}, 1500,
+             {{0, 0, FULL}, {300, 1, FULL}, {600, 2, FULL}});
+    scenario("off", {{0, 100}, {2000, 0}}, 3500,
+             {{0, 0, FULL}, {300, 1, FULL}, {600, 2, FULL},
+              {2000, 2, 0}, {2300, 1, 0}, {2600, 0, 0}});
+    scenario("turn round", {{0, 100}, {450, 0}}, 2000,
+             {{0, 0, FULL}, {300, 1, FULL}, {450, 1, 0}, {450, 2, 0}, {1050, 0, 0}});
+    scenario("dim", {{0, 100}, {2000, 50}}, 3500,
+             {{0, 0, FULL}, {300, 1, FULL}, {600, 2, FULL},
+              {2000, 0, HALF}, {2300, 1, HALF}, {2600, 2, HALF}});
+    scenario("repeat", {{0, 100}, {100, 100}, {700, 100}}, 1500,
+             {{0, 0, FULL}, {300, 1, FULL}, {600, 2, FULL}});
+    printf("\n");
+
+    // Both start dark
+    ledcLightsTo(0, simMs);
+    for (uint32_t settle = simMs + 2000; simMs < settle; simMs++) fireTimers();
+
+    loopCost("old stepper", oldStepper);
+    loopCost("ledc engine", engineStep);
+    return failed ? 2 : 0;
+}
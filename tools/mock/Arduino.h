@@ -0,0 +1,143 @@
+// Host stand-in for the parts of Arduino.h that src/ledcLights.cpp,
+// src/wsOutbox.cpp, src/commandQueue.cpp, src/gpioEdges.cpp,
+// src/stateStore.cpp, src/sensorHealth.cpp and the trace modules
+// (src/hal.cpp, src/sensorTrace.cpp, src/controlState.cpp) and
+// src/webAssets.cpp use (see tools/light_sim.cpp, tools/outbox_sim.cpp,
+// tools/alloc_soak.cpp, tools/edge_sim.cpp, tools/journal_fuzz.cpp,
+// tools/health_sim.cpp, tools/trace_replay.cpp, tools/asset_bench.cpp),
+// and the firmware as a whole (src/main.cpp and the room modules, see
+// tools/kernel_bench.cpp).
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define CHANGE 0x03
+#define IRAM_ATTR
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+
+// As Arduino's: [min, max)
+inline void randomSeed(unsigned long seed) { srandom(seed); }
+inline long random(long max) { return max > 0 ? ::random() % max : 0; }
+inline long random(long min, long max) { return min + random(max - min); }
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+// Single-threaded host: a mutex that is always free
+typedef int* SemaphoreHandle_t;
+#define portMAX_DELAY 0xFFFFFFFFu
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    static int mutex;
+    return &mutex;
+}
+inline bool xSemaphoreTake(SemaphoreHandle_t, uint32_t) { return true; }
+inline bool xSemaphoreGive(SemaphoreHandle_t) { return true; }
+
+#if !(defined(__GLIBC__) && __GLIBC_PREREQ(2, 38))
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+// Enough of String for building JSON
+class String {
+public:
+    String(const char* s = "") : str(s) {}
+    String(const std::string& s) : str(s) {}
+    String(int v) : str(std::to_string(v)) {}
+    String(unsigned v) : str(std::to_string(v)) {}
+    String(long v) : str(std::to_string(v)) {}
+    String(unsigned long v) : str(std::to_string(v)) {}
+    String(float v, int decimals) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        str = buf;
+    }
+    String& operator+=(const String& s) { str += s.str; return *this; }
+    String& operator+=(const char* s) { str += s; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.str + b.str); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.str); }
+    friend String operator+(const String& a, const char* b) { return String(a.str + b); }
+    bool operator==(const char* s) const { return str == s; }
+    const char* c_str() const { return str.c_str(); }
+    size_t length() const { return str.size(); }
+private:
+    std::string str;
+};
+
+// Text output through write(), as Arduino's Print
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const char* s) {
+        size_t n = 0;
+        while (*s) n += write((uint8_t)*s++);
+        return n;
+    }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return print(String(v)); }
+    size_t print(double v, int digits = 2) { return print(String((float)v, digits)); }
+    size_t print(const String& s) { return write(s.c_str()); }
+};
+
+// Serial output is dropped
+struct MockSerial {
+    void begin(unsigned long) {}
+    void print(const String&) {}
+    void print(const char*) {}
+    void println(const String&) {}
+    void println(const char*) {}
+    int printf(const char*, ...) { return 0; }
+};
+inline MockSerial Serial;
+
+// The cycle counter runs at one cycle per host nanosecond
+struct MockEsp {
+    uint32_t getCpuFreqMHz() { return 1000; }
+    uint32_t getCycleCount() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+    }
+    const char* getSdkVersion() { return "host"; }
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+};
+inline MockEsp ESP;
+
+unsigned long millis();
+unsigned long micros();
+uint32_t esp_random();
+
+#endif
@@ -0,0 +1,5 @@
+// Host mock: src/main.cpp includes it, everything it uses is in the
+// ESPAsyncWebServer.h mock.
+#ifndef MOCK_ASYNCTCP_H
+#define MOCK_ASYNCTCP_H
+#endif
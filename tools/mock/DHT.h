@@ -0,0 +1,47 @@
+// Host mock: src/hal.h takes the sensor by reference, src/hal.cpp reads it
+// (see tools/trace_replay.cpp, which sets the values). The heat index is
+// the library's own formula, src/roomSystem_3.cpp alerts on it (see
+// tools/kernel_bench.cpp).
+#ifndef MOCK_DHT_H
+#define MOCK_DHT_H
+
+#include <math.h>
+#include <stdint.h>
+
+#define DHT22 22
+
+class DHT {
+public:
+    DHT() {}
+    DHT(uint8_t, uint8_t) {}
+    void begin() {}
+
+    // Steadman, then the Rothfusz regression above 79 F, as in the library
+    float computeHeatIndex(float temperature, float percentHumidity, bool isFahrenheit = true) {
+        if (!isFahrenheit) temperature = temperature * 1.8f + 32;
+        float hi = 0.5f * (temperature + 61.0f + ((temperature - 68.0f) * 1.2f) + (percentHumidity * 0.094f));
+        if (hi > 79) {
+            hi = -42.379f + 2.04901523f * temperature + 10.14333127f * percentHumidity +
+                 -0.22475541f * temperature * percentHumidity +
+                 -0.00683783f * powf(temperature, 2) +
+                 -0.05481717f * powf(percentHumidity, 2) +
+                 0.00122874f * powf(temperature, 2) * percentHumidity +
+                 0.00085282f * temperature * powf(percentHumidity, 2) +
+                 -0.00000199f * powf(temperature, 2) * powf(percentHumidity, 2);
+            if (percentHumidity < 13 && temperature >= 80.0f && temperature <= 112.0f) {
+                hi -= ((13.0f - percentHumidity) * 0.25f) * sqrtf((17.0f - fabsf(temperature - 95.0f)) * 0.05882f);
+            } else if (percentHumidity > 85.0f && temperature >= 80.0f && temperature <= 87.0f) {
+                hi += ((percentHumidity - 85.0f) * 0.1f) * ((87.0f - temperature) * 0.2f);
+            }
+        }
+        return isFahrenheit ? hi : (hi - 32) * 0.55555f;
+    }
+
+    float readHumidity() { return humidity; }
+    float readTemperature() { return temperature; }
+
+    float humidity = NAN;
+    float temperature = NAN;
+};
+
+#endif
@@ -0,0 +1,291 @@
+// Host mock of the AsyncWebSocketClient calls used by src/wsOutbox.cpp
+// (see tools/outbox_sim.cpp). The socket queue is a list of frames the
+// simulation drains at the client's own pace. The socket server has the
+// client count src/hal.cpp reads (see tools/trace_replay.cpp) and keeps
+// the event handler src/main.cpp sets, for a tool to deliver events
+// through (see tools/kernel_bench.cpp).
+//
+// The HTTP side covers the static file serving of src/webAssets.cpp and
+// the LittleFS fallback in src/main.cpp (see tools/asset_bench.cpp): the
+// flash array and file responses, routes and serveStatic. The rest of
+// src/main.cpp's routes are registered and never requested.
+#ifndef MOCK_ESPASYNCWEBSERVER_H
+#define MOCK_ESPASYNCWEBSERVER_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class AsyncWebSocket;
+class AsyncWebSocketClient;
+
+typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+typedef enum { WS_CONTINUATION, WS_TEXT, WS_BINARY } AwsFrameType;
+
+typedef struct {
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+} AwsFrameInfo;
+
+typedef std::function<void(AsyncWebSocket*, AsyncWebSocketClient*, AwsEventType, void*, uint8_t*, size_t)>
+    AwsEventHandler;
+
+class AsyncWebSocket {
+public:
+    AsyncWebSocket() {}
+    explicit AsyncWebSocket(const char*) {}
+
+    size_t count() const { return clients; }
+    void onEvent(AwsEventHandler handler) { eventHandler = handler; }
+    void cleanupClients() {}
+
+    size_t clients = 0;
+    AwsEventHandler eventHandler;
+};
+
+typedef std::shared_ptr<std::vector<uint8_t>> AsyncWebSocketSharedBuffer;
+
+typedef enum { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING } AwsClientStatus;
+
+// As the library's WS_MAX_QUEUED_MESSAGES
+const size_t MOCK_WS_MAX_QUEUED = 32;
+
+class AsyncWebSocketClient {
+public:
+    explicit AsyncWebSocketClient(uint32_t id) : clientId(id) {}
+
+    uint32_t id() const { return clientId; }
+    AwsClientStatus status() const { return connected ? WS_CONNECTED : WS_DISCONNECTED; }
+    size_t queueLen() const { return queue.size(); }
+    bool queueIsFull() const { return queue.size() >= MOCK_WS_MAX_QUEUED; }
+
+    bool text(const char* msg) {
+        if (queueIsFull()) return false;
+        queue.push_back(msg);
+        return true;
+    }
+    bool text(AsyncWebSocketSharedBuffer buf) {
+        if (queueIsFull()) return false;
+        queue.push_back(std::string(buf->begin(), buf->end()));
+        return true;
+    }
+    void close() { connected = false; }
+
+    bool connected = true;
+    std::deque<std::string> queue;
+
+private:
+    uint32_t clientId;
+};
+
+// --- HTTP ---
+
+typedef enum { HTTP_GET = 0x01, HTTP_POST = 0x02 } WebRequestMethod;
+
+class AsyncWebHeader {
+public:
+    AsyncWebHeader(const char* name, const char* value) : headerName(name), headerValue(value) {}
+    const String& name() const { return headerName; }
+    const String& value() const { return headerValue; }
+
+private:
+    String headerName;
+    String headerValue;
+};
+
+// Free space in the TCP send buffer per ack (TCP_SND_BUF on the ESP32).
+// The library allocates a buffer this size, fills it from the response
+// and hands it to the socket.
+const size_t MOCK_TCP_SND_BUF = 5744;
+
+// LittleFS allocates a cache per open file (CONFIG_LITTLEFS_CACHE_SIZE)
+const size_t MOCK_LFS_CACHE = 512;
+
+// A flash array response (the library's AsyncProgmemResponse) or a file
+// response (AsyncFileResponse). fill() copies the next part of the body
+// into the send buffer, as _fillBuffer does.
+class AsyncWebServerResponse {
+public:
+    AsyncWebServerResponse(int status, const char* type, const uint8_t* data, size_t len)
+        : code(status), mime(type), content(data), contentLength(len) {}
+    AsyncWebServerResponse(int status, const char* type, File f)
+        : code(status), mime(type), contentLength(f.size()), file(f), fileCache(new uint8_t[MOCK_LFS_CACHE]) {}
+
+    void addHeader(const char* name, const char* value) { headers.emplace_back(name, value); }
+    const AsyncWebHeader* header(const char* name) const {
+        for (const AsyncWebHeader& h : headers) {
+            if (h.name() == name) return &h;
+        }
+        return nullptr;
+    }
+
+    size_t fill(uint8_t* buf, size_t len) {
+        size_t n = contentLength - sent < len ? contentLength - sent : len;
+        if (content) {
+            memcpy(buf, content + sent, n);
+        } else {
+            n = file.read(buf, n);
+            fileReads++;
+        }
+        sent += n;
+        return n;
+    }
+    bool done() const { return sent >= contentLength; }
+
+    int code;
+    std::string mime;
+    const uint8_t* content = nullptr;   // not owned, in flash on the device
+    std::string text;                   // or a copy, for send(code, type, text)
+    size_t contentLength;
+    size_t sent = 0;
+    std::list<AsyncWebHeader> headers;      // a linked list in the library
+    File file;
+    std::unique_ptr<uint8_t[]> fileCache;
+    unsigned fileReads = 0;
+};
+
+// Counts the filesystem calls made while serving
+struct MockServeStats {
+    unsigned fsLookups = 0;     // exists() and open()
+    unsigned fsOpens = 0;
+};
+
+class AsyncWebServerRequest {
+public:
+    AsyncWebServerRequest(const char* path, MockServeStats* counters) : url(path), stats(counters) {}
+
+    const AsyncWebHeader* getHeader(const char* name) const {
+        for (const AsyncWebHeader& h : headers) {
+            if (h.name() == name) return &h;
+        }
+        return nullptr;
+    }
+
+    AsyncWebServerResponse* beginResponse(int code, const char* type, const char* content) {
+        return new AsyncWebServerResponse(code, type, (const uint8_t*)content, strlen(content));
+    }
+    AsyncWebServerResponse* beginResponse(int code, const char* type, const uint8_t* content, size_t len) {
+        return new AsyncWebServerResponse(code, type, content, len);
+    }
+    void send(AsyncWebServerResponse* r) { response.reset(r); }
+    // The response keeps its own copy of the text
+    void send(int code, const char* type, const String& content) {
+        AsyncWebServerResponse* r = new AsyncWebServerResponse(code, type, nullptr, 0);
+        r->text = content.c_str();
+        r->content = (const uint8_t*)r->text.data();
+        r->contentLength = r->text.size();
+        send(r);
+    }
+
+    // As the library: the file, else its .gz with Content-Encoding gzip
+    void send(MockFS& fs, const char* path, const char* type) {
+        String gz = String(path) + ".gz";
+        stats->fsLookups++;
+        if (!fs.exists(path)) {
+            stats->fsLookups++;
+            if (!fs.exists(gz.c_str())) {
+                send(beginResponse(404, "text/plain", "Not found"));
+                return;
+            }
+            sendFile(fs, gz.c_str(), type, true);
+            return;
+        }
+        sendFile(fs, path, type, false);
+    }
+
+    void sendFile(MockFS& fs, const char* path, const char* type, bool gzipped) {
+        stats->fsLookups++;
+        stats->fsOpens++;
+        send(new AsyncWebServerResponse(200, type, fs.open(path, "r")));
+        if (gzipped) response->addHeader("Content-Encoding", "gzip");
+    }
+
+    std::string url;
+    std::vector<AsyncWebHeader> headers;
+    std::unique_ptr<AsyncWebServerResponse> response;
+    MockServeStats* stats;
+};
+
+typedef std::function<void(AsyncWebServerRequest*)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, const String&, size_t, uint8_t*, size_t, bool)>
+    ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest*, uint8_t*, size_t, size_t, size_t)> ArBodyHandlerFunction;
+
+class AsyncWebServer {
+public:
+    AsyncWebServer() {}
+    explicit AsyncWebServer(uint16_t) {}
+
+    void begin() {}
+    void addHandler(AsyncWebSocket*) {}
+
+    void on(const char* uri, WebRequestMethod, ArRequestHandlerFunction handler) {
+        routes.emplace_back(uri, handler);
+    }
+    // Uploads and bodies are never sent
+    void on(const char* uri, WebRequestMethod method, ArRequestHandlerFunction handler,
+            ArUploadHandlerFunction, ArBodyHandlerFunction) {
+        on(uri, method, handler);
+    }
+
+    // Files under uri come from path on fs, the .gz first, MIME type by
+    // extension, no ETag (no cache control set)
+    void serveStatic(const char* uri, MockFS& fs, const char* path) {
+        staticUri = uri;
+        staticPath = path;
+        staticFs = &fs;
+    }
+
+    // Routes first, then the static handler; false when nothing matched
+    bool handle(AsyncWebServerRequest& request) {
+        for (auto& route : routes) {
+            if (route.first == request.url) {
+                route.second(&request);
+                return true;
+            }
+        }
+        if (!staticFs || request.url.compare(0, staticUri.size(), staticUri) != 0) return false;
+        std::string path = staticPath + request.url.substr(staticUri.size());
+        std::string gz = path + ".gz";
+        request.stats->fsLookups++;
+        bool gzipped = staticFs->exists(gz.c_str());
+        if (!gzipped) {
+            request.stats->fsLookups++;
+            if (!staticFs->exists(path.c_str())) return false;
+        }
+        request.sendFile(*staticFs, gzipped ? gz.c_str() : path.c_str(), mimeType(path), gzipped);
+        return true;
+    }
+
+    static const char* mimeType(const std::string& path) {
+        static const char* const types[][2] = {
+            {".html", "text/html"}, {".js", "application/javascript"}, {".css", "text/css"},
+            {".svg", "image/svg+xml"}, {".png", "image/png"}, {".ttf", "application/x-font-ttf"},
+        };
+        for (const auto& t : types) {
+            size_t n = strlen(t[0]);
+            if (path.size() >= n && path.compare(path.size() - n, n, t[0]) == 0) return t[1];
+        }
+        return "text/plain";
+    }
+
+private:
+    std::vector<std::pair<std::string, ArRequestHandlerFunction>> routes;
+    std::string staticUri;
+    std::string staticPath;
+    MockFS* staticFs = nullptr;
+};
+
+#endif
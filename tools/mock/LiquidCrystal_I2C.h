@@ -0,0 +1,30 @@
+// Host mock of the 20x4 panel behind src/lcd.cpp (see tools/kernel_bench.cpp).
+// The bus is counted the way the library drives the PCF8574 expander: every
+// character and command goes out as two nibbles, each written with the
+// enable line high and then low, so six one-byte writes.
+#ifndef MOCK_LIQUIDCRYSTAL_I2C_H
+#define MOCK_LIQUIDCRYSTAL_I2C_H
+
+#include <Arduino.h>
+
+class LiquidCrystal_I2C : public Print {
+public:
+    LiquidCrystal_I2C(uint8_t, uint8_t, uint8_t) {}
+
+    void init() { send(); }
+    void backlight() { busWrites++; }
+    void clear() { send(); }
+    void setCursor(uint8_t, uint8_t) { send(); }
+    size_t write(uint8_t) override {
+        send();
+        return 1;
+    }
+    using Print::write;
+
+    static inline unsigned long busWrites = 0;
+
+private:
+    void send() { busWrites += 6; }
+};
+
+#endif
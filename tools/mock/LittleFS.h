@@ -0,0 +1,76 @@
+// Host mock of the LittleFS calls used by src/stateStore.cpp,
+// src/sensorTrace.cpp and the mocked web server's file responses (see
+// tools/journal_fuzz.cpp, tools/trace_replay.cpp, tools/asset_bench.cpp).
+// Files are byte vectors in memory, keyed by path; the tool reads and
+// rewrites them directly.
+#ifndef MOCK_LITTLEFS_H
+#define MOCK_LITTLEFS_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> MockFiles;
+
+class File {
+public:
+    File() {}
+    File(std::vector<uint8_t>* data, bool append) : file(data), pos(append ? data->size() : 0) {}
+
+    explicit operator bool() const { return file != nullptr; }
+    size_t size() const { return file ? file->size() : 0; }
+
+    size_t read(uint8_t* buf, size_t len) {
+        if (!file || pos >= file->size()) return 0;
+        size_t n = file->size() - pos < len ? file->size() - pos : len;
+        memcpy(buf, file->data() + pos, n);
+        pos += n;
+        return n;
+    }
+    bool seek(uint32_t to) {
+        if (!file || to > file->size()) return false;
+        pos = to;
+        return true;
+    }
+    size_t write(const uint8_t* buf, size_t len) {
+        if (!file) return 0;
+        file->insert(file->end(), buf, buf + len);
+        pos = file->size();
+        return len;
+    }
+    void close() { file = nullptr; }
+
+private:
+    std::vector<uint8_t>* file = nullptr;
+    size_t pos = 0;
+};
+
+class MockFS {
+public:
+    bool begin() { return true; }
+
+    // "r" needs an existing file, "w" truncates, "a" appends
+    File open(const char* path, const char* mode) {
+        auto it = files.find(path);
+        if (mode[0] == 'r') return it == files.end() ? File() : File(&it->second, false);
+        std::vector<uint8_t>& data = files[path];
+        if (mode[0] == 'w') data.clear();
+        return File(&data, mode[0] == 'a');
+    }
+    bool exists(const char* path) const { return files.count(path) > 0; }
+    bool remove(const char* path) { return files.erase(path) > 0; }
+    bool rename(const char* from, const char* to) {
+        auto it = files.find(from);
+        if (it == files.end()) return false;
+        files[to] = it->second;
+        files.erase(from);
+        return true;
+    }
+
+    MockFiles files;
+};
+
+inline MockFS LittleFS;
+
+#endif
@@ -0,0 +1,25 @@
+// Host mock of the soft AP calls in src/main.cpp (see tools/kernel_bench.cpp).
+// The AP always starts.
+#ifndef MOCK_WIFI_H
+#define MOCK_WIFI_H
+
+#include <Arduino.h>
+
+#define WIFI_AP 2
+
+class IPAddress {
+public:
+    String toString() const { return "192.168.4.1"; }
+};
+
+class WiFiClass {
+public:
+    bool mode(int) { return true; }
+    bool setSleep(bool) { return true; }
+    bool softAP(const char*, const char*) { return true; }
+    IPAddress softAPIP() { return IPAddress(); }
+};
+
+inline WiFiClass WiFi;
+
+#endif
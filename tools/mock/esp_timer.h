@@ -0,0 +1,26 @@
+// Host mock of the esp_timer one-shot API (see tools/light_sim.cpp).
+#ifndef MOCK_ESP_TIMER_H
+#define MOCK_ESP_TIMER_H
+
+#include <stdint.h>
+#include "driver/ledc.h"
+
+typedef struct MockTimer* esp_timer_handle_t;
+
+typedef enum {
+    ESP_TIMER_TASK
+} esp_timer_dispatch_t;
+
+typedef struct {
+    void (*callback)(void* arg);
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+
+#endif
@@ -0,0 +1,14 @@
+// Host mock of the GPIO input registers read by src/gpioEdges.cpp
+// (see tools/edge_sim.cpp): the simulation sets the pin levels here.
+#ifndef MOCK_SOC_GPIO_REG_H
+#define MOCK_SOC_GPIO_REG_H
+
+#include <stdint.h>
+
+extern uint32_t mockGpioIn[2];
+
+#define GPIO_IN_REG 0
+#define GPIO_IN1_REG 1
+#define REG_READ(reg) (mockGpioIn[reg])
+
+#endif
@@ -0,0 +1,631 @@
+// Host check of the WebSocket outbox (src/wsOutbox.cpp) with slow consumers.
+//
+// Builds the real outbox against a mock AsyncWebSocketClient (tools/mock/)
+// whose socket queue each simulated client drains at its own pace. A minute
+// of a 20 ms env stream, a door change every 700 ms and an alert every 2 s
+// is published with one outbox pass per simulated millisecond, then the
+// clients are given time to catch up. It checks that:
+//   - a client reading everything at once gets every env frame
+//   - a client taking one frame every 250 ms keeps a short socket queue, has
+//     its state interval backed off (intervalMs in wsOutboxStatsJson), is
+//     sent fewer frames (newer ones replace what it has not been sent) and
+//     ends on the last env and door frames; the fast client never backs off
+//   - a client that stops reading for 15 s does the same once it resumes
+//   - every client gets every alert, in order
+//   - a client past OUTBOX_MAX_CLIENTS is refused, and its slot is usable
+//     again after a disconnect
+//   - full state frames published every 20 ms reach a "sub:all" client at
+//     most every 500 ms, and a client of every state topic with a slow env
+//     rate no faster than that rate
+//   - under a flood of state frames on a link carrying 25 frames/s, every
+//     alert is read within 4 frames of being published, where one queue in
+//     publish order (textAll() before the alert lane) loses them; alerts are
+//     acknowledged as script.js does and none are retried, and with every
+//     4th alert copy lost on the link each is sent again within the first
+//     retry time
+// It then runs a minute of device-like traffic for mixed client populations
+// twice: through the outbox, where clients with the same subscription share
+// a group and each frame is serialized only when some group is due and
+// encoded once per round, and through a per-client model of the same
+// subscriptions that serializes and encodes for each client when it is due.
+// It counts frames serialized and buffers encoded for both, prices them at
+// the host cost of one serialize and one encode, and reports the CPU time
+// grouping saves; it checks that grouping never does more of either.
+//
+// Build:  g++ -O2 -std=c++17 -Itools/mock -Isrc -o outbox_sim tools/outbox_sim.cpp src/wsOutbox.cpp
+// Run:    ./outbox_sim
+
+#include "wsOutbox.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+static uint32_t simMs = 0;
+
+unsigned long millis() {
+    return simMs;
+}
+
+// The boot id comes from src/stateStore.cpp on the device
+uint16_t stateBootId() {
+    return 4242;
+}
+
+// Latency spans are not traced here
+void spanQueued(uint16_t) {
+}
+void spanSent(uint16_t) {
+}
+
+// --- Simulated clients ---
+
+struct SimClient {
+    const char* name;
+    AsyncWebSocketClient socket;
+    uint32_t readEveryMs;       // 0 = reads everything each millisecond
+    uint32_t stallFrom, stallTo;
+    size_t maxQueue;
+    unsigned long maxIntervalMs;
+    int frames;
+    int envFrames;
+    int lastEnv;
+    int lastDoor;
+    int nextAlert;
+    bool alertsInOrder;
+
+    SimClient(const char* n, uint32_t id, uint32_t every, uint32_t from = 0, uint32_t to = 0)
+        : name(n), socket(id), readEveryMs(every), stallFrom(from), stallTo(to),
+          maxQueue(0), maxIntervalMs(0), frames(0), envFrames(0), lastEnv(-1), lastDoor(-1),
+          nextAlert(1), alertsInOrder(true) {}
+
+    void take(const std::string& frame) {
+        frames++;
+        int n;
+        if (sscanf(frame.c_str(), "{\"env\":%d", &n) == 1) {
+            envFrames++;
+            lastEnv = n;
+        } else if (sscanf(frame.c_str(), "{\"door\":%d", &n) == 1) {
+            lastDoor = n;
+        } else if (sscanf(frame.c_str(), "{\"alertSeq\":%d", &n) == 1) {
+            if (n != nextAlert) alertsInOrder = false;
+            nextAlert = n + 1;
+        }
+    }
+
+    void read() {
+        if (socket.queue.size() > maxQueue) maxQueue = socket.queue.size();
+        if (simMs >= stallFrom && simMs < stallTo) return;
+        if (readEveryMs == 0) {
+            while (!socket.queue.empty()) {
+                take(socket.queue.front());
+                socket.queue.pop_front();
+            }
+        } else if (simMs % readEveryMs == 0 && !socket.queue.empty()) {
+            take(socket.queue.front());
+            socket.queue.pop_front();
+        }
+    }
+};
+
+// A client's counter, as the outbox reports it
+static unsigned long statOf(uint32_t id, const char* name) {
+    String json = wsOutboxStatsJson();
+    char key[24];
+    snprintf(key, sizeof(key), "{\"id\":%u,", (unsigned)id);
+    std::string field = std::string("\"") + name + "\":";
+    const char* entry = strstr(json.c_str(), key);
+    const char* at = entry ? strstr(entry, field.c_str()) : nullptr;
+    return at ? strtoul(at + field.size(), nullptr, 10) : 0;
+}
+
+// The client's state interval
+static unsigned long intervalOf(uint32_t id) {
+    return statOf(id, "intervalMs");
+}
+
+static bool failed = false;
+
+static double nowSec() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// --- Full state rate ---
+
+// Full state asked for every 20 ms and held until due, as main.cpp does;
+// returns the shortest gap between two state frames the client got
+static uint32_t fullStateGap(AsyncWebSocketClient& socket, const char* spec, uint32_t runMs) {
+    wsOutboxConnect(&socket);
+    wsOutboxSubscribe(socket.id(), spec);
+    socket.queue.clear();
+
+    bool pending = false;
+    uint32_t last = 0, gap = 0xFFFFFFFFu;
+    int n = 0;
+    char json[48];
+    for (uint32_t end = simMs + runMs; simMs < end; simMs++) {
+        if (simMs % 20 == 0) pending = true;
+        if (pending && frameDue(FRAME_STATE)) {
+            snprintf(json, sizeof(json), "{\"state\":%d}", n++);
+            publishFrame(FRAME_STATE, json);
+            pending = false;
+        }
+        startWsOutbox();
+        while (!socket.queue.empty()) {
+            if (socket.queue.front().compare(0, 9, "{\"state\":") == 0) {
+                if (last != 0 && simMs - last < gap) gap = simMs - last;
+                last = simMs;
+            }
+            socket.queue.pop_front();
+        }
+    }
+    wsOutboxDisconnect(socket.id());
+    return gap;
+}
+
+// --- Alert latency under a state flood ---
+
+// Every state class is produced every 5 ms and full state every 20 ms,
+// far more than a congested link carries; an alert every 1.5 s
+const uint32_t FLOOD_MS = 60000;
+const uint32_t FLOOD_ALERT_MS = 1500;
+const uint32_t FLOOD_ACK_DELAY_MS = 20;
+const FrameClass floodClasses[] = {FRAME_ENV, FRAME_ROOMS, FRAME_DOOR, FRAME_SOUND};
+
+struct FloodResult {
+    std::vector<long> latencyMs;    // publish to first read, per alert, -1 = never read
+    bool inOrder;
+    unsigned long retried, lost, unacked, ackMsMax;
+};
+
+static long maxLatency(const FloodResult& r) {
+    long worst = 0;
+    for (long ms : r.latencyMs) worst = ms < 0 || worst < 0 ? -1 : std::max(worst, ms);
+    return worst;
+}
+
+// The alert's own "n", for frames that carry an alert
+static int alertIndex(const std::string& frame) {
+    const char* n = strstr(frame.c_str(), "\"alert\":");
+    n = n ? strstr(n, "\"n\":") : nullptr;
+    return n ? atoi(n + 4) : -1;
+}
+
+// A dashboard on a link that carries one frame every readEveryMs and loses
+// every dropEvery-th alert frame (0 = none). It acknowledges as script.js
+// does, the last alertSeq seen, FLOOD_ACK_DELAY_MS after reading it. With
+// outbox false frames go straight onto the socket queue in publish order,
+// as textAll() sent them before the alert lane.
+static FloodResult alertFlood(uint32_t id, uint32_t readEveryMs, int dropEvery, bool outbox) {
+    AsyncWebSocketClient socket(id);
+    if (outbox) wsOutboxConnect(&socket);
+
+    FloodResult r = {{}, true, 0, 0, 0, 0};
+    std::vector<uint32_t> publishedAt;
+    bool pending = false;
+    int n = 0, alertFrames = 0, lastRead = -1;
+    long lastSeq = 0;
+    uint32_t ackAt = 0;
+    char json[96];
+    uint32_t start = simMs;
+    for (uint32_t end = simMs + FLOOD_MS + 10000; simMs < end; simMs++) {
+        uint32_t t = simMs - start;
+        if (t < FLOOD_MS) {
+            for (FrameClass cls : floodClasses) {
+                if (t % 5 != 0 || (outbox && !frameDue(cls))) continue;
+                snprintf(json, sizeof(json), "{\"class\":%d,\"value\":%d}", (int)cls, n++);
+                if (outbox) publishFrame(cls, json);
+                else socket.text(json);
+            }
+            if (t % 20 == 0) pending = true;
+            if (pending && (!outbox || frameDue(FRAME_STATE))) {
+                snprintf(json, sizeof(json), "{\"state\":%d}", n++);
+                if (outbox) publishFrame(FRAME_STATE, json);
+                else socket.text(json);
+                pending = false;
+            }
+            if (t % FLOOD_ALERT_MS == FLOOD_ALERT_MS / 2) {
+                snprintf(json, sizeof(json), "{\"alert\":\"Failed Attempt\",\"n\":%zu}", publishedAt.size());
+                publishedAt.push_back(simMs);
+                r.latencyMs.push_back(-1);
+                if (outbox) publishFrame(FRAME_ALERT, json);
+                else socket.text(json);
+            }
+        }
+        if (outbox) startWsOutbox();
+
+        if (ackAt != 0 && simMs >= ackAt) {
+            snprintf(json, sizeof(json), "%u:%ld", (unsigned)stateBootId(), lastSeq);
+            wsOutboxAck(id, json);
+            ackAt = 0;
+        }
+        if (simMs % readEveryMs != 0 || socket.queue.empty()) continue;
+        std::string frame = socket.queue.front();
+        socket.queue.pop_front();
+        int a = alertIndex(frame);
+        if (a < 0 || (dropEvery > 0 && ++alertFrames % dropEvery == 0)) continue;
+        if (r.latencyMs[a] < 0) {
+            r.latencyMs[a] = simMs - publishedAt[a];
+            if (a < lastRead) r.inOrder = false;
+            lastRead = a;
+        }
+        const char* seq = strstr(frame.c_str(), "\"alertSeq\":");
+        if (seq && atol(seq + 11) > lastSeq) {
+            lastSeq = atol(seq + 11);
+            ackAt = simMs + FLOOD_ACK_DELAY_MS;
+        }
+    }
+    if (outbox) {
+        r.retried = statOf(id, "alertsRetried");
+        r.lost = statOf(id, "alertsLost");
+        r.unacked = statOf(id, "unacked");
+        r.ackMsMax = statOf(id, "ackMsMax");
+        wsOutboxDisconnect(id);
+    }
+    return r;
+}
+
+static void printFlood(const char* name, const FloodResult& r) {
+    long sum = 0, worst = 0, received = 0;
+    for (long ms : r.latencyMs) {
+        if (ms < 0) continue;
+        sum += ms;
+        worst = std::max(worst, ms);
+        received++;
+    }
+    printf("%-34s %5ld/%-4zu", name, received, r.latencyMs.size());
+    if (received) printf(" %8ld %8ld %8lu\n", sum / received, worst, r.retried);
+    else printf(" %8s %8s %8lu\n", "-", "-", r.retried);
+}
+
+// --- Grouping benchmark ---
+
+// Device cadences: env every 5 s, rooms every 500 ms, sound every 250 ms,
+// door every 700 ms, full state on a change every 200 ms, an alert every 10 s
+struct Producer {
+    FrameClass cls;
+    uint32_t everyMs;
+};
+static const Producer producers[] = {
+    {FRAME_ENV, 5000}, {FRAME_ROOMS, 500}, {FRAME_SOUND, 250},
+    {FRAME_DOOR, 700}, {FRAME_STATE, 200}, {FRAME_ALERT, 10000}
+};
+
+// Roughly the size and work of the device's frames
+static void serialize(FrameClass cls, int n, char* json, size_t size) {
+    if (cls == FRAME_STATE) {
+        snprintf(json, size, "{\"temperature\":%.1f,\"humidity\":%.1f,\"room1\":\"%s\","
+                 "\"room1Mode\":\"AUTO\",\"room2\":\"%s\",\"room2Mode\":\"MANUAL\","
+                 "\"door\":\"LOCKED\",\"sound\":\"quiet\",\"dht\":\"ok\",\"ultrasonic\":\"ok\",\"n\":%d}",
+                 21.5f + n % 10 * 0.1f, 48.0f + n % 7 * 0.3f, n % 2 ? "ON" : "OFF", n % 3 ? "ON" : "OFF", n);
+    } else if (cls == FRAME_ALERT) {
+        snprintf(json, size, "{\"alert\":\"Failed Attempt\",\"n\":%d}", n);
+    } else {
+        snprintf(json, size, "{\"class\":%d,\"value\":%.1f,\"n\":%d}", (int)cls, 20.0f + n % 50 * 0.1f, n);
+    }
+}
+
+// The same subscriptions as wsOutboxSubscribe() parses, kept per client
+struct ModelClient {
+    uint8_t topics;
+    uint32_t intervalMs[FRAME_CLASS_COUNT + 1];
+    uint32_t lastSend[FRAME_CLASS_COUNT + 1];
+    bool sentOnce[FRAME_CLASS_COUNT + 1];
+};
+
+static void modelSubscribe(ModelClient& m, const char* spec) {
+    static const char* const names[] = {"env", "rooms", "door", "sound", "alerts"};
+    // Topic of each class, as in wsOutbox.cpp (-1 = every state topic)
+    static const int topicOf[FRAME_CLASS_COUNT + 1] = {-1, 1, 0, 2, 3, 4};
+    uint32_t topicMs[5] = {0};
+    memset(&m, 0, sizeof(m));
+    if (strcmp(spec, "all") == 0) {
+        m.topics = 0x1F;
+    } else {
+        char buf[64];
+        strncpy(buf, spec, sizeof(buf) - 1);
+        buf[sizeof(buf) - 1] = '\0';
+        for (char* tok = strtok(buf, ","); tok; tok = strtok(nullptr, ",")) {
+            char* eq = strchr(tok, '=');
+            uint32_t ms = eq ? strtoul(eq + 1, nullptr, 10) : 0;
+            if (eq) *eq = '\0';
+            for (int t = 0; t < 5; t++) {
+                if (strcmp(tok, names[t]) == 0) {
+                    m.topics |= 1 << t;
+                    topicMs[t] = ms;
+                }
+            }
+        }
+    }
+    for (int cls = 0; cls <= FRAME_CLASS_COUNT; cls++) {
+        if (topicOf[cls] >= 0) {
+            m.intervalMs[cls] = topicMs[topicOf[cls]];
+            if (!(m.topics & (1 << topicOf[cls]))) m.intervalMs[cls] = 0xFFFFFFFFu;
+            continue;
+        }
+        m.intervalMs[cls] = (m.topics & 0x0F) == 0x0F ? 500 : 0xFFFFFFFFu;
+        for (int t = 0; t < 4; t++) {
+            if (m.intervalMs[cls] != 0xFFFFFFFFu && topicMs[t] > m.intervalMs[cls]) m.intervalMs[cls] = topicMs[t];
+        }
+    }
+}
+
+static bool modelDue(ModelClient& m, int cls, uint32_t now) {
+    if (m.intervalMs[cls] == 0xFFFFFFFFu) return false;
+    if (cls == FRAME_ALERT) return true;
+    return !m.sentOnce[cls] || now - m.lastSend[cls] >= m.intervalMs[cls];
+}
+
+struct BenchResult {
+    long serialized;
+    long encoded;
+    long frames;
+};
+
+static AsyncWebSocketSharedBuffer encode(const char* json) {
+    return std::make_shared<std::vector<uint8_t>>(json, json + strlen(json));
+}
+
+// Host ns of one serialize() and one encode(), over the frame mix
+static void unitCosts(double* serializeNs, double* encodeNs) {
+    const int N = 200000;
+    char json[320];
+    volatile size_t sink = 0;
+    double start = nowSec();
+    for (int i = 0; i < N; i++) {
+        serialize(producers[i % 6].cls, i, json, sizeof(json));
+        sink = sink + json[0];
+    }
+    *serializeNs = (nowSec() - start) * 1e9 / N;
+    start = nowSec();
+    for (int i = 0; i < N; i++) {
+        AsyncWebSocketSharedBuffer buf = encode(json);
+        sink = sink + buf->size();
+    }
+    *encodeNs = (nowSec() - start) * 1e9 / N;
+}
+
+static BenchResult runGrouped(const std::vector<const char*>& specs, uint32_t runMs) {
+    std::vector<std::unique_ptr<AsyncWebSocketClient>> sockets;
+    for (size_t i = 0; i < specs.size(); i++) {
+        sockets.emplace_back(new AsyncWebSocketClient(200 + i));
+        wsOutboxConnect(sockets.back().get());
+        wsOutboxSubscribe(200 + i, specs[i]);
+    }
+
+    BenchResult r = {0, 0, 0};
+    bool pending[FRAME_CLASS_COUNT + 1] = {false};
+    char json[320];
+    for (uint32_t end = simMs + runMs; simMs < end; simMs++) {
+        for (const Producer& p : producers) {
+            if (simMs % p.everyMs == 0) pending[p.cls] = true;
+            if (pending[p.cls] && frameDue(p.cls)) {
+                serialize(p.cls, r.serialized++, json, sizeof(json));
+                publishFrame(p.cls, json);
+                pending[p.cls] = false;
+            }
+        }
+        startWsOutbox();
+
+        // A state frame is one shared buffer for the round, the library
+        // makes its own for each text(const char*), as alerts are sent
+        std::vector<std::string> round;
+        for (auto& s : sockets) {
+            for (const std::string& frame : s->queue) {
+                if (frame.compare(0, 12, "{\"alertSeq\":") == 0) r.encoded++;
+                else round.push_back(frame);
+            }
+            r.frames += s->queue.size();
+            s->queue.clear();
+        }
+        std::sort(round.begin(), round.end());
+        r.encoded += std::unique(round.begin(), round.end()) - round.begin();
+    }
+    for (auto& s : sockets) wsOutboxDisconnect(s->id());
+    return r;
+}
+
+static BenchResult runPerClient(const std::vector<const char*>& specs, uint32_t runMs) {
+    std::vector<std::unique_ptr<AsyncWebSocketClient>> sockets;
+    std::vector<ModelClient> models(specs.size());
+    for (size_t i = 0; i < specs.size(); i++) {
+        sockets.emplace_back(new AsyncWebSocketClient(300 + i));
+        modelSubscribe(models[i], specs[i]);
+    }
+
+    BenchResult r = {0, 0, 0};
+    bool pending[FRAME_CLASS_COUNT + 1] = {false};
+    char json[320];
+    for (uint32_t end = simMs + runMs; simMs < end; simMs++) {
+        for (const Producer& p : producers) {
+            if (simMs % p.everyMs == 0) pending[p.cls] = true;
+            if (!pending[p.cls]) continue;
+            bool anyDue = false;
+            for (size_t i = 0; i < models.size(); i++) {
+                if (!modelDue(models[i], p.cls, simMs)) continue;
+                serialize(p.cls, r.serialized++, json, sizeof(json));
+                sockets[i]->text(encode(json));
+                r.encoded++;
+                models[i].lastSend[p.cls] = simMs;
+                models[i].sentOnce[p.cls] = true;
+                anyDue = true;
+            }
+            if (anyDue) pending[p.cls] = false;
+        }
+        for (auto& s : sockets) {
+            r.frames += s->queue.size();
+            s->queue.clear();
+        }
+    }
+    return r;
+}
+
+static void check(const char* what, bool ok) {
+    printf("%-52s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok) failed = true;
+}
+
+int main() {
+    const uint32_t PUBLISH_MS = 60000;
+    const uint32_t CATCH_UP_MS = 10000;
+
+    if (!setWsOutbox()) {
+        printf("setWsOutbox failed\n");
+        return 1;
+    }
+
+    SimClient fast("fast", 1, 0);
+    SimClient slow("slow (1 frame / 250 ms)", 2, 250);
+    SimClient stalled("stalled 20-35 s", 3, 0, 20000, 35000);
+    SimClient* sims[] = {&fast, &slow, &stalled};
+    for (SimClient* c : sims) wsOutboxConnect(&c->socket);
+
+    int envPublished = 0;
+    int doorPublished = 0;
+    int alertsPublished = 0;
+    char json[64];
+
+    for (simMs = 1; simMs <= PUBLISH_MS + CATCH_UP_MS; simMs++) {
+        if (simMs <= PUBLISH_MS) {
+            if (simMs % 20 == 0 && frameDue(FRAME_ENV)) {
+                snprintf(json, sizeof(json), "{\"env\":%d}", envPublished++);
+                publishFrame(FRAME_ENV, json);
+            }
+            if (simMs % 700 == 0) {
+                snprintf(json, sizeof(json), "{\"door\":%d}", doorPublished++);
+                publishFrame(FRAME_DOOR, json);
+            }
+            if (simMs % 2000 == 0) {
+                snprintf(json, sizeof(json), "{\"alert\":\"test %d\"}", alertsPublished++);
+                publishFrame(FRAME_ALERT, json);
+            }
+        }
+        startWsOutbox();
+        for (SimClient* c : sims) {
+            c->read();
+            if (simMs % 100 == 0) {
+                unsigned long interval = intervalOf(c->socket.id());
+                if (interval > c->maxIntervalMs) c->maxIntervalMs = interval;
+            }
+        }
+    }
+
+    printf("%d env, %d door frames and %d alerts over %u s\n\n",
+           envPublished, doorPublished, alertsPublished, PUBLISH_MS / 1000);
+    printf("%-26s %8s %10s %10s %12s\n", "client", "frames", "env frames", "max queue", "max interval");
+    for (SimClient* c : sims) {
+        printf("%-26s %8d %10d %10zu %9lu ms\n", c->name, c->frames, c->envFrames, c->maxQueue,
+               c->maxIntervalMs);
+    }
+    printf("\n");
+
+    check("fast: every env frame", fast.envFrames == envPublished);
+    check("slow: fewer env frames than published", slow.envFrames < envPublished);
+    check("slow: socket queue stays short", slow.maxQueue <= 5);
+    check("slow: state interval backs off", slow.maxIntervalMs > 0);
+    check("fast: state interval never backs off", fast.maxIntervalMs == 0);
+    for (SimClient* c : sims) {
+        char what[64];
+        snprintf(what, sizeof(what), "%s: ends on the latest state", c->name);
+        check(what, c->lastEnv == envPublished - 1 && c->lastDoor == doorPublished - 1);
+        snprintf(what, sizeof(what), "%s: every alert, in order", c->name);
+        check(what, c->alertsInOrder && c->nextAlert == alertsPublished + 1);
+    }
+
+    // Fill the remaining slots, one more is refused until a slot frees up
+    std::vector<std::unique_ptr<AsyncWebSocketClient>> extra;
+    bool filled = true;
+    for (uint32_t id = 10; id < 10 + OUTBOX_MAX_CLIENTS - 3; id++) {
+        extra.emplace_back(new AsyncWebSocketClient(id));
+        filled = filled && wsOutboxConnect(extra.back().get());
+    }
+    AsyncWebSocketClient oneTooMany(99);
+    check("clients up to OUTBOX_MAX_CLIENTS accepted", filled);
+    check("one more client refused", !wsOutboxConnect(&oneTooMany));
+    wsOutboxDisconnect(slow.socket.id());
+    check("accepted after a disconnect", wsOutboxConnect(&oneTooMany));
+
+    wsOutboxDisconnect(oneTooMany.id());
+    wsOutboxDisconnect(fast.socket.id());
+    wsOutboxDisconnect(stalled.socket.id());
+    for (auto& c : extra) wsOutboxDisconnect(c->id());
+
+    AsyncWebSocketClient dashboard(100);
+    check("sub:all: full state at most every 500 ms", fullStateGap(dashboard, "all", 10000) >= 500);
+    AsyncWebSocketClient slowEnv(101);
+    check("env=2000 and every state topic: full state >= 2 s apart",
+          fullStateGap(slowEnv, "env=2000,rooms,door,sound", 10000) >= 2000);
+
+    // A dashboard on a link carrying 25 frames/s, flooded with state
+    const uint32_t READ_EVERY_MS = 40;
+    FloodResult fifo = alertFlood(110, READ_EVERY_MS, 0, false);
+    FloodResult lane = alertFlood(111, READ_EVERY_MS, 0, true);
+    FloodResult lossy = alertFlood(112, READ_EVERY_MS, 4, true);
+    printf("\n%-34s %10s %8s %8s %8s\n", "alerts in a state flood", "received", "mean ms", "max ms", "retried");
+    printFlood("one queue, publish order", fifo);
+    printFlood("alert lane", lane);
+    printFlood("alert lane, every 4th copy lost", lossy);
+    printf("\n");
+
+    // An alert waits behind at most STATE_QUEUE_LIMIT (3) state frames
+    long laneBound = 4 * READ_EVERY_MS;
+    check("flood: every alert received, in order",
+          lane.inOrder && std::count(lane.latencyMs.begin(), lane.latencyMs.end(), -1) == 0);
+    check("flood: alert read within 4 frames of the link", maxLatency(lane) >= 0 && maxLatency(lane) <= laneBound);
+    // Behind a full socket queue textAll() drops the alert outright
+    check("flood: faster than one queue in publish order",
+          maxLatency(fifo) < 0 || maxLatency(lane) < maxLatency(fifo));
+    check("flood: all acknowledged, none retried or lost",
+          lane.unacked == 0 && lane.retried == 0 && lane.lost == 0);
+    check("flood: ack time is latency plus the way back",
+          (long)lane.ackMsMax <= maxLatency(lane) + (long)FLOOD_ACK_DELAY_MS + 1);
+    check("lossy: every alert received, in order",
+          lossy.inOrder && std::count(lossy.latencyMs.begin(), lossy.latencyMs.end(), -1) == 0);
+    check("lossy: lost copies sent again, none given up",
+          lossy.retried > 0 && lossy.lost == 0 && lossy.unacked == 0);
+    check("lossy: resent within the first retry time",
+          maxLatency(lossy) <= 1000 + laneBound + (long)FLOOD_ACK_DELAY_MS);
+
+    struct Population {
+        const char* name;
+        std::vector<const char*> specs;
+    };
+    const std::vector<Population> populations = {
+        {"8 dashboards", {"all", "all", "all", "all", "all", "all", "all", "all"}},
+        {"8 wall tablets", std::vector<const char*>(8, "env=60000")},
+        {"4 tablets, 2 consoles, 2 dashboards",
+         {"env=60000", "env=60000", "env=60000", "env=60000", "door,alerts", "door,alerts", "all", "all"}},
+        {"8 different", {"all", "env=60000", "door,alerts", "rooms=1000", "sound", "env,rooms",
+                         "rooms,door,sound,env=5000", "alerts"}},
+    };
+    const uint32_t BENCH_MS = 60000;
+    double serializeNs, encodeNs;
+    unitCosts(&serializeNs, &encodeNs);
+    printf("\none serialize %.0f ns, one encode %.0f ns (host)\n\n", serializeNs, encodeNs);
+    printf("%-36s %25s %25s %7s\n", "population, 1 min", "per client: ser enc us",
+           "grouped: ser enc us", "saved");
+    bool neverMore = true;
+    for (const Population& p : populations) {
+        BenchResult perClient = runPerClient(p.specs, BENCH_MS);
+        BenchResult grouped = runGrouped(p.specs, BENCH_MS);
+        double perClientUs = (perClient.serialized * serializeNs + perClient.encoded * encodeNs) / 1000;
+        double groupedUs = (grouped.serialized * serializeNs + grouped.encoded * encodeNs) / 1000;
+        printf("%-36s %7ld %7ld %9.0f %7ld %7ld %9.0f %6.0f%%\n", p.name,
+               perClient.serialized, perClient.encoded, perClientUs,
+               grouped.serialized, grouped.encoded, groupedUs,
+               perClientUs > 0 ? 100.0 * (1.0 - groupedUs / perClientUs) : 0.0);
+        neverMore = neverMore && grouped.serialized <= perClient.serialized &&
+                    grouped.encoded <= perClient.encoded;
+    }
+    printf("\n");
+    check("grouping never serializes or encodes more", neverMore);
+
+    return failed ? 2 : 0;
+}
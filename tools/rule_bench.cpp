@@ -0,0 +1,156 @@
+// Host benchmark for the compiled rule tables (src/ruleTable.cpp).
+//
+// Checks that hold windows latch whether or not their output is asked for,
+// that hysteresis holds a latched condition inside its band, and that every
+// heat band is evaluated when a higher one matches. Then times a firmware
+// tick (the eight inputs set one after another, each set evaluating every
+// rule) for the built-in rule set and for a full table, and reports the
+// cost per tick and per rule per tick.
+//
+// Build:  g++ -O2 -std=c++17 -Isrc -o rule_bench tools/rule_bench.cpp src/ruleTable.cpp
+// Run:    ./rule_bench
+
+#include "ruleTable.h"
+
+#include <time.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+static bool failed = false;
+
+static void check(const char* name, bool ok) {
+    printf("%-34s %s\n", name, ok ? "ok" : "FAILED");
+    if (!ok) failed = true;
+}
+
+static void addRule(RuleTable& t, uint8_t out, uint8_t in, uint8_t op, float value,
+                    float hyst = 0, uint32_t holdMs = 0) {
+    ruleTableAddRule(t, out, false);
+    ruleTableAddCondition(t, in, op, value, hyst, holdMs);
+}
+
+// Same as defaultRules in src/ruleEngine.cpp
+static void defaultRules(RuleTable& t) {
+    ruleTableClear(t);
+    addRule(t, RULE_OUT_ROOM1_DARK, RULE_IN_LDR, OP_GT, 4000, 50);
+    addRule(t, RULE_OUT_CLAP, RULE_IN_SOUND_RATIO, OP_GT, 0.35f);
+    ruleTableAddRule(t, RULE_OUT_ENV_QUIET, false);
+    ruleTableAddCondition(t, RULE_IN_NOISE_AVG, OP_LT, 15, 0, 0);
+    ruleTableAddCondition(t, RULE_IN_NOISE_VAR, OP_LT, 50, 0, 0);
+    ruleTableAddRule(t, RULE_OUT_ENV_NOISY, true);
+    ruleTableAddCondition(t, RULE_IN_NOISE_AVG, OP_GT, 30, 0, 0);
+    ruleTableAddCondition(t, RULE_IN_NOISE_VAR, OP_GT, 200, 0, 0);
+    addRule(t, RULE_OUT_PRESENCE, RULE_IN_DISTANCE, OP_LE, 10);
+    addRule(t, RULE_OUT_GREET_HOT, RULE_IN_TEMPERATURE, OP_GE, 32);
+    addRule(t, RULE_OUT_GREET_COLD, RULE_IN_TEMPERATURE, OP_LT, 22);
+    addRule(t, RULE_OUT_HEAT_CAUTION, RULE_IN_HEAT_INDEX, OP_GE, 27);
+    addRule(t, RULE_OUT_HEAT_EXTREME_CAUTION, RULE_IN_HEAT_INDEX, OP_GE, 33);
+    addRule(t, RULE_OUT_HEAT_DANGER, RULE_IN_HEAT_INDEX, OP_GE, 42);
+    addRule(t, RULE_OUT_HEAT_EXTREME_DANGER, RULE_IN_HEAT_INDEX, OP_GE, 52);
+    ruleTableFinish(t);
+}
+
+// MAX_RULES rules of two conditions each, spread over every output
+static void fullTable(RuleTable& t) {
+    ruleTableClear(t);
+    for (int i = 0; i < MAX_RULES; i++) {
+        ruleTableAddRule(t, i % RULE_OUTPUT_COUNT, i % 3 == 0);
+        ruleTableAddCondition(t, i % RULE_INPUT_COUNT, OP_GT, 50, 5, 0);
+        ruleTableAddCondition(t, (i + 3) % RULE_INPUT_COUNT, OP_LT, 60, 0, i % 4 == 0 ? 1000 : 0);
+    }
+    ruleTableFinish(t);
+}
+
+static void checks() {
+    RuleTable t;
+
+    // Hold window: pending on the first set, latched by a later set of some
+    // other input, with nothing asking for the output in between
+    ruleTableClear(t);
+    addRule(t, RULE_OUT_GREET_HOT, RULE_IN_TEMPERATURE, OP_GE, 32, 0, 2000);
+    ruleTableFinish(t);
+    ruleTableSetInput(t, RULE_IN_TEMPERATURE, 33, 1000);
+    bool early = ruleTableOutput(t, RULE_OUT_GREET_HOT);
+    ruleTableSetInput(t, RULE_IN_DISTANCE, 50, 2500);
+    bool during = ruleTableOutput(t, RULE_OUT_GREET_HOT);
+    ruleTableSetInput(t, RULE_IN_DISTANCE, 50, 3000);
+    check("hold latches unqueried", !early && !during && ruleTableOutput(t, RULE_OUT_GREET_HOT));
+
+    // Hysteresis: latched above 4000, held down to 3950
+    ruleTableClear(t);
+    addRule(t, RULE_OUT_ROOM1_DARK, RULE_IN_LDR, OP_GT, 4000, 50);
+    ruleTableFinish(t);
+    ruleTableSetInput(t, RULE_IN_LDR, 4001, 0);
+    bool on = ruleTableOutput(t, RULE_OUT_ROOM1_DARK);
+    ruleTableSetInput(t, RULE_IN_LDR, 3960, 10);
+    bool held = ruleTableOutput(t, RULE_OUT_ROOM1_DARK);
+    ruleTableSetInput(t, RULE_IN_LDR, 3949, 20);
+    check("hysteresis band", on && held && !ruleTableOutput(t, RULE_OUT_ROOM1_DARK));
+
+    // Lower bands are current whatever band the caller checks first
+    defaultRules(t);
+    ruleTableSetInput(t, RULE_IN_HEAT_INDEX, 45, 30);
+    check("every heat band evaluated",
+          ruleTableOutput(t, RULE_OUT_HEAT_DANGER) && ruleTableOutput(t, RULE_OUT_HEAT_EXTREME_CAUTION) &&
+          ruleTableOutput(t, RULE_OUT_HEAT_CAUTION) && !ruleTableOutput(t, RULE_OUT_HEAT_EXTREME_DANGER));
+
+    // Unset input: nothing latched
+    ruleTableSetInput(t, RULE_IN_HEAT_INDEX, NAN, 40);
+    check("unset input clears", !ruleTableOutput(t, RULE_OUT_HEAT_CAUTION));
+}
+
+static double nowSec() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// One tick sets every input in turn, values from a random walk around the
+// default thresholds (generated up front so only evaluation is timed)
+static void bench(const char* name, RuleTable& t) {
+    const int TICKS = 2000000;
+    const int WALK = 4096;
+    const float base[RULE_INPUT_COUNT] = {4000, 0.35f, 20, 100, 10, 27, 50, 33};
+    const float spread[RULE_INPUT_COUNT] = {200, 0.3f, 15, 150, 10, 8, 20, 20};
+
+    static float walk[WALK][RULE_INPUT_COUNT];
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> step(-1, 1);
+    for (int i = 0; i < RULE_INPUT_COUNT; i++) {
+        float v = base[i];
+        for (int n = 0; n < WALK; n++) {
+            v += step(rng) * spread[i] * 0.05f;
+            if (v > base[i] + spread[i]) v = base[i] + spread[i];
+            if (v < base[i] - spread[i]) v = base[i] - spread[i];
+            walk[n][i] = v;
+        }
+    }
+
+    uint32_t outputsOn = 0;
+    double start = nowSec();
+    for (int tick = 0; tick < TICKS; tick++) {
+        const float* values = walk[tick % WALK];
+        uint32_t now = tick * 5;
+        for (int i = 0; i < RULE_INPUT_COUNT; i++) ruleTableSetInput(t, i, values[i], now);
+        for (int out = 0; out < RULE_OUTPUT_COUNT; out++) outputsOn += ruleTableOutput(t, out);
+    }
+    double ns = (nowSec() - start) * 1e9 / TICKS;
+
+    printf("%-12s %2d rules %2d conditions  %7.1f ns/tick  %5.2f ns/rule/tick  (%u outputs on)\n",
+           name, t.numRules, t.numConditions, ns, ns / t.numRules, outputsOn);
+}
+
+int main() {
+    checks();
+    printf("\n");
+
+    static RuleTable t;
+    defaultRules(t);
+    bench("built-in", t);
+    fullTable(t);
+    bench("full table", t);
+    return failed ? 2 : 0;
+}
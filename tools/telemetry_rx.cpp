@@ -0,0 +1,349 @@
+// UDP telemetry receiver for the DomusLink firmware (env:esp32dev_telemetry).
+//
+// Listens for the binary sample datagrams described in src/telemetry.h,
+// decodes every sample into a CSV row and tracks packet sequence numbers:
+//   - gaps (packets lost between two received ones)
+//   - packets arriving out of order or twice
+//   - device restarts (sequence jumps back to 0)
+// A summary is printed at the end.
+//
+// With --send it instead emits synthetic packets in the same format, so the
+// decoder and gap detection can be exercised over loopback:
+//   ./telemetry_rx --port 5006 --group none --duration 5 --out rx.csv &
+//   ./telemetry_rx --send 127.0.0.1 --port 5006 --count 200 --skip 17
+//
+// Build:  g++ -O2 -std=c++17 -o telemetry_rx tools/telemetry_rx.cpp
+// Run:    ./telemetry_rx --group 239.10.0.1 --port 5005 --out telemetry.csv
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Wire format (little-endian), must match src/telemetry.cpp
+static const uint32_t MAGIC = 0x31544C44;   // "DLT1"
+static const size_t HEADER_BYTES = 16;
+static const size_t SAMPLE_BYTES = 20;       // fields known to this decoder
+static const size_t PACKET_BYTES = 1400;
+static const uint16_t NONE_U16 = 0xFFFF;
+static const int16_t NAN_I16 = (int16_t)0x8000;
+
+// Sequence numbers further back than this mean the device restarted
+static const uint32_t RESTART_WINDOW = 1000;
+
+struct Options {
+    int port = 5005;
+    std::string group = "239.10.0.1";   // multicast group to join, "none" = unicast only
+    int durationSec = 0;                 // 0 = until interrupted
+    std::string out = "telemetry.csv";
+    // Sender mode
+    std::string sendHost;
+    int count = 100;                     // packets
+    int samples = 20;                    // per packet
+    int intervalMs = 10;
+    int skip = 0;                        // leave out every Nth sequence number
+};
+
+struct Sample {
+    uint32_t timeUs;
+    uint16_t ldr;
+    uint16_t soundAmplitude;
+    uint16_t soundBaseline;
+    uint16_t soundThreshold;
+    uint16_t distanceMm;
+    int16_t temperature;
+    int16_t humidity;
+    uint16_t loopUs;
+};
+
+struct Stats {
+    uint64_t packets = 0;
+    uint64_t samples = 0;
+    uint64_t badPackets = 0;
+    uint64_t gaps = 0;
+    uint64_t lostPackets = 0;
+    uint64_t outOfOrder = 0;
+    uint64_t restarts = 0;
+    bool haveSeq = false;
+    uint32_t nextSeq = 0;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static uint64_t nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = v >> (8 * i);
+}
+
+static Sample decodeSample(const uint8_t* p) {
+    Sample s;
+    s.timeUs = getU32(p);
+    s.ldr = getU16(p + 4);
+    s.soundAmplitude = getU16(p + 6);
+    s.soundBaseline = getU16(p + 8);
+    s.soundThreshold = getU16(p + 10);
+    s.distanceMm = getU16(p + 12);
+    s.temperature = (int16_t)getU16(p + 14);
+    s.humidity = (int16_t)getU16(p + 16);
+    s.loopUs = getU16(p + 18);
+    return s;
+}
+
+static void encodeSample(uint8_t* p, const Sample& s) {
+    putU32(p, s.timeUs);
+    putU16(p + 4, s.ldr);
+    putU16(p + 6, s.soundAmplitude);
+    putU16(p + 8, s.soundBaseline);
+    putU16(p + 10, s.soundThreshold);
+    putU16(p + 12, s.distanceMm);
+    putU16(p + 14, (uint16_t)s.temperature);
+    putU16(p + 16, (uint16_t)s.humidity);
+    putU16(p + 18, s.loopUs);
+}
+
+// Missing values are written as empty cells
+static void writeTenths(FILE* f, int16_t v) {
+    if (v == NAN_I16) fputc(',', f);
+    else fprintf(f, ",%.1f", v / 10.0);
+}
+
+static void writeRow(FILE* f, uint32_t seq, const Sample& s) {
+    fprintf(f, "%u,%u,%u,%u,%u,%u", seq, s.timeUs, s.ldr, s.soundAmplitude,
+            s.soundBaseline, s.soundThreshold);
+    if (s.distanceMm == NONE_U16) fputc(',', f);
+    else fprintf(f, ",%.1f", s.distanceMm / 10.0);
+    writeTenths(f, s.temperature);
+    writeTenths(f, s.humidity);
+    fprintf(f, ",%u\n", s.loopUs);
+}
+
+static void trackSequence(Stats& stats, uint32_t seq) {
+    if (!stats.haveSeq) {
+        stats.haveSeq = true;
+    } else if (seq > stats.nextSeq) {
+        uint32_t missing = seq - stats.nextSeq;
+        stats.gaps++;
+        stats.lostPackets += missing;
+        fprintf(stderr, "gap: %u packet(s) missing before seq %u\n", missing, seq);
+    } else if (seq < stats.nextSeq) {
+        if (stats.nextSeq - seq > RESTART_WINDOW || seq == 0) {
+            stats.restarts++;
+            fprintf(stderr, "restart: seq went back to %u\n", seq);
+        } else {
+            stats.outOfOrder++;
+            return;
+        }
+    }
+    stats.nextSeq = seq + 1;
+}
+
+// Returns false for a datagram that is not a valid telemetry packet
+static bool handlePacket(const uint8_t* buf, size_t len, FILE* csv, Stats& stats) {
+    if (len < HEADER_BYTES || getU32(buf) != MAGIC) return false;
+    uint32_t seq = getU32(buf + 4);
+    uint16_t count = getU16(buf + 12);
+    uint16_t sampleBytes = getU16(buf + 14);
+    // Newer firmware may append fields, only the known prefix is decoded
+    if (sampleBytes < SAMPLE_BYTES || HEADER_BYTES + (size_t)count * sampleBytes != len) return false;
+
+    trackSequence(stats, seq);
+    for (uint16_t i = 0; i < count; i++) {
+        writeRow(csv, seq, decodeSample(buf + HEADER_BYTES + (size_t)i * sampleBytes));
+    }
+    stats.packets++;
+    stats.samples += count;
+    return true;
+}
+
+static int receivePackets(const Options& opt) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 2;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    int rcvbuf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return 2;
+    }
+
+    if (opt.group != "none") {
+        ip_mreq mreq{};
+        if (inet_pton(AF_INET, opt.group.c_str(), &mreq.imr_multiaddr) != 1) {
+            fprintf(stderr, "bad multicast group %s\n", opt.group.c_str());
+            close(fd);
+            return 2;
+        }
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            perror("IP_ADD_MEMBERSHIP");
+        }
+    }
+
+    FILE* csv = opt.out == "-" ? stdout : fopen(opt.out.c_str(), "w");
+    if (!csv) {
+        fprintf(stderr, "cannot write %s\n", opt.out.c_str());
+        close(fd);
+        return 2;
+    }
+    fprintf(csv, "seq,timeUs,ldr,soundAmplitude,soundBaseline,soundThreshold,"
+                 "distanceCm,temperature,humidity,loopUs\n");
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    Stats stats;
+    uint64_t start = nowUs();
+    uint64_t end = opt.durationSec > 0 ? start + (uint64_t)opt.durationSec * 1000000ULL : 0;
+    uint8_t buf[2048];
+
+    while (!stopRequested && (end == 0 || nowUs() < end)) {
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) continue;
+        if (!handlePacket(buf, (size_t)n, csv, stats)) stats.badPackets++;
+    }
+
+    if (csv != stdout) fclose(csv);
+    close(fd);
+
+    double seconds = (nowUs() - start) / 1e6;
+    uint64_t expected = stats.packets + stats.lostPackets;
+    printf("packets %llu, samples %llu (%.0f/s), bad %llu\n",
+           (unsigned long long)stats.packets, (unsigned long long)stats.samples,
+           seconds > 0 ? stats.samples / seconds : 0.0, (unsigned long long)stats.badPackets);
+    printf("gaps %llu, lost %llu (%.2f%%), out of order %llu, restarts %llu\n",
+           (unsigned long long)stats.gaps, (unsigned long long)stats.lostPackets,
+           expected ? stats.lostPackets * 100.0 / expected : 0.0,
+           (unsigned long long)stats.outOfOrder, (unsigned long long)stats.restarts);
+    return 0;
+}
+
+// Synthetic packets in the firmware format, skipping every Nth sequence number
+static int sendSynthetic(const Options& opt) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 2;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    if (inet_pton(AF_INET, opt.sendHost.c_str(), &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad host %s\n", opt.sendHost.c_str());
+        close(fd);
+        return 2;
+    }
+
+    uint8_t buf[PACKET_BYTES];
+    uint32_t timeUs = 0;
+    int sent = 0, skipped = 0;
+    for (int seq = 0; seq < opt.count; seq++) {
+        if (opt.skip > 0 && seq % opt.skip == opt.skip - 1) {
+            skipped++;
+            continue;
+        }
+        putU32(buf, MAGIC);
+        putU32(buf + 4, seq);
+        putU32(buf + 8, timeUs);
+        putU16(buf + 12, opt.samples);
+        putU16(buf + 14, SAMPLE_BYTES);
+        for (int i = 0; i < opt.samples; i++) {
+            Sample s;
+            s.timeUs = timeUs;
+            s.ldr = 2000 + (int)(1000 * sin(timeUs / 1e6));
+            s.soundAmplitude = (seq + i) % 40;
+            s.soundBaseline = 12;
+            s.soundThreshold = 47;
+            s.distanceMm = i % 10 == 0 ? NONE_U16 : 250 + i;
+            s.temperature = 231;
+            s.humidity = i % 10 == 0 ? NAN_I16 : 455;
+            s.loopUs = 800 + i;
+            encodeSample(buf + HEADER_BYTES + (size_t)i * SAMPLE_BYTES, s);
+            timeUs += 1000;
+        }
+        size_t len = HEADER_BYTES + (size_t)opt.samples * SAMPLE_BYTES;
+        if (sendto(fd, buf, len, 0, (sockaddr*)&addr, sizeof(addr)) == (ssize_t)len) sent++;
+        usleep(opt.intervalMs * 1000);
+    }
+    close(fd);
+    printf("sent %d packets, skipped %d sequence numbers\n", sent, skipped);
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--port P] [--group IP|none] [--duration S] [--out FILE|-]\n", prog);
+    fprintf(stderr, "       %s --send HOST [--port P] [--count N] [--samples N] [--interval MS] [--skip N]\n", prog);
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* v = argv[++i];
+        if (a == "--port") opt.port = atoi(v);
+        else if (a == "--group") opt.group = v;
+        else if (a == "--duration") opt.durationSec = atoi(v);
+        else if (a == "--out") opt.out = v;
+        else if (a == "--send") opt.sendHost = v;
+        else if (a == "--count") opt.count = atoi(v);
+        else if (a == "--samples") opt.samples = atoi(v);
+        else if (a == "--interval") opt.intervalMs = atoi(v);
+        else if (a == "--skip") opt.skip = atoi(v);
+        else return false;
+    }
+    size_t maxSamples = (PACKET_BYTES - HEADER_BYTES) / SAMPLE_BYTES;
+    return opt.port > 0 && opt.durationSec >= 0 && opt.samples > 0 &&
+           (size_t)opt.samples <= maxSamples;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+    return opt.sendHost.empty() ? receivePackets(opt) : sendSynthetic(opt);
+}
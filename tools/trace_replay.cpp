@@ -0,0 +1,486 @@
+// Host check of sensor trace recording and replay (src/sensorTrace.cpp)
+// against a golden log.
+//
+// Builds the trace modules with the real door logic and edge capture
+// (src/doorSystem.cpp, src/gpioEdges.cpp), plus a pass of room-style reads
+// kept here: the LDR oversampled 8 times per pass, the ultrasonic sensor
+// every 100 ms, the DHT every 2 s and a rooms frame every 500 ms. A 25 s
+// scenario on a simulated clock (bouncing button presses, a held touch
+// re-armed when the LEDs go out, three short touches, WebSocket commands,
+// clients coming and going) is recorded through the HAL, streamed to the
+// mocked LittleFS and replayed. Checks:
+//   - the trace is many times the RAM ring, nothing is dropped, and it has
+//     one snapshot, as its first record
+//   - the outputs of the live run (pin writes other than the trig pulses,
+//     and frames) match tools/trace_replay.golden line for line
+//   - replaying the file reproduces every recorded output and leaves the
+//     live control state alone
+//   - an input record changed in the file desyncs the replay, an output
+//     record changed in it is one mismatch
+//   - a stream that falls behind, or a full file, ends the trace at the
+//     last record before the gap
+//
+// Build:  g++ -O2 -std=c++17 -Itools/mock -Isrc -o trace_replay tools/trace_replay.cpp src/sensorTrace.cpp src/hal.cpp src/controlState.cpp src/doorSystem.cpp src/gpioEdges.cpp
+// Run:    ./trace_replay [--update]   (from the repository root; --update
+//         rewrites the golden log from this run)
+
+#include "sensorTrace.h"
+#include "controlState.h"
+#include "doorSystem.h"
+#include "hal.h"
+#include "latencyTrace.h"
+#include <LittleFS.h>
+#include <soc/gpio_reg.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+const char* GOLDEN_PATH = "tools/trace_replay.golden";
+const unsigned long SCENARIO_MS = 25000;
+
+// Same pins as src/roomSystem_1.cpp, src/roomSystem_3.cpp and src/doorSystem.cpp
+const uint8_t LDR_PIN = 34;
+const uint8_t LIGHT_PIN = 25;
+const uint8_t TRIG_PIN = 19;
+const uint8_t ECHO_PIN = 18;
+const uint8_t BUTTON_PIN = 13;
+const uint8_t TOUCH1_PIN = 2;
+const uint8_t TOUCH2_PIN = 4;
+const uint8_t ACCESS_LED_PIN = 14;
+
+static unsigned long simUs = 0;
+uint32_t mockGpioIn[2];
+
+// Inputs come from a fixed-seed generator, so every run is the same
+static uint32_t rng = 12345;
+static uint32_t nextRandom() {
+    rng = rng * 1103515245u + 12345u;
+    return rng >> 8;
+}
+
+// Outputs of the live run, compared with the golden log
+static std::vector<std::string> outputLog;
+
+static void logOutput(const char* fmt, const char* what, unsigned long a, const char* b) {
+    char line[160];
+    snprintf(line, sizeof(line), fmt, simUs / 1000, what, a, b);
+    outputLog.push_back(line);
+}
+
+// --- Arduino and hardware mock ---
+
+unsigned long millis() {
+    return simUs / 1000;
+}
+unsigned long micros() {
+    return simUs;
+}
+void delay(unsigned long ms) {
+    simUs += ms * 1000;
+}
+void delayMicroseconds(unsigned int us) {
+    simUs += us;
+}
+
+static void (*isr[40])(void*);
+static void* isrArg[40];
+
+void pinMode(uint8_t, uint8_t) {
+}
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int) {
+    isr[pin] = handler;
+    isrArg[pin] = arg;
+}
+int digitalRead(uint8_t pin) {
+    return (mockGpioIn[pin / 32] >> (pin & 31)) & 1;
+}
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin != TRIG_PIN) logOutput("%8lu %s %lu%s", "pin", pin * 10 + value, "");
+}
+
+// LDR drifts through dark and light twice a scenario, with read noise
+int analogRead(uint8_t) {
+    long phase = (long)(simUs / 1000) % 12500;
+    long level = phase < 6250 ? 1000 + phase / 5 : 2250 - (phase - 6250) / 5;
+    return level + (long)(nextRandom() % 81) - 40;
+}
+
+// The echo takes as long as it measures
+unsigned long pulseIn(uint8_t, uint8_t, unsigned long) {
+    unsigned long us = 1200 + nextRandom() % 1200;
+    simUs += us;
+    return us;
+}
+
+// --- Stand-ins for the modules not built here ---
+
+void spanBegin(SpanEvent, unsigned long, uint8_t) {
+}
+void spanState() {
+}
+uint16_t spanFrame(FrameClass) {
+    return 0;
+}
+void latencyBeginReplay() {
+}
+
+// Three of four frames find a subscriber due
+bool frameDue(FrameClass) {
+    static unsigned calls = 0;
+    return ++calls % 4 != 0;
+}
+void publishFrame(FrameClass cls, const char* json, uint16_t) {
+    logOutput("%8lu %s %lu %s", "frame", cls, json);
+}
+
+// --- One control pass, as controlTick() ---
+
+static DHT dht;
+static AsyncWebSocket ws;
+
+static unsigned long lastDHT = 0;
+static unsigned long lastEcho = 0;
+static unsigned long lastFrame = 0;
+static float temperature = NAN;
+static float humidity = NAN;
+static bool lightOn = false;
+static unsigned long distanceCm = 0;
+
+static void tick() {
+    halBeginTick();
+    unsigned long now = halMillis();
+
+    if (now - lastDHT >= 2000) {
+        lastDHT = now;
+        halReadDHT(dht, &humidity, &temperature);
+    }
+
+    long sum = 0;
+    for (int i = 0; i < 8; i++) sum += halAnalogRead(LDR_PIN);
+    bool dark = sum / 8 < (lightOn ? 1700 : 1500);
+    if (dark != lightOn) {
+        lightOn = dark;
+        halDigitalWrite(LIGHT_PIN, dark ? HIGH : LOW);
+    }
+
+    if (now - lastEcho >= 100) {
+        lastEcho = now;
+        halDigitalWrite(TRIG_PIN, HIGH);
+        halDelayMicroseconds(10);
+        halDigitalWrite(TRIG_PIN, LOW);
+        distanceCm = halPulseIn(ECHO_PIN, HIGH, 30000) / 58;
+    }
+
+    startDoor(ws);
+
+    if (halClientCount(ws) > 0 && now - lastFrame >= 500) {
+        lastFrame = now;
+        if (halFrameDue(FRAME_ROOMS)) {
+            char json[96];
+            snprintf(json, sizeof(json), "{\"light\":\"%s\",\"distance\":%lu,\"temperature\":%.1f}",
+                     lightOn ? "ON" : "OFF", distanceCm, temperature);
+            halTextAll(ws, json, FRAME_ROOMS);
+        }
+    }
+}
+
+static void handleCommand(const char* msg) {
+    if (strcmp(msg, "door:unlock") == 0) unlockDoor(ws);
+    else if (strcmp(msg, "door:lock") == 0) lockDoor(ws);
+}
+
+static void runCommand(const char* msg) {
+    halCommand(msg);
+    handleCommand(msg);
+}
+
+// --- Scenario ---
+
+struct Step {
+    unsigned long ms;
+    uint8_t pin;            // an edge on this pin, or 0
+    bool level;
+    const char* command;    // or a command, or
+    int clients;            // a new client count (-1: none)
+};
+
+static std::vector<Step> steps;
+
+static void edge(unsigned long ms, uint8_t pin, bool level) {
+    steps.push_back({ms, pin, level, nullptr, -1});
+}
+
+// A press that bounces for a few hundred microseconds each way
+static void press(unsigned long ms, uint8_t pin, unsigned long holdMs) {
+    edge(ms, pin, true);
+    edge(ms, pin, false);
+    edge(ms, pin, true);
+    edge(ms + holdMs, pin, false);
+    edge(ms + holdMs, pin, true);
+    edge(ms + holdMs, pin, false);
+}
+
+static void touch(unsigned long ms, unsigned long holdMs) {
+    press(ms, TOUCH1_PIN, holdMs);
+    press(ms + 40, TOUCH2_PIN, holdMs - 80);
+}
+
+static void buildScenario() {
+    steps.push_back({200, 0, false, nullptr, 1});
+    press(1000, BUTTON_PIN, 150);                   // unlock
+    press(3000, BUTTON_PIN, 120);                   // lock
+    steps.push_back({4000, 0, false, "door:unlock", -1});
+    steps.push_back({5000, 0, false, "door:lock", -1});
+    steps.push_back({8000, 0, false, nullptr, 2});
+    touch(6000, 7000);                              // held past the LEDs going out
+    steps.push_back({15000, 0, false, nullptr, 1});
+    touch(17500, 1000);                             // three short touches
+    touch(19000, 1000);
+    touch(20500, 1000);
+    steps.push_back({23000, 0, false, "door:unlock", -1});
+
+    // Bounces 300 us apart
+    std::stable_sort(steps.begin(), steps.end(), [](const Step& a, const Step& b) { return a.ms < b.ms; });
+    unsigned long lastMs = 0;
+    int bounce = 0;
+    for (Step& s : steps) {
+        bounce = s.ms == lastMs ? bounce + 1 : 0;
+        lastMs = s.ms;
+        s.ms = s.ms * 1000 + bounce * 300;
+    }
+}
+
+static size_t nextStep = 0;
+
+// Edges interrupt whatever the loop was doing, at their own time
+static void runSteps() {
+    while (nextStep < steps.size() && steps[nextStep].ms <= simUs) {
+        const Step& s = steps[nextStep++];
+        if (s.pin) {
+            unsigned long now = simUs;
+            simUs = s.ms;
+            if (s.level) mockGpioIn[s.pin / 32] |= 1u << (s.pin & 31);
+            else mockGpioIn[s.pin / 32] &= ~(1u << (s.pin & 31));
+            isr[s.pin](isrArg[s.pin]);
+            simUs = now;
+        } else if (s.command) {
+            runCommand(s.command);
+        } else {
+            ws.clients = s.clients;
+            halClientsChanged(ws);
+        }
+    }
+}
+
+// One loop(): trace actions, commands, the control pass, then the rest of
+// the loop (LCD, web server, outbox) and its delay(1), 5 to 15 ms
+static void loopPass() {
+    startTrace(tick);
+    runSteps();
+    tick();
+    simUs += 5000 + nextRandom() % 10000;
+}
+
+// --- Trace file ---
+
+static std::vector<uint8_t>& traceFile() {
+    return LittleFS.files["/trace.bin"];
+}
+
+static size_t traceRecords() {
+    return traceFile().size() / sizeof(TraceRecord);
+}
+
+static TraceRecord recordAt(size_t i) {
+    TraceRecord rec;
+    memcpy(&rec, traceFile().data() + i * sizeof(TraceRecord), sizeof(rec));
+    return rec;
+}
+
+static void setRecord(size_t i, const TraceRecord& rec) {
+    memcpy(traceFile().data() + i * sizeof(TraceRecord), &rec, sizeof(rec));
+}
+
+static size_t countType(uint8_t type) {
+    size_t n = 0;
+    for (size_t i = 0; i < traceRecords(); i++) {
+        if (recordAt(i).type == type) n++;
+    }
+    return n;
+}
+
+// The nth record of a type (and pin, unless 0xFF)
+static size_t findRecord(uint8_t type, uint8_t pin, size_t nth) {
+    for (size_t i = 0; i < traceRecords(); i++) {
+        TraceRecord rec = recordAt(i);
+        if (rec.type == type && (pin == 0xFF || rec.pin == pin) && nth-- == 0) return i;
+    }
+    return traceRecords();
+}
+
+// --- Stats ---
+
+static long field(const char* key) {
+    std::string json = traceStatsJson().c_str();
+    size_t at = json.find(std::string("\"") + key + "\":");
+    if (at == std::string::npos) return -1;
+    return atol(json.c_str() + at + strlen(key) + 3);
+}
+
+static bool has(const std::string& text) {
+    return std::string(traceStatsJson().c_str()).find(text) != std::string::npos;
+}
+
+static bool replayResultIs(const char* result) {
+    return has(std::string("\"result\":\"") + result + "\"");
+}
+
+// Replay the file from the loop until it finishes; only trace actions run,
+// so the live state has no reason to change
+static void replay() {
+    requestTraceAction(TRACE_ACTION_REPLAY);
+    startTrace(tick);
+    for (int i = 0; i < 1000 && replayResultIs("running"); i++) {
+        simUs += 1000;
+        startTrace(tick);
+    }
+}
+
+static bool failed = false;
+
+static void check(const char* name, bool ok) {
+    printf("%-56s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok) {
+        failed = true;
+        printf("    %s\n", traceStatsJson().c_str());
+    }
+}
+
+// --- Golden log ---
+
+static bool matchesGolden(bool update) {
+    if (update) {
+        std::ofstream out(GOLDEN_PATH);
+        for (const std::string& line : outputLog) out << line << "\n";
+        printf("wrote %zu lines to %s\n", outputLog.size(), GOLDEN_PATH);
+        return (bool)out;
+    }
+
+    std::ifstream in(GOLDEN_PATH);
+    if (!in) {
+        printf("    cannot read %s (run from the repository root)\n", GOLDEN_PATH);
+        return false;
+    }
+    std::vector<std::string> golden;
+    for (std::string line; std::getline(in, line);) golden.push_back(line);
+
+    for (size_t i = 0; i < golden.size() || i < outputLog.size(); i++) {
+        const char* want = i < golden.size() ? golden[i].c_str() : "(end)";
+        const char* got = i < outputLog.size() ? outputLog[i].c_str() : "(end)";
+        if (strcmp(want, got) != 0) {
+            printf("    line %zu: golden  %s\n    line %zu: this run %s\n", i + 1, want, i + 1, got);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool update = argc > 1 && strcmp(argv[1], "--update") == 0;
+
+    dht.humidity = 45.0f;
+    dht.temperature = 22.5f;
+    setHal();
+    setDoorPins();
+    keepControlState(lastDHT);
+    keepControlState(lastEcho);
+    keepControlState(lastFrame);
+    keepControlState(temperature);
+    keepControlState(humidity);
+    keepControlState(lightOn);
+    keepControlState(distanceCm);
+    setTraceCommandHandler(handleCommand);
+    buildScenario();
+    outputLog.clear();
+
+    // Record the scenario
+    simUs = 100000;
+    requestTraceAction(TRACE_ACTION_START);
+    while (simUs < SCENARIO_MS * 1000) loopPass();
+    requestTraceAction(TRACE_ACTION_STOP);
+    startTrace(tick);
+
+    printf("%zu records, %lu ms, %zu outputs logged\n", traceRecords(), simUs / 1000, outputLog.size());
+    check("recording: trace is over 4 RAM rings long",
+          field("records") == (long)traceRecords() && field("records") > 4 * field("ringRecords"));
+    check("recording: nothing dropped", field("dropped") == 0 && field("waiting") == 0);
+    check("recording: one snapshot, as the first record",
+          countType(TRACE_STATE) == 1 && recordAt(0).type == TRACE_STATE);
+    check("recording: outputs match the golden log", matchesGolden(update));
+
+    // Replay it
+    size_t stateSize = controlStateSize();
+    std::vector<uint8_t> before(stateSize), after(stateSize);
+    saveControlState(before.data());
+    size_t logged = outputLog.size();
+    size_t outputs = countType(TRACE_PIN_OUT) + countType(TRACE_FRAME);
+
+    replay();
+    saveControlState(after.data());
+    check("replay: passes", replayResultIs("pass") && has("\"desync\":false"));
+    check("replay: every recorded output matched",
+          field("matched") == (long)outputs && field("mismatched") == 0 &&
+          field("missing") == 0 && field("extra") == 0);
+    check("replay: covers the whole scenario", field("traceMs") > (long)SCENARIO_MS - 500);
+    check("replay: live control state untouched", before == after);
+    check("replay: nothing reaches the pins or clients", outputLog.size() == logged);
+
+    // An input that is not what the code reads
+    size_t analog = findRecord(TRACE_ANALOG, LDR_PIN, 5000);
+    TraceRecord saved = recordAt(analog);
+    TraceRecord changed = saved;
+    changed.pin = LDR_PIN + 1;
+    setRecord(analog, changed);
+    replay();
+    check("changed input: replay stops on a desync", replayResultIs("diff") && has("\"desync\":true"));
+    setRecord(analog, saved);
+
+    // An output the code does not produce
+    size_t led = findRecord(TRACE_PIN_OUT, ACCESS_LED_PIN, 1);
+    saved = recordAt(led);
+    changed = saved;
+    changed.value = !changed.value;
+    setRecord(led, changed);
+    replay();
+    check("changed output: one mismatch, the rest matched",
+          replayResultIs("diff") && has("\"desync\":false") && field("mismatched") == 1 &&
+          field("matched") == (long)outputs - 1);
+    setRecord(led, saved);
+
+    // More records than the ring holds between two loop passes
+    requestTraceAction(TRACE_ACTION_START);
+    startTrace(tick);
+    for (int i = 0; i < 3000; i++) traceRecord(TRACE_ANALOG, LDR_PIN, i);
+    check("stream behind: records past the ring are dropped", field("dropped") > 0);
+    startTrace(tick);
+    check("stream behind: trace ends at the last record kept",
+          has("\"recording\":false") && traceRecords() == (size_t)field("ringRecords") &&
+          recordAt(0).type == TRACE_STATE);
+
+    // More than the file holds, streamed in time
+    requestTraceAction(TRACE_ACTION_START);
+    startTrace(tick);
+    for (long i = 0; i < field("fileRecords") + 1000 && has("\"recording\":true"); i++) {
+        traceRecord(TRACE_ANALOG, LDR_PIN, i);
+        if (i % 1000 == 0) startTrace(tick);
+    }
+    startTrace(tick);
+    check("file full: trace ends at the longest kept",
+          has("\"recording\":false") && traceRecords() == (size_t)field("fileRecords") &&
+          recordAt(0).type == TRACE_STATE);
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,562 @@
+// WebSocket load generator for the DomusLink dashboard server.
+//
+// Opens many concurrent WebSocket connections to /ws, replays a dashboard-like
+// command mix and measures:
+//   - room broadcast cadence (expected every 500 ms) and how late frames arrive
+//   - command-to-state-echo latency (room1/room2/door/getReadings)
+//   - server free heap and loop time sampled from GET /status
+// With --flood, extra connections send commands as fast as --flood-rate
+// without waiting for echoes, to check that the per-client rate limit keeps
+// the loop time and the other clients' cadence stable.
+// Alerts are acknowledged like the dashboard does ("ack:<boot>:<seq>"); the
+// report has the unlockDoor-to-"Access Granted" alert latency under the
+// state traffic, plus repeated (retransmitted) and missing alerts.
+// Results are written as JSON so runs can be compared.
+//
+// Limits: the device tracks at most 8 WebSocket clients (OUTBOX_MAX_CLIENTS
+// in src/wsOutbox.h, more are refused with "too many clients") and its soft
+// AP takes about 4 stations, so this is a test of a handful of dashboards,
+// not of scaling. Run it from one machine, keep --clients plus --flood at 8
+// or less and leave a slot for a browser if one is open. How the outbox
+// copes with slow consumers is checked on the host by tools/outbox_sim.cpp.
+//
+// Build:  g++ -O2 -std=c++17 -o wsload tools/wsload.cpp
+// Run:    ./wsload --host 192.168.4.1 --clients 6 --duration 60 --out report.json
+//         ./wsload --clients 4 --flood 2 --flood-rate 200 --duration 60
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static const uint64_t ROOM_BROADCAST_MS = 500;
+static const uint64_t ECHO_TIMEOUT_MS = 5000;
+static const uint64_t STATUS_INTERVAL_MS = 2000;
+// WebSocket clients the device keeps (OUTBOX_MAX_CLIENTS)
+static const int DEVICE_MAX_CLIENTS = 8;
+
+struct Options {
+    std::string host = "192.168.4.1";
+    int port = 80;
+    int clients = 6;               // two slots left for browsers
+    int durationSec = 30;
+    double commandsPerSec = 0.5;   // per client
+    int rampMs = 20;               // delay between connection attempts
+    int flood = 0;                 // abusive connections (on top of --clients)
+    double floodRate = 100;        // commands per second per flood connection
+    std::string out = "wsload-report.json";
+};
+
+static uint64_t nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// A command and the text that marks its state echo in a frame
+struct Command {
+    const char* text;
+    const char* echo;
+    const char* kind;
+    int weight;
+};
+
+static const Command COMMANDS[] = {
+    {"room1:ON",    "\"room1Mode\":\"MANUAL\"", "room1", 15},
+    {"room1:AUTO",  "\"room1Mode\":\"AUTO\"",   "room1", 15},
+    {"room2:ON",    "\"room2Mode\":\"MANUAL\"", "room2", 15},
+    {"room2:AUTO",  "\"room2Mode\":\"AUTO\"",   "room2", 15},
+    {"unlockDoor",  "\"door\":\"UNLOCKED\"",    "door",  5},
+    {"lockDoor",    "\"door\":\"LOCKED\"",      "door",  5},
+    {"getReadings", "\"temperature\"",          "getReadings", 30},
+};
+static const int COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+enum ConnState { CONN_CONNECTING, CONN_HANDSHAKE, CONN_OPEN, CONN_CLOSED };
+
+struct Conn {
+    int fd = -1;
+    ConnState state = CONN_CLOSED;
+    std::string in;
+    std::string out;
+    uint64_t lastRoomFrameUs = 0;
+    int pending = -1;             // index into COMMANDS awaiting its echo
+    uint64_t pendingSinceUs = 0;
+    uint64_t nextCommandUs = 0;
+    bool flood = false;
+    uint64_t unlockSentUs = 0;    // waiting for its "Access Granted" alert
+    long alertBoot = -1;
+    long lastAlertSeq = 0;
+};
+
+struct Stats {
+    int connected = 0;
+    int connectFailures = 0;
+    int disconnects = 0;
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t commandsSent = 0;
+    uint64_t echoTimeouts = 0;
+    std::vector<double> roomIntervalMs;
+    std::vector<double> roomLatenessMs;
+    std::vector<double> echoMs[COMMAND_COUNT];
+    long heapBefore = -1;
+    long heapMin = -1;
+    std::vector<double> loopUs;
+    std::vector<double> loopUsMax;
+    uint64_t floodCommands = 0;
+    uint64_t floodRefusals = 0;
+    uint64_t alerts = 0;
+    uint64_t alertRepeats = 0;
+    uint64_t alertsMissing = 0;
+    std::vector<double> alertMs;
+};
+
+static int openSocket(const Options& opt, bool nonBlocking) {
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char port[16];
+    snprintf(port, sizeof(port), "%d", opt.port);
+    if (getaddrinfo(opt.host.c_str(), port, &hints, &res) != 0 || !res) return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (nonBlocking) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    int rc = connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Masked client text frame
+static void appendFrame(std::string& out, uint8_t opcode, const std::string& payload, std::mt19937& rng) {
+    out.push_back((char)(0x80 | opcode));
+    size_t len = payload.size();
+    if (len < 126) {
+        out.push_back((char)(0x80 | len));
+    } else {
+        out.push_back((char)(0x80 | 126));
+        out.push_back((char)(len >> 8));
+        out.push_back((char)(len & 0xFF));
+    }
+    uint8_t mask[4];
+    for (int i = 0; i < 4; i++) mask[i] = rng() & 0xFF;
+    out.append((const char*)mask, 4);
+    for (size_t i = 0; i < len; i++) out.push_back(payload[i] ^ mask[i % 4]);
+}
+
+static void closeConn(Conn& c, Stats& stats) {
+    if (c.fd >= 0) close(c.fd);
+    if (c.state == CONN_OPEN) stats.disconnects++;
+    c.fd = -1;
+    c.state = CONN_CLOSED;
+}
+
+static long jsonNumber(const std::string& json, const char* key);
+
+// Sequence check and cumulative ack, like the dashboard
+static void onAlert(Conn& c, const std::string& text, uint64_t now, Stats& stats, std::mt19937& rng) {
+    long seq = jsonNumber(text, "alertSeq");
+    long boot = jsonNumber(text, "boot");
+    if (boot != c.alertBoot) {
+        c.alertBoot = boot;
+        c.lastAlertSeq = seq - 1;
+    }
+    if (seq <= c.lastAlertSeq) {
+        stats.alertRepeats++;
+    } else {
+        stats.alerts++;
+        stats.alertsMissing += seq - c.lastAlertSeq - 1;
+        c.lastAlertSeq = seq;
+        if (c.unlockSentUs && text.find("Access Granted") != std::string::npos) {
+            stats.alertMs.push_back((now - c.unlockSentUs) / 1000.0);
+            c.unlockSentUs = 0;
+        }
+    }
+    appendFrame(c.out, 0x1, "ack:" + std::to_string(c.alertBoot) + ":" + std::to_string(c.lastAlertSeq), rng);
+}
+
+static void onText(Conn& c, const std::string& text, uint64_t now, Stats& stats, std::mt19937& rng) {
+    stats.frames++;
+
+    // Flood connections only count how often they were refused
+    if (c.flood) {
+        if (text.find("\"error\"") != std::string::npos) stats.floodRefusals++;
+        return;
+    }
+
+    if (text.find("\"alertSeq\"") != std::string::npos) {
+        onAlert(c, text, now, stats, rng);
+        return;
+    }
+
+    // The 500 ms room frame has room state but no readings
+    bool roomFrame = text.find("\"room1\"") != std::string::npos &&
+                     text.find("\"temperature\"") == std::string::npos;
+    if (roomFrame) {
+        if (c.lastRoomFrameUs) {
+            double interval = (now - c.lastRoomFrameUs) / 1000.0;
+            stats.roomIntervalMs.push_back(interval);
+            stats.roomLatenessMs.push_back(std::max(0.0, interval - ROOM_BROADCAST_MS));
+        }
+        c.lastRoomFrameUs = now;
+    }
+
+    if (c.pending >= 0 && text.find(COMMANDS[c.pending].echo) != std::string::npos) {
+        stats.echoMs[c.pending].push_back((now - c.pendingSinceUs) / 1000.0);
+        c.pending = -1;
+    }
+}
+
+// Parse complete server frames out of the input buffer
+static void parseFrames(Conn& c, uint64_t now, Stats& stats, std::mt19937& rng) {
+    for (;;) {
+        if (c.in.size() < 2) return;
+        const uint8_t* p = (const uint8_t*)c.in.data();
+        uint8_t opcode = p[0] & 0x0F;
+        uint64_t len = p[1] & 0x7F;
+        size_t header = 2;
+        if (len == 126) {
+            if (c.in.size() < 4) return;
+            len = (p[2] << 8) | p[3];
+            header = 4;
+        } else if (len == 127) {
+            if (c.in.size() < 10) return;
+            len = 0;
+            for (int i = 0; i < 8; i++) len = (len << 8) | p[2 + i];
+            header = 10;
+        }
+        if (c.in.size() < header + len) return;
+
+        std::string payload = c.in.substr(header, len);
+        c.in.erase(0, header + len);
+
+        if (opcode == 0x1) onText(c, payload, now, stats, rng);
+        else if (opcode == 0x9) appendFrame(c.out, 0xA, payload, rng);
+        else if (opcode == 0x8) {
+            closeConn(c, stats);
+            return;
+        }
+    }
+}
+
+static void onReadable(Conn& c, uint64_t now, Stats& stats, std::mt19937& rng) {
+    char buf[4096];
+    for (;;) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            stats.bytes += n;
+            c.in.append(buf, n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            closeConn(c, stats);
+            return;
+        }
+        break;
+    }
+
+    if (c.state == CONN_HANDSHAKE) {
+        size_t end = c.in.find("\r\n\r\n");
+        if (end == std::string::npos) return;
+        if (c.in.compare(0, 12, "HTTP/1.1 101") != 0) {
+            stats.connectFailures++;
+            c.state = CONN_CLOSED;
+            close(c.fd);
+            c.fd = -1;
+            return;
+        }
+        c.in.erase(0, end + 4);
+        c.state = CONN_OPEN;
+        stats.connected++;
+        // Turns on alert retransmission for this connection
+        if (!c.flood) appendFrame(c.out, 0x1, "ack:0:0", rng);
+    }
+    if (c.state == CONN_OPEN) parseFrames(c, now, stats, rng);
+}
+
+static void flushOut(Conn& c, Stats& stats) {
+    while (!c.out.empty()) {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+            c.out.erase(0, n);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        closeConn(c, stats);
+        return;
+    }
+}
+
+// Blocking GET /status, returns the body or "" on failure
+static std::string httpGet(const Options& opt, const char* path) {
+    int fd = openSocket(opt, false);
+    if (fd < 0) return "";
+    timeval tv{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::string req = std::string("GET ") + path + " HTTP/1.1\r\nHost: " + opt.host + "\r\nConnection: close\r\n\r\n";
+    send(fd, req.data(), req.size(), MSG_NOSIGNAL);
+
+    std::string resp;
+    char buf[2048];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) resp.append(buf, n);
+    close(fd);
+
+    size_t body = resp.find("\r\n\r\n");
+    return body == std::string::npos ? "" : resp.substr(body + 4);
+}
+
+static long jsonNumber(const std::string& json, const char* key) {
+    std::string k = std::string("\"") + key + "\":";
+    size_t at = json.find(k);
+    if (at == std::string::npos) return -1;
+    return strtol(json.c_str() + at + k.size(), nullptr, 10);
+}
+
+static void sampleStatus(const Options& opt, Stats& stats) {
+    std::string body = httpGet(opt, "/status");
+    if (body.empty()) return;
+    long heap = jsonNumber(body, "freeHeap");
+    long loop = jsonNumber(body, "loopUs");
+    long loopMax = jsonNumber(body, "loopUsMax");
+    if (heap >= 0 && (stats.heapMin < 0 || heap < stats.heapMin)) stats.heapMin = heap;
+    if (loop >= 0) stats.loopUs.push_back(loop);
+    if (loopMax >= 0) stats.loopUsMax.push_back(loopMax);
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t idx = (size_t)(p / 100.0 * (v.size() - 1) + 0.5);
+    return v[std::min(idx, v.size() - 1)];
+}
+
+static void writeDist(FILE* f, const char* name, const std::vector<double>& v, bool last) {
+    fprintf(f, "    \"%s\": {\"count\": %zu, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}%s\n",
+            name, v.size(), percentile(v, 50), percentile(v, 90), percentile(v, 99),
+            v.empty() ? 0.0 : *std::max_element(v.begin(), v.end()), last ? "" : ",");
+}
+
+static bool writeReport(const Options& opt, const Stats& stats) {
+    FILE* f = fopen(opt.out.c_str(), "w");
+    if (!f) return false;
+
+    std::vector<double> allEcho;
+    for (int i = 0; i < COMMAND_COUNT; i++) allEcho.insert(allEcho.end(), stats.echoMs[i].begin(), stats.echoMs[i].end());
+    double loopAvg = 0;
+    for (double v : stats.loopUs) loopAvg += v;
+    if (!stats.loopUs.empty()) loopAvg /= stats.loopUs.size();
+    long heapPerClient = (stats.heapBefore >= 0 && stats.heapMin >= 0 && stats.connected > 0)
+                         ? (stats.heapBefore - stats.heapMin) / stats.connected : -1;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"config\": {\"host\": \"%s\", \"port\": %d, \"clients\": %d, \"durationSec\": %d, \"commandsPerSec\": %.3f, \"flood\": %d, \"floodRate\": %.1f},\n",
+            opt.host.c_str(), opt.port, opt.clients, opt.durationSec, opt.commandsPerSec, opt.flood, opt.floodRate);
+    fprintf(f, "  \"connections\": {\"connected\": %d, \"failed\": %d, \"dropped\": %d},\n",
+            stats.connected, stats.connectFailures, stats.disconnects);
+    fprintf(f, "  \"traffic\": {\"frames\": %llu, \"bytes\": %llu, \"commands\": %llu, \"echoTimeouts\": %llu},\n",
+            (unsigned long long)stats.frames, (unsigned long long)stats.bytes,
+            (unsigned long long)stats.commandsSent, (unsigned long long)stats.echoTimeouts);
+    fprintf(f, "  \"flood\": {\"commands\": %llu, \"refusals\": %llu},\n",
+            (unsigned long long)stats.floodCommands, (unsigned long long)stats.floodRefusals);
+    fprintf(f, "  \"alerts\": {\"received\": %llu, \"repeats\": %llu, \"missing\": %llu},\n",
+            (unsigned long long)stats.alerts, (unsigned long long)stats.alertRepeats,
+            (unsigned long long)stats.alertsMissing);
+    fprintf(f, "  \"latencyMs\": {\n");
+    writeDist(f, "roomInterval", stats.roomIntervalMs, false);
+    writeDist(f, "roomLateness", stats.roomLatenessMs, false);
+    writeDist(f, "commandEcho", allEcho, false);
+    writeDist(f, "alert.unlockDoor", stats.alertMs, false);
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        std::string name = std::string("echo.") + COMMANDS[i].text;
+        writeDist(f, name.c_str(), stats.echoMs[i], i == COMMAND_COUNT - 1);
+    }
+    fprintf(f, "  },\n");
+    fprintf(f, "  \"server\": {\"heapBefore\": %ld, \"heapMin\": %ld, \"heapPerClient\": %ld, \"loopUsAvg\": %.1f,\n",
+            stats.heapBefore, stats.heapMin, heapPerClient, loopAvg);
+    writeDist(f, "loopUsMax", stats.loopUsMax, true);
+    fprintf(f, "  }\n");
+    fprintf(f, "}\n");
+    fclose(f);
+    return true;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--host H] [--port P] [--clients N] [--duration S] [--rate CMD_PER_SEC] [--ramp MS] [--flood N] [--flood-rate CMD_PER_SEC] [--out FILE]\n", prog);
+    fprintf(stderr, "--clients plus --flood is at most %d, the clients the device keeps\n", DEVICE_MAX_CLIENTS);
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* v = argv[++i];
+        if (a == "--host") opt.host = v;
+        else if (a == "--port") opt.port = atoi(v);
+        else if (a == "--clients") opt.clients = atoi(v);
+        else if (a == "--duration") opt.durationSec = atoi(v);
+        else if (a == "--rate") opt.commandsPerSec = atof(v);
+        else if (a == "--ramp") opt.rampMs = atoi(v);
+        else if (a == "--flood") opt.flood = atoi(v);
+        else if (a == "--flood-rate") opt.floodRate = atof(v);
+        else if (a == "--out") opt.out = v;
+        else return false;
+    }
+    return opt.clients > 0 && opt.durationSec > 0 && opt.flood >= 0 && opt.floodRate > 0 &&
+           opt.clients + opt.flood <= DEVICE_MAX_CLIENTS;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::mt19937 rng(12345);
+    int totalWeight = 0;
+    for (int i = 0; i < COMMAND_COUNT; i++) totalWeight += COMMANDS[i].weight;
+    std::exponential_distribution<double> gap(opt.commandsPerSec > 0 ? opt.commandsPerSec : 1.0);
+
+    Stats stats;
+    std::string body = httpGet(opt, "/status");
+    stats.heapBefore = jsonNumber(body, "freeHeap");
+
+    std::vector<Conn> conns(opt.clients + opt.flood);
+    for (int i = opt.clients; i < (int)conns.size(); i++) conns[i].flood = true;
+    uint64_t start = nowUs();
+    uint64_t end = start + (uint64_t)opt.durationSec * 1000000ULL;
+    uint64_t nextStatus = start;
+    int opened = 0;
+    uint64_t nextOpen = start;
+
+    std::vector<pollfd> pfds;
+    std::vector<int> owners;
+
+    while (nowUs() < end) {
+        uint64_t now = nowUs();
+
+        // Ramp up connections
+        if (opened < (int)conns.size() && now >= nextOpen) {
+            Conn& c = conns[opened++];
+            c.fd = openSocket(opt, true);
+            if (c.fd < 0) {
+                stats.connectFailures++;
+            } else {
+                c.state = CONN_CONNECTING;
+                c.out = "GET /ws HTTP/1.1\r\nHost: " + opt.host +
+                        "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                        "Sec-WebSocket-Version: 13\r\n\r\n";
+                c.nextCommandUs = now + (uint64_t)(gap(rng) * 1e6);
+            }
+            nextOpen = now + (uint64_t)opt.rampMs * 1000ULL;
+        }
+
+        // Issue commands (one outstanding per connection)
+        for (Conn& c : conns) {
+            if (c.state != CONN_OPEN) continue;
+            if (c.flood) {
+                // Fire and forget, bounded only by the socket
+                if (now >= c.nextCommandUs && c.out.size() < 4096) {
+                    appendFrame(c.out, 0x1, COMMANDS[rng() % COMMAND_COUNT].text, rng);
+                    c.nextCommandUs = now + (uint64_t)(1e6 / opt.floodRate);
+                    stats.floodCommands++;
+                }
+                continue;
+            }
+            if (c.pending >= 0 && now - c.pendingSinceUs > ECHO_TIMEOUT_MS * 1000ULL) {
+                stats.echoTimeouts++;
+                c.pending = -1;
+            }
+            if (c.pending < 0 && opt.commandsPerSec > 0 && now >= c.nextCommandUs) {
+                int pick = rng() % totalWeight;
+                int idx = 0;
+                while (pick >= COMMANDS[idx].weight) pick -= COMMANDS[idx++].weight;
+                appendFrame(c.out, 0x1, COMMANDS[idx].text, rng);
+                c.pending = idx;
+                c.pendingSinceUs = now;
+                if (strcmp(COMMANDS[idx].text, "unlockDoor") == 0) c.unlockSentUs = now;
+                c.nextCommandUs = now + (uint64_t)(gap(rng) * 1e6);
+                stats.commandsSent++;
+            }
+        }
+
+        if (now >= nextStatus) {
+            nextStatus = now + STATUS_INTERVAL_MS * 1000ULL;
+            sampleStatus(opt, stats);
+        }
+
+        pfds.clear();
+        owners.clear();
+        for (size_t i = 0; i < conns.size(); i++) {
+            Conn& c = conns[i];
+            if (c.fd < 0) continue;
+            short events = POLLIN;
+            if (c.state == CONN_CONNECTING || !c.out.empty()) events |= POLLOUT;
+            pfds.push_back({c.fd, events, 0});
+            owners.push_back(i);
+        }
+        if (pfds.empty()) {
+            usleep(1000);
+            continue;
+        }
+
+        if (poll(pfds.data(), pfds.size(), 5) <= 0) continue;
+        now = nowUs();
+
+        for (size_t i = 0; i < pfds.size(); i++) {
+            Conn& c = conns[owners[i]];
+            if (c.fd < 0) continue;
+            if (pfds[i].revents & (POLLERR | POLLHUP)) {
+                if (c.state == CONN_CONNECTING) stats.connectFailures++;
+                closeConn(c, stats);
+                continue;
+            }
+            if (c.state == CONN_CONNECTING && (pfds[i].revents & POLLOUT)) c.state = CONN_HANDSHAKE;
+            if (pfds[i].revents & POLLOUT) flushOut(c, stats);
+            if (c.fd >= 0 && (pfds[i].revents & POLLIN)) onReadable(c, now, stats, rng);
+            if (c.fd >= 0 && !c.out.empty()) flushOut(c, stats);
+        }
+    }
+
+    for (Conn& c : conns) {
+        if (c.fd >= 0) close(c.fd);
+    }
+
+    if (!writeReport(opt, stats)) {
+        fprintf(stderr, "cannot write %s\n", opt.out.c_str());
+        return 1;
+    }
+    printf("connected %d/%d, %llu frames, %llu commands, report written to %s\n",
+           stats.connected, opt.clients + opt.flood, (unsigned long long)stats.frames,
+           (unsigned long long)stats.commandsSent, opt.out.c_str());
+    return 0;
+}